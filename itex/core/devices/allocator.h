@@ -16,10 +16,64 @@ limitations under the License.
 #ifndef ITEX_CORE_DEVICES_ALLOCATOR_H_
 #define ITEX_CORE_DEVICES_ALLOCATOR_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace itex {
 
+// Runtime statistics of an allocator.
+struct AllocatorStats {
+  int64_t num_allocs = 0;
+  // Bytes of the allocations in use, rounded up to the allocator's
+  // granularity.
+  int64_t bytes_in_use = 0;
+  int64_t peak_bytes_in_use = 0;
+  int64_t largest_alloc_size = 0;
+  // Bytes the clients asked for, of the allocations in use out of thread
+  // caches.
+  int64_t requested_bytes_in_use = 0;
+  int64_t peak_requested_bytes_in_use = 0;
+  // Bytes the allocator may take from the system.
+  int64_t bytes_limit = 0;
+  // Bytes the allocator has taken from the system.
+  int64_t bytes_reserved = 0;
+  // The largest block which can be allocated without taking more memory.
+  int64_t largest_free_block_bytes = 0;
+  // Bytes of freed allocations kept in per-thread caches, which are counted
+  // in `bytes_in_use`.
+  int64_t bytes_in_thread_caches = 0;
+
+  // Fraction of the free reserved memory outside the largest free block.
+  // 0 means no fragmentation.
+  double Fragmentation() const {
+    const int64_t free_bytes = bytes_reserved - bytes_in_use;
+    if (free_bytes <= 0) return 0;
+    return 1.0 - static_cast<double>(largest_free_block_bytes) / free_bytes;
+  }
+
+  // Fraction of the bytes in use wasted by rounding and unsplit chunks.
+  double InternalFragmentation() const {
+    const int64_t used_bytes = bytes_in_use - bytes_in_thread_caches;
+    if (used_bytes <= 0) return 0;
+    return 1.0 - static_cast<double>(requested_bytes_in_use) / used_bytes;
+  }
+};
+
+// Source of the large memory regions which an allocator splits into
+// allocations.
+class SubAllocator {
+ public:
+  SubAllocator() = default;
+  virtual ~SubAllocator() = default;
+
+  // Returns a region of "num_bytes" bytes, or nullptr on failure.
+  virtual void* Alloc(size_t num_bytes) = 0;
+
+  // Frees a region returned by Alloc() of the same size.
+  virtual void Free(void* ptr, size_t num_bytes) = 0;
+};
+
 class Allocator {
  public:
   Allocator() = default;
@@ -35,6 +89,13 @@ class Allocator {
   // Deallocate a block of memory pointer to by "ptr"
   // REQUIRES: "ptr" was previously returned by a call to AllocateRaw
   virtual void DeallocateRaw(void* ptr) = 0;
+
+  // Fills in "stats" and returns true if the allocator collects statistics.
+  virtual bool GetStats(AllocatorStats* stats) { return false; }
+
+  // Resets the counters and sets the peaks to the current usage. Returns
+  // false if the allocator doesn't collect statistics.
+  virtual bool ClearStats() { return false; }
 };
 
 }  // namespace itex
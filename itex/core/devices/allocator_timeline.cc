@@ -0,0 +1,183 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "itex/core/devices/allocator_timeline.h"
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include "absl/strings/string_view.h"
+#include "itex/core/utils/annotation_stack.h"
+#include "itex/core/utils/env_var.h"
+#include "itex/core/utils/logging.h"
+
+namespace itex {
+
+namespace {
+
+struct TimelineRegistry {
+  mutex mu;
+  std::set<AllocatorTimeline*> timelines TF_GUARDED_BY(mu);
+};
+
+TimelineRegistry* GetRegistry() {
+  static TimelineRegistry* registry = new TimelineRegistry;
+  return registry;
+}
+
+string GetTimelineFile() {
+  string path;
+  ITEX_CHECK_OK(
+      ReadStringFromEnvVar("ITEX_ALLOCATOR_TIMELINE_FILE", "", &path));
+  return path;
+}
+
+void DumpAllTimelines() {
+  const string path = GetTimelineFile();
+  TimelineRegistry* registry = GetRegistry();
+  mutex_lock lock(&registry->mu);
+  for (AllocatorTimeline* timeline : registry->timelines) {
+    timeline->Dump(path);
+  }
+}
+
+// Returns the innermost op of the annotation stack of the calling thread.
+// Kernel annotations look like "op_name:op_type#shape=...#", the metadata is
+// dropped.
+absl::string_view CurrentOpName() {
+  absl::string_view annotation = AnnotationStack::Get();
+  size_t pos = annotation.rfind("::");
+  if (pos != absl::string_view::npos) annotation.remove_prefix(pos + 2);
+  return annotation.substr(0, annotation.find('#'));
+}
+
+}  // namespace
+
+AllocatorTimeline* AllocatorTimeline::MaybeCreate(const string& name,
+                                                  Allocator* allocator) {
+  int64 capacity;
+  ITEX_CHECK_OK(
+      ReadInt64FromEnvVar("ITEX_ALLOCATOR_TIMELINE_SIZE", 0, &capacity));
+  if (capacity <= 0) return nullptr;
+
+  // Kernels annotate themselves only when the annotation stack is enabled.
+  AnnotationStack::Enable(true);
+  static bool dump_at_exit = []() {
+    std::atexit(DumpAllTimelines);
+    return true;
+  }();
+  (void)dump_at_exit;
+
+  auto* timeline =
+      new AllocatorTimeline(name, allocator, static_cast<size_t>(capacity));
+  TimelineRegistry* registry = GetRegistry();
+  mutex_lock lock(&registry->mu);
+  registry->timelines.insert(timeline);
+  return timeline;
+}
+
+AllocatorTimeline::AllocatorTimeline(const string& name, Allocator* allocator,
+                                     size_t capacity)
+    : name_(name), allocator_(allocator), events_(capacity) {}
+
+AllocatorTimeline::~AllocatorTimeline() {
+  {
+    TimelineRegistry* registry = GetRegistry();
+    mutex_lock lock(&registry->mu);
+    registry->timelines.erase(this);
+  }
+  Dump(GetTimelineFile());
+}
+
+void AllocatorTimeline::Record(bool is_alloc, const void* ptr,
+                               int64 requested_bytes, int64 chunk_bytes,
+                               int64 requested_bytes_in_use) {
+  absl::string_view op_name = CurrentOpName();
+  // Wall time, same clock as the profiler, so that events can be matched
+  // with traces.
+  uint64 time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+  mutex_lock lock(&mu_);
+  Event& event = events_[next_];
+  event.time_ns = time_ns;
+  event.is_alloc = is_alloc;
+  event.ptr = ptr;
+  event.requested_bytes = requested_bytes;
+  event.chunk_bytes = chunk_bytes;
+  event.requested_bytes_in_use = requested_bytes_in_use;
+  event.op_name.assign(op_name.data(), op_name.size());
+  next_ = (next_ + 1) % events_.size();
+  num_events_++;
+}
+
+std::vector<AllocatorTimeline::Event> AllocatorTimeline::GetEvents() {
+  mutex_lock lock(&mu_);
+  std::vector<Event> events;
+  if (num_events_ < events_.size()) {
+    events.assign(events_.begin(), events_.begin() + next_);
+  } else {
+    events.assign(events_.begin() + next_, events_.end());
+    events.insert(events.end(), events_.begin(), events_.begin() + next_);
+  }
+  return events;
+}
+
+void AllocatorTimeline::Dump(const string& path) {
+  std::ostringstream output;
+  AllocatorStats stats;
+  if (allocator_->GetStats(&stats)) {
+    output << "# allocator=" << name_ << " num_allocs=" << stats.num_allocs
+           << " bytes_in_use=" << stats.bytes_in_use
+           << " peak_bytes_in_use=" << stats.peak_bytes_in_use
+           << " requested_bytes_in_use=" << stats.requested_bytes_in_use
+           << " peak_requested_bytes_in_use="
+           << stats.peak_requested_bytes_in_use
+           << " largest_alloc_size=" << stats.largest_alloc_size
+           << " bytes_reserved=" << stats.bytes_reserved
+           << " bytes_limit=" << stats.bytes_limit
+           << " largest_free_block_bytes=" << stats.largest_free_block_bytes
+           << " fragmentation=" << stats.Fragmentation()
+           << " internal_fragmentation=" << stats.InternalFragmentation()
+           << "\n";
+  }
+  output << "time_ns,event,ptr,requested_bytes,chunk_bytes,"
+            "requested_bytes_in_use,op_name\n";
+  for (const Event& event : GetEvents()) {
+    output << event.time_ns << "," << (event.is_alloc ? "alloc" : "free")
+           << "," << event.ptr << "," << event.requested_bytes << ","
+           << event.chunk_bytes << "," << event.requested_bytes_in_use << ","
+           << event.op_name << "\n";
+  }
+
+  if (path.empty()) {
+    ITEX_LOG(INFO) << "Timeline of allocator " << name_ << ":\n"
+                   << output.str();
+    return;
+  }
+  string file = path + "." + name_;
+  std::ofstream stream(file, std::ios::out | std::ios::trunc);
+  stream << output.str();
+  stream.close();
+  if (!stream.good()) {
+    ITEX_LOG(WARNING) << "Failed to write allocator timeline file " << file;
+  }
+}
+
+}  // namespace itex
@@ -0,0 +1,87 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef ITEX_CORE_DEVICES_ALLOCATOR_TIMELINE_H_
+#define ITEX_CORE_DEVICES_ALLOCATOR_TIMELINE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "itex/core/devices/allocator.h"
+#include "itex/core/utils/macros.h"
+#include "itex/core/utils/mutex.h"
+#include "itex/core/utils/types.h"
+
+namespace itex {
+
+// Ring buffer of the latest allocation and deallocation events of an
+// allocator. Each event is tagged with the op being executed by the calling
+// thread, taken from the annotation stack, so that a dump shows which ops
+// hold the memory at the peak.
+//
+// The timeline is enabled by `ITEX_ALLOCATOR_TIMELINE_SIZE`, the number of
+// events kept per allocator. Timelines are written at process exit to
+// `ITEX_ALLOCATOR_TIMELINE_FILE` suffixed by the allocator name, or to the
+// log if it's not set.
+class AllocatorTimeline {
+ public:
+  struct Event {
+    uint64 time_ns = 0;
+    bool is_alloc = false;
+    const void* ptr = nullptr;
+    // Bytes the client asked for, and bytes of the chunk handed out.
+    int64 requested_bytes = 0;
+    int64 chunk_bytes = 0;
+    // Requested bytes in use of the allocator after the event.
+    int64 requested_bytes_in_use = 0;
+    string op_name;
+  };
+
+  // Returns a timeline for allocator `name`, or nullptr if timelines are not
+  // enabled. The timeline is dumped when it's destroyed or at exit, whichever
+  // comes first. It must be destroyed before `allocator`.
+  static AllocatorTimeline* MaybeCreate(const string& name,
+                                        Allocator* allocator);
+  ~AllocatorTimeline();
+
+  void Record(bool is_alloc, const void* ptr, int64 requested_bytes,
+              int64 chunk_bytes, int64 requested_bytes_in_use);
+
+  // Returns the events in the buffer from the oldest one.
+  std::vector<Event> GetEvents();
+
+  // Writes the allocator stats and the events as CSV to `path`, or to the
+  // log if `path` is empty.
+  void Dump(const string& path);
+
+ private:
+  AllocatorTimeline(const string& name, Allocator* allocator,
+                    size_t capacity);
+
+  const string name_;
+  Allocator* allocator_;
+  mutex mu_;
+  std::vector<Event> events_ TF_GUARDED_BY(mu_);
+  // Index of the next event to write, and number of events ever recorded.
+  size_t next_ TF_GUARDED_BY(mu_) = 0;
+  uint64 num_events_ TF_GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AllocatorTimeline);
+};
+
+}  // namespace itex
+
+#endif  // ITEX_CORE_DEVICES_ALLOCATOR_TIMELINE_H_
@@ -15,17 +15,85 @@ limitations under the License.
 
 #include "itex/core/devices/bfc_allocator.h"
 
+#include "absl/memory/memory.h"
+#ifndef INTEL_CPU_ONLY
+#include "itex/core/utils/hw_info.h"
+#endif  // INTEL_CPU_ONLY
+
 namespace itex {
 
-BFCAllocator::BFCAllocator(DPCPPDevice* device) : Allocator() {
-  device_ = device;
-  memory_limit_ = device_->get_info<sycl::info::device::global_mem_size>();
+namespace {
+
+// Unique among all allocators of the process, so that the thread local cache
+// maps never mix up a destroyed allocator with a new one.
+uint64 NextAllocatorId() {
+  static std::atomic<uint64> next_id{0};
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+#ifndef INTEL_CPU_ONLY
+class DPCPPSubAllocator : public SubAllocator {
+ public:
+  explicit DPCPPSubAllocator(DPCPPDevice* device) : device_(device) {}
+
+  void* Alloc(size_t num_bytes) override {
+    return dpcppMalloc(device_, num_bytes);
+  }
+
+  void Free(void* ptr, size_t num_bytes) override { dpcppFree(device_, ptr); }
+
+ private:
+  DPCPPDevice* device_;
+};
+
+BFCAllocator::Options GetDeviceOptions(DPCPPDevice* device) {
+  BFCAllocator::Options options;
+  options.memory_limit =
+      device->get_info<sycl::info::device::global_mem_size>();
   size_t _800mb = 800 * 1024 * 1024;
   // Leave 800MB memory for system like proper did.
-  memory_limit_ -= _800mb;
-  ITEX_VLOG(1) << "Set memory limit to " << memory_limit_ << " Bytes";
-  curr_region_allocation_bytes_ = RoundedBytes(memory_limit_);
+  options.memory_limit -= _800mb;
+
+  // This sets the upper bound of memory allocation size, the actuall
+  // allocation size is the minimal value of this limit size and the size want
+  // to get from system.
+  int64 limit_size = 4 * 1024;  // unit is MB
+  if (IsXeHPC(device)) {
+    // Use a big value that means do not set limit.
+    limit_size = 1024 * 1024;
+  }
+  TF_ABORT_IF_ERROR(ReadInt64FromEnvVar("ITEX_LIMIT_MEMORY_SIZE_IN_MB",
+                                        limit_size, &limit_size));
+  options.max_region_bytes = limit_size * 1024 * 1024;
+
+  int64 thread_cache_kb;
+  TF_ABORT_IF_ERROR(
+      ReadInt64FromEnvVar("ITEX_DEVICE_BFC_THREAD_CACHE_MAX_CHUNK_IN_KB", 0,
+                          &thread_cache_kb));
+  options.thread_cache_max_chunk_bytes = thread_cache_kb * 1024;
+  return options;
+}
+#endif  // INTEL_CPU_ONLY
+
+}  // namespace
+
+BFCAllocator::BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator,
+                           const Options& options, const string& name)
+    : Allocator(),
+      sub_allocator_(std::move(sub_allocator)),
+      options_(options),
+      name_(name),
+      id_(NextAllocatorId()) {
+  memory_limit_ = options_.memory_limit;
+  ITEX_VLOG(1) << "Set memory limit of " << name_ << " to " << memory_limit_
+               << " Bytes";
+  curr_region_allocation_bytes_ = RoundedBytes(
+      options_.initial_region_bytes == 0
+          ? memory_limit_
+          : std::min(options_.initial_region_bytes, memory_limit_));
   free_chunks_list_ = kInvalidChunkHandle;
+  stats_.bytes_limit = static_cast<int64_t>(memory_limit_);
+  timeline_.reset(AllocatorTimeline::MaybeCreate(name_, this));
 
   // Create a bunch of bins of various good sizes.
 
@@ -45,13 +113,21 @@ BFCAllocator::BFCAllocator(DPCPPDevice* device) : Allocator() {
   }
 }
 
+#ifndef INTEL_CPU_ONLY
+BFCAllocator::BFCAllocator(DPCPPDevice* device)
+    : BFCAllocator(absl::make_unique<DPCPPSubAllocator>(device),
+                   GetDeviceOptions(device), "itex_device_bfc") {}
+#endif  // INTEL_CPU_ONLY
+
 BFCAllocator::~BFCAllocator() {
+  timeline_.reset();
+
   // Return memory back.
   ITEX_VLOG(2) << "Number of regions allocated: "
                << region_manager_.regions().size();
   for (const auto& region : region_manager_.regions()) {
     if (region.ptr()) {
-      dpcppFree(device_, region.ptr());
+      sub_allocator_->Free(region.ptr(), region.memory_size());
     }
   }
 
@@ -71,30 +147,25 @@ void* BFCAllocator::AllocateRaw(size_t num_bytes) {
   // so all memory addresses are nicely byte aligned.
   size_t rounded_bytes = RoundedBytes(num_bytes);
 
-  // The BFC allocator tries to find the best fit first.
-  BinNum bin_num = BinNumForSize(rounded_bytes);
-
-  mutex_lock l(&lock_);
-
-  void* ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes);
+  size_t chunk_size = 0;
+  void* ptr = nullptr;
+  if (UseThreadCache(rounded_bytes)) {
+    ptr = AllocateFromThreadCache(rounded_bytes, &chunk_size);
+  }
+  if (ptr == nullptr) {
+    ptr = AllocateChunkPtr(rounded_bytes, num_bytes, &chunk_size);
+  }
   if (ptr != nullptr) {
+    if (UseThreadCache(chunk_size)) {
+      RecordChunkSizes(ptr, {chunk_size, num_bytes});
+    }
+    RecordAlloc(ptr, num_bytes, chunk_size);
     ITEX_VLOG(2) << "Requested bytes: " << num_bytes
                  << ", allocated_bytes: " << rounded_bytes
                  << ", allocator_name: " << Name() << ", ptr: " << ptr;
     return ptr;
   }
 
-  // No memory in current memory pool, try to extend from system.
-  if (Extend(rounded_bytes)) {
-    ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes);
-    if (ptr != nullptr) {
-      ITEX_VLOG(2) << "Requested bytes: " << num_bytes
-                   << ", allocated_bytes: " << rounded_bytes
-                   << ", allocator_name: " << Name() << ", ptr: " << ptr;
-      return ptr;
-    }
-  }
-
   ITEX_LOG(ERROR) << "Allocator ran out of memory trying "
                   << "to allocate " << num_bytes << " Bytes"
                   << " (rounded to " << rounded_bytes << " Bytes)";
@@ -102,21 +173,233 @@ void* BFCAllocator::AllocateRaw(size_t num_bytes) {
   return nullptr;
 }
 
+void* BFCAllocator::AllocateChunkPtr(size_t rounded_bytes, size_t num_bytes,
+                                     size_t* chunk_size) {
+  // The BFC allocator tries to find the best fit first.
+  BinNum bin_num = BinNumForSize(rounded_bytes);
+  mutex_lock l(&lock_);
+
+  void* ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes);
+  // No memory in current memory pool, try to extend from system.
+  if (ptr == nullptr && Extend(rounded_bytes)) {
+    ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes);
+  }
+  // The free chunks may be held by thread caches, put them back and retry.
+  if (ptr == nullptr && !thread_caches_.empty()) {
+    DrainThreadCaches();
+    ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes);
+    if (ptr == nullptr && Extend(rounded_bytes)) {
+      ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes);
+    }
+  }
+  if (ptr == nullptr) return nullptr;
+
+  *chunk_size = ChunkFromHandle(region_manager_.get_handle(ptr))->size;
+  stats_.num_allocs++;
+  stats_.bytes_in_use += *chunk_size;
+  stats_.peak_bytes_in_use =
+      std::max(stats_.peak_bytes_in_use, stats_.bytes_in_use);
+  stats_.largest_alloc_size =
+      std::max<int64_t>(stats_.largest_alloc_size, *chunk_size);
+  return ptr;
+}
+
 void BFCAllocator::DeallocateRaw(void* ptr) {
   ITEX_VLOG(1) << "Deallocate " << ptr;
   if (ptr == nullptr) {
     ITEX_VLOG(1) << "tried to deallocate nullptr";
     return;
   }
-  mutex_lock l(&lock_);
 
+  ChunkSizes sizes;
+  if (options_.thread_cache_max_chunk_bytes > 0 &&
+      LookUpChunkSizes(ptr, &sizes)) {
+    RecordFree(ptr, sizes.requested_size, sizes.size);
+    if (DeallocateToThreadCache(ptr, sizes.size)) return;
+    mutex_lock l(&lock_);
+    FreeChunkPtr(ptr, nullptr);
+    return;
+  }
+
+  size_t chunk_size = 0;
+  {
+    mutex_lock l(&lock_);
+    chunk_size = FreeChunkPtr(ptr, &sizes.requested_size);
+  }
+  RecordFree(ptr, sizes.requested_size, chunk_size);
+}
+
+size_t BFCAllocator::FreeChunkPtr(void* ptr, size_t* requested_size) {
   // Find the chunk from the ptr.
   BFCAllocator::ChunkHandle h = region_manager_.get_handle(ptr);
   ITEX_CHECK(h != kInvalidChunkHandle);
   Chunk* chunk = ChunkFromHandle(h);
+  const size_t chunk_size = chunk->size;
+  if (requested_size != nullptr) *requested_size = chunk->requested_size;
+  stats_.bytes_in_use -= chunk_size;
+  if (UseThreadCache(chunk_size)) EraseChunkSizes(ptr);
   // Mark the chunk as no longer in use.
   chunk->allocation_id = -1;
   InsertFreeChunkIntoBin(TryToCoalesce(h));
+  return chunk_size;
+}
+
+void BFCAllocator::RecordAlloc(const void* ptr, size_t requested_size,
+                               size_t chunk_size) {
+  const int64 requested_bytes_in_use =
+      requested_bytes_in_use_.fetch_add(requested_size,
+                                        std::memory_order_relaxed) +
+      requested_size;
+  int64 peak = peak_requested_bytes_in_use_.load(std::memory_order_relaxed);
+  while (peak < requested_bytes_in_use &&
+         !peak_requested_bytes_in_use_.compare_exchange_weak(
+             peak, requested_bytes_in_use, std::memory_order_relaxed)) {
+  }
+  if (ITEX_PREDICT_FALSE(timeline_ != nullptr)) {
+    timeline_->Record(true, ptr, requested_size, chunk_size,
+                      requested_bytes_in_use);
+  }
+}
+
+void BFCAllocator::RecordFree(const void* ptr, size_t requested_size,
+                              size_t chunk_size) {
+  const int64 requested_bytes_in_use =
+      requested_bytes_in_use_.fetch_sub(requested_size,
+                                        std::memory_order_relaxed) -
+      requested_size;
+  if (ITEX_PREDICT_FALSE(timeline_ != nullptr)) {
+    timeline_->Record(false, ptr, requested_size, chunk_size,
+                      requested_bytes_in_use);
+  }
+}
+
+BFCAllocator::ThreadCache* BFCAllocator::GetThreadCache() {
+  // Keyed by allocator id, the caches of destroyed allocators are left
+  // behind until the thread exits.
+  thread_local std::unordered_map<uint64, std::shared_ptr<ThreadCache>>
+      caches;
+  auto it = caches.find(id_);
+  if (ITEX_PREDICT_TRUE(it != caches.end())) return it->second.get();
+
+  auto cache = std::make_shared<ThreadCache>();
+  {
+    mutex_lock cache_lock(&cache->mu);
+    cache->bins.resize(BinNumForSize(options_.thread_cache_max_chunk_bytes) +
+                       1);
+  }
+  {
+    mutex_lock l(&lock_);
+    thread_caches_.push_back(cache);
+  }
+  caches.emplace(id_, cache);
+  return cache.get();
+}
+
+void* BFCAllocator::AllocateFromThreadCache(size_t rounded_bytes,
+                                            size_t* chunk_size) {
+  ThreadCache* cache = GetThreadCache();
+  mutex_lock cache_lock(&cache->mu);
+  // Chunks in the same bin are less than twice of 'rounded_bytes', which is
+  // the same bound as FindChunkPtr() splits chunks by.
+  std::vector<ThreadCache::Entry>& bin =
+      cache->bins[BinNumForSize(rounded_bytes)];
+  for (auto it = bin.rbegin(); it != bin.rend(); ++it) {
+    if (it->size < rounded_bytes) continue;
+    void* ptr = it->ptr;
+    *chunk_size = it->size;
+    bytes_in_thread_caches_.fetch_sub(it->size, std::memory_order_relaxed);
+    num_thread_cache_allocs_.fetch_add(1, std::memory_order_relaxed);
+    bin.erase(std::next(it).base());
+    return ptr;
+  }
+  return nullptr;
+}
+
+bool BFCAllocator::DeallocateToThreadCache(void* ptr, size_t chunk_size) {
+  ThreadCache* cache = GetThreadCache();
+  mutex_lock cache_lock(&cache->mu);
+  std::vector<ThreadCache::Entry>& bin = cache->bins[BinNumForSize(chunk_size)];
+  if (bin.size() >= static_cast<size_t>(options_.thread_cache_chunks_per_bin)) {
+    return false;
+  }
+  bin.push_back({ptr, chunk_size});
+  bytes_in_thread_caches_.fetch_add(chunk_size, std::memory_order_relaxed);
+  return true;
+}
+
+void BFCAllocator::DrainThreadCaches() {
+  for (const auto& cache : thread_caches_) {
+    mutex_lock cache_lock(&cache->mu);
+    for (auto& bin : cache->bins) {
+      for (const ThreadCache::Entry& entry : bin) {
+        bytes_in_thread_caches_.fetch_sub(entry.size,
+                                          std::memory_order_relaxed);
+        FreeChunkPtr(entry.ptr, nullptr);
+      }
+      bin.clear();
+    }
+  }
+}
+
+void BFCAllocator::RecordChunkSizes(const void* ptr, const ChunkSizes& sizes) {
+  ChunkSizeShard* shard = ChunkSizeShardFor(ptr);
+  mutex_lock shard_lock(&shard->mu);
+  shard->sizes[ptr] = sizes;
+}
+
+bool BFCAllocator::LookUpChunkSizes(const void* ptr, ChunkSizes* sizes) {
+  ChunkSizeShard* shard = ChunkSizeShardFor(ptr);
+  mutex_lock shard_lock(&shard->mu);
+  auto it = shard->sizes.find(ptr);
+  if (it == shard->sizes.end()) return false;
+  *sizes = it->second;
+  return true;
+}
+
+void BFCAllocator::EraseChunkSizes(const void* ptr) {
+  ChunkSizeShard* shard = ChunkSizeShardFor(ptr);
+  mutex_lock shard_lock(&shard->mu);
+  shard->sizes.erase(ptr);
+}
+
+size_t BFCAllocator::LargestFreeChunkSize() const {
+  for (BinNum b = kNumBins - 1; b >= 0; b--) {
+    const Bin* bin = reinterpret_cast<const Bin*>(
+        &(bins_space_[b * sizeof(Bin)]));
+    if (!bin->free_chunks.empty()) {
+      return ChunkFromHandle(*bin->free_chunks.rbegin())->size;
+    }
+  }
+  return 0;
+}
+
+bool BFCAllocator::GetStats(AllocatorStats* stats) {
+  mutex_lock l(&lock_);
+  *stats = stats_;
+  stats->num_allocs +=
+      num_thread_cache_allocs_.load(std::memory_order_relaxed);
+  stats->requested_bytes_in_use =
+      requested_bytes_in_use_.load(std::memory_order_relaxed);
+  stats->peak_requested_bytes_in_use =
+      peak_requested_bytes_in_use_.load(std::memory_order_relaxed);
+  stats->bytes_reserved = static_cast<int64_t>(total_region_allocated_bytes_);
+  stats->largest_free_block_bytes =
+      static_cast<int64_t>(LargestFreeChunkSize());
+  stats->bytes_in_thread_caches =
+      bytes_in_thread_caches_.load(std::memory_order_relaxed);
+  return true;
+}
+
+bool BFCAllocator::ClearStats() {
+  mutex_lock l(&lock_);
+  stats_.num_allocs = 0;
+  stats_.peak_bytes_in_use = stats_.bytes_in_use;
+  stats_.largest_alloc_size = 0;
+  num_thread_cache_allocs_.store(0, std::memory_order_relaxed);
+  peak_requested_bytes_in_use_.store(
+      requested_bytes_in_use_.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+  return true;
 }
 
 // static
@@ -235,25 +518,6 @@ void BFCAllocator::InsertFreeChunkIntoBin(BFCAllocator::ChunkHandle h) {
   new_bin->free_chunks.insert(h);
 }
 
-// This function set the upper bound of memory allocation size, the
-// actuall allocation size is the minimal value of this limit size
-// and the size want to get from system.
-size_t BFCAllocator::GetLimitAlloc() {
-  int64 limit_size = 4 * 1024;  // unit is MB
-  if (IsXeHPC(device_)) {
-    // Use a big value that means do not set limit.
-    limit_size = 1024 * 1024;
-  }
-  TF_ABORT_IF_ERROR(ReadInt64FromEnvVar("ITEX_LIMIT_MEMORY_SIZE_IN_MB",
-                                        limit_size, &limit_size));
-  return limit_size * 1024 * 1024;
-}
-
-size_t BFCAllocator::LimitAlloc() {
-  static size_t limit_alloc = GetLimitAlloc();
-  return limit_alloc;
-}
-
 bool BFCAllocator::Extend(size_t rounded_bytes) {
   size_t available_bytes = memory_limit_ - total_region_allocated_bytes_;
   // Rounds available_bytes down to the nearest multiple of kMinAllocationSize.
@@ -277,8 +541,8 @@ bool BFCAllocator::Extend(size_t rounded_bytes) {
   // Try allocating.
   size_t bytes = std::min(curr_region_allocation_bytes_, available_bytes);
 
-  bytes = std::min(bytes, LimitAlloc());
-  void* mem_addr = dpcppMalloc(device_, bytes);
+  bytes = std::min(bytes, options_.max_region_bytes);
+  void* mem_addr = sub_allocator_->Alloc(bytes);
   if (mem_addr == nullptr) {
     static constexpr float kBackpedalFactor = 0.9;
 
@@ -286,7 +550,7 @@ bool BFCAllocator::Extend(size_t rounded_bytes) {
     while (mem_addr == nullptr) {
       bytes = RoundedBytes(bytes * kBackpedalFactor);
       if (bytes < rounded_bytes) break;
-      mem_addr = dpcppMalloc(device_, bytes);
+      mem_addr = sub_allocator_->Alloc(bytes);
     }
   }
 
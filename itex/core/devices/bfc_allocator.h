@@ -17,33 +17,62 @@ limitations under the License.
 #define ITEX_CORE_DEVICES_BFC_ALLOCATOR_H_
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 
 #include "itex/core/devices/allocator.h"
+#include "itex/core/devices/allocator_timeline.h"
 #include "itex/core/utils/env_var.h"
-#include "itex/core/utils/hw_info.h"
 #include "itex/core/utils/logging.h"
 #include "itex/core/utils/mutex.h"
+#ifndef INTEL_CPU_ONLY
 #include "third_party/build_option/dpcpp/runtime/dpcpp_runtime.h"
+#endif  // INTEL_CPU_ONLY
 
 namespace itex {
 
 // Currently, the default strategy of itex custom device allocator is BFC
 class BFCAllocator : public Allocator {
  public:
+  struct Options {
+    // Total bytes of the regions can't exceed this limit.
+    size_t memory_limit = 0;
+    // Size of the first region, 0 means `memory_limit`. Later regions are
+    // twice as large as the previous one.
+    size_t initial_region_bytes = 0;
+    // Upper bound of the size of a region.
+    size_t max_region_bytes = SIZE_MAX;
+    // Freed chunks of at most this size are kept in a cache of the freeing
+    // thread for its next allocations, which skip the allocator lock. 0
+    // disables the thread caches.
+    size_t thread_cache_max_chunk_bytes = 0;
+    // Number of chunks kept by a thread cache for each bin.
+    int thread_cache_chunks_per_bin = 16;
+  };
+
+  BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator,
+               const Options& options, const string& name);
+#ifndef INTEL_CPU_ONLY
   explicit BFCAllocator(DPCPPDevice* device);
+#endif  // INTEL_CPU_ONLY
   ~BFCAllocator() override;
   void* AllocateRaw(size_t num_bytes) override;
   void DeallocateRaw(void* ptr) override;
-  string Name() override { return "itex_device_bfc"; }
+  string Name() override { return name_; }
+  bool GetStats(AllocatorStats* stats) override;
+  bool ClearStats() override;
 
  private:
-  DPCPPDevice* device_;
+  std::unique_ptr<SubAllocator> sub_allocator_;
+  const Options options_;
+  const string name_;
   size_t memory_limit_;
   static constexpr size_t kMinAllocationBits = 8;
   static constexpr size_t kMinAllocationSize = 1 << kMinAllocationBits;
@@ -374,6 +403,78 @@ class BFCAllocator : public Allocator {
   // Removes the chunk metadata represented by 'h'.
   void DeleteChunk(ChunkHandle h) TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
+  // Allocates a chunk of 'rounded_bytes' under lock_, and returns its
+  // pointer or nullptr. Sets 'chunk_size' to the size of the chunk.
+  void* AllocateChunkPtr(size_t rounded_bytes, size_t num_bytes,
+                         size_t* chunk_size) TF_LOCKS_EXCLUDED(lock_);
+
+  // Marks the chunk of 'ptr' as free and puts it back into the bins. Returns
+  // the size of the chunk, and sets 'requested_size' if it's not nullptr.
+  size_t FreeChunkPtr(void* ptr, size_t* requested_size)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Free chunks kept by a thread for its next allocations. They are still
+  // in use from the view of the bins, so allocating and freeing them only
+  // takes the cache's own lock, which is contended only when the allocator
+  // drains the cache.
+  struct ThreadCache {
+    struct Entry {
+      void* ptr;
+      size_t size;
+    };
+
+    mutex mu;
+    // Entries of each cached bin.
+    std::vector<std::vector<Entry>> bins TF_GUARDED_BY(mu);
+  };
+
+  bool UseThreadCache(size_t rounded_bytes) const {
+    return rounded_bytes <= options_.thread_cache_max_chunk_bytes;
+  }
+  ThreadCache* GetThreadCache() TF_LOCKS_EXCLUDED(lock_);
+  // Returns a cached chunk of at least 'rounded_bytes' and sets 'chunk_size',
+  // or returns nullptr.
+  void* AllocateFromThreadCache(size_t rounded_bytes, size_t* chunk_size)
+      TF_LOCKS_EXCLUDED(lock_);
+  // Returns true if the chunk is kept by the thread cache.
+  bool DeallocateToThreadCache(void* ptr, size_t chunk_size)
+      TF_LOCKS_EXCLUDED(lock_);
+  // Puts the chunks of all thread caches back into the bins, so that they can
+  // be merged into larger chunks.
+  void DrainThreadCaches() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Sizes of the chunks in use which may go to a thread cache when freed.
+  // The chunk metadata can't be read without lock_, so the sizes are kept in
+  // maps sharded by pointer, which rarely contend. The requested size here
+  // overrides the one of the chunk, which is not updated when the chunk is
+  // reused from a thread cache.
+  struct ChunkSizes {
+    size_t size;
+    size_t requested_size;
+  };
+  struct ChunkSizeShard {
+    mutex mu;
+    absl::flat_hash_map<const void*, ChunkSizes> sizes TF_GUARDED_BY(mu);
+  };
+  static constexpr int kNumChunkSizeShards = 64;
+  ChunkSizeShard* ChunkSizeShardFor(const void* ptr) {
+    const std::uintptr_t p = reinterpret_cast<std::uintptr_t>(ptr);
+    return &chunk_size_shards_[(p >> kMinAllocationBits) %
+                               kNumChunkSizeShards];
+  }
+  void RecordChunkSizes(const void* ptr, const ChunkSizes& sizes);
+  // Returns false if the sizes of 'ptr' are not recorded.
+  bool LookUpChunkSizes(const void* ptr, ChunkSizes* sizes);
+  void EraseChunkSizes(const void* ptr);
+
+  // Updates the statistics kept out of lock_ after an allocation or a
+  // deallocation of a chunk, and records it in the timeline.
+  void RecordAlloc(const void* ptr, size_t requested_size, size_t chunk_size);
+  void RecordFree(const void* ptr, size_t requested_size, size_t chunk_size);
+
+  // Returns the size of the largest free chunk in the bins.
+  size_t LargestFreeChunkSize() const TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
   char bins_space_[sizeof(Bin) * kNumBins];
   mutable mutex lock_;
   RegionManager region_manager_ TF_GUARDED_BY(lock_);
@@ -388,10 +489,29 @@ class BFCAllocator : public Allocator {
   size_t total_region_allocated_bytes_ = 0;
 
   std::vector<Chunk> chunks_ TF_GUARDED_BY(lock_);
-  TF_DISALLOW_COPY_AND_ASSIGN(BFCAllocator);
 
-  size_t LimitAlloc();
-  size_t GetLimitAlloc();
+  // Identifies the allocator in the thread local cache maps, which outlive
+  // allocators.
+  const uint64 id_;
+  std::vector<std::shared_ptr<ThreadCache>> thread_caches_
+      TF_GUARDED_BY(lock_);
+  ChunkSizeShard chunk_size_shards_[kNumChunkSizeShards];
+
+  // Statistics of the chunks handed out by the bins. Chunks in thread caches
+  // count as in use.
+  AllocatorStats stats_ TF_GUARDED_BY(lock_);
+  // Allocations served by thread caches, and the bytes they keep.
+  std::atomic<int64> num_thread_cache_allocs_{0};
+  std::atomic<int64> bytes_in_thread_caches_{0};
+  // Requested bytes are known out of lock_ on the thread cache paths.
+  std::atomic<int64> requested_bytes_in_use_{0};
+  std::atomic<int64> peak_requested_bytes_in_use_{0};
+
+  // Latest allocation events, nullptr unless ITEX_ALLOCATOR_TIMELINE_SIZE is
+  // set.
+  std::unique_ptr<AllocatorTimeline> timeline_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BFCAllocator);
 };  // class BFCAllocator
 
 }  // namespace itex
@@ -0,0 +1,116 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "itex/core/devices/host_allocator.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "itex/core/utils/env_var.h"
+#include "itex/core/utils/logging.h"
+
+namespace itex {
+
+namespace {
+
+// Same as MPOL_BIND of <numaif.h>, which is not always installed.
+constexpr int kMemoryPolicyBind = 2;
+
+// Defaults of the host BFC allocator. Regions start small since host memory
+// is shared with the rest of the process, and only small chunks go to the
+// thread caches to bound the memory they hold.
+constexpr int64 kDefaultInitialRegionMB = 64;
+constexpr int64 kDefaultThreadCacheMaxChunkKB = 1024;
+
+}  // namespace
+
+HostSubAllocator::HostSubAllocator(bool use_huge_pages, int numa_node)
+    : use_huge_pages_(use_huge_pages), numa_node_(numa_node) {}
+
+void* HostSubAllocator::Alloc(size_t num_bytes) {
+  void* ptr = mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    ITEX_VLOG(1) << "Failed to map " << num_bytes << " bytes of host memory";
+    return nullptr;
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (use_huge_pages_ && madvise(ptr, num_bytes, MADV_HUGEPAGE) != 0) {
+    ITEX_VLOG(1) << "Huge pages are not available for host memory at " << ptr;
+  }
+#endif  // MADV_HUGEPAGE
+
+  if (numa_node_ >= 0) {
+    // Pages are not touched yet, so binding them places every page on the
+    // node when it's first written.
+    unsigned long node_mask = 1UL << numa_node_;  // NOLINT(runtime/int)
+    if (syscall(SYS_mbind, ptr, num_bytes, kMemoryPolicyBind, &node_mask,
+                sizeof(node_mask) * 8, 0) != 0) {
+      ITEX_LOG(WARNING) << "Failed to bind host memory to NUMA node "
+                        << numa_node_;
+    }
+  }
+  return ptr;
+}
+
+void HostSubAllocator::Free(void* ptr, size_t num_bytes) {
+  if (munmap(ptr, num_bytes) != 0) {
+    ITEX_LOG(WARNING) << "Failed to unmap host memory at " << ptr;
+  }
+}
+
+BFCAllocator* GetHostBFCAllocator() {
+  static BFCAllocator* allocator = []() -> BFCAllocator* {
+    bool enabled;
+    ITEX_CHECK_OK(ReadBoolFromEnvVar("ITEX_HOST_BFC_ALLOCATOR", false,
+                                     &enabled));
+    if (!enabled) return nullptr;
+
+    bool use_huge_pages;
+    ITEX_CHECK_OK(ReadBoolFromEnvVar("ITEX_HOST_BFC_HUGE_PAGES", true,
+                                     &use_huge_pages));
+    int64 numa_node;
+    ITEX_CHECK_OK(ReadInt64FromEnvVar("ITEX_HOST_BFC_NUMA_NODE", -1,
+                                      &numa_node));
+    // Use the physical memory as the limit by default.
+    int64 limit_mb =
+        static_cast<int64>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE) /
+        (1024 * 1024);
+    ITEX_CHECK_OK(ReadInt64FromEnvVar("ITEX_HOST_BFC_LIMIT_IN_MB", limit_mb,
+                                      &limit_mb));
+    int64 thread_cache_kb;
+    ITEX_CHECK_OK(
+        ReadInt64FromEnvVar("ITEX_HOST_BFC_THREAD_CACHE_MAX_CHUNK_IN_KB",
+                            kDefaultThreadCacheMaxChunkKB, &thread_cache_kb));
+
+    BFCAllocator::Options options;
+    options.memory_limit = limit_mb * 1024 * 1024;
+    options.initial_region_bytes = kDefaultInitialRegionMB * 1024 * 1024;
+    options.thread_cache_max_chunk_bytes = thread_cache_kb * 1024;
+    ITEX_VLOG(1) << "Enable host BFC allocator with limit " << limit_mb
+                 << " MB, NUMA node " << numa_node;
+    return new BFCAllocator(absl::make_unique<HostSubAllocator>(
+                                use_huge_pages, static_cast<int>(numa_node)),
+                            options, "itex_host_bfc");
+  }();
+  return allocator;
+}
+
+}  // namespace itex
@@ -0,0 +1,50 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef ITEX_CORE_DEVICES_HOST_ALLOCATOR_H_
+#define ITEX_CORE_DEVICES_HOST_ALLOCATOR_H_
+
+#include <cstddef>
+
+#include "itex/core/devices/allocator.h"
+#include "itex/core/devices/bfc_allocator.h"
+
+namespace itex {
+
+// Takes regions of host memory from the OS with mmap, so that freed regions
+// are returned to the OS instead of staying in the heap of malloc.
+class HostSubAllocator : public SubAllocator {
+ public:
+  // If 'use_huge_pages' is true, regions are backed by transparent huge pages
+  // when the OS allows. If 'numa_node' is not negative, regions are bound to
+  // the memory of that NUMA node.
+  HostSubAllocator(bool use_huge_pages, int numa_node);
+
+  void* Alloc(size_t num_bytes) override;
+  void Free(void* ptr, size_t num_bytes) override;
+
+ private:
+  const bool use_huge_pages_;
+  const int numa_node_;
+};
+
+// Returns the process wide BFC allocator of host memory, or nullptr if it's
+// not enabled by `ITEX_HOST_BFC_ALLOCATOR`. Its allocations are 256 bytes
+// aligned.
+BFCAllocator* GetHostBFCAllocator();
+
+}  // namespace itex
+
+#endif  // ITEX_CORE_DEVICES_HOST_ALLOCATOR_H_
@@ -54,6 +54,16 @@ const char kCastToFp16[] = "CastToFp16";
 const char kCastToBf16[] = "CastToBf16";
 const char kCastToFp32[] = "CastToFp32";
 
+// Rough CPU costs of the cost model, in bytes moved to or from memory.
+// fp32 FLOPs done in the time one byte is moved, the machine balance of a
+// typical CPU core.
+constexpr double kFlopsPerByte = 8.0;
+// Speedup of bf16 contractions over fp32 ones with AVX512-BF16 or AMX.
+constexpr double kF16ComputeSpeedup = 2.0;
+// Size assumed for the dimensions unknown before running, usually the batch.
+// Most costs scale with it, except the ones of weights.
+constexpr int64 kUnknownDimSize = 32;
+
 // Get AutoMixedPrecision Mode through device_name.
 Status GetAutoMixedPrecisionMode(const char* device_name,
                                  AutoMixedPrecisionMode* model) {
@@ -627,12 +637,80 @@ Status ValidateLists(const gtl::FlatSet<string>& allow_list,
   }
 }
 
+// Returns the estimated number of elements of `prop`, or -1 if its rank is
+// unknown.
+int64 EstimateNumElements(const OpInfo_TensorProperties& prop) {
+  const TensorShapeProto& shape = prop.shape();
+  if (shape.unknown_rank()) return -1;
+  int64 num_elements = 1;
+  for (const auto& dim : shape.dim()) {
+    num_elements *= dim.size() < 0 ? kUnknownDimSize : dim.size();
+  }
+  return num_elements;
+}
+
+// Returns the estimated size of dimension `dim` of `prop`, counted from the
+// end if negative, or -1 if there is no such dimension.
+int64 EstimateDimSize(const OpInfo_TensorProperties& prop, int dim) {
+  const TensorShapeProto& shape = prop.shape();
+  const int rank = shape.unknown_rank() ? -1 : shape.dim_size();
+  if (dim < 0) dim += rank;
+  if (dim < 0 || dim >= rank) return -1;
+  const int64 size = shape.dim(dim).size();
+  return size < 0 ? kUnknownDimSize : size;
+}
+
+// Returns the FLOPs of the contraction `node` with the given input and output
+// properties, or -1 if the op or its shapes are unknown.
+double EstimateContractionFlops(
+    const NodeDef& node, const std::vector<OpInfo_TensorProperties>& inputs,
+    const std::vector<OpInfo_TensorProperties>& outputs) {
+  static const gtl::FlatSet<string> matmul_ops = {
+      "MatMul", "_FusedMatMulWithSum", "_ITEXFusedMatMul"};
+  static const gtl::FlatSet<string> batch_matmul_ops = {
+      "BatchMatMul", "BatchMatMulV2", "_FusedBatchMatMulV2"};
+  static const gtl::FlatSet<string> conv_ops = {
+      "Conv2D",           "Conv3D",          "_FusedConv2DWithSum",
+      "_ITEXFusedConv2D", "_ITEXFusedConv3D", "_PadWithConv2D",
+      "_PadWithConv3D",   "_PadWithFusedConv2D", "_PadWithFusedConv3D"};
+  static const gtl::FlatSet<string> depthwise_conv_ops = {
+      "DepthwiseConv2dNative", "_ITEXFusedDepthwiseConv2dNative"};
+  if (inputs.size() < 2 || outputs.empty()) return -1;
+
+  // Each output element is a dot product of `reduction` pairs.
+  int64 reduction = -1;
+  const string& op = node.op();
+  if (matmul_ops.count(op)) {
+    bool transpose_a = false;
+    TryGetNodeAttr(node, "transpose_a", &transpose_a);
+    reduction = EstimateDimSize(inputs[0], transpose_a ? -2 : -1);
+  } else if (batch_matmul_ops.count(op)) {
+    bool adj_x = false;
+    TryGetNodeAttr(node, "adj_x", &adj_x);
+    reduction = EstimateDimSize(inputs[0], adj_x ? -2 : -1);
+  } else if (conv_ops.count(op)) {
+    // The filter is [spatial..., in_channels, out_channels].
+    const int64 filter = EstimateNumElements(inputs[1]);
+    const int64 out_channels = EstimateDimSize(inputs[1], -1);
+    if (filter >= 0 && out_channels > 0) reduction = filter / out_channels;
+  } else if (depthwise_conv_ops.count(op)) {
+    // The filter is [height, width, in_channels, multiplier].
+    const int64 height = EstimateDimSize(inputs[1], 0);
+    const int64 width = EstimateDimSize(inputs[1], 1);
+    if (height >= 0 && width >= 0) reduction = height * width;
+  }
+  const int64 num_outputs = EstimateNumElements(outputs[0]);
+  if (reduction < 0 || num_outputs < 0) return -1;
+  return 2.0 * num_outputs * reduction;
+}
+
 // TODO(itex): after supporting virtual_placer_ and , please add them.
 class AutoMixedPrecisionImpl {
  public:
-  AutoMixedPrecisionImpl(const std::unordered_set<string>& nodes_to_preserve,
-                         GraphDef* graph, AutoMixedPrecisionMode mode)
-      : nodes_to_preserve_(nodes_to_preserve),
+  AutoMixedPrecisionImpl(const GrapplerItem& item, GraphDef* graph,
+                         AutoMixedPrecisionMode mode)
+      : item_(item),
+        nodes_to_preserve_(item.NodesToPreserve()),
         graph_(graph),
         function_library_(*graph),
         graph_view_(graph),
@@ -643,6 +721,12 @@ class AutoMixedPrecisionImpl {
 
   Status Optimize();
 
+  // Changes of tensor types made by Optimize(), to be applied to the graph
+  // properties shared with the later passes.
+  const std::vector<GraphPropertiesCache::Update>& property_updates() const {
+    return property_updates_;
+  }
+
  private:
   typedef absl::flat_hash_set<NodeTypeId> NodeTypeIdSet;
   std::unique_ptr<AutoMixedPrecisionLists> get_mixed_precision_lists() const {
@@ -696,11 +780,16 @@ class AutoMixedPrecisionImpl {
       absl::flat_hash_set<int>* allow_set) const;
   void MakeCastsAllowIfAllOutputsAllow(
       absl::flat_hash_set<int>* allow_set) const;
+  void RemoveAllowClustersNotWorthCasts(absl::flat_hash_set<int>* allow_set);
   NodeDef BuildCastNode(const MutableGraphView::OutputPort& src, bool to_f16,
                         const string& device) const;
+  GraphPropertiesCache::Update BuildCastPropertiesUpdate(
+      const MutableGraphView::OutputPort& src, const string& cast_name,
+      bool to_f16) const;
   Status ChangeTypeAttrsAndAddCasts(const absl::flat_hash_set<int>& allow_set);
 
   std::unordered_map<string, DeviceProperties> devices_;
+  const GrapplerItem& item_;
   std::unordered_set<string> nodes_to_preserve_;
   GraphDef* graph_;
   FunctionLibraryDefinition function_library_;
@@ -708,6 +797,9 @@ class AutoMixedPrecisionImpl {
   NodeTypeAttrMap node_type_map_;
   GraphTypeTopologyView graph_type_view_;
   bool force_all_f16_;
+  bool cost_model_ = false;
+  // Decisions of the cost model, written to the log path.
+  std::vector<string> cost_model_log_;
   AutoMixedPrecisionMode mode_;
   gtl::FlatSet<string> f16_allowlist_;
   gtl::FlatSet<string> f16_denylist_;
@@ -715,6 +807,7 @@ class AutoMixedPrecisionImpl {
   gtl::FlatSet<string> f16_clearlist_;
   absl::flat_hash_set<const NodeDef*> should_process_nodes_;
   DataType target_dtype_;  // Either DT_HALF or DT_BFLOAT16
+  std::vector<GraphPropertiesCache::Update> property_updates_;
 };
 
 NodeDef AutoMixedPrecisionImpl::BuildCastNode(
@@ -738,6 +831,24 @@ NodeDef AutoMixedPrecisionImpl::BuildCastNode(
   return node;
 }
 
+// The Cast node takes the shape of its input.
+GraphPropertiesCache::Update AutoMixedPrecisionImpl::BuildCastPropertiesUpdate(
+    const MutableGraphView::OutputPort& src, const string& cast_name,
+    bool to_f16) const {
+  const string src_name = src.node->name();
+  const int src_port = src.port_id;
+  const DataType dst_type = to_f16 ? target_dtype_ : DT_FLOAT;
+  return [=](GraphProperties* properties) {
+    const auto& src_props = properties->GetOutputProperties(src_name);
+    if (src_port >= static_cast<int>(src_props.size())) return;
+    OpInfo_TensorProperties prop = src_props[src_port];
+    properties->SetInputProperties(cast_name, {prop});
+    prop.set_dtype(dst_type);
+    prop.clear_value();
+    properties->SetOutputProperties(cast_name, {prop});
+  };
+}
+
 bool AutoMixedPrecisionImpl::HasInputOrOutputRefs(const NodeDef& node) const {
   OpDef op_def;
   Status status = function_library_.LookUpOpDef(node.op(), &op_def);
@@ -849,6 +960,22 @@ Status AutoMixedPrecisionImpl::PrintDebugLogs(bool preop, size_t timestamp) {
       ITEX_LOG(ERROR) << "failed to open " << fname;
     }
   }
+
+  if (!preop && cost_model_) {
+    fname = itex::io::JoinPath(prepend_path,
+                               strings::StrCat("costmodel", suffix, ".txt"));
+    f.open(fname.c_str(), std::fstream::out);
+    if (f.is_open()) {
+      for (const string& line : cost_model_log_) {
+        f << line << "\n";
+      }
+      f.close();
+      ITEX_LOG(INFO) << "Saved cost model decisions to " << fname;
+    } else {
+      f.close();
+      ITEX_LOG(ERROR) << "failed to open " << fname;
+    }
+  }
   return Status::OK();
 }
 
@@ -972,6 +1099,18 @@ Status AutoMixedPrecisionImpl::Optimize() {
         "true.");
   }
 
+  if (cfg_.graph_options().auto_mixed_precision_options().cost_model()) {
+    cost_model_ = true;
+  } else {
+    TF_RETURN_IF_ERROR(ReadBoolFromEnvVar(
+        "ITEX_AUTO_MIXED_PRECISION_COST_MODEL", false, &cost_model_));
+  }
+  if (cost_model_ && mode_ != AutoMixedPrecisionMode::CPU_BFLOAT16) {
+    // The costs are of CPUs.
+    ITEX_VLOG(2) << "Ignoring the cost model of auto mixed precision on GPU";
+    cost_model_ = false;
+  }
+
   std::unique_ptr<AutoMixedPrecisionLists> mp_lists =
       get_mixed_precision_lists();
   f16_allowlist_ = mp_lists->AllowList();
@@ -1059,6 +1198,8 @@ Status AutoMixedPrecisionImpl::Optimize() {
   //    connected to a node in the allow_set via other clearlist nodes.
   //    This is done to increase the number of ops in the allow_set without
   //    affecting numerical stability.
+  // 6) If the cost model is enabled, remove the clusters of connected allow
+  //    nodes whose estimated gain is less than the cost of their casts.
 
   absl::flat_hash_set<int> allow_set;
   ITEX_VLOG(2) << "Beginning pass 1 to add allowlist ops";
@@ -1116,6 +1257,11 @@ Status AutoMixedPrecisionImpl::Optimize() {
   ITEX_VLOG(2) << "Finding existing casts that can be made allow";
   MakeCastsAllowIfAllOutputsAllow(&allow_set);
 
+  if (cost_model_) {
+    ITEX_VLOG(2) << "Removing allow clusters which are not worth their casts";
+    RemoveAllowClustersNotWorthCasts(&allow_set);
+  }
+
   ITEX_VLOG(2)
       << "Beginning final pass to change type attributes and insert Cast "
          "ops at paint boundaries";
@@ -1647,6 +1793,169 @@ void AutoMixedPrecisionImpl::MakeCastsAllowIfAllOutputsAllow(
   }
 }
 
+// Removes the clusters of connected allow nodes from allow_set when the
+// memory traffic and compute they save in f16 is estimated to be less than the
+// traffic of the Casts at their boundaries. The estimates come from the
+// inferred shapes: every tensor of an allow node moves half the bytes, and
+// contractions compute faster. Clusters with unknown costs are kept.
+//
+// The shapes are inferred on the graph of item_, before the remapper fused
+// the nodes of *graph_. A fused node keeps the name and the outputs of the
+// node it replaces but not its inputs, so only output properties are looked
+// up by name, and the inputs of a node are the outputs of its fanins.
+void AutoMixedPrecisionImpl::RemoveAllowClustersNotWorthCasts(
+    absl::flat_hash_set<int>* allow_set) {
+  GraphProperties* properties = nullptr;
+  Status status = GetSharedGraphProperties(item_, /*assume_valid_feeds=*/true,
+                                           /*include_tensor_values=*/true,
+                                           &properties);
+  if (!status.ok()) {
+    ITEX_LOG(WARNING) << "Skipping the cost model of auto mixed precision: "
+                      << status.ToString();
+    return;
+  }
+  auto get_input_props = [&](NodeDef* node) {
+    std::vector<OpInfo_TensorProperties> props;
+    for (int port = 0;
+         port < node->input_size() && !IsControlInput(node->input(port));
+         ++port) {
+      const MutableGraphView::OutputPort src =
+          graph_view_.GetRegularFanin(MutableGraphView::InputPort(node, port));
+      props.emplace_back();
+      props.back().mutable_shape()->set_unknown_rank(true);
+      if (src.node == nullptr) continue;
+      const auto& src_props = properties->GetOutputProperties(src.node->name());
+      if (src.port_id >= 0 &&
+          src.port_id < static_cast<int>(src_props.size())) {
+        props.back() = src_props[src.port_id];
+      }
+    }
+    return props;
+  };
+  const int f32_bytes = DataTypeSize(DT_FLOAT);
+  const int f16_bytes = DataTypeSize(target_dtype_);
+
+  int num_clusters = 0;
+  int num_removed = 0;
+  absl::flat_hash_set<int> visited;
+  for (int root_idx = 0; root_idx < graph_type_view_.num_nodes(); ++root_idx) {
+    if (!allow_set->count(root_idx) || visited.count(root_idx)) continue;
+    std::vector<int> cluster;
+    DfsTypeTraversal(
+        graph_type_view_, {graph_type_view_.GetNode(root_idx)},
+        TypeTraversalDirection::kFollowInputsAndOutputs,
+        DfsTypePredicates::Enter(
+            [&](int idx) -> bool { return allow_set->count(idx); }),
+        DfsTypeCallbacks::PreOrder([&](int idx) {
+          visited.insert(idx);
+          cluster.push_back(idx);
+        }));
+    ++num_clusters;
+
+    bool known = true;
+    auto num_elements = [&known](
+                            const std::vector<OpInfo_TensorProperties>& props,
+                            int port) -> int64 {
+      const int64 n = port < static_cast<int>(props.size())
+                          ? EstimateNumElements(props[port])
+                          : -1;
+      if (n < 0) known = false;
+      return std::max<int64>(n, 0);
+    };
+    // Returns true if a Cast is inserted between the cluster and the fp32
+    // type attribute of a node outside of it.
+    auto needs_cast = [&](const NodeDef& node, const TypeAttrId& type_attr) {
+      const absl::optional<int> idx =
+          graph_type_view_.GetNodeIndex(node.name(), type_attr);
+      return idx.has_value() && !allow_set->count(idx.value()) &&
+             IsFloat32(*graph_type_view_.GetNode(idx.value()));
+    };
+
+    double gain = 0;
+    int64 cast_elements = 0;
+    // Outputs cast to f16, shared by all the nodes of the cluster reading
+    // them.
+    absl::flat_hash_set<std::pair<const NodeDef*, int>> cast_to_f16;
+    for (int idx : cluster) {
+      const NodeTypeId& item = *graph_type_view_.GetNode(idx);
+      if (!IsFloat32(item)) continue;
+      NodeDef* node = graph_view_.GetNode(item.node->name());
+      const std::vector<OpInfo_TensorProperties> input_props =
+          get_input_props(node);
+      const auto& output_props = properties->GetOutputProperties(node->name());
+
+      int64 node_elements = 0;
+      for (int port : node_type_map_.GetInputPorts(*node, item.type_attr)) {
+        const int64 n = num_elements(input_props, port);
+        node_elements += n;
+        MutableGraphView::InputPort dst(node, port);
+        const MutableGraphView::OutputPort src =
+            graph_view_.GetRegularFanin(dst);
+        if (src.node != nullptr &&
+            needs_cast(*src.node, node_type_map_.GetOutputTypeAttr(
+                                      *src.node, src.port_id)) &&
+            cast_to_f16.insert({src.node, src.port_id}).second) {
+          cast_elements += n;
+        }
+      }
+      for (int port : node_type_map_.GetOutputPorts(*node, item.type_attr)) {
+        const int64 n = num_elements(output_props, port);
+        node_elements += n;
+        MutableGraphView::OutputPort src(node, port);
+        for (const MutableGraphView::InputPort& dst :
+             graph_view_.GetFanout(src)) {
+          if (needs_cast(*dst.node, node_type_map_.GetInputTypeAttr(
+                                        *dst.node, dst.port_id))) {
+            cast_elements += n;
+            break;
+          }
+        }
+      }
+      gain += static_cast<double>(node_elements) * (f32_bytes - f16_bytes);
+
+      if (f16_allowlist_.count(node->op())) {
+        const double flops =
+            EstimateContractionFlops(*node, input_props, output_props);
+        if (flops < 0) known = false;
+        gain += std::max(flops, 0.0) / kFlopsPerByte *
+                (1.0 - 1.0 / kF16ComputeSpeedup);
+      }
+    }
+    const double cast_cost =
+        static_cast<double>(cast_elements) * (f32_bytes + f16_bytes);
+
+    const bool keep = !known || gain > cast_cost;
+    const NodeDef& root = *graph_type_view_.GetNode(root_idx)->node;
+    cost_model_log_.push_back(strings::StrCat(
+        keep ? "KEEP" : "REMOVE", " cluster of ", cluster.size(),
+        " type attributes from ", root.op(), " node ", root.name(),
+        known ? strings::StrCat(": gain ", gain, " bytes, casts ", cast_cost,
+                                " bytes")
+              : ": unknown costs"));
+    for (int idx : cluster) {
+      const NodeTypeId& item = *graph_type_view_.GetNode(idx);
+      cost_model_log_.push_back(strings::StrCat(
+          "  ", item.type_attr.DebugString(), " of ", item.node->op(),
+          " node ", item.node->name()));
+    }
+    if (keep) continue;
+
+    ++num_removed;
+    for (int idx : cluster) {
+      allow_set->erase(idx);
+      if (ITEX_VLOG_IS_ON(2)) {
+        const NodeTypeId& item = *graph_type_view_.GetNode(idx);
+        ITEX_VLOG(2) << "UnPainting type " << item.type_attr.DebugString()
+                     << " of " << item.node->op() << " node "
+                     << item.node->name()
+                     << " ALLOW because its cluster is not worth the casts";
+      }
+    }
+  }
+  ITEX_LOG(INFO) << "Cost model of auto mixed precision removed "
+                 << num_removed << "/" << num_clusters << " clusters";
+}
+
 // Changes all allow-painted type attributes to DT_HALF or DT_BFLOAT16, and
 // inserts Cast nodes at node outputs for all edges that connect
 // allow-painted <-> non-allow-painted type attributes.
@@ -1676,6 +1985,21 @@ Status AutoMixedPrecisionImpl::ChangeTypeAttrsAndAddCasts(
           return errors::Internal("Failed to set type attribute");
         }
         ++num_nodes_changed;
+
+        const string node_name = node->name();
+        const absl::flat_hash_set<int> input_ports =
+            node_type_map_.GetInputPorts(*node, type_attr);
+        const absl::flat_hash_set<int> output_ports =
+            node_type_map_.GetOutputPorts(*node, type_attr);
+        const DataType dtype = target_dtype_;
+        property_updates_.push_back([=](GraphProperties* properties) {
+          for (int port : input_ports) {
+            properties->SetInputDataType(node_name, port, dtype);
+          }
+          for (int port : output_ports) {
+            properties->SetOutputDataType(node_name, port, dtype);
+          }
+        });
       }
       for (int output_port : node_type_map_.GetOutputPorts(*node, type_attr)) {
         MutableGraphView::OutputPort src(node, output_port);
@@ -1705,6 +2029,8 @@ Status AutoMixedPrecisionImpl::ChangeTypeAttrsAndAddCasts(
                            << src.node->name() << ":" << src.port_id;
               added_cast_node = graph_view_.AddNode(
                   BuildCastNode(src, to_f16, src.node->device()));
+              property_updates_.push_back(BuildCastPropertiesUpdate(
+                  src, added_cast_node->name(), to_f16));
               if (to_f16 && !IsConstant(*node) && !IsVariable(*node) &&
                   !NodeImplicitlyReadsNonResourceVariable(*node)) {
                 ++num_nonvar_casts_to_f16;
@@ -1738,12 +2064,17 @@ Status RunAutoMixedPrecision(const char* device_name, const GrapplerItem& item,
   TF_RETURN_IF_ERROR(status);
 
   // Optimize the output graph in-place.
-  AutoMixedPrecisionImpl optimizer(item.NodesToPreserve(), output, mode);
+  AutoMixedPrecisionImpl optimizer(item, output, mode);
   status = optimizer.Optimize();
   if (!status.ok()) {
     // Restore the original graph.
     *output = graph_def;
     ITEX_LOG(WARNING) << " graph optimizer FAILED: " << status.ToString();
+    return status;
+  }
+
+  for (const auto& update : optimizer.property_updates()) {
+    UpdateSharedGraphProperties(item, update);
   }
   return status;
 }
@@ -0,0 +1,324 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "itex/core/graph/elementwise_fusion/elementwise_fusion.h"
+
+#include <map>
+#include <queue>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "itex/core/graph/utils/fusion_report.h"
+#include "itex/core/graph/utils/graph_properties.h"
+#include "itex/core/graph/utils/graph_view.h"
+#include "itex/core/graph/utils/symbolic_shapes.h"
+#include "itex/core/graph/utils/utils.h"
+#include "itex/core/utils/node_def_util.h"
+
+namespace itex {
+namespace graph {
+
+namespace {
+
+constexpr char kFusedElementwise[] = "_ITEXFusedElementwise";
+constexpr char kPassName[] = "elementwise-fusion";
+
+// Limits of one fused node. The kernel keeps a tile of every input and every
+// op result in cache, so a larger group is fused partly.
+constexpr int kMaxOps = 32;
+constexpr int kMaxArgs = 16;
+
+// Number of inputs of each op the _ITEXFusedElementwise kernel implements.
+const std::unordered_map<string, int>& GetElementwiseArity() {
+  static const auto* arity = new std::unordered_map<string, int>({
+      // Unary ops.
+      {"Abs", 1},
+      {"Cast", 1},
+      {"Exp", 1},
+      {"Identity", 1},
+      {"Log", 1},
+      {"Neg", 1},
+      {"Reciprocal", 1},
+      {"Relu", 1},
+      {"Relu6", 1},
+      {"Rsqrt", 1},
+      {"Sigmoid", 1},
+      {"Sqrt", 1},
+      {"Square", 1},
+      {"Tanh", 1},
+      // Binary ops.
+      {"Add", 2},
+      {"AddV2", 2},
+      {"Maximum", 2},
+      {"Minimum", 2},
+      {"Mul", 2},
+      {"RealDiv", 2},
+      {"SquaredDifference", 2},
+      {"Sub", 2},
+      // Ternary ops, whose first input is the condition.
+      {"Select", 3},
+      {"SelectV2", 3},
+  });
+  return *arity;
+}
+
+bool IsFloatType(DataType dtype) {
+  return dtype == DT_FLOAT || dtype == DT_BFLOAT16;
+}
+
+bool IsSelectOp(const NodeDef& node) {
+  return node.op() == "Select" || node.op() == "SelectV2";
+}
+
+struct ElementwiseFusionContext {
+  explicit ElementwiseFusionContext(const GrapplerItem& item, GraphDef* g_def,
+                                    Status* status)
+      : item(item),
+        nodes_to_preserve(item.NodesToPreserve()),
+        graph_view(g_def, status),
+        fusion_report(GetFusionReport(item)) {}
+
+  const GrapplerItem& item;
+  std::unordered_set<string> nodes_to_preserve;
+  utils::MutableGraphView graph_view;
+  // Shared with the other passes optimizing `item`.
+  GraphProperties* graph_properties = nullptr;
+  FusionReport* fusion_report;
+
+  GraphProperties& GetGraphProperties() {
+    if (graph_properties == nullptr) {
+      TF_ABORT_IF_ERROR(GetSharedGraphProperties(
+          item, /*assume_valid_feeds=*/true,
+          /*include_tensor_values=*/false, &graph_properties));
+    }
+    return *graph_properties;
+  }
+};
+
+// Returns the type of input `port` of elementwise op `node`.
+DataType GetInputType(const NodeDef& node, int port) {
+  if (node.op() == "Cast") return GetDataTypeFromAttr(node, "SrcT");
+  if (IsSelectOp(node) && port == 0) return DT_BOOL;
+  return GetDataTypeFromAttr(node, "T");
+}
+
+// Returns the output type of `node` if it's an elementwise op which the
+// kernel implements for its types, or DT_INVALID.
+DataType GetElementwiseType(const NodeDef& node) {
+  if (GetElementwiseArity().count(node.op()) == 0) return DT_INVALID;
+  if (node.op() == "Cast") {
+    bool truncate = false;
+    TryGetNodeAttr(AttrSlice(node), "Truncate", &truncate);
+    const DataType dst_type = GetDataTypeFromAttr(node, "DstT");
+    if (truncate || !IsFloatType(GetInputType(node, 0)) ||
+        !IsFloatType(dst_type)) {
+      return DT_INVALID;
+    }
+    return dst_type;
+  }
+  const DataType dtype = GetDataTypeFromAttr(node, "T");
+  return IsFloatType(dtype) ? dtype : DT_INVALID;
+}
+
+// Returns true if `node_view` can be fused with `root`.
+bool IsFusible(ElementwiseFusionContext* ctx,
+               const utils::MutableNodeView& node_view, const NodeDef& root) {
+  const NodeDef* node_def = node_view.node();
+  if (GetElementwiseType(*node_def) == DT_INVALID ||
+      node_view.NumControllingFanins() > 0 ||
+      node_view.NumControlledFanouts() > 0 ||
+      ctx->nodes_to_preserve.count(node_def->name()) > 0 ||
+      node_def->device() != root.device()) {
+    return false;
+  }
+
+  // Select broadcasts a vector condition to the rows of the other inputs, so
+  // it's fused only if its inputs have the same shape.
+  if (node_def->op() == "Select") {
+    const auto& props =
+        ctx->GetGraphProperties().GetInputProperties(node_def->name());
+    return props.size() == 3 &&
+           ShapesSymbolicallyEqual(props[0].shape(), props[1].shape()) &&
+           ShapesSymbolicallyEqual(props[1].shape(), props[2].shape());
+  }
+  return true;
+}
+
+// Returns the nodes fused with `root` in topological order. A node is fused
+// if all its readers are, so it can be removed.
+std::vector<int> GrowRegion(ElementwiseFusionContext* ctx, int root,
+                            const std::vector<bool>& fused) {
+  const NodeDef& root_def = *ctx->graph_view.GetNode(root)->node();
+  std::set<int> region = {root};
+  // The readers of a node come after it in topological order, so they are
+  // all visited before it when the candidates are visited backwards.
+  std::priority_queue<int> candidates;
+  const auto add_fanins = [&](int index) {
+    for (const auto& fanin :
+         ctx->graph_view.GetNode(index)->GetRegularFanins()) {
+      candidates.push(fanin.node_index());
+    }
+  };
+  add_fanins(root);
+
+  while (!candidates.empty() && static_cast<int>(region.size()) < kMaxOps) {
+    const int index = candidates.top();
+    candidates.pop();
+    if (region.count(index) > 0 || fused[index]) continue;
+
+    const auto* node_view = ctx->graph_view.GetNode(index);
+    if (!IsFusible(ctx, *node_view, root_def)) continue;
+    bool all_fanouts_fused = true;
+    for (const auto& fanouts : node_view->GetRegularFanouts()) {
+      for (const auto& fanout : fanouts) {
+        all_fanouts_fused &= region.count(fanout.node_index()) > 0;
+      }
+    }
+    if (!all_fanouts_fused) continue;
+
+    region.insert(index);
+    add_fanins(index);
+  }
+  return std::vector<int>(region.begin(), region.end());
+}
+
+// Replaces the nodes of `region` with one _ITEXFusedElementwise node, and
+// returns false if it has too many inputs. The values of the fused node are
+// numbered with its inputs first, then the op results in `region` order.
+bool FuseRegion(ElementwiseFusionContext* ctx, const std::vector<int>& region,
+                std::vector<bool>* nodes_to_delete) {
+  std::unordered_map<int, int> op_of_node;
+  for (int i = 0; i < static_cast<int>(region.size()); ++i) {
+    op_of_node[region[i]] = i;
+  }
+
+  std::vector<string> args;
+  std::vector<DataType> arg_types;
+  std::map<string, int> arg_of_tensor;
+  for (int index : region) {
+    const auto* node_view = ctx->graph_view.GetNode(index);
+    const NodeDef* node_def = node_view->node();
+    for (int port = 0; port < node_view->NumRegularFanins(); ++port) {
+      if (op_of_node.count(node_view->GetRegularFanin(port).node_index()))
+        continue;
+      const string& tensor = node_def->input(port);
+      if (arg_of_tensor.emplace(tensor, args.size()).second) {
+        args.push_back(tensor);
+        arg_types.push_back(GetInputType(*node_def, port));
+      }
+    }
+  }
+  if (static_cast<int>(args.size()) > kMaxArgs) return false;
+
+  std::vector<string> fused_ops;
+  std::vector<int32> operands;
+  std::vector<DataType> op_types;
+  for (int index : region) {
+    const auto* node_view = ctx->graph_view.GetNode(index);
+    const NodeDef* node_def = node_view->node();
+    fused_ops.push_back(node_def->op());
+    op_types.push_back(GetElementwiseType(*node_def));
+    for (int port = 0; port < node_view->NumRegularFanins(); ++port) {
+      auto it = op_of_node.find(node_view->GetRegularFanin(port).node_index());
+      operands.push_back(it != op_of_node.end()
+                             ? args.size() + it->second
+                             : arg_of_tensor.at(node_def->input(port)));
+    }
+  }
+
+  const NodeDef& root = *ctx->graph_view.GetNode(region.back())->node();
+  ITEX_VLOG(2) << "ElementwiseFusion: fuse " << region.size()
+               << " ops with " << args.size() << " inputs into "
+               << root.name();
+
+  NodeDef fused_node;
+  fused_node.set_name(root.name());
+  fused_node.set_op(kFusedElementwise);
+  fused_node.set_device(root.device());
+  for (const string& arg : args) fused_node.add_input(arg);
+  AddNodeAttr("T", op_types.back(), &fused_node);
+  AddNodeAttr("Targs", arg_types, &fused_node);
+  AddNodeAttr("fused_ops", fused_ops, &fused_node);
+  AddNodeAttr("operands", operands, &fused_node);
+  AddNodeAttr("op_types", op_types, &fused_node);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_node), &status);
+  TF_ABORT_IF_ERROR(status);
+  TF_ABORT_IF_ERROR(mutation->Apply());
+
+  for (size_t i = 0; i + 1 < region.size(); ++i) {
+    (*nodes_to_delete)[region[i]] = true;
+  }
+  if (ctx->fusion_report != nullptr) {
+    ctx->fusion_report->AddFused(kPassName, "elementwise-chain", root.name());
+  }
+  return true;
+}
+
+}  // namespace
+
+Status RunElementwiseFusion(const char* device_name, const GrapplerItem& item,
+                            const GraphDef& graph_def,
+                            GraphDef* optimized_graph) {
+  Status status;
+  GraphDef mutable_graph_def = graph_def;
+  ElementwiseFusionContext ctx(item, &mutable_graph_def, &status);
+  TF_RETURN_IF_ERROR(status);
+
+  // Processing graph in reverse-topological sorted order allows to fuse the
+  // longest chain ending at each node.
+  TF_RETURN_IF_ERROR(
+      ctx.graph_view.SortTopologically(/*ignore_cycles=*/false, {}));
+
+  const int num_nodes = mutable_graph_def.node_size();
+  std::vector<bool> fused(num_nodes);
+  std::vector<bool> nodes_to_delete(num_nodes);
+  for (int i = num_nodes - 1; i >= 0; --i) {
+    if (fused[i]) continue;
+    const auto* node_view = ctx.graph_view.GetNode(i);
+    const NodeDef* node_def = node_view->node();
+    // TODO(itex): Add a GPU kernel, which may replace _ITEXFusedBinary.
+    if (!NodeIsOnCpu(node_def) || !NodeIsOnDevice(device_name, node_def) ||
+        !IsFusible(&ctx, *node_view, *node_def)) {
+      continue;
+    }
+
+    const std::vector<int> region = GrowRegion(&ctx, i, fused);
+    if (region.size() < 2) continue;
+    if (FuseRegion(&ctx, region, &nodes_to_delete)) {
+      for (int index : region) fused[index] = true;
+    }
+  }
+
+  utils::Mutation* mutation = ctx.graph_view.GetMutationBuilder();
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(ctx.graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  *optimized_graph = std::move(mutable_graph_def);
+  return Status::OK();
+}
+
+}  // namespace graph
+}  // namespace itex
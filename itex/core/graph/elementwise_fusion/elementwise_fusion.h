@@ -0,0 +1,39 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef ITEX_CORE_GRAPH_ELEMENTWISE_FUSION_ELEMENTWISE_FUSION_H_
+#define ITEX_CORE_GRAPH_ELEMENTWISE_FUSION_ELEMENTWISE_FUSION_H_
+
+#include "itex/core/graph/utils/grappler_item.h"
+#include "itex/core/utils/status.h"
+#include "protos/graph.pb.h"
+
+namespace itex {
+namespace graph {
+
+// Groups connected elementwise ops, such as Add, Mul, Cast, Relu, Tanh,
+// Sigmoid, Maximum and SelectV2, into one _ITEXFusedElementwise node, which
+// evaluates them in one pass over memory. Inputs are broadcast like NumPy.
+//
+// It runs after the remapper, so it only takes the elementwise ops which no
+// other fusion took. Only CPU nodes are fused.
+Status RunElementwiseFusion(const char* device_name, const GrapplerItem& item,
+                            const GraphDef& graph_def,
+                            GraphDef* optimized_graph);
+
+}  // namespace graph
+}  // namespace itex
+
+#endif  // ITEX_CORE_GRAPH_ELEMENTWISE_FUSION_ELEMENTWISE_FUSION_H_
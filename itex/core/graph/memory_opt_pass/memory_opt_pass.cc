@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "itex/core/graph/memory_opt_pass/memory_opt_pass.h"
 
+#include <algorithm>
+#include <limits>
+#include <map>
 #include <set>
 #include <string>
 #include <utility>
@@ -23,8 +26,10 @@ limitations under the License.
 #include "google/protobuf/text_format.h"
 #include "itex/core/graph/utils/graph_properties.h"
 #include "itex/core/graph/utils/op_types.h"
+#include "itex/core/graph/utils/symbolic_shapes.h"
 #include "itex/core/graph/utils/utils.h"
 #include "itex/core/utils/attr_value_util.h"
+#include "itex/core/utils/env_var.h"
 #include "itex/core/utils/types.h"
 
 namespace itex {
@@ -33,6 +38,20 @@ namespace graph {
 namespace {
 // Auxiliary information for Inplace Inference
 std::vector<SearchInfo> sinfo;
+
+// Memory shared by tensors which alias the same buffer, e.g. the output of
+// inplace ops or reshape-like ops and their input.
+struct MemoryBlock {
+  int64 size;
+  // Topological index of the producer and the last consumer.
+  int first_step;
+  int last_step;
+  int64 offset = -1;
+  bool is_valid = true;
+  std::vector<std::pair<int, int>> tensors;
+};
+
+constexpr int64 kMemoryPlanningAlignment = 64;
 }  // namespace
 
 // Forwarding from input:0 to output:0
@@ -49,6 +68,11 @@ const auto add_inplace_rule = gtl::FlatSet<string>{
 const auto onednngraph_inplace_rule =
     gtl::FlatSet<string>{"_OneDnnGraph", "OneDnnGraph"};
 
+// Ops whose output:0 shares the buffer of input:0
+const auto alias_rule = gtl::FlatSet<string>{
+    "Identity", "Reshape", "Squeeze", "ExpandDims", "StopGradient",
+};
+
 bool IsOneDnnLayoutDependentOp(const string& op_name) {
   return op_name.substr(0, 7) == "_OneDnn";
 }
@@ -359,6 +383,229 @@ void StaticInplaceOpt(MemoryOptContext* ctx, const char* device_name) {
   }
 }
 
+// Returns the input port whose buffer is shared by output:0, or -1 if none.
+int GetAliasInputPort(const MutableNodeView* node_view) {
+  const auto* node_def = node_view->node();
+
+  if (alias_rule.count(node_def->op())) return 0;
+
+  if (HasNodeAttr(*node_def, "is_inplace") &&
+      node_def->attr().at("is_inplace").b()) {
+    return 0;
+  }
+
+  if (HasNodeAttr(*node_def, "inplace_sum") &&
+      node_def->attr().at("inplace_sum").b()) {
+    std::vector<int> forward_ports = GetCandidateForwardPort(node_view);
+    return forward_ports.empty() ? -1 : forward_ports[0];
+  }
+
+  return -1;
+}
+
+// Returns true if any input of the node may be forwarded to an unknown
+// output, so neither its inputs nor its outputs can be planned.
+bool HasUnknownAlias(const MutableNodeView* node_view) {
+  const auto* node_def = node_view->node();
+  if (!HasNodeAttr(*node_def, "candidate_inplace_input_edge")) return false;
+  for (bool is_candidate :
+       node_def->attr().at("candidate_inplace_input_edge").list().b()) {
+    if (is_candidate) return true;
+  }
+  return false;
+}
+
+// Assigns each block the offset of the smallest gap among the blocks already
+// assigned with overlapped lifetime, from the largest block to the smallest.
+// Returns the arena size.
+int64 AssignOffsetsGreedyBySize(std::vector<MemoryBlock>* blocks) {
+  std::vector<int> order;
+  for (int i = 0; i < blocks->size(); ++i) {
+    if (blocks->at(i).is_valid) order.push_back(i);
+  }
+  std::sort(order.begin(), order.end(), [blocks](int x, int y) {
+    const auto& a = blocks->at(x);
+    const auto& b = blocks->at(y);
+    if (a.size != b.size) return a.size > b.size;
+    return a.first_step < b.first_step;
+  });
+
+  int64 arena_size = 0;
+  std::vector<const MemoryBlock*> assigned;
+  for (int index : order) {
+    MemoryBlock& block = blocks->at(index);
+
+    std::vector<const MemoryBlock*> overlapped;
+    for (const auto* other : assigned) {
+      if (other->last_step < block.first_step ||
+          block.last_step < other->first_step)
+        continue;
+      overlapped.push_back(other);
+    }
+    std::sort(overlapped.begin(), overlapped.end(),
+              [](const MemoryBlock* a, const MemoryBlock* b) {
+                return a->offset < b->offset;
+              });
+
+    int64 best_offset = -1;
+    int64 best_gap = std::numeric_limits<int64>::max();
+    int64 prev_end = 0;
+    for (const auto* other : overlapped) {
+      int64 gap = other->offset - prev_end;
+      if (gap >= block.size && gap < best_gap) {
+        best_offset = prev_end;
+        best_gap = gap;
+      }
+      prev_end = std::max(prev_end, other->offset + other->size);
+    }
+    block.offset = best_offset >= 0 ? best_offset : prev_end;
+    arena_size = std::max(arena_size, block.offset + block.size);
+    assigned.push_back(&block);
+  }
+
+  return arena_size;
+}
+
+void StaticMemoryPlanning(MemoryOptContext* ctx, const GrapplerItem& item,
+                          const char* device_name) {
+  const int num_nodes = ctx->graph_view.graph()->node_size();
+
+  // Lifetime in topological order is meaningless inside loops.
+  for (int node_index = 0; node_index < num_nodes; ++node_index) {
+    if (IsControlFlow(*ctx->graph_view.GetNode(node_index)->node())) {
+      ITEX_VLOG(1) << "MemoryOptPass: Skip memory planning for graph with "
+                   << "control flow.";
+      return;
+    }
+  }
+
+  // TODO(itex): Shapes are inferred from the graph before ITEX optimization,
+  // so nodes created by ITEX passes are only planned if they reuse the name
+  // of an original node or the pass updates the shared properties.
+  GraphProperties* properties = nullptr;
+  Status status = GetSharedGraphProperties(item, /*assume_valid_feeds=*/false,
+                                           /*include_tensor_values=*/false,
+                                           &properties);
+  if (!status.ok()) {
+    ITEX_VLOG(1) << "MemoryOptPass: Skip memory planning because shape "
+                 << "inference failed: " << status;
+    return;
+  }
+
+  std::vector<MemoryBlock> blocks;
+  // Map from (node index, output port) to the block index.
+  std::map<std::pair<int, int>, int> tensor_to_block;
+
+  auto get_block = [&tensor_to_block](int node_index, int port) {
+    auto it = tensor_to_block.find({node_index, port});
+    return it == tensor_to_block.end() ? -1 : it->second;
+  };
+
+  for (int node_index = 0; node_index < num_nodes; ++node_index) {
+    const auto* node_view = ctx->graph_view.GetNode(node_index);
+    const auto* node_def = node_view->node();
+
+    if (HasUnknownAlias(node_view)) {
+      for (const auto& fanin : node_view->GetRegularFanins()) {
+        int block = get_block(fanin.node_index(), fanin.index());
+        if (block >= 0) blocks[block].is_valid = false;
+      }
+      continue;
+    }
+
+    // Persistent, fed and fetched tensors are not intermediate tensors.
+    if (!NodeIsOnDevice(device_name, node_def) || IsPersistent(*node_def) ||
+        IsPlaceholder(*node_def) || IsInPreserveSet(ctx, node_def))
+      continue;
+
+    const std::vector<OpInfo_TensorProperties>& output_props =
+        properties->GetOutputProperties(node_def->name());
+
+    const auto& fanouts = node_view->GetRegularFanouts();
+    const int num_outputs = std::min<int>(output_props.size(), fanouts.size());
+    const int alias_port = GetAliasInputPort(node_view);
+
+    for (int port = 0; port < num_outputs; ++port) {
+      int block = -1;
+      if (port == 0 && alias_port >= 0 &&
+          alias_port < node_view->NumRegularFanins()) {
+        // Output shares the buffer of input, which can't be planned if the
+        // input is not planned.
+        const auto& fanin = node_view->GetRegularFanin(alias_port);
+        block = get_block(fanin.node_index(), fanin.index());
+        if (block < 0) continue;
+      } else {
+        int64 num_elements = NumCoefficients(output_props[port].shape());
+        int64 type_size = DataTypeSize(output_props[port].dtype());
+        if (num_elements < 0 || type_size <= 0) continue;
+        int64 size = num_elements * type_size;
+        size = (size + kMemoryPlanningAlignment - 1) /
+               kMemoryPlanningAlignment * kMemoryPlanningAlignment;
+        if (size == 0) continue;
+
+        block = blocks.size();
+        MemoryBlock new_block;
+        new_block.size = size;
+        new_block.first_step = node_index;
+        new_block.last_step = node_index;
+        blocks.push_back(std::move(new_block));
+      }
+
+      tensor_to_block[{node_index, port}] = block;
+      blocks[block].tensors.push_back({node_index, port});
+      for (const auto& fanout : fanouts[port]) {
+        blocks[block].last_step =
+            std::max(blocks[block].last_step, fanout.node_index());
+      }
+    }
+  }
+
+  // Naive peak allocates every tensor separately, live peak is the lower
+  // bound of any plan.
+  int64 naive_peak = 0, live_peak = 0;
+  int num_planned_tensors = 0;
+  std::vector<int64> live_bytes(num_nodes + 1, 0);
+  for (const auto& block : blocks) {
+    if (!block.is_valid) continue;
+    naive_peak += block.size;
+    num_planned_tensors += block.tensors.size();
+    live_bytes[block.first_step] += block.size;
+    live_bytes[block.last_step + 1] -= block.size;
+  }
+  int64 cur_live = 0;
+  for (int64 bytes : live_bytes) {
+    cur_live += bytes;
+    live_peak = std::max(live_peak, cur_live);
+  }
+
+  int64 arena_size = AssignOffsetsGreedyBySize(&blocks);
+
+  ITEX_VLOG(1) << "MemoryOptPass: Planned " << num_planned_tensors
+               << " tensors in " << blocks.size()
+               << " buffers, naive peak bytes: " << naive_peak
+               << ", planned peak bytes: " << arena_size
+               << ", live peak bytes: " << live_peak;
+
+  // Annotate planned offsets to producers, -1 means not planned.
+  std::map<int, std::vector<int64>> node_offsets;
+  for (const auto& block : blocks) {
+    if (!block.is_valid) continue;
+    for (const auto& tensor : block.tensors) {
+      auto& offsets = node_offsets[tensor.first];
+      const int num_outputs =
+          ctx->graph_view.GetNode(tensor.first)->GetRegularFanouts().size();
+      if (offsets.empty()) offsets.resize(num_outputs, -1);
+      offsets[tensor.second] = block.offset;
+    }
+  }
+  for (const auto& node_offset : node_offsets) {
+    auto* new_attr =
+        ctx->graph_view.GetNode(node_offset.first)->node()->mutable_attr();
+    SetAttrValue(node_offset.second, &(*new_attr)["_itex_planned_offsets"]);
+    SetAttrValue(arena_size, &(*new_attr)["_itex_planned_arena_size"]);
+  }
+}
+
 Status RunMemoryOptPass(const char* device_name, const GrapplerItem& item,
                         const GraphDef& graph_def, GraphDef* optimized_graph) {
   Status status;
@@ -372,6 +619,13 @@ Status RunMemoryOptPass(const char* device_name, const GrapplerItem& item,
 
   StaticInplaceOpt(&ctx, device_name);
 
+  bool enable_memory_planning;
+  ITEX_CHECK_OK(ReadBoolFromEnvVar("ITEX_MEMORY_PLANNING", false,
+                                   &enable_memory_planning));
+  if (enable_memory_planning) {
+    StaticMemoryPlanning(&ctx, item, device_name);
+  }
+
   // Introduce more optimization if needed.
 
   *optimized_graph = std::move(mutable_graph_def);
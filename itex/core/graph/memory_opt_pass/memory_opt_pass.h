@@ -80,6 +80,13 @@ void InplaceInference(MemoryOptContext* ctx, const MutableNodeView* node_view);
 
 void StaticInplaceOpt(MemoryOptContext* ctx, const char* device_name);
 
+// Plan offsets of intermediate tensors with static shape in a shared arena
+// according to their lifetime in topological order. Tensors whose lifetimes
+// don't overlap share the same memory. Planned offsets are annotated to the
+// producer nodes.
+void StaticMemoryPlanning(MemoryOptContext* ctx, const GrapplerItem& item,
+                          const char* device_name);
+
 Status RunMemoryOptPass(const char* device_name, const GrapplerItem& item,
                         const GraphDef& graph_def, GraphDef* optimized_graph);
 
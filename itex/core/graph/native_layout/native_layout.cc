@@ -156,6 +156,7 @@ const std::vector<NativeFormatInfo>* GetNativeFormatInfo() {
        AlwaysRewrite},
       {"_ITEXAUGRUCell", "_ITEXAUGRUCell", CopyAttrsAllCheckConstFilter,
        AlwaysRewrite},
+      {"ItexRnn", "ItexRnn", CopyAttrsAllCheckConstFilter, AlwaysRewrite},
       // Intel-TF ops. Usually these ops should always be rewritten.
       // This part is for compatibility of legacy Intel-TF models, it will be
       // removed in future.
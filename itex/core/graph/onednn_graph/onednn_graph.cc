@@ -23,6 +23,7 @@ limitations under the License.
 #include <unordered_set>
 #include <utility>
 
+#include "absl/strings/str_join.h"
 #include "itex/core/graph/utils/graph_common_utils.h"
 #include "itex/core/graph/utils/graph_properties.h"
 #include "itex/core/graph/utils/op_types.h"
@@ -995,9 +996,8 @@ Status TranslateBinary(const OneDnnGraphContext* ctx, const int node_index,
       {"Sub", kind::Subtract}};
 
   auto* node_def = node_view->node();
-  std::vector<OpInfo_TensorProperties> props;
-  TF_ABORT_IF_ERROR(
-      ctx->graph_properties.GetInputProperties(node_def->name(), &props));
+  const std::vector<OpInfo_TensorProperties>& props =
+      ctx->graph_properties->GetInputProperties(node_def->name());
   if (props.size() != 2) {
     onednn_graph_node = nullptr;
     return Status::OK();
@@ -1359,9 +1359,8 @@ Status TranslateReduce(const OneDnnGraphContext* ctx, const int node_index,
   }
 
   auto* node_def = node_view->node();
-  std::vector<OpInfo_TensorProperties> props;
-  TF_ABORT_IF_ERROR(
-      ctx->graph_properties.GetInputProperties(node_def->name(), &props));
+  const std::vector<OpInfo_TensorProperties>& props =
+      ctx->graph_properties->GetInputProperties(node_def->name());
   if (props.size() != 2) {
     onednn_graph_node = nullptr;
     return Status::OK();
@@ -1612,6 +1611,26 @@ bool IsConstantInput(const utils::MutableNodeView* node_view,
   return IsAnyConst(*input_node);
 }
 
+// Reports the ops of partition `p` as not fused for `reason`. Only the ops in
+// `selected_nodes` are reported if it's not nullptr, so that wildcard ops
+// aren't.
+void RejectPartition(
+    OneDnnGraphContext* ctx,
+    dnnl::graph::partition& p,  // NOLINT(runtime/references)
+    const char* reason,
+    const std::unordered_set<std::string>* selected_nodes = nullptr) {
+  if (ctx->fusion_report == nullptr) return;
+  for (auto node_index : p.get_ops()) {
+    const auto* f_node_def = ctx->graph_view.GetNode(node_index)->node();
+    if (selected_nodes != nullptr &&
+        selected_nodes->count(f_node_def->name()) == 0) {
+      continue;
+    }
+    ctx->fusion_report->AddRejected("onednn_graph", f_node_def->name(),
+                                    f_node_def->op(), reason, "");
+  }
+}
+
 }  // namespace
 
 // Note: this function only handles LLGA graph, adding input/output for LLGA
@@ -1659,13 +1678,21 @@ Status SelectNode(OneDnnGraphContext* ctx, int num_nodes,
                                const utils::MutableNodeView* node_view,
                                dnnl::graph::op** onednn_graph_node)>* op_func;
     dnnl::graph::op* onednn_graph_node = nullptr;
+    bool is_translatable = false;
     if (!is_wildcard) {
-      if (tf_to_onednn_graph_op_translation_map.find(f_node_def->op()) !=
-              tf_to_onednn_graph_op_translation_map.end() &&
-          IsOneDnnGraphSupportedDataType(*f_node_def)) {
+      is_translatable =
+          tf_to_onednn_graph_op_translation_map.find(f_node_def->op()) !=
+          tf_to_onednn_graph_op_translation_map.end();
+      if (is_translatable && IsOneDnnGraphSupportedDataType(*f_node_def)) {
         op_func = &(tf_to_onednn_graph_op_translation_map.at(f_node_def->op()));
       } else {
         op_func = &(tf_to_onednn_graph_op_translation_map.at("Unhandled"));
+        if (is_translatable && ctx->fusion_report != nullptr) {
+          ctx->fusion_report->AddRejected("onednn_graph", f_node_def->name(),
+                                          f_node_def->op(), kRejectDataType,
+                                          "");
+        }
+        is_translatable = false;
       }
     } else {
       op_func = &(tf_to_onednn_graph_op_translation_map.at("Wildcard"));
@@ -1680,7 +1707,14 @@ Status SelectNode(OneDnnGraphContext* ctx, int num_nodes,
           f_node_def->op() + ")\n" + f_node_def->DebugString() + "\n" +
           "what(): " + e.what());
     }
-    if (onednn_graph_node == nullptr) continue;
+    if (onednn_graph_node == nullptr) {
+      if (is_translatable && ctx->fusion_report != nullptr) {
+        ctx->fusion_report->AddRejected("onednn_graph", f_node_def->name(),
+                                        f_node_def->op(),
+                                        kRejectPatternMismatch, "");
+      }
+      continue;
+    }
 
     if (!is_wildcard) {
       rewrite_nodes->insert(f_node_def->name());
@@ -1801,6 +1835,10 @@ Status SelectNode(OneDnnGraphContext* ctx, int num_nodes,
     DeviceNameUtils::ParsedName name;
     if (!DeviceNameUtils::ParseFullName(f_node_def->device(), &name) ||
         !name.has_type) {
+      if (!is_wildcard && ctx->fusion_report != nullptr) {
+        ctx->fusion_report->AddRejected("onednn_graph", f_node_def->name(),
+                                        f_node_def->op(), kRejectDevice, "");
+      }
       continue;
     }
 
@@ -1852,6 +1890,7 @@ Status FuseFwPartitionWithLLGA(
   if (!onednn_graph_all_type_flag & !find_quantize_dequantize) {
     ITEX_VLOG(2) << "oneDNN Graph partition doesn't contain INT8 op, won't "
                     "rewrite this partition to ";
+    RejectPartition(ctx, p, "not an INT8 partition");
     return Status::OK();
   }
 
@@ -1925,6 +1964,14 @@ Status FuseFwPartitionWithLLGA(
   onednn_graph_node.set_name(llga_op_name);
   onednn_graph_node.set_device(last_node_def->device());
 
+  if (ctx->fusion_report != nullptr) {
+    std::vector<string> sorted_ops = framework_ops;
+    std::sort(sorted_ops.begin(), sorted_ops.end());
+    ctx->fusion_report->AddFused("onednn_graph",
+                                 absl::StrJoin(sorted_ops, "+"),
+                                 last_node_def->name());
+  }
+
   ITEX_VLOG(2) << "Generate LLGA node: " << llga_op_name;
 
   // handle input
@@ -2528,6 +2575,8 @@ Status RunRewritePass(OneDnnGraphContext* ctx) {
       TF_ABORT_IF_ERROR(FuseFwPartitionWithLLGA(
           ctx, it, &invalidated_nodes, &nodes_to_delete, &edge_manager,
           &edge_manager_tmp, &addtional_args));
+    } else {
+      RejectPartition(ctx, it, "unsupported partition", &rewrite_nodes);
     }
   }
 
@@ -2577,14 +2626,10 @@ Status RunOneDnnGraph(const GrapplerItem& item, const GraphDef& graph_def,
   // TODO(itex): shape inference currently only used in verify scalar tensor
   // for LLGA Mul. Remove this shape inference function, once LLGA supports
   // scalar tensor.
-  if (!ctx.inferred_graph_properties) {
-    TF_RETURN_IF_ERROR(ctx.graph_properties.InferStatically(
-        /*assume_valid_feeds=*/true,
-        /*aggressive_shape_inference=*/false,
-        /*include_input_tensor_values=*/true,
-        /*include_output_tensor_values=*/false));
-    ctx.inferred_graph_properties = true;
-  }
+  TF_RETURN_IF_ERROR(GetSharedGraphProperties(item,
+                                              /*assume_valid_feeds=*/true,
+                                              /*include_tensor_values=*/true,
+                                              &ctx.graph_properties));
 
   TF_ABORT_IF_ERROR(ctx.graph_view.SortTopologically(false, {}));
   TF_ABORT_IF_ERROR(RunPrePass(&ctx));
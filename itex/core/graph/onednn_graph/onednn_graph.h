@@ -20,6 +20,7 @@ limitations under the License.
 #include <unordered_set>
 #include <vector>
 
+#include "itex/core/graph/utils/fusion_report.h"
 #include "itex/core/graph/utils/graph_properties.h"
 #include "itex/core/graph/utils/graph_view.h"
 #include "itex/core/graph/utils/grappler_item.h"
@@ -37,16 +38,19 @@ struct OneDnnGraphContext {
       : graph_view(g_def, status),
         fetch_tensors(item.fetch),
         nodes_to_preserve(item.NodesToPreserve()),
-        graph_properties(item),
-        inferred_graph_properties(false) {
+        graph_properties(nullptr),
+        fusion_report(GetFusionReport(item)) {
     TF_ABORT_IF_ERROR(node_type_map.Init(*g_def));
   }
   utils::MutableGraphView graph_view;
   NodeTypeAttrMap node_type_map;
   std::vector<string> fetch_tensors;
   std::unordered_set<string> nodes_to_preserve;
-  GraphProperties graph_properties;
-  bool inferred_graph_properties;
+  // Shared with the other passes optimizing the item.
+  GraphProperties* graph_properties;
+  // Shared with the other passes optimizing the item, nullptr if the fusion
+  // report is disabled.
+  FusionReport* fusion_report;
 };
 
 Status RunOneDnnGraph(const GrapplerItem& item, const GraphDef& graph_def,
@@ -0,0 +1,208 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "itex/core/graph/optimized_graph_cache.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "itex/core/devices/device_backend_util.h"
+#include "itex/core/graph/utils/op_types.h"
+#include "itex/core/utils/env_var.h"
+#include "itex/core/utils/hash.h"
+#include "itex/core/utils/numbers.h"
+#include "itex/core/utils/proto_serialization.h"
+#include "itex/core/utils/strcat.h"
+
+extern char** environ;
+
+namespace itex {
+namespace graph {
+
+namespace {
+constexpr int64 kDefaultGraphCacheCapacity = 0;
+
+size_t GetGraphCacheCapacity() {
+  int64 capacity;
+  ITEX_CHECK_OK(ReadInt64FromEnvVar("ITEX_GRAPH_CACHE_CAPACITY",
+                                    kDefaultGraphCacheCapacity, &capacity));
+  return capacity > 0 ? static_cast<size_t>(capacity) : 0;
+}
+
+// ITEX passes read part of their options from environment variables, so
+// they are part of the key as well.
+uint64 HashItexEnvVars() {
+  uint64 fp = 0;
+  for (char** env = environ; env != nullptr && *env != nullptr; ++env) {
+    if (absl::StartsWith(*env, "ITEX_")) {
+      fp = Hash64CombineUnordered(fp, Hash64(*env));
+    }
+  }
+  return fp;
+}
+
+// oneDNN Graph nodes refer to partitions registered by the process which ran
+// the oneDNN Graph pass, so graphs containing them can't be shared between
+// processes.
+bool HasOneDnnGraphPartition(const GraphDef& graph_def) {
+  for (const NodeDef& node : graph_def.node()) {
+    if (IsAnyOneDnnGraph(node)) return true;
+  }
+  return false;
+}
+}  // namespace
+
+OptimizedGraphCache& OptimizedGraphCache::GetInstance() {
+  static OptimizedGraphCache instance;
+  return instance;
+}
+
+OptimizedGraphCache::OptimizedGraphCache()
+    : capacity_(GetGraphCacheCapacity()),
+      cache_(std::max<size_t>(capacity_, 1)) {
+  ITEX_CHECK_OK(ReadStringFromEnvVar("ITEX_GRAPH_CACHE_DIR", "", &cache_dir_));
+}
+
+string OptimizedGraphCache::GetKey(const char* device_name,
+                                   const GraphDef& graph_def,
+                                   const GrapplerItem& item,
+                                   const OptimizerConfigFlags& config) {
+  uint64 fp = DeterministicProtoHash64(graph_def);
+  fp = Hash64Combine(fp, Hash64(device_name));
+
+  std::vector<string> fetch = item.fetch;
+  std::sort(fetch.begin(), fetch.end());
+  for (const string& node : fetch) {
+    fp = Hash64Combine(fp, Hash64(node));
+  }
+
+  uint64 preserve_fp = 0;
+  for (const string& node : item.NodesToPreserve()) {
+    preserve_fp = Hash64CombineUnordered(preserve_fp, Hash64(node));
+  }
+  fp = Hash64Combine(fp, preserve_fp);
+
+  fp = Hash64Combine(fp, config.enable_onednn_graph);
+  fp = Hash64Combine(fp, config.enable_remapper);
+  fp = Hash64Combine(fp, config.enable_auto_mixed_precision);
+  fp = Hash64Combine(fp, config.enable_native_format);
+  fp = Hash64Combine(fp, config.enable_layout_opt);
+  fp = Hash64Combine(fp, config.enable_elementwise_fusion);
+  fp = Hash64Combine(fp, config.remapper_run_pass);
+
+  fp = Hash64Combine(fp, DeterministicProtoHash64(itex_get_config()));
+  fp = Hash64Combine(fp, HashItexEnvVars());
+  return FpToString(fp);
+}
+
+string OptimizedGraphCache::GetFilePath(const string& key) const {
+  return strings::StrCat(cache_dir_, "/itex_optimized_graph_", key, ".pb");
+}
+
+bool OptimizedGraphCache::Find(
+    const string& key, GraphDef* optimized_graph_def,
+    std::shared_ptr<const FusionReport>* fusion_report) {
+  fusion_report->reset();
+  if (capacity_ > 0) {
+    mutex_lock lock(&mu_);
+    CachedGraph* cached = cache_.Find(key);
+    if (cached != nullptr) {
+      *optimized_graph_def = cached->graph_def;
+      *fusion_report = cached->fusion_report;
+      ITEX_VLOG(1) << "Optimized graph cache hit in memory, key: " << key
+                   << ", hit count: " << cache_.hit_count()
+                   << ", miss count: " << cache_.miss_count();
+      return true;
+    }
+  }
+
+  if (cache_dir_.empty()) return false;
+
+  std::ifstream input(GetFilePath(key), std::ios::in | std::ios::binary);
+  if (!input.is_open()) return false;
+  std::stringstream buffer;
+  buffer << input.rdbuf();
+  if (!optimized_graph_def->ParseFromString(buffer.str())) {
+    ITEX_LOG(WARNING) << "Failed to parse cached optimized graph "
+                      << GetFilePath(key) << ", ignore it.";
+    optimized_graph_def->Clear();
+    return false;
+  }
+  if (HasOneDnnGraphPartition(*optimized_graph_def)) {
+    ITEX_LOG(WARNING) << "Cached optimized graph " << GetFilePath(key)
+                      << " has oneDNN Graph partitions of another process, "
+                         "ignore it.";
+    optimized_graph_def->Clear();
+    return false;
+  }
+  ITEX_VLOG(1) << "Optimized graph cache hit on disk, key: " << key;
+
+  if (capacity_ > 0) {
+    mutex_lock lock(&mu_);
+    cache_.Insert(key, {*optimized_graph_def, nullptr});
+  }
+  return true;
+}
+
+void OptimizedGraphCache::Insert(
+    const string& key, const GraphDef& optimized_graph_def,
+    std::shared_ptr<const FusionReport> fusion_report) {
+  if (capacity_ > 0) {
+    mutex_lock lock(&mu_);
+    cache_.Insert(key, {optimized_graph_def, std::move(fusion_report)});
+  }
+
+  if (cache_dir_.empty()) return;
+  if (HasOneDnnGraphPartition(optimized_graph_def)) {
+    ITEX_VLOG(1) << "Not saving optimized graph with oneDNN Graph partitions "
+                    "to disk, key: "
+                 << key;
+    return;
+  }
+
+  // Write to a temporary file first, so that other processes sharing the
+  // directory never read a partially written graph.
+  string path = GetFilePath(key);
+  string tmp_path = strings::StrCat(path, ".tmp.", getpid());
+  string serialized;
+  if (!SerializeToStringDeterministic(optimized_graph_def, &serialized)) {
+    ITEX_LOG(WARNING) << "Failed to serialize optimized graph, key: " << key;
+    return;
+  }
+  std::ofstream output(tmp_path,
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!output.is_open()) {
+    ITEX_LOG(WARNING) << "Unable to create optimized graph cache file "
+                      << tmp_path;
+    return;
+  }
+  output << serialized;
+  output.close();
+  if (!output.good() || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    ITEX_LOG(WARNING) << "Failed to write optimized graph cache file " << path;
+    std::remove(tmp_path.c_str());
+  }
+}
+
+}  // namespace graph
+}  // namespace itex
@@ -0,0 +1,87 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef ITEX_CORE_GRAPH_OPTIMIZED_GRAPH_CACHE_H_
+#define ITEX_CORE_GRAPH_OPTIMIZED_GRAPH_CACHE_H_
+
+#include <memory>
+#include <string>
+
+#include "itex/core/graph/optimizer_config.h"
+#include "itex/core/graph/utils/fusion_report.h"
+#include "itex/core/graph/utils/grappler_item.h"
+#include "itex/core/utils/lru_cache.h"
+#include "itex/core/utils/mutex.h"
+#include "itex/core/utils/types.h"
+#include "protos/graph.pb.h"
+
+namespace itex {
+namespace graph {
+
+// Process-wide cache of graphs optimized by ITEX, so that optimizing the same
+// graph again (e.g. reloading a SavedModel or retracing a function) skips all
+// ITEX graph passes. Both caches are opt-in: the in-process cache holds at
+// most `ITEX_GRAPH_CACHE_CAPACITY` graphs, and is disabled when it's 0 (the
+// default). If `ITEX_GRAPH_CACHE_DIR` is set, optimized graphs are also
+// stored in that directory and shared between processes, except the ones
+// with oneDNN Graph partitions, which only exist in the process that created
+// them. Graphs cached in memory keep the fusion report of the optimization
+// which produced them, if reporting was enabled.
+class OptimizedGraphCache {
+ public:
+  static OptimizedGraphCache& GetInstance();
+
+  // Returns true if the in-process or the on-disk cache is enabled.
+  bool enabled() const { return capacity_ > 0 || !cache_dir_.empty(); }
+
+  // Fingerprint of everything which affects ITEX graph optimization: input
+  // graph, device, fetch nodes, nodes to preserve, optimizer config flags,
+  // ITEX config and ITEX environment variables.
+  static string GetKey(const char* device_name, const GraphDef& graph_def,
+                       const GrapplerItem& item,
+                       const OptimizerConfigFlags& config);
+
+  // Looks up the optimized graph of `key` in memory first, then on disk.
+  // `fusion_report` is set to nullptr if the graph has no report, e.g. it's
+  // loaded from disk.
+  bool Find(const string& key, GraphDef* optimized_graph_def,
+            std::shared_ptr<const FusionReport>* fusion_report)
+      TF_LOCKS_EXCLUDED(mu_);
+
+  void Insert(const string& key, const GraphDef& optimized_graph_def,
+              std::shared_ptr<const FusionReport> fusion_report)
+      TF_LOCKS_EXCLUDED(mu_);
+
+ private:
+  OptimizedGraphCache();
+
+  struct CachedGraph {
+    GraphDef graph_def;
+    std::shared_ptr<const FusionReport> fusion_report;
+  };
+
+  string GetFilePath(const string& key) const;
+
+  size_t capacity_;
+  string cache_dir_;
+
+  mutex mu_;
+  LRUCache<CachedGraph> cache_ TF_GUARDED_BY(mu_);
+};
+
+}  // namespace graph
+}  // namespace itex
+
+#endif  // ITEX_CORE_GRAPH_OPTIMIZED_GRAPH_CACHE_H_
@@ -47,6 +47,7 @@ void SetOptimizerConfigFlags(OptimizerConfigFlags* opt_config_flags) {
   bool auto_mixed_precision_flag;
   bool native_format_flag;
   bool layout_opt_flag;
+  bool elementwise_fusion_flag;
 
   auto cfg_ = itex::itex_get_config();
 #define USER_IS_ON(CFG) cfg_.graph_options().CFG() == itex::Toggle::ON
@@ -123,12 +124,19 @@ void SetOptimizerConfigFlags(OptimizerConfigFlags* opt_config_flags) {
 #undef USER_IS_OFF
 #undef USER_IS_SET
 
+  // The fused kernel computes bf16 chains in fp32 without rounding between
+  // ops, so results differ from the unfused graph and it's opt-in.
+  ITEX_CHECK_OK(itex::ReadBoolFromEnvVar("ITEX_ELEMENTWISE_FUSION",
+                                         enable_itex_elementwise_fusion,
+                                         &elementwise_fusion_flag));
+
   // Set OptimizerConfigFlags.
   opt_config_flags->enable_onednn_graph = onednn_graph_flag;
   opt_config_flags->enable_remapper = remapper_flag;
   opt_config_flags->enable_auto_mixed_precision = auto_mixed_precision_flag;
   opt_config_flags->enable_native_format = native_format_flag;
   opt_config_flags->enable_layout_opt = layout_opt_flag;
+  opt_config_flags->enable_elementwise_fusion = elementwise_fusion_flag;
   opt_config_flags->remapper_run_pass = remapper_run_pass;
 }
 
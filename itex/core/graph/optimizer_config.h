@@ -24,6 +24,7 @@ constexpr static bool enable_itex_remapper = true;
 constexpr static bool enable_itex_auto_mixed_precision = false;
 constexpr static bool enable_itex_native_format = false;
 constexpr static bool enable_itex_layout_opt = true;
+constexpr static bool enable_itex_elementwise_fusion = false;
 constexpr static int32_t remapper_run_pass = 2;
 
 typedef struct _OptimizerConfigFlags {
@@ -33,6 +34,7 @@ typedef struct _OptimizerConfigFlags {
   // TODO(itex): To integrate DOC & GraphOptions
   bool enable_native_format;
   bool enable_layout_opt;
+  bool enable_elementwise_fusion;
   int32_t remapper_run_pass;
 } OptimizerConfigFlags;
 
@@ -95,12 +95,12 @@ class BatchMatMulWithMulAndAddV2Fusion : public Fusion {
 
  private:
   bool CheckMul(RemapperContext* ctx, int index) const {
-    auto properties = GetOutputProperties(ctx, index);
+    const auto& properties = GetOutputProperties(ctx, index);
     return !properties.empty() && NumCoefficients(properties[0].shape()) == 1;
   }
 
   bool CheckBatchMatmul(RemapperContext* ctx, int index) const {
-    auto properties = GetOutputProperties(ctx, index);
+    const auto& properties = GetOutputProperties(ctx, index);
     auto node_def = ctx->graph_view.GetNode(index)->node();
 
     // TODO(itex) only support for CPU now due to performance issue on GPU.
@@ -109,7 +109,7 @@ class BatchMatMulWithMulAndAddV2Fusion : public Fusion {
   }
 
   bool CheckAddV2(RemapperContext* ctx, int index) const {
-    auto properties = GetOutputProperties(ctx, index);
+    const auto& properties = GetOutputProperties(ctx, index);
     return !properties.empty() && Rank(properties[0].shape()) == 4 &&
            properties[0].shape().dim(1).size() == 1;
   }
@@ -40,7 +40,9 @@ constexpr char kConv3DBackpropFilterV2[] = "Conv3DBackpropFilterV2";
 constexpr char kConv3DBackpropFilterWithBias[] = "Conv3DBackpropFilterWithBias";
 constexpr char kConv3D[] = "Conv3D";
 constexpr char kDequantize[] = "Dequantize";
+constexpr char kEinsum[] = "Einsum";
 constexpr char kFusedBatchNormV3[] = "FusedBatchNormV3";
+constexpr char kIdentity[] = "Identity";
 constexpr char kLeakyRelu[] = "LeakyRelu";
 constexpr char kMatMul[] = "MatMul";
 constexpr char kMean[] = "Mean";
@@ -56,6 +58,7 @@ constexpr char kResizeNearestNeighbor[] = "ResizeNearestNeighbor";
 constexpr char kResizeNearestNeighborGrad[] = "ResizeNearestNeighborGrad";
 constexpr char kRsqrt[] = "Rsqrt";
 constexpr char kSlice[] = "Slice";
+constexpr char kSoftmax[] = "Softmax";
 constexpr char kSub[] = "Sub";
 constexpr char kSigmoid[] = "Sigmoid";
 constexpr char kSplit[] = "Split";
@@ -65,7 +68,9 @@ constexpr char kSquare[] = "Square";
 constexpr char kSquaredDifference[] = "SquaredDifference";
 constexpr char kSwish[] = "Swish";
 constexpr char kTanh[] = "Tanh";
+constexpr char kTranspose[] = "Transpose";
 
+constexpr char kEmbeddingBag[] = "_ITEXEmbeddingBag";
 constexpr char kFusedBatchMatMulV2[] = "_FusedBatchMatMulV2";
 constexpr char kInstanceNorm[] = "InstanceNorm";
 constexpr char kFusedInstanceNorm[] = "FusedInstanceNorm";
@@ -74,6 +79,8 @@ constexpr char kITEXFusedMatMul[] = "_ITEXFusedMatMul";
 constexpr char kLayerNorm[] = "LayerNorm";
 constexpr char kMklLayerNorm[] = "_MklLayerNorm";
 constexpr char kPadConv3d[] = "_ITEXConv3D";
+constexpr char kScaledDotProductAttention[] =
+    "_ITEXScaledDotProductAttention";
 
 }  // namespace graph
 }  // namespace itex
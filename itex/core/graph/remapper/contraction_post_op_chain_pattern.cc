@@ -0,0 +1,270 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_join.h"
+#include "itex/core/graph/remapper/constant_names.h"
+#include "itex/core/graph/remapper/fusion.h"
+#include "itex/core/graph/remapper/remapper.h"
+#include "itex/core/graph/utils/layout_utils.h"
+#include "itex/core/graph/utils/op_types.h"
+#include "itex/core/graph/utils/symbolic_shapes.h"
+#include "itex/core/graph/utils/utils.h"
+#include "itex/core/utils/errors.h"
+#include "itex/core/utils/node_def_util.h"
+#include "itex/core/utils/onednn/onednn_post_op_util.h"
+
+namespace itex {
+namespace graph {
+
+namespace {
+
+// oneDNN limits the number of post ops of a primitive, and long chains are
+// rarely seen after a contraction, so keep the search short.
+constexpr int kMaxPostOps = 8;
+
+struct PostOpChainMatch {
+  utils::MutableNodeView* contraction = nullptr;
+  string bias;
+  // Post ops from the contraction to the root, and the other inputs of the
+  // binary ones in the same order.
+  std::vector<const NodeDef*> post_ops;
+  std::vector<string> operands;
+  // Nodes replaced by the fused op, except the root.
+  std::vector<int> removed;
+};
+
+}  // namespace
+
+// Fuses MatMul with an optional BiasAdd and a chain of eltwise and binary ops
+//   root(... binary(eltwise(BiasAdd(MatMul(a, b), bias)), operand) ...)
+// into _ITEXFusedMatMul, which applies the chain as oneDNN post ops. Operands
+// of binary ops are broadcast to the output per tensor, per channel or not at
+// all, and they become inputs of the fused op after the bias.
+class ContractionWithPostOpChainFusion : public Fusion {
+ public:
+  ContractionWithPostOpChainFusion() : Fusion() {
+    // The chain has any length, so it's matched by hand.
+    pattern_.num_nodes = 2;
+    // Try it after the other fusions of these ops, which handle the chains
+    // they know with dedicated kernels or layouts.
+    priority = std::numeric_limits<int>::min();
+  }
+
+  ~ContractionWithPostOpChainFusion() {}
+
+  std::string Name() override { return "contraction-with-post-op-chain"; }
+
+  std::string Key() override {
+    std::vector<string> keys = {"Add", kAddV2, kMul, "Maximum", "Minimum"};
+    for (const PostOpInfo& info : PostOpUtil::GetAllPostOpInfo()) {
+      if (PostOpUtil::IsSupportedActivation(info.name)) {
+        keys.push_back(string(info.name));
+      }
+    }
+    return absl::StrJoin(keys, "|");
+  }
+
+  MatchedProperties Check(RemapperContext* ctx,
+                          const int node_index) const override {
+    MatchedProperties ret;
+    PostOpChainMatch match;
+    if (!Match(ctx, node_index, &match)) return ret;
+
+    ret.map.emplace("output", node_index);
+    ret.invalidated.insert(node_index);
+    ret.deleted.insert(match.removed.begin(), match.removed.end());
+    return ret;
+  }
+
+  Status Update(RemapperContext* ctx /** in and out **/,
+                const MatchedProperties& properties) const override {
+    const int node_index = properties.map.at("output");
+    PostOpChainMatch match;
+    if (!Match(ctx, node_index, &match)) {
+      return errors::Internal("Failed to match the post op chain again.");
+    }
+    const NodeDef* output_node = ctx->graph_view.GetNode(node_index)->node();
+    const NodeDef* contraction = match.contraction->node();
+
+    NodeDef fused_node;
+    fused_node.set_name(output_node->name());
+    fused_node.set_op(kITEXFusedMatMul);
+    fused_node.set_device(contraction->device());
+    fused_node.add_input(contraction->input(0));
+    fused_node.add_input(contraction->input(1));
+    if (!match.bias.empty()) fused_node.add_input(match.bias);
+    for (const string& operand : match.operands) {
+      fused_node.add_input(operand);
+    }
+
+    CopyAllAttrs(*contraction, &fused_node);
+    std::vector<string> fused_ops;
+    if (!match.bias.empty()) fused_ops.push_back(kBiasAdd);
+    for (const NodeDef* post_op : match.post_ops) {
+      if (IsLeakyRelu(*post_op)) {
+        AddNodeAttr("leakyrelu_alpha", post_op->attr().at("alpha"),
+                    &fused_node);
+      }
+      fused_ops.push_back(PostOpName(*post_op));
+    }
+    const int num_args = (match.bias.empty() ? 0 : 1) +
+                         static_cast<int>(match.operands.size());
+    SetFusedOpAttributes(
+        &fused_node,
+        std::vector<absl::string_view>(fused_ops.begin(), fused_ops.end()),
+        num_args);
+
+    utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+    Status status;
+    mutation->AddNode(std::move(fused_node), &status);
+    TF_RETURN_IF_ERROR(status);
+    TF_RETURN_IF_ERROR(mutation->Apply());
+    return Status::OK();
+  }
+
+ private:
+  static utils::MutableNodeView* Fanin(utils::MutableNodeView* node_view,
+                                       int port) {
+    return node_view->GetRegularFanin(port).node_view();
+  }
+
+  // Returns true if `node_view` is only read by the next node of the chain,
+  // so it can be removed.
+  static bool IsIntermediate(const RemapperContext& ctx,
+                             const utils::MutableNodeView& node_view,
+                             const NodeDef& root) {
+    const NodeDef* node_def = node_view.node();
+    return node_view.NumControllingFanins() == 0 &&
+           node_view.NumControlledFanouts() == 0 &&
+           node_view.GetRegularFanout(0).size() == 1 &&
+           ctx.nodes_to_preserve.count(node_def->name()) == 0 &&
+           node_def->device() == root.device();
+  }
+
+  static bool IsBinaryPostOp(const NodeDef& node_def) {
+    return IsAdd(node_def) || IsMul(node_def) || IsMaximum(node_def) ||
+           IsMinimum(node_def);
+  }
+
+  // Returns the name of `node_def` in `fused_ops` of the fused op.
+  static string PostOpName(const NodeDef& node_def) {
+    if (IsAdd(node_def)) return kBinaryAdd;
+    if (IsMul(node_def)) return "BinaryMul";
+    if (IsMaximum(node_def)) return "BinaryMaximum";
+    if (IsMinimum(node_def)) return "BinaryMinimum";
+    if (IsGelu(node_def)) {
+      return node_def.attr().at("approximate").b() ? "GeluApproximate"
+                                                   : "GeluExact";
+    }
+    return node_def.op();
+  }
+
+  // Returns true if input `port` of binary `node_view` may carry the chain,
+  // which requires the other input to be broadcast to it, not the reverse.
+  static bool IsChainInput(RemapperContext* ctx,
+                           const utils::MutableNodeView& node_view, int port) {
+    const auto& input_props =
+        ctx->GetGraphProperties().GetInputProperties(node_view.node()->name());
+    const auto& output_props = GetOutputProperties(ctx, node_view.node_index());
+    if (input_props.size() != 2 || output_props.empty()) return false;
+    const TensorShapeProto& operand = input_props[1 - port].shape();
+    return ShapesSymbolicallyEqual(output_props[0].shape(),
+                                   input_props[port].shape()) &&
+           Rank(operand) >= 0 && Rank(operand) <= Rank(output_props[0].shape());
+  }
+
+  // Matches the post op `node_view` and the chain feeding it.
+  static bool MatchPostOp(RemapperContext* ctx, const NodeDef& root,
+                          utils::MutableNodeView* node_view, int depth,
+                          PostOpChainMatch* match) {
+    if (depth >= kMaxPostOps) return false;
+    const NodeDef* node_def = node_view->node();
+    if (PostOpUtil::IsSupportedActivation(node_def->op())) {
+      if (!MatchChain(ctx, root, Fanin(node_view, 0), depth + 1, match)) {
+        return false;
+      }
+      match->post_ops.push_back(node_def);
+      return true;
+    }
+    if (!IsBinaryPostOp(*node_def)) return false;
+
+    const PostOpChainMatch matched_root = *match;
+    for (int port = 0; port < 2; ++port) {
+      *match = matched_root;
+      if (IsChainInput(ctx, *node_view, port) &&
+          MatchChain(ctx, root, Fanin(node_view, port), depth + 1, match)) {
+        match->post_ops.push_back(node_def);
+        match->operands.push_back(node_def->input(1 - port));
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Matches the chain ending with `node_view`, which is either a post op or
+  // the contraction with an optional BiasAdd.
+  static bool MatchChain(RemapperContext* ctx, const NodeDef& root,
+                         utils::MutableNodeView* node_view, int depth,
+                         PostOpChainMatch* match) {
+    if (!IsIntermediate(*ctx, *node_view, root)) return false;
+    match->removed.push_back(node_view->node_index());
+
+    const NodeDef* node_def = node_view->node();
+    if (IsMatMul(*node_def)) {
+      match->contraction = node_view;
+      return true;
+    }
+    if (IsBiasAdd(*node_def)) {
+      utils::MutableNodeView* contraction = Fanin(node_view, 0);
+      if (!IsMatMul(*contraction->node()) ||
+          !IsIntermediate(*ctx, *contraction, root)) {
+        return false;
+      }
+      match->removed.push_back(contraction->node_index());
+      match->contraction = contraction;
+      match->bias = node_def->input(1);
+      return true;
+    }
+    return MatchPostOp(ctx, root, node_view, depth, match);
+  }
+
+  static bool Match(RemapperContext* ctx, int node_index,
+                    PostOpChainMatch* match) {
+    utils::MutableNodeView* output = ctx->graph_view.GetNode(node_index);
+    const NodeDef& root = *output->node();
+    // TODO(itex): Wire binary post ops into the GPU kernels and Conv.
+    if (!NodeIsOnCpu(&root) || output->NumControllingFanins() != 0 ||
+        (!HasDataType(&root, DT_FLOAT) && !HasDataType(&root, DT_BFLOAT16))) {
+      return false;
+    }
+    if (!MatchPostOp(ctx, root, output, /*depth=*/0, match)) return false;
+
+    // The fused op has only one alpha for LeakyRelu.
+    int num_leaky_relu = 0;
+    for (const NodeDef* post_op : match->post_ops) {
+      if (IsLeakyRelu(*post_op)) ++num_leaky_relu;
+    }
+    return num_leaky_relu <= 1;
+  }
+};
+
+REGISTER_FUSION(ContractionWithPostOpChainFusion)
+
+}  // namespace graph
+}  // namespace itex
@@ -0,0 +1,260 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <string>
+#include <vector>
+
+#include "itex/core/graph/remapper/constant_names.h"
+#include "itex/core/graph/remapper/fusion.h"
+#include "itex/core/graph/remapper/remapper.h"
+#include "itex/core/graph/utils/op_types.h"
+#include "itex/core/graph/utils/symbolic_shapes.h"
+#include "itex/core/graph/utils/utils.h"
+#include "itex/core/utils/errors.h"
+#include "itex/core/utils/node_def_util.h"
+#include "itex/core/utils/plugin_tensor.h"
+#include "itex/core/utils/strcat.h"
+
+namespace itex {
+namespace graph {
+
+namespace {
+
+constexpr char kGatherV2[] = "GatherV2";
+constexpr char kResourceGather[] = "ResourceGather";
+constexpr char kSparseSegmentMean[] = "SparseSegmentMean";
+constexpr char kSparseSegmentSqrtN[] = "SparseSegmentSqrtN";
+constexpr char kSparseSegmentSum[] = "SparseSegmentSum";
+constexpr char kSum[] = "Sum";
+
+struct EmbeddingBagMatch {
+  utils::MutableNodeView* gather = nullptr;
+  string combiner;
+  bool has_segments = false;
+  // Nodes replaced by the fused op, except the root.
+  std::vector<int> removed;
+};
+
+}  // namespace
+
+// Fuses the lookup of embeddings and the combiner of each bag
+//   SparseSegment{Sum,Mean,SqrtN}(Gather(params, ids), indices, segment_ids)
+//   {Sum,Mean}(Gather(params, ids), axis=1)
+// into _ITEXEmbeddingBag, which adds the rows of params to their bags
+// directly instead of gathering them to a [num_ids, dim] tensor first. The
+// gather is either GatherV2 on axis 0 or ResourceGather, and it may be
+// followed by Identity like in tf.nn.embedding_lookup.
+class EmbeddingBagFusion : public Fusion {
+ public:
+  EmbeddingBagFusion() : Fusion() {
+    // Both forms are matched by hand.
+    pattern_.num_nodes = 2;
+  }
+
+  ~EmbeddingBagFusion() {}
+
+  std::string Name() override { return "embedding-bag"; }
+
+  std::string Key() override {
+    return strings::StrCat(kSparseSegmentSum, "|", kSparseSegmentMean, "|",
+                           kSparseSegmentSqrtN, "|", kSum, "|", kMean);
+  }
+
+  MatchedProperties Check(RemapperContext* ctx,
+                          const int node_index) const override {
+    MatchedProperties ret;
+    EmbeddingBagMatch match;
+    if (!Match(ctx, node_index, &match)) return ret;
+
+    ret.map.emplace("output", node_index);
+    ret.invalidated.insert(node_index);
+    ret.deleted.insert(match.removed.begin(), match.removed.end());
+    return ret;
+  }
+
+  Status Update(RemapperContext* ctx /** in and out **/,
+                const MatchedProperties& properties) const override {
+    const int node_index = properties.map.at("output");
+    EmbeddingBagMatch match;
+    if (!Match(ctx, node_index, &match)) {
+      return errors::Internal("Failed to match the embedding bag again.");
+    }
+    const NodeDef* output_node = ctx->graph_view.GetNode(node_index)->node();
+    const NodeDef* gather_node = match.gather->node();
+
+    NodeDef fused_node;
+    fused_node.set_name(output_node->name());
+    fused_node.set_op(kEmbeddingBag);
+    fused_node.set_device(output_node->device());
+    fused_node.add_input(gather_node->input(0));
+    fused_node.add_input(gather_node->input(1));
+    if (match.has_segments) {
+      fused_node.add_input(output_node->input(1));
+      fused_node.add_input(output_node->input(2));
+    }
+    // Keep the control dependencies of both nodes, such as the ones added to
+    // the reads of variables in functions.
+    for (const NodeDef* node : {gather_node, output_node}) {
+      for (const string& input : node->input()) {
+        if (IsControlInput(input)) fused_node.add_input(input);
+      }
+    }
+
+    auto* attr = fused_node.mutable_attr();
+    const AttrValue& type = output_node->attr().at("T");
+    (*attr)["T"] = type;
+    if (gather_node->op() == kResourceGather) {
+      SetAttrValue(DT_RESOURCE, &(*attr)["Tparams"]);
+    } else {
+      (*attr)["Tparams"] = type;
+    }
+    (*attr)["Tindices"] = gather_node->attr().at("Tindices");
+    if (match.has_segments) {
+      (*attr)["Tidx"] = output_node->attr().at("Tidx");
+      // Older SparseSegment ops only take int32 segment ids.
+      DataType segment_type = DT_INT32;
+      TryGetNodeAttr(*output_node, "Tsegmentids", &segment_type);
+      SetAttrValue(segment_type, &(*attr)["Tsegmentids"]);
+    }
+    SetAttrValue(match.combiner, &(*attr)["combiner"]);
+    SetAttrValue(match.has_segments ? 1 : 0, &(*attr)["num_segment_inputs"]);
+
+    utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+    Status status;
+    mutation->AddNode(std::move(fused_node), &status);
+    TF_RETURN_IF_ERROR(status);
+    TF_RETURN_IF_ERROR(mutation->Apply());
+    return Status::OK();
+  }
+
+ private:
+  static utils::MutableNodeView* Fanin(utils::MutableNodeView* node_view,
+                                       int port) {
+    return node_view->GetRegularFanin(port).node_view();
+  }
+
+  // Returns the values of the integer Const feeding input `port` of
+  // `node_view`, or false if it isn't one.
+  static bool GetConstValues(utils::MutableNodeView* node_view, int port,
+                             std::vector<int64>* values) {
+    const NodeDef* const_node = Fanin(node_view, port)->node();
+    Tensor tensor;
+    if (const_node->op() != kConst ||
+        !tensor.FromProto(const_node->attr().at("value").tensor()) ||
+        (tensor.dtype() != DT_INT32 && tensor.dtype() != DT_INT64)) {
+      return false;
+    }
+    values->clear();
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.dtype() == DT_INT32 ? tensor.flat<int32>()(i)
+                                                   : tensor.flat<int64>()(i));
+    }
+    return true;
+  }
+
+  // Returns true if `node_view` is only read by the next node of the
+  // pattern, so it can be removed.
+  static bool IsIntermediate(const RemapperContext& ctx,
+                             const utils::MutableNodeView& node_view,
+                             const NodeDef& root) {
+    const NodeDef* node_def = node_view.node();
+    return node_view.NumControlledFanouts() == 0 &&
+           node_view.GetRegularFanout(0).size() == 1 &&
+           ctx.nodes_to_preserve.count(node_def->name()) == 0 &&
+           node_def->device() == root.device();
+  }
+
+  // Returns true if `node_view` gathers rows of params, i.e. on axis 0
+  // without batch dims.
+  static bool IsRowGather(utils::MutableNodeView* node_view,
+                          const NodeDef& root) {
+    const NodeDef* node_def = node_view->node();
+
+    int batch_dims = 0;
+    TryGetNodeAttr(*node_def, "batch_dims", &batch_dims);
+    if (batch_dims != 0) return false;
+    if (node_def->op() == kResourceGather) {
+      DataType dtype;
+      return TryGetNodeAttr(*node_def, "dtype", &dtype) &&
+             dtype == root.attr().at("T").type();
+    }
+    std::vector<int64> axis;
+    return node_def->op() == kGatherV2 &&
+           GetConstValues(node_view, 2, &axis) && axis.size() == 1 &&
+           axis[0] == 0;
+  }
+
+  // Returns the rank of the ids of `gather`, or -1 if it's unknown.
+  static int IdsRank(RemapperContext* ctx, const NodeDef& gather) {
+    const auto& props =
+        ctx->GetGraphProperties().GetInputProperties(gather.name());
+    return props.size() >= 2 ? Rank(props[1].shape()) : -1;
+  }
+
+  static bool Match(RemapperContext* ctx, int node_index,
+                    EmbeddingBagMatch* match) {
+    utils::MutableNodeView* output = ctx->graph_view.GetNode(node_index);
+    const NodeDef& root = *output->node();
+    // TODO(itex): Add a GPU kernel.
+    if (!NodeIsOnCpu(&root) ||
+        (!HasDataType(&root, DT_FLOAT) && !HasDataType(&root, DT_BFLOAT16))) {
+      return false;
+    }
+
+    utils::MutableNodeView* gather = Fanin(output, 0);
+    while (IsIdentity(*gather->node()) &&
+           gather->NumControllingFanins() == 0 &&
+           IsIntermediate(*ctx, *gather, root)) {
+      match->removed.push_back(gather->node_index());
+      gather = Fanin(gather, 0);
+    }
+    if (!IsIntermediate(*ctx, *gather, root) || !IsRowGather(gather, root)) {
+      return false;
+    }
+    match->removed.push_back(gather->node_index());
+    match->gather = gather;
+
+    const string& op = root.op();
+    if (op == kSparseSegmentSum || op == kSparseSegmentMean ||
+        op == kSparseSegmentSqrtN) {
+      // Segments pick the gathered rows, which are the ids only if the ids
+      // are a vector.
+      match->has_segments = true;
+      match->combiner = op == kSparseSegmentSum
+                            ? "sum"
+                            : (op == kSparseSegmentMean ? "mean" : "sqrtn");
+      return IdsRank(ctx, *gather->node()) == 1;
+    }
+
+    // The reduction over the bags of 2-D ids, from a 2-D params.
+    bool keep_dims = false;
+    TryGetNodeAttr(root, "keep_dims", &keep_dims);
+    const auto& gather_props = GetOutputProperties(ctx, gather->node_index());
+    std::vector<int64> axis;
+    if (keep_dims || IdsRank(ctx, *gather->node()) != 2 ||
+        gather_props.empty() || Rank(gather_props[0].shape()) != 3 ||
+        !GetConstValues(output, 1, &axis) || axis.size() != 1 ||
+        (axis[0] != 1 && axis[0] != -2)) {
+      return false;
+    }
+    match->combiner = op == kSum ? "sum" : "mean";
+    return true;
+  }
+};
+
+REGISTER_FUSION(EmbeddingBagFusion)
+
+}  // namespace graph
+}  // namespace itex
@@ -16,12 +16,17 @@ limitations under the License.
 #include "itex/core/graph/remapper/fusion.h"
 
 #include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_join.h"
+#include "itex/core/graph/utils/fusion_report.h"
+#include "itex/core/graph/utils/op_types.h"
 #include "itex/core/graph/utils/pattern_utils.h"
 #include "itex/core/graph/utils/utils.h"
+#include "itex/core/utils/node_def_util.h"
 
 namespace itex {
 namespace graph {
@@ -58,6 +63,24 @@ Fusion::InternalPattern::InternalPattern(OpTypePattern&& pattern) {
   num_nodes = NumNodesHelper(info);
 }
 
+Status Fusion::Run(RemapperContext* ctx, int node_index,
+                   std::vector<bool>* invalidated, std::vector<bool>* deleted,
+                   bool* matched) const {
+  auto properties = Check(ctx, node_index);
+  *matched = !properties.Empty();
+  if (!*matched) return Status::OK();
+
+  Status status = Update(ctx, properties);
+  for (auto const& index : properties.invalidated) {
+    invalidated->at(index) = true;
+  }
+
+  for (auto const& index : properties.deleted) {
+    deleted->at(index) = true;
+  }
+  return status;
+}
+
 int Fusion::NumNodes() const { return pattern_.num_nodes; }
 
 std::string Fusion::Key() { return pattern_.info.op; }
@@ -69,10 +92,13 @@ FusionMgr& FusionMgr::GetInstance() {
 
 void FusionMgr::Sort() {
   for (auto& [key, value] : map_) {
-    std::sort(value.begin(), value.end(),
-              [](const Fusion* left, const Fusion* right) {
-                return left->NumNodes() > right->NumNodes();
-              });
+    std::stable_sort(value.begin(), value.end(),
+                     [](const Fusion* left, const Fusion* right) {
+                       if (left->priority != right->priority) {
+                         return left->priority > right->priority;
+                       }
+                       return left->NumNodes() > right->NumNodes();
+                     });
   }
 }
 
@@ -108,20 +134,37 @@ MatchedProperties FillProperties(utils::MutableGraphView* graph_view,
   return properties;
 }
 
-std::vector<OpInfo_TensorProperties> GetOutputProperties(RemapperContext* ctx,
-                                                         int index) {
-  std::vector<OpInfo_TensorProperties> properties;
-
+const std::vector<OpInfo_TensorProperties>& GetOutputProperties(
+    RemapperContext* ctx, int index) {
   NodeDef* node_def = ctx->graph_view.GetNode(index)->node();
-  Status s = ctx->GetGraphProperties().GetOutputProperties(node_def->name(),
-                                                           &properties);
+  return ctx->GetGraphProperties().GetOutputProperties(node_def->name());
+}
 
-  if (!s.ok()) {
-    ITEX_VLOG(1) << "Have not found the output properties for "
-                 << node_def->name();
+// Guesses why none of the fusions matched the node, from the conditions
+// most matchers check on the root and its inputs first.
+static const char* GetRejectionReason(RemapperContext* ctx, int index) {
+  const auto* node_view = ctx->graph_view.GetNode(index);
+  DataType dtype;
+  if (TryGetNodeAttr(AttrSlice(*node_view->node()), "T", &dtype) &&
+      dtype != DT_FLOAT && dtype != DT_BFLOAT16 && dtype != DT_HALF) {
+    return kRejectDataType;
   }
 
-  return properties;
+  if (node_view->NumControllingFanins() > 0 ||
+      node_view->NumControlledFanouts() > 0) {
+    return kRejectControlEdge;
+  }
+
+  for (int i = 0; i < node_view->NumRegularFanins(); ++i) {
+    const auto& fanin = node_view->GetRegularFanin(i);
+    const auto* fanin_view = fanin.node_view();
+    if (IsAnyConst(*fanin_view->node())) continue;
+    if (fanin_view->NumControllingFanins() > 0) return kRejectControlEdge;
+    if (fanin_view->GetRegularFanout(fanin.index()).size() > 1) {
+      return kRejectMultipleFanout;
+    }
+  }
+  return kRejectPatternMismatch;
 }
 
 Status LaunchPatternMatcher(RemapperContext* ctx, int index,
@@ -129,27 +172,35 @@ Status LaunchPatternMatcher(RemapperContext* ctx, int index,
                             std::vector<bool>* deleted, bool is_full) {
   auto* node = ctx->graph_view.GetNode(index)->node();
 
+  std::vector<std::string> tried;
   for (auto const& fusion : FusionMgr::GetInstance().GetFusions(node->op())) {
     if (!is_full && !fusion->is_partial) continue;
+    if (ctx->fusion_report != nullptr) tried.push_back(fusion->Name());
     ITEX_VLOG(3) << "Start to run fusion pass: " << fusion->Name();
-    auto properties = fusion->Check(ctx, index);
-    if (!properties.Empty()) {
-      Status status = fusion->Update(ctx, properties);
-
-      for (auto const& index : properties.invalidated) {
-        invalidated->at(index) = true;
-      }
-
-      for (auto const& index : properties.deleted) {
-        deleted->at(index) = true;
-      }
-
+    FusionStats& stats = ctx->fusion_stats[fusion];
+    auto start = std::chrono::steady_clock::now();
+    bool matched = false;
+    Status status = fusion->Run(ctx, index, invalidated, deleted, &matched);
+    stats.num_tried++;
+    stats.time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    if (matched) {
+      stats.num_matched++;
       ITEX_VLOG(3) << "Succeed to match fusion pass: " << fusion->Name();
+      if (ctx->fusion_report != nullptr) {
+        ctx->fusion_report->AddFused("remapper", fusion->Name(), node->name());
+      }
       return status;
     }
     ITEX_VLOG(3) << "Failed to match fusion pass: " << fusion->Name();
   }
 
+  if (!tried.empty()) {
+    ctx->fusion_report->AddRejected("remapper", node->name(), node->op(),
+                                    GetRejectionReason(ctx, index),
+                                    absl::StrJoin(tried, ","));
+  }
   return Status::OK();
 }
 }  // namespace graph
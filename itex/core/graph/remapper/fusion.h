@@ -77,6 +77,10 @@ class Fusion {
   // We can set it as true only if we need this fusion when oneDNN Graph is
   // enabled. Currently, only InstanceNorm and LayerNorm is set is_partial=true.
 
+  // Fusions with the same key are tried from the highest priority. Fusions
+  // with the same priority are tried from the one with most nodes.
+  int priority = 0;
+
   struct InternalPattern {
     InternalPattern() = default;
     explicit InternalPattern(utils::OpTypePattern&& pattern_graph);
@@ -99,11 +103,17 @@ class Fusion {
   virtual Status Update(RemapperContext* ctx /** in and out **/,
                         const MatchedProperties& properties) const = 0;
 
+  // Tries the fusion on the node and updates the graph if it's matched. The
+  // default one is Check followed by Update.
+  virtual Status Run(RemapperContext* ctx, int node_index,
+                     std::vector<bool>* invalidated,
+                     std::vector<bool>* deleted, bool* matched) const;
+
   // The fusion name, such as sigmoid-with-mul.
   virtual std::string Name() = 0;
 
-  // The output node op of pattern graph.
-  std::string Key();
+  // The output node op of pattern graph. Multiple ops are separated by "|".
+  virtual std::string Key();
 
   // The nodes number in graph, including Any node.
   int NumNodes() const;
@@ -120,8 +130,9 @@ class FusionMgr {
   void operator=(const FusionMgr& other) = delete;
 
   // Maybe multiple fusion pattern with the same output op. We should use the
-  // sort to determine the priority. Currently, we just use the nodes number as
-  // the priority, which means, the more nodes, the higher priority.
+  // sort to determine the priority. Fusions are sorted by `Fusion::priority`
+  // first, then by the nodes number, which means, the more nodes, the higher
+  // priority.
   void Sort();
 
   // Add a fusion to global, the key must be the output node op. For instance,
@@ -172,11 +183,12 @@ MatchedProperties FillProperties(utils::MutableGraphView* graph_view,
                                  bool fanin_checking = true);
 
 // Helper function to get output properties from graph.
-std::vector<OpInfo_TensorProperties> GetOutputProperties(RemapperContext* ctx,
-                                                         int index);
+const std::vector<OpInfo_TensorProperties>& GetOutputProperties(
+    RemapperContext* ctx, int index);
 
 // Helper function to compatiable current remapper for loop.
-// Will change the content of invalidated and deleted.
+// Will change the content of invalidated and deleted, and counts the tried
+// fusions in `ctx->fusion_stats`.
 // Use the pointer output instead of reference to make cpplint happy.
 Status LaunchPatternMatcher(RemapperContext* ctx, int index,
                             std::vector<bool>* invalidated,
@@ -99,8 +99,8 @@ class LayerNormFusionBase : public Fusion {
  protected:
   bool CheckInputOutputShape(RemapperContext* ctx, int input_node_index,
                              int output_node_index) const {
-    auto input_properties = GetOutputProperties(ctx, input_node_index);
-    auto output_properties = GetOutputProperties(ctx, output_node_index);
+    const auto& input_properties = GetOutputProperties(ctx, input_node_index);
+    const auto& output_properties = GetOutputProperties(ctx, output_node_index);
 
     return !input_properties.empty() && !output_properties.empty() &&
            ShapesSymbolicallyEqual(input_properties[0].shape(),
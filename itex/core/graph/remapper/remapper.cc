@@ -17,7 +17,9 @@ limitations under the License.
 
 #include "itex/core/graph/remapper/remapper.h"
 
+#include <functional>
 #include <map>
+#include <mutex>  // NOLINT(build/c++11)
 #include <queue>
 #include <set>
 #include <string>
@@ -25,6 +27,8 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
 #include "itex/core/graph/optimizer_config.h"
 #include "itex/core/graph/remapper/fusion.h"
 #include "itex/core/graph/utils/graph_common_utils.h"
@@ -155,6 +159,20 @@ struct RandomWithComparisonAndCast {
   int direction = -1;
 };
 
+// Dropout mask from _ITEXFusedRandom applied to an input, which may be scaled
+// by a scalar first.
+struct RandomWithMul {
+  RandomWithMul() = default;
+
+  int random = kMissingIndex;
+  int mul = kMissingIndex;
+  int scale_mul = kMissingIndex;
+  // Port of the mask on `mul`.
+  int random_port = -1;
+  // Port of the scalar on `scale_mul`.
+  int scale_port = -1;
+};
+
 // Mul + Maximum pattern. will substitute Mul + Maximum with LeakyRelu.
 struct MulWithMaximum {
   MulWithMaximum() = default;
@@ -400,9 +418,8 @@ bool IsAddWithNoBroadcast(const RemapperContext& ctx, const NodeDef& node) {
   if (!IsAdd(node)) return false;
 
   // Check if this is case of broadcasting - Add node supports broadcasting.
-  std::vector<OpInfo_TensorProperties> props;
-  TF_ABORT_IF_ERROR(
-      ctx.graph_properties.GetInputProperties(node.name(), &props));
+  const std::vector<OpInfo_TensorProperties>& props =
+      ctx.graph_properties->GetInputProperties(node.name());
   if (props.size() == 2 &&
       ShapesSymbolicallyEqual(props[0].shape(), props[1].shape())) {
     return true;
@@ -424,9 +441,8 @@ bool IsBiasSemanticAdd(const RemapperContext& ctx,
   const auto* node_def = node_view.node();
   if (!IsAdd(*node_def) || node_view.NumRegularFanins() != 2) return false;
 
-  std::vector<OpInfo_TensorProperties> props;
-  TF_ABORT_IF_ERROR(
-      ctx.graph_properties.GetInputProperties(node_def->name(), &props));
+  const std::vector<OpInfo_TensorProperties>& props =
+      ctx.graph_properties->GetInputProperties(node_def->name());
 
   if (props.size() < 2) return false;
 
@@ -497,9 +513,8 @@ bool IsBiasSemanticAdd(const RemapperContext& ctx,
 // Returns 0: left input scalar, 1: right input scalar, -1: no scalar inputs
 int GetMulScalarInputIndex(const RemapperContext& ctx,
                            const NodeDef& node_def) {
-  std::vector<OpInfo_TensorProperties> props;
-  TF_ABORT_IF_ERROR(
-      ctx.graph_properties.GetInputProperties(node_def.name(), &props));
+  const std::vector<OpInfo_TensorProperties>& props =
+      ctx.graph_properties->GetInputProperties(node_def.name());
   if (props.size() != 2) return -1;
 
   bool left_is_scalar = IsScalar(props[0].shape());
@@ -1172,9 +1187,9 @@ bool FindFusedBatchNormEx(const RemapperContext& ctx, int node_index,
       return false;
 
     // Add node supports broadcasting, FusedBatchNormEx does not.
-    std::vector<OpInfo_TensorProperties> props;
-    TF_ABORT_IF_ERROR(ctx.graph_properties.GetInputProperties(
-        relu_fanin_0_node_def->name(), &props));
+    const std::vector<OpInfo_TensorProperties>& props =
+        ctx.graph_properties->GetInputProperties(
+            relu_fanin_0_node_def->name());
     if (props.size() < 2 ||
         !ShapesSymbolicallyEqual(props[0].shape(), props[1].shape()))
       return false;
@@ -1288,7 +1303,8 @@ bool FindAddV2WithSoftmax(const RemapperContext& ctx, int node_index,
   const auto* node_view = ctx.graph_view.GetNode(node_index);
   const auto* node_def = node_view->node();
 
-  if (!NodeIsOnGpu(node_def)) return false;
+  const bool is_on_cpu = NodeIsOnCpu(node_def);
+  if (!is_on_cpu && !NodeIsOnGpu(node_def)) return false;
 
   if (!IsSoftmax(*node_def)) return false;
   auto* addv2_node_view = node_view->GetRegularFanin(0).node_view();
@@ -1302,6 +1318,25 @@ bool FindAddV2WithSoftmax(const RemapperContext& ctx, int node_index,
     return false;
   }
 
+  if (is_on_cpu) {
+    // CPU kernel supports float and bfloat16, and broadcasting one input
+    // (the mask) to the shape of the other one (the logits) only.
+    if (!HasDataType(node_def, DT_FLOAT) && !HasDataType(node_def, DT_BFLOAT16))
+      return false;
+
+    const auto& input_props =
+        ctx.graph_properties->GetInputProperties(addv2_node_def->name());
+    const auto& output_props =
+        ctx.graph_properties->GetOutputProperties(addv2_node_def->name());
+    if (input_props.size() != 2 || output_props.empty()) return false;
+    const TensorShapeProto& output_shape = output_props[0].shape();
+    if (Rank(output_shape) < 1 ||
+        (!ShapesSymbolicallyEqual(output_shape, input_props[0].shape()) &&
+         !ShapesSymbolicallyEqual(output_shape, input_props[1].shape()))) {
+      return false;
+    }
+  }
+
   const AddV2WithSoftmax pattern{addv2_node_view->node_index(),
                                  node_view->node_index()};
   *matched = pattern;
@@ -1535,9 +1570,11 @@ bool FindFusedTrainingOp(const RemapperContext& ctx, int node_index,
   const auto* node_view = ctx.graph_view.GetNode(node_index);
   const auto* node_def = node_view->node();
 
-  // Only GPU supports this fusion.
-  // TODO(itex): Remove this limitation once it's supported.
-  if (!NodeIsOnGpu(node_def)) return false;
+  // CPU kernels are registered for float and bfloat16 only.
+  const bool is_supported_on_cpu =
+      NodeIsOnCpu(node_def) && (HasDataType(node_def, DT_FLOAT) ||
+                                HasDataType(node_def, DT_BFLOAT16));
+  if (!NodeIsOnGpu(node_def) && !is_supported_on_cpu) return false;
 
   int input_index = -1;
   if (IsApplyMomentum(*node_def) || IsResourceApplyMomentum(*node_def)) {
@@ -1776,6 +1813,16 @@ bool FindBf16ContractionWithCastFp32(const RemapperContext& ctx, int node_index,
       HasControlFaninOrFanout(*contraction))
     return false;
 
+  // Inputs of binary post ops are bf16, but the AccMatMul reads them in fp32.
+  if (IsFusedMatmul(*contraction_node_def)) {
+    std::vector<string> fused_ops;
+    PostOpUtil post_op_util;
+    if (TryGetNodeAttr(*contraction_node_def, "fused_ops", &fused_ops) &&
+        post_op_util.AddOps(fused_ops) && post_op_util.HasBinary()) {
+      return false;
+    }
+  }
+
   if (IsMatMul(*contraction_node_def)) {
     bool is_BiasAddGrad = false;
     int dz_index;
@@ -1858,9 +1905,9 @@ bool FindRandomWithComparisonAndCast(const RemapperContext& ctx, int node_index,
   const auto* node_def = node_view->node();
   if (!IsGreaterEqual(*node_def)) return false;
 
-  std::vector<OpInfo_TensorProperties> props;
-  TF_ABORT_IF_ERROR(
-      ctx.graph_properties.GetInputProperties(node_def->name(), &props));
+  const std::vector<OpInfo_TensorProperties>& props =
+      ctx.graph_properties->GetInputProperties(node_def->name());
+  if (props.size() != 2) return false;
 
   const auto HasRandom = [&](int direction) -> bool {
     const auto& regular_fanin = node_view->GetRegularFanin(direction);
@@ -1880,9 +1927,6 @@ bool FindRandomWithComparisonAndCast(const RemapperContext& ctx, int node_index,
   const auto* random = regular_fanin.node_view();
   const auto* random_node_def = random->node();
 
-  // TODO(itex) Add CPU support
-  if (NodeIsOnCpu(random_node_def)) return false;
-
   if (HasControlFaninOrFanout(*random)) return false;
 
   DataType random_dtype = GetDataTypeFromAttr(*random_node_def, "dtype");
@@ -1903,6 +1947,80 @@ bool FindRandomWithComparisonAndCast(const RemapperContext& ctx, int node_index,
   return true;
 }
 
+// Optimize:
+/*
+         Mul                          _ITEXFusedRandom
+        /   \                        /    |    \     \
+     Mul*   _ITEXFusedRandom  ->   shape   y   input  scale*
+    /   \        /   \
+ input scale*  shape   y
+*/
+// * means optional ops. Only the CPU kernel applies the mask, and the mask
+// isn't broadcast.
+bool FindRandomWithMul(const RemapperContext& ctx, int node_index,
+                       RandomWithMul* matched) {
+  const auto* mul_view = ctx.graph_view.GetNode(node_index);
+  const auto* mul_def = mul_view->node();
+  if (!IsMul(*mul_def) || !NodeIsOnCpu(mul_def) ||
+      mul_view->NumRegularFanins() != 2 || HasControlFaninOrFanout(*mul_view))
+    return false;
+
+  const auto& props = ctx.graph_properties->GetInputProperties(mul_def->name());
+  const auto& output_props =
+      ctx.graph_properties->GetOutputProperties(mul_def->name());
+  if (props.size() != 2 || output_props.empty()) return false;
+  const TensorShapeProto& output_shape = output_props[0].shape();
+  if (!ShapesSymbolicallyEqual(props[0].shape(), output_shape) ||
+      !ShapesSymbolicallyEqual(props[1].shape(), output_shape))
+    return false;
+
+  int random_port = -1;
+  for (int port = 0; port < 2; ++port) {
+    const auto* random_view = mul_view->GetRegularFanin(port).node_view();
+    const auto* random_def = random_view->node();
+    int num_args = 0;
+    TryGetNodeAttr(*random_def, "num_args", &num_args);
+    if (random_def->op() == kFusedRandom && num_args == 0 &&
+        random_def->device() == mul_def->device() &&
+        GetDataTypeFromAttr(*random_def, "DstT") ==
+            GetDataTypeFromAttr(*mul_def, "T") &&
+        HasAtMostOneFanoutAtPort0(*random_view) &&
+        !IsInPreserveSet(ctx, random_def) &&
+        !HasControlFaninOrFanout(*random_view)) {
+      random_port = port;
+      break;
+    }
+  }
+  if (random_port == -1) return false;
+
+  matched->random = mul_view->GetRegularFanin(random_port).node_index();
+  matched->mul = node_index;
+  matched->random_port = random_port;
+  matched->scale_mul = kMissingIndex;
+
+  // Fold the scale of dropout, e.g. Mul(input, 1 / (1 - rate)), as well.
+  const auto* input_view =
+      mul_view->GetRegularFanin(1 - random_port).node_view();
+  const auto* input_def = input_view->node();
+  if (IsMul(*input_def) && HaveSameDataType(mul_def, input_def) &&
+      input_def->device() == mul_def->device() &&
+      input_view->NumRegularFanins() == 2 &&
+      HasAtMostOneFanoutAtPort0(*input_view) &&
+      !IsInPreserveSet(ctx, input_def) &&
+      !HasControlFaninOrFanout(*input_view)) {
+    const int scale_port = GetMulScalarInputIndex(ctx, *input_def);
+    const auto& input_props =
+        ctx.graph_properties->GetInputProperties(input_def->name());
+    if (scale_port != -1 && input_props.size() == 2 &&
+        ShapesSymbolicallyEqual(input_props[1 - scale_port].shape(),
+                                output_shape)) {
+      matched->scale_mul = input_view->node_index();
+      matched->scale_port = scale_port;
+    }
+  }
+  return true;
+}
+
 // Fuse Mul and Maximum into LeakyRelu
 /*
        maximum
@@ -2046,9 +2164,8 @@ bool FindFusedBinary(const RemapperContext& ctx, int node_index,
   // Returns true iff the node is a compatible FusedBatchNorm node.
   const auto valid_shape = [&](const utils::MutableNodeView& binary) -> bool {
     const auto* binary_def = binary.node();
-    std::vector<OpInfo_TensorProperties> props;
-    TF_ABORT_IF_ERROR(
-        ctx.graph_properties.GetInputProperties(binary_def->name(), &props));
+    const std::vector<OpInfo_TensorProperties>& props =
+        ctx.graph_properties->GetInputProperties(binary_def->name());
 
     if (props.size() < 2) return false;
     bool same_input =
@@ -3247,6 +3364,51 @@ Status AddRandomWithComparisonAndCastNode(
   return Status::OK();
 }
 
+// _ITEXFusedRandom + Mul
+Status AddRandomWithMulNode(RemapperContext* ctx, const RandomWithMul& matched,
+                            std::vector<bool>* invalidated_nodes,
+                            std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& random = graph->node(matched.random);
+  const NodeDef& mul = graph->node(matched.mul);
+
+  ITEX_VLOG(2) << "Fuse " << mul.op() << " with " << kFusedRandom
+               << ": mul=" << mul.name() << " random=" << random.name();
+
+  NodeDef fused_op;
+  fused_op.set_op(kFusedRandom);
+  fused_op.set_name(mul.name());
+  fused_op.set_device(mul.device());
+  fused_op.add_input(random.input(0));
+  fused_op.add_input(random.input(1));
+  *fused_op.mutable_attr() = random.attr();
+  auto* attrs = fused_op.mutable_attr();
+  auto* fused_ops = (*attrs)["fused_ops"].mutable_list();
+
+  if (matched.scale_mul != kMissingIndex) {
+    const NodeDef& scale_mul = graph->node(matched.scale_mul);
+    fused_op.add_input(scale_mul.input(1 - matched.scale_port));
+    fused_op.add_input(scale_mul.input(matched.scale_port));
+    fused_ops->add_s(scale_mul.op());
+    (*nodes_to_delete)[matched.scale_mul] = true;
+  } else {
+    fused_op.add_input(mul.input(1 - matched.random_port));
+  }
+  fused_ops->add_s(mul.op());
+  SetAttrValue(fused_op.input_size() - 2, &(*attrs)["num_args"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_ABORT_IF_ERROR(status);
+  TF_ABORT_IF_ERROR(mutation->Apply());
+
+  (*nodes_to_delete)[matched.random] = true;
+  (*invalidated_nodes)[matched.mul] = true;
+
+  return Status::OK();
+}
+
 inline bool VerifyConstants(RemapperContext* ctx,
                             std::map<string, int>* nodes_map,
                             std::map<string, float>* values_map) {
@@ -3672,6 +3834,346 @@ Status AddFusedBinaryNode(RemapperContext* ctx, const FusedBinary& matched,
   return Status::OK();
 }
 
+struct MatMulBiasAddAndGelu {
+  std::map<string, int> matched_nodes_map;
+  std::set<int> remove_node_indices;
+  bool is_gelu_approximate = false;
+};
+
+// Adapts a Find*/Add* pair of this file to a Fusion, so that it's tried only
+// on nodes whose op is one of `keys`.
+template <typename Pattern>
+class FindAndAddFusion : public Fusion {
+ public:
+  using FindFunc = std::function<bool(RemapperContext*, int, Pattern*)>;
+  using AddFunc = Status (*)(RemapperContext*, const Pattern&,
+                             std::vector<bool>*, std::vector<bool>*);
+
+  FindAndAddFusion(const string& name, const std::vector<string>& keys,
+                   FindFunc find, AddFunc add)
+      : Fusion(),
+        name_(name),
+        keys_(keys),
+        find_(std::move(find)),
+        add_(add) {
+    pattern_.num_nodes = 0;
+  }
+
+  // Matching and rewriting are done by Run().
+  MatchedProperties Check(RemapperContext* ctx,
+                          const int node_index) const override {
+    return MatchedProperties();
+  }
+
+  Status Update(RemapperContext* ctx,
+                const MatchedProperties& properties) const override {
+    return Status::OK();
+  }
+
+  Status Run(RemapperContext* ctx, int node_index,
+             std::vector<bool>* invalidated, std::vector<bool>* deleted,
+             bool* matched) const override {
+    Pattern pattern;
+    *matched = find_(ctx, node_index, &pattern);
+    if (!*matched) return Status::OK();
+    TF_ABORT_IF_ERROR(add_(ctx, pattern, invalidated, deleted));
+    return Status::OK();
+  }
+
+  std::string Name() override { return name_; }
+
+  std::string Key() override { return absl::StrJoin(keys_, "|"); }
+
+ private:
+  const string name_;
+  const std::vector<string> keys_;
+  const FindFunc find_;
+  const AddFunc add_;
+};
+
+// Registers the fusions of this file in the order they are tried on a node.
+// Those registered before `pattern_fusions_priority` are tried before the
+// fusions defined by pattern graphs, and the others after them.
+void RegisterFindAndAddFusions() {
+  constexpr int pattern_fusions_priority = 0;
+  int priority = 3;
+  const auto add_fusion = [&priority](Fusion* fusion, bool is_partial) {
+    fusion->priority = priority--;
+    if (priority == pattern_fusions_priority) priority--;
+    fusion->is_partial = is_partial;
+    std::vector<std::string> keys = absl::StrSplit(fusion->Key(), "|");
+    for (auto const& key : keys) {
+      FusionMgr::GetInstance().AddFusion(key, fusion);
+    }
+  };
+  const auto full = [&add_fusion](Fusion* fusion) {
+    add_fusion(fusion, /*is_partial=*/false);
+  };
+  const auto partial = [&add_fusion](Fusion* fusion) {
+    add_fusion(fusion, /*is_partial=*/true);
+  };
+
+  std::vector<string> activations;
+  for (const PostOpInfo& info : PostOpUtil::GetAllPostOpInfo()) {
+    if (PostOpUtil::IsSupportedActivation(info.name)) {
+      activations.push_back(string(info.name));
+    }
+  }
+  const std::vector<string> adds = {"Add", "AddV2", "AddN"};
+  const std::vector<string> casts = {"Cast"};
+
+  // Remap Conv2D+BiasAdd+Add+Activation into the _ITEXFusedConv2D.
+  full(new FindAndAddFusion<ContractionWithBiasAndAddActivation>(
+      "contraction-with-bias-add-activation", activations,
+      [](RemapperContext* ctx, int i,
+         ContractionWithBiasAndAddActivation* matched) {
+        return FindContractionWithBiasAndAddActivation(*ctx, i, matched);
+      },
+      AddFusedContractionNode));
+
+  // Remap Conv2D+BiasAdd+Add into the _ITEXFusedConv2D.
+  full(new FindAndAddFusion<ContractionWithBiasAddAndAdd>(
+      "contraction-with-bias-add-add", adds,
+      [](RemapperContext* ctx, int i, ContractionWithBiasAddAndAdd* matched) {
+        return FindContractionWithBiasAddAndAdd(*ctx, i, matched);
+      },
+      AddFusedContractionNode));
+
+  // Remap MatMul + BiasAdd + gelu-subgraph
+  full(new FindAndAddFusion<MatMulBiasAddAndGelu>(
+      "matmul-with-bias-gelu", {"Mul"},
+      [](RemapperContext* ctx, int i, MatMulBiasAddAndGelu* matched) {
+        return FindMatMulBiasAddAndGelu(ctx, i, &matched->matched_nodes_map,
+                                        &matched->remove_node_indices,
+                                        &matched->is_gelu_approximate);
+      },
+      [](RemapperContext* ctx, const MatMulBiasAddAndGelu& matched,
+         std::vector<bool>* invalidated_nodes,
+         std::vector<bool>* nodes_to_delete) {
+        std::map<string, int> matched_nodes_map = matched.matched_nodes_map;
+        std::set<int> remove_node_indices = matched.remove_node_indices;
+        return AddFusedMatMulBiasAddAndGelu(
+            ctx, &matched_nodes_map, &remove_node_indices, invalidated_nodes,
+            nodes_to_delete, matched.is_gelu_approximate);
+      }));
+
+  // Fusions defined by pattern graphs go here.
+
+  // Remap {Conv2D,DepthwiseConv2D,Conv3D,MatMul}+BiasAdd into the
+  // _ITEXFused{Conv2D,DepthwiseConv2dNative,Conv3D,MatMul}
+  full(new FindAndAddFusion<ContractionWithBiasAdd>(
+      "contraction-with-bias", {"BiasAdd", "BiasAddV1", "Add", "AddV2"},
+      [](RemapperContext* ctx, int i, ContractionWithBiasAdd* matched) {
+        return FindContractionWithBias(*ctx, i, matched);
+      },
+      AddFusedContractionNode));
+
+  // Remap MatMul+BiasAddGrad into the _fusedMatMulGrad
+  full(new FindAndAddFusion<ContractionWithBiasAddGrad>(
+      "matmul-grad-with-bias-add-grad", {"BiasAddGrad"},
+      [](RemapperContext* ctx, int i, ContractionWithBiasAddGrad* matched) {
+        return FindContractionWithBiasAddGrad(*ctx, i, matched);
+      },
+      AddFusedContractionGradNode));
+
+  // Remap {Conv2DBackpropFilter,Conv3DBackpropFilter}+BiasAddGrad into
+  // FusedContractionBackpropFiler.
+  full(new FindAndAddFusion<ContractionWithBiasAddGrad>(
+      "conv-backprop-filter-with-bias-add-grad", {"BiasAddGrad"},
+      [](RemapperContext* ctx, int i, ContractionWithBiasAddGrad* matched) {
+        return FindConvContractionWithBiasAddGrad(*ctx, i, matched);
+      },
+      AddFusedContractionGradNode));
+
+  // Remap {Conv2D,Conv3D,MatMul}+BiasAdd+Activation into
+  // _ITEXFused{Conv2D,Conv3D,MatMul}.
+  full(new FindAndAddFusion<ContractionWithBiasAddAndActivation>(
+      "contraction-with-bias-activation", activations,
+      [](RemapperContext* ctx, int i,
+         ContractionWithBiasAddAndActivation* matched) {
+        return FindContractionWithBiasAndActivation(*ctx, i, matched);
+      },
+      AddFusedContractionNode));
+
+  // Remap FusedBatchNorm+<SideInput>+<Activation> into the
+  // _FusedBatchNormEx.
+  full(new FindAndAddFusion<FusedBatchNormEx>(
+      "fused-batch-norm-ex", {"Relu"},
+      [](RemapperContext* ctx, int i, FusedBatchNormEx* matched) {
+        return FindFusedBatchNormEx(*ctx, i, matched);
+      },
+      AddFusedBatchNormExNode));
+
+  full(new FindAndAddFusion<FusedBatchNormGradEx>(
+      "fused-batch-norm-grad-ex",
+      {"FusedBatchNormGrad", "FusedBatchNormGradV2", "FusedBatchNormGradV3"},
+      [](RemapperContext* ctx, int i, FusedBatchNormGradEx* matched) {
+        return FindFusedBatchNormGradEx(*ctx, i, matched);
+      },
+      AddFusedBatchNormGradExNode));
+
+  // Remap Pad+{Conv2D, _ITEXFusedConv2D} into the _FusedPadConv2D.
+  full(new FindAndAddFusion<PadWithContraction>(
+      "pad-with-contraction", {"Conv2D", kFusedConv2D, "Conv3D", kFusedConv3D},
+      [](RemapperContext* ctx, int i, PadWithContraction* matched) {
+        return FindPadWithContraction(*ctx, i, matched);
+      },
+      AddPadWithContractionNode));
+
+  full(new FindAndAddFusion<ConvBackpropInputWithSlice>(
+      "conv-backprop-input-with-slice", {"Slice"},
+      [](RemapperContext* ctx, int i, ConvBackpropInputWithSlice* matched) {
+        return FindConvBackpropInputWithSlice(*ctx, i, matched);
+      },
+      AddConvBackpropInputWithSliceNode));
+
+  // Remap Mul + AddN + TrainingOp into the _FusedTrainingOp.
+  full(new FindAndAddFusion<FusedTrainingOp>(
+      "fused-training-op",
+      {"ApplyMomentum", "ResourceApplyMomentum", "ApplyAdam",
+       "ResourceApplyAdam", "ApplyAdamWithWeightDecay",
+       "ResourceApplyAdamWithWeightDecay"},
+      [](RemapperContext* ctx, int i, FusedTrainingOp* matched) {
+        return FindFusedTrainingOp(*ctx, i, matched);
+      },
+      AddFusedTrainingNode));
+
+  // Remap BatchMatMul+Mul into the _FusedBatchMatMul.
+  full(new FindAndAddFusion<ContractionWithMul>(
+      "batch-matmul-with-mul", {"Mul", "MulNoNan"},
+      [](RemapperContext* ctx, int i, ContractionWithMul* matched) {
+        return FindContractionWithMul(*ctx, i, matched);
+      },
+      AddFusedContractionNode));
+
+  // delete dequantize node if it finds dequantize_with_shape pattern
+  full(new FindAndAddFusion<DequantizeWithShape>(
+      "dequantize-with-shape", {"Shape"},
+      [](RemapperContext* ctx, int i, DequantizeWithShape* matched) {
+        return FindDequantizeWithShape(*ctx, i, matched);
+      },
+      AddFusedDequantizeWithShape));
+
+  // delete dequantize node if it finds dequantize_with_reshape pattern
+  full(new FindAndAddFusion<DequantizeWithReshape>(
+      "dequantize-with-reshape", {"Reshape"},
+      [](RemapperContext* ctx, int i, DequantizeWithReshape* matched) {
+        return GetOptimizerConfigFlags().enable_layout_opt &&
+               FindDequantizeWithReshape(*ctx, i, matched);
+      },
+      AddFusedDequantizeWithReshape));
+
+  // Remap QuantizeV2+QuantizedConv2D into the
+  // _ITEXQuantizeV2WithQuantizedConv2D
+  full(new FindAndAddFusion<QuantizeV2WithQuantizedConv2D>(
+      "quantizev2-with-quantized-conv2d",
+      {"QuantizedConv2DWithBiasAndReluAndRequantize"},
+      [](RemapperContext* ctx, int i, QuantizeV2WithQuantizedConv2D* matched) {
+        return GetOptimizerConfigFlags().enable_layout_opt &&
+               FindQuantizeV2WithQuantizedConv2D(*ctx, i, matched);
+      },
+      AddQuantizeV2WithQuantizedConv2DNode));
+
+  // Remap L2loss+AddN into the _FusedAddN
+  full(new FindAndAddFusion<FusedAddN>(
+      "l2loss-with-addn", {"AddN"},
+      [](RemapperContext* ctx, int i, FusedAddN* matched) {
+        return FindFusedAddN(*ctx, i, matched);
+      },
+      AddFusedAddN));
+
+  full(new FindAndAddFusion<AddV2WithSoftmax>(
+      "addv2-with-softmax", {"Softmax"},
+      [](RemapperContext* ctx, int i, AddV2WithSoftmax* matched) {
+        return FindAddV2WithSoftmax(*ctx, i, matched);
+      },
+      AddFusedAddV2WithSoftmaxNode));
+
+  // Remap Bf16(Fused)Matmul+CastFp32 into the _ITEX(Fused)AccMatMul.
+  full(new FindAndAddFusion<Bf16ContractionWithCastFp32>(
+      "bf16-contraction-with-cast-fp32", casts,
+      [](RemapperContext* ctx, int i, Bf16ContractionWithCastFp32* matched) {
+        return FindBf16ContractionWithCastFp32(*ctx, i, matched);
+      },
+      AddBf16ContractionWithCastFp32Node));
+
+  // Remap Random Comparison+Cast into the RandomWithComparisonAndCast.
+  full(new FindAndAddFusion<RandomWithComparisonAndCast>(
+      "random-with-comparison-cast", casts,
+      [](RemapperContext* ctx, int i, RandomWithComparisonAndCast* matched) {
+        return FindRandomWithComparisonAndCast(*ctx, i, matched);
+      },
+      AddRandomWithComparisonAndCastNode));
+
+  // Remap _ITEXFusedRandom+Mul into the _ITEXFusedRandom applying the mask.
+  full(new FindAndAddFusion<RandomWithMul>(
+      "random-with-mul", {"Mul"},
+      [](RemapperContext* ctx, int i, RandomWithMul* matched) {
+        return FindRandomWithMul(*ctx, i, matched);
+      },
+      AddRandomWithMulNode));
+
+  // Remap Bf16FusedMatmulGrad+CastFp32 into the _ITEXFusedAccMatMulGrad.
+  full(new FindAndAddFusion<Bf16ContractionGradWithCastFp32>(
+      "bf16-matmul-grad-with-cast-fp32", casts,
+      [](RemapperContext* ctx, int i,
+         Bf16ContractionGradWithCastFp32* matched) {
+        return FindBf16ContractionGradWithCastFp32(*ctx, i, matched);
+      },
+      AddFusedContractionGradWithCastNode));
+
+  // Remap Comparison+Cast into the ComparisonWithCast.
+  full(new FindAndAddFusion<ComparisonWithCast>(
+      "comparison-with-cast", casts,
+      [](RemapperContext* ctx, int i, ComparisonWithCast* matched) {
+        return FindComparisonWithCast(*ctx, i, matched);
+      },
+      AddComparisonWithCastNode));
+
+  // Remap Mul+Max into the LeakyRelu.
+  full(new FindAndAddFusion<MulWithMaximum>(
+      "mul-with-maximum", {"Maximum"},
+      [](RemapperContext* ctx, int i, MulWithMaximum* matched) {
+        return FindMulWithMaximum(*ctx, i, matched);
+      },
+      AddMulWithMaximumNode));
+
+  // Remap Const+Cast into the Const. this fusion aims to reduce the number
+  // of Cast which were produced by auto mixed precision.
+  partial(new FindAndAddFusion<ConstWithCast>(
+      "const-with-cast", casts,
+      [](RemapperContext* ctx, int i, ConstWithCast* matched) {
+        return FindConstWithCast(*ctx, i, matched);
+      },
+      AddConstWithCastNode));
+
+  // Remap sequatial Binary ops into the _ITEXFusedBinary op.
+  partial(new FindAndAddFusion<FusedBinary>(
+      "fused-binary", {"Add", "AddV2", "Mul", "Sub"},
+      [](RemapperContext* ctx, int i, FusedBinary* matched) {
+        return FindFusedBinary(*ctx, i, matched);
+      },
+      AddFusedBinaryNode));
+}
+
+// Logs the fusions tried on the graph, from the most time consuming one.
+void LogFusionStats(const RemapperContext& ctx) {
+  if (!ITEX_VLOG_IS_ON(1)) return;
+  std::vector<std::pair<Fusion*, FusionStats>> stats(ctx.fusion_stats.begin(),
+                                                     ctx.fusion_stats.end());
+  std::sort(stats.begin(), stats.end(),
+            [](const std::pair<Fusion*, FusionStats>& left,
+               const std::pair<Fusion*, FusionStats>& right) {
+              return left.second.time_ns > right.second.time_ns;
+            });
+  for (const auto& [fusion, fusion_stats] : stats) {
+    ITEX_VLOG(1) << "RemapperPass: fusion " << fusion->Name()
+                 << " matched " << fusion_stats.num_matched << " of "
+                 << fusion_stats.num_tried << " nodes in "
+                 << fusion_stats.time_ns / 1000 << " us.";
+  }
+}
+
 }  // namespace
 
 // is_full is true by default. When oneDNN Graph is enabled, we want to set it
@@ -3707,11 +4209,16 @@ Status RunRemapper(const char* device_name, const GrapplerItem& item,
   //     item.optimization_options().allow_non_differentiable_rewrites;
 
   // Maybe exist multiple patterns mapping to one key, so we need to sort it.
-  // Currently we just based on the node number, which means, the more nodes,
-  // the higher priority.
-  FusionMgr::GetInstance().Sort();
-
-  // Infer statically first and only once.
+  // Fusions are sorted by their priority, then by the node number, which
+  // means, the more nodes, the higher priority.
+  static std::once_flag register_once;
+  std::call_once(register_once, []() {
+    RegisterFindAndAddFusions();
+    FusionMgr::GetInstance().Sort();
+  });
+
+  // Get the static shape inference shared with the other passes first, which
+  // pattern matchers use through `ctx.graph_properties`.
   ctx.GetGraphProperties();
 
   for (int i = num_nodes - 1; i >= 0; --i) {
@@ -3734,241 +4241,20 @@ Status RunRemapper(const char* device_name, const GrapplerItem& item,
       NodeDef* node_def = (ctx.graph_view.GetNode(i))->node();
       ITEX_VLOG(3) << "The node " << node_def->op() << ":" << node_def->name()
                    << "is not at " << device_name;
+      if (ctx.fusion_report != nullptr &&
+          !FusionMgr::GetInstance().GetFusions(node_def->op()).empty()) {
+        ctx.fusion_report->AddRejected("remapper", node_def->name(),
+                                       node_def->op(), kRejectDevice, "");
+      }
       continue;
     }
 
-    if (is_full) {
-      // Remap Conv2D+BiasAdd+Add+Activation into the _ITEXFusedConv2D.
-      ContractionWithBiasAndAddActivation contract_with_bias_and_add_activation;
-      if (FindContractionWithBiasAndAddActivation(
-              ctx, i, &contract_with_bias_and_add_activation)) {
-        TF_ABORT_IF_ERROR(
-            AddFusedContractionNode(&ctx, contract_with_bias_and_add_activation,
-                                    &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap Conv2D+BiasAdd+Add into the _ITEXFusedConv2D.
-      ContractionWithBiasAddAndAdd contract_with_bias_and_add;
-      if (FindContractionWithBiasAddAndAdd(ctx, i,
-                                           &contract_with_bias_and_add)) {
-        TF_ABORT_IF_ERROR(
-            AddFusedContractionNode(&ctx, contract_with_bias_and_add,
-                                    &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap MatMul + BiasAdd + gelu-subgraph
-      std::map<string, int> matched_nodes_map;
-      std::set<int> remove_node_indices;
-      bool is_gelu_approximate = false;
-      if (FindMatMulBiasAddAndGelu(&ctx, i, &matched_nodes_map,
-                                   &remove_node_indices,
-                                   &is_gelu_approximate)) {
-        TF_ABORT_IF_ERROR(AddFusedMatMulBiasAddAndGelu(
-            &ctx, &matched_nodes_map, &remove_node_indices, &invalidated_nodes,
-            &nodes_to_delete, is_gelu_approximate));
-        continue;
-      }
-    }
-    // The entry of the fusion pass. It will iterate all fusion registered.
+    // The entry of the fusion pass. It will try the fusions registered with
+    // the node op.
     TF_ABORT_IF_ERROR(LaunchPatternMatcher(&ctx, i, &invalidated_nodes,
                                            &nodes_to_delete, is_full));
-
-    if (is_full) {
-      // Remap {Conv2D,DepthwiseConv2D,Conv3D,MatMul}+BiasAdd into the
-      // _ITEXFused{Conv2D,DepthwiseConv2dNative,Conv3D,MatMul}
-      ContractionWithBiasAdd contract_with_bias;
-      if (FindContractionWithBias(ctx, i, &contract_with_bias)) {
-        TF_ABORT_IF_ERROR(AddFusedContractionNode(
-            &ctx, contract_with_bias, &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap MatMul+BiasAddGrad into the _fusedMatMulGrad
-      ContractionWithBiasAddGrad contract_with_bias_grad;
-      if (FindContractionWithBiasAddGrad(ctx, i, &contract_with_bias_grad)) {
-        TF_ABORT_IF_ERROR(
-            AddFusedContractionGradNode(&ctx, contract_with_bias_grad,
-                                        &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap {Conv2DBackpropFilter,Conv3DBackpropFilter}+BiasAddGrad into
-      // FusedContractionBackpropFiler.
-      ContractionWithBiasAddGrad conv_contract_with_bias_grad;
-      if (FindConvContractionWithBiasAddGrad(ctx, i,
-                                             &conv_contract_with_bias_grad)) {
-        TF_ABORT_IF_ERROR(
-            AddFusedContractionGradNode(&ctx, conv_contract_with_bias_grad,
-                                        &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-      // Remap {Conv2D,Conv3D,MatMul}+BiasAdd+Activation into
-      // _ITEXFused{Conv2D,Conv3D,MatMul}.
-      ContractionWithBiasAddAndActivation contract_with_bias_and_activation;
-      if (FindContractionWithBiasAndActivation(
-              ctx, i, &contract_with_bias_and_activation)) {
-        TF_ABORT_IF_ERROR(
-            AddFusedContractionNode(&ctx, contract_with_bias_and_activation,
-                                    &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap FusedBatchNorm+<SideInput>+<Activation> into the
-      // _FusedBatchNormEx.
-      FusedBatchNormEx fused_batch_norm_ex;
-      if (FindFusedBatchNormEx(ctx, i, &fused_batch_norm_ex)) {
-        TF_ABORT_IF_ERROR(AddFusedBatchNormExNode(
-            &ctx, fused_batch_norm_ex, &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      FusedBatchNormGradEx fused_batch_norm_grad_ex;
-      if (FindFusedBatchNormGradEx(ctx, i, &fused_batch_norm_grad_ex)) {
-        TF_ABORT_IF_ERROR(
-            AddFusedBatchNormGradExNode(&ctx, fused_batch_norm_grad_ex,
-                                        &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap Pad+{Conv2D, _ITEXFusedConv2D} into the _FusedPadConv2D.
-      PadWithContraction pad_with_contract;
-      if (FindPadWithContraction(ctx, i, &pad_with_contract)) {
-        TF_ABORT_IF_ERROR(AddPadWithContractionNode(
-            &ctx, pad_with_contract, &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      ConvBackpropInputWithSlice conv_with_slice;
-      if (FindConvBackpropInputWithSlice(ctx, i, &conv_with_slice)) {
-        TF_ABORT_IF_ERROR(AddConvBackpropInputWithSliceNode(
-            &ctx, conv_with_slice, &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap Mul + AddN + TrainingOp into the _FusedTrainingOp.
-      FusedTrainingOp fused_training_op;
-      if (FindFusedTrainingOp(ctx, i, &fused_training_op)) {
-        TF_ABORT_IF_ERROR(AddFusedTrainingNode(
-            &ctx, fused_training_op, &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap BatchMatMul+Mul into the _FusedBatchMatMul.
-      ContractionWithMul contract_with_mul;
-      if (FindContractionWithMul(ctx, i, &contract_with_mul)) {
-        TF_ABORT_IF_ERROR(AddFusedContractionNode(
-            &ctx, contract_with_mul, &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // delete dequantize node if it finds dequantize_with_shape pattern
-      DequantizeWithShape dequantize_with_shape;
-      if (FindDequantizeWithShape(ctx, i, &dequantize_with_shape)) {
-        TF_ABORT_IF_ERROR(AddFusedDequantizeWithShape(
-            &ctx, dequantize_with_shape, &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // delete dequantize node if it finds dequantize_with_reshape pattern
-      DequantizeWithReshape dequantize_with_reshape;
-      if (is_layout_opt &&
-          FindDequantizeWithReshape(ctx, i, &dequantize_with_reshape)) {
-        TF_ABORT_IF_ERROR(AddFusedDequantizeWithReshape(
-            &ctx, dequantize_with_reshape, &invalidated_nodes,
-            &nodes_to_delete));
-        continue;
-      }
-
-      // Remap QuantizeV2+QuantizedConv2D into the
-      // _ITEXQuantizeV2WithQuantizedConv2D
-      QuantizeV2WithQuantizedConv2D quantizev2_with_quantizedconv;
-      if (is_layout_opt && FindQuantizeV2WithQuantizedConv2D(
-                               ctx, i, &quantizev2_with_quantizedconv)) {
-        TF_ABORT_IF_ERROR(AddQuantizeV2WithQuantizedConv2DNode(
-            &ctx, quantizev2_with_quantizedconv, &invalidated_nodes,
-            &nodes_to_delete));
-        continue;
-      }
-
-      // Remap L2loss+AddN into the _FusedAddN
-      FusedAddN fused_addn;
-      if (FindFusedAddN(ctx, i, &fused_addn)) {
-        TF_ABORT_IF_ERROR(AddFusedAddN(&ctx, fused_addn, &invalidated_nodes,
-                                       &nodes_to_delete));
-        continue;
-      }
-
-      AddV2WithSoftmax fused_addv2_with_softmax;
-      if (FindAddV2WithSoftmax(ctx, i, &fused_addv2_with_softmax)) {
-        TF_ABORT_IF_ERROR(
-            AddFusedAddV2WithSoftmaxNode(&ctx, fused_addv2_with_softmax,
-                                         &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap Bf16(Fused)Matmul+CastFp32 into the _ITEX(Fused)AccMatMul.
-      Bf16ContractionWithCastFp32 contraction_with_cast;
-      if (FindBf16ContractionWithCastFp32(ctx, i, &contraction_with_cast)) {
-        TF_ABORT_IF_ERROR(AddBf16ContractionWithCastFp32Node(
-            &ctx, contraction_with_cast, &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap Random Comparison+Cast into the RandomWithComparisonAndCast.
-      RandomWithComparisonAndCast random_with_compare_and_cast;
-      if (FindRandomWithComparisonAndCast(ctx, i,
-                                          &random_with_compare_and_cast)) {
-        TF_ABORT_IF_ERROR(AddRandomWithComparisonAndCastNode(
-            &ctx, random_with_compare_and_cast, &invalidated_nodes,
-            &nodes_to_delete));
-        continue;
-      }
-
-      // Remap Bf16FusedMatmulGrad+CastFp32 into the _ITEXFusedAccMatMulGrad.
-      Bf16ContractionGradWithCastFp32 contraction_grad_with_cast;
-      if (FindBf16ContractionGradWithCastFp32(ctx, i,
-                                              &contraction_grad_with_cast)) {
-        TF_ABORT_IF_ERROR(AddFusedContractionGradWithCastNode(
-            &ctx, contraction_grad_with_cast, &invalidated_nodes,
-            &nodes_to_delete));
-        continue;
-      }
-
-      // Remap Comparison+Cast into the ComparisonWithCast.
-      ComparisonWithCast comparison_with_cast;
-      if (FindComparisonWithCast(ctx, i, &comparison_with_cast)) {
-        TF_ABORT_IF_ERROR(AddComparisonWithCastNode(
-            &ctx, comparison_with_cast, &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-
-      // Remap Mul+Max into the LeakyRelu.
-      MulWithMaximum mul_with_maximum;
-      if (FindMulWithMaximum(ctx, i, &mul_with_maximum)) {
-        TF_ABORT_IF_ERROR(AddMulWithMaximumNode(
-            &ctx, mul_with_maximum, &invalidated_nodes, &nodes_to_delete));
-        continue;
-      }
-    }
-
-    // Remap Const+Cast into the Const. this fusion aims to reduce the number
-    // of Cast which were produced by auto mixed precision.
-    ConstWithCast const_with_cast;
-    if (FindConstWithCast(ctx, i, &const_with_cast)) {
-      TF_ABORT_IF_ERROR(AddConstWithCastNode(
-          &ctx, const_with_cast, &invalidated_nodes, &nodes_to_delete));
-      continue;
-    }
-
-    // Remap sequatial Binary ops into the _ITEXFusedBinary op.
-    FusedBinary seq_binary;
-    if (FindFusedBinary(ctx, i, &seq_binary)) {
-      TF_ABORT_IF_ERROR(AddFusedBinaryNode(&ctx, seq_binary, &invalidated_nodes,
-                                           &nodes_to_delete));
-    }
   }
+  LogFusionStats(ctx);
 
   // Remove invalidated nodes.
   utils::Mutation* mutation = ctx.graph_view.GetMutationBuilder();
@@ -21,9 +21,11 @@ limitations under the License.
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "itex/core/graph/utils/fusion_report.h"
 #include "itex/core/graph/utils/graph_properties.h"
 #include "itex/core/graph/utils/graph_view.h"
 #include "itex/core/graph/utils/grappler_item.h"
@@ -33,34 +35,46 @@ limitations under the License.
 namespace itex {
 namespace graph {
 
+class Fusion;
+
+// Fusions tried on a graph, and the time spent on matching and rewriting.
+struct FusionStats {
+  int64 num_tried = 0;
+  int64 num_matched = 0;
+  int64 time_ns = 0;
+};
+
 struct RemapperContext {
   explicit RemapperContext(const GrapplerItem& item, GraphDef* g_def,
                            Status* status)
-      : nodes_to_preserve(item.NodesToPreserve()),
+      : item(item),
+        nodes_to_preserve(item.NodesToPreserve()),
         graph_view(g_def, status),
-        graph_properties(item),
-        inferred_graph_properties(false) {}
+        graph_properties(nullptr),
+        fusion_report(GetFusionReport(item)) {}
 
+  const GrapplerItem& item;
   std::unordered_set<string> nodes_to_preserve;
   utils::MutableGraphView graph_view;
-  GraphProperties graph_properties;
-  bool inferred_graph_properties;
+  // Shared with the other passes optimizing `item`.
+  GraphProperties* graph_properties;
+  std::unordered_map<Fusion*, FusionStats> fusion_stats;
+  // Shared with the other passes optimizing `item`, nullptr if the fusion
+  // report is disabled.
+  FusionReport* fusion_report;
 
   GraphProperties& GetGraphProperties() {
-    if (!inferred_graph_properties) {
-      Status s = graph_properties.InferStatically(
-          /*assume_valid_feeds=*/true,
-          /*aggressive_shape_inference=*/false,
-          /*include_input_tensor_values=*/true,
-          /*include_output_tensor_values=*/true);
+    if (graph_properties == nullptr) {
+      Status s = GetSharedGraphProperties(item, /*assume_valid_feeds=*/true,
+                                          /*include_tensor_values=*/true,
+                                          &graph_properties);
 
       // TODO(itex) Is there any case that InferStatically will return an
       // unsuccessful state?
       TF_ABORT_IF_ERROR(s);
-      inferred_graph_properties = true;
     }
 
-    return graph_properties;
+    return *graph_properties;
   }
 };
 
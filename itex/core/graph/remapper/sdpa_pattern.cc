@@ -0,0 +1,401 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <string>
+#include <vector>
+
+#include "itex/core/graph/remapper/constant_names.h"
+#include "itex/core/graph/remapper/fusion.h"
+#include "itex/core/graph/remapper/remapper.h"
+#include "itex/core/graph/utils/op_types.h"
+#include "itex/core/graph/utils/pattern_utils.h"
+#include "itex/core/graph/utils/symbolic_shapes.h"
+#include "itex/core/graph/utils/utils.h"
+#include "itex/core/utils/errors.h"
+#include "itex/core/utils/node_def_util.h"
+#include "itex/core/utils/plugin_tensor.h"
+#include "itex/core/utils/strcat.h"
+
+namespace itex {
+namespace graph {
+
+namespace {
+
+// Einsum equations of the Keras MultiHeadAttention layer with inputs of
+// [batch, seq, heads, depth], which compute the scores from the key and the
+// query, and the output from the probabilities and the value.
+constexpr char kKerasScoresEquation[] = "aecd,abcd->acbe";
+constexpr char kKerasOutputEquation[] = "acbe,aecd->abcd";
+
+// Layouts of the inputs and the output of the fused op. The query, the key
+// and the value are [B]atch, [H]eads, [S]equence and [D]epth, and the key may
+// also be stored transposed.
+constexpr char kLayoutBHSD[] = "BHSD";
+constexpr char kLayoutBSHD[] = "BSHD";
+constexpr char kLayoutBHDS[] = "BHDS";
+
+// One input of the fused op, read by input `port` of `consumer` in the
+// original graph.
+struct AttentionInput {
+  utils::MutableNodeView* consumer = nullptr;
+  int port = 0;
+  string layout = kLayoutBHSD;
+
+  string TensorName() const { return consumer->node()->input(port); }
+};
+
+struct AttentionMatch {
+  AttentionInput query;
+  AttentionInput key;
+  AttentionInput value;
+  string scale;
+  string mask;
+  string output_layout = kLayoutBHSD;
+  // Nodes replaced by the fused op, except the root.
+  std::vector<int> removed;
+};
+
+}  // namespace
+
+// Fuses the scaled dot product attention
+//   BatchMatMulV2(Softmax(Q * K^T * scale + mask), V)
+// into one op, which computes it in blocks without writing the scores to
+// memory. The scale may be applied to Q instead, and the mask is optional.
+// Transposes of the inputs and the output between [B, S, H, D] and
+// [B, H, S, D] are folded into the layouts of the fused op, and so is the
+// Einsum form of the Keras MultiHeadAttention layer.
+class ScaledDotProductAttentionFusion : public Fusion {
+ public:
+  ScaledDotProductAttentionFusion() : Fusion() {
+    // The pattern has several variants, so it's matched by hand. The number
+    // of nodes is the one of the shortest variant.
+    pattern_.num_nodes = 4;
+  }
+
+  ~ScaledDotProductAttentionFusion() {}
+
+  std::string Name() override { return "scaled-dot-product-attention"; }
+
+  std::string Key() override {
+    return strings::StrCat(kBatchMatMulV2, "|", kEinsum, "|", kTranspose);
+  }
+
+  MatchedProperties Check(RemapperContext* ctx,
+                          const int node_index) const override {
+    MatchedProperties ret;
+    AttentionMatch match;
+    if (!Match(ctx, node_index, &match)) return ret;
+
+    ret.map.emplace("output", node_index);
+    ret.invalidated.insert(node_index);
+    ret.deleted.insert(match.removed.begin(), match.removed.end());
+    return ret;
+  }
+
+  Status Update(RemapperContext* ctx /** in and out **/,
+                const MatchedProperties& properties) const override {
+    const int node_index = properties.map.at("output");
+    AttentionMatch match;
+    if (!Match(ctx, node_index, &match)) {
+      return errors::Internal("Failed to match the attention again.");
+    }
+    const NodeDef* output_node = ctx->graph_view.GetNode(node_index)->node();
+
+    NodeDef fused_node;
+    fused_node.set_name(output_node->name());
+    fused_node.set_op(kScaledDotProductAttention);
+    fused_node.set_device(output_node->device());
+    fused_node.add_input(match.query.TensorName());
+    fused_node.add_input(match.key.TensorName());
+    fused_node.add_input(match.value.TensorName());
+    fused_node.add_input(match.scale);
+    if (!match.mask.empty()) fused_node.add_input(match.mask);
+
+    auto* attr = fused_node.mutable_attr();
+    (*attr)["T"] = output_node->attr().at("T");
+    SetAttrValue(match.query.layout, &(*attr)["query_layout"]);
+    SetAttrValue(match.key.layout, &(*attr)["key_layout"]);
+    SetAttrValue(match.value.layout, &(*attr)["value_layout"]);
+    SetAttrValue(match.output_layout, &(*attr)["output_layout"]);
+    SetAttrValue(match.mask.empty() ? 0 : 1, &(*attr)["num_masks"]);
+
+    utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+    Status status;
+    mutation->AddNode(std::move(fused_node), &status);
+    TF_RETURN_IF_ERROR(status);
+    TF_RETURN_IF_ERROR(mutation->Apply());
+    return Status::OK();
+  }
+
+ private:
+  static utils::MutableNodeView* Fanin(utils::MutableNodeView* node_view,
+                                       int port) {
+    return node_view->GetRegularFanin(port).node_view();
+  }
+
+  // Returns true if `node_view` is only read by the next node of the
+  // pattern, so it can be removed.
+  static bool IsIntermediate(const RemapperContext& ctx,
+                             const utils::MutableNodeView& node_view,
+                             const NodeDef& root) {
+    const NodeDef* node_def = node_view.node();
+    return node_view.NumControllingFanins() == 0 &&
+           node_view.NumControlledFanouts() == 0 &&
+           node_view.GetRegularFanout(0).size() == 1 &&
+           ctx.nodes_to_preserve.count(node_def->name()) == 0 &&
+           node_def->device() == root.device();
+  }
+
+  static bool HasEquation(const NodeDef& node_def, const char* equation) {
+    string value;
+    return node_def.op() == kEinsum &&
+           TryGetNodeAttr(AttrSlice(node_def), "equation", &value) &&
+           value == equation;
+  }
+
+  static bool IsTransposeWithPerm(utils::MutableNodeView* node_view,
+                                  const std::vector<int64>& perm) {
+    if (!IsTranspose(*node_view->node())) return false;
+    const NodeDef* perm_node = Fanin(node_view, 1)->node();
+    Tensor perm_tensor;
+    if (perm_node->op() != kConst ||
+        !perm_tensor.FromProto(perm_node->attr().at("value").tensor()) ||
+        perm_tensor.NumElements() != static_cast<int64>(perm.size())) {
+      return false;
+    }
+    for (size_t i = 0; i < perm.size(); ++i) {
+      const int64 value = perm_tensor.dtype() == DT_INT32
+                              ? perm_tensor.flat<int32>()(i)
+                              : perm_tensor.flat<int64>()(i);
+      if (value != perm[i]) return false;
+    }
+    return true;
+  }
+
+  // Folds the Transpose with `perm` feeding `input` into it, and sets the
+  // layout of `input` to `layout` in that case.
+  static void FoldTranspose(const RemapperContext& ctx, const NodeDef& root,
+                            const std::vector<int64>& perm,
+                            const char* layout, AttentionInput* input,
+                            AttentionMatch* match) {
+    utils::MutableNodeView* producer = Fanin(input->consumer, input->port);
+    if (!IsTransposeWithPerm(producer, perm) ||
+        !IsIntermediate(ctx, *producer, root)) {
+      return;
+    }
+    match->removed.push_back(producer->node_index());
+    input->consumer = producer;
+    input->port = 0;
+    input->layout = layout;
+  }
+
+  // Returns the input of Mul `node_view` which isn't the scalar one, or -1 if
+  // neither input is a scalar.
+  static int MulOperandPort(RemapperContext* ctx,
+                            utils::MutableNodeView* node_view) {
+    if (!IsMul(*node_view->node())) return -1;
+    for (int port = 0; port < 2; ++port) {
+      const auto& props =
+          GetOutputProperties(ctx, Fanin(node_view, 1 - port)->node_index());
+      if (!props.empty() && NumCoefficients(props[0].shape()) == 1) {
+        return port;
+      }
+    }
+    return -1;
+  }
+
+  static TensorShapeProto InputShape(RemapperContext* ctx,
+                                     const AttentionInput& input) {
+    const auto& props = ctx->GetGraphProperties().GetInputProperties(
+        input.consumer->node()->name());
+    return input.port < static_cast<int>(props.size())
+               ? props[input.port].shape()
+               : TensorShapeProto();
+  }
+
+  // Matches the scores Q * K^T * scale fed to `scores`, which is read by
+  // input `port` of `consumer`.
+  static bool MatchScores(RemapperContext* ctx, const NodeDef& root,
+                          utils::MutableNodeView* consumer, int port,
+                          AttentionMatch* match) {
+    utils::MutableNodeView* scores = Fanin(consumer, port);
+    if (!IsIntermediate(*ctx, *scores, root)) return false;
+
+    const int scores_port = MulOperandPort(ctx, scores);
+    if (scores_port >= 0) {
+      match->removed.push_back(scores->node_index());
+      match->scale = scores->node()->input(1 - scores_port);
+      scores = Fanin(scores, scores_port);
+      if (!IsIntermediate(*ctx, *scores, root)) return false;
+    }
+    match->removed.push_back(scores->node_index());
+    const NodeDef* scores_def = scores->node();
+
+    int query_port;
+    if (HasEquation(*scores_def, kKerasScoresEquation)) {
+      query_port = 1;
+      match->key = {scores, 0, kLayoutBSHD};
+      match->query = {scores, 1, kLayoutBSHD};
+    } else if (scores_def->op() == kBatchMatMulV2) {
+      bool adj_x, adj_y;
+      TF_ABORT_IF_ERROR(GetNodeAttr(*scores_def, "adj_x", &adj_x));
+      TF_ABORT_IF_ERROR(GetNodeAttr(*scores_def, "adj_y", &adj_y));
+      if (adj_x) return false;
+      query_port = 0;
+      match->query = {scores, 0, kLayoutBHSD};
+      match->key = {scores, 1, adj_y ? kLayoutBHSD : kLayoutBHDS};
+    } else {
+      return false;
+    }
+
+    // The scale may be applied to the query instead of the scores.
+    utils::MutableNodeView* query = Fanin(scores, query_port);
+    const int query_mul_port = MulOperandPort(ctx, query);
+    if (match->scale.empty() && query_mul_port >= 0 &&
+        IsIntermediate(*ctx, *query, root)) {
+      match->removed.push_back(query->node_index());
+      match->scale = query->node()->input(1 - query_mul_port);
+      match->query.consumer = query;
+      match->query.port = query_mul_port;
+    }
+    if (match->scale.empty()) return false;
+
+    if (scores_def->op() == kBatchMatMulV2) {
+      FoldTranspose(*ctx, root, {0, 2, 1, 3}, kLayoutBSHD, &match->query,
+                    match);
+      FoldTranspose(*ctx, root,
+                    match->key.layout == kLayoutBHSD
+                        ? std::vector<int64>{0, 2, 1, 3}
+                        : std::vector<int64>{0, 2, 3, 1},
+                    kLayoutBSHD, &match->key, match);
+    }
+    return true;
+  }
+
+  // Matches Softmax(scores + mask) fed to input `port` of `consumer`.
+  static bool MatchProbabilities(RemapperContext* ctx, const NodeDef& root,
+                                 utils::MutableNodeView* consumer, int port,
+                                 AttentionMatch* match) {
+    utils::MutableNodeView* softmax = Fanin(consumer, port);
+    if (IsIdentity(*softmax->node()) &&
+        IsIntermediate(*ctx, *softmax, root)) {
+      match->removed.push_back(softmax->node_index());
+      softmax = Fanin(softmax, 0);
+    }
+    if (!IsSoftmax(*softmax->node()) || !IsIntermediate(*ctx, *softmax, root))
+      return false;
+    match->removed.push_back(softmax->node_index());
+
+    utils::MutableNodeView* add = Fanin(softmax, 0);
+    if (!IsAdd(*add->node()) || !IsIntermediate(*ctx, *add, root)) {
+      return MatchScores(ctx, root, softmax, 0, match);
+    }
+
+    // The mask is broadcast to the scores, which may be either input.
+    const auto& input_props =
+        ctx->GetGraphProperties().GetInputProperties(add->node()->name());
+    const auto& output_props = GetOutputProperties(ctx, add->node_index());
+    if (input_props.size() != 2 || output_props.empty() ||
+        Rank(output_props[0].shape()) != 4) {
+      return false;
+    }
+    match->removed.push_back(add->node_index());
+    const AttentionMatch matched_add = *match;
+    for (int scores_port = 0; scores_port < 2; ++scores_port) {
+      *match = matched_add;
+      if (ShapesSymbolicallyEqual(output_props[0].shape(),
+                                  input_props[scores_port].shape()) &&
+          MatchScores(ctx, root, add, scores_port, match)) {
+        match->mask = add->node()->input(1 - scores_port);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool Match(RemapperContext* ctx, int node_index,
+                    AttentionMatch* match) {
+    utils::MutableNodeView* output = ctx->graph_view.GetNode(node_index);
+    const NodeDef& root = *output->node();
+    // TODO(itex): Add a GPU kernel.
+    if (!NodeIsOnCpu(&root) ||
+        (!HasDataType(&root, DT_FLOAT) && !HasDataType(&root, DT_BFLOAT16))) {
+      return false;
+    }
+
+    if (IsTranspose(root)) {
+      if (!IsTransposeWithPerm(output, {0, 2, 1, 3})) return false;
+      output = Fanin(output, 0);
+      if (output->node()->op() != kBatchMatMulV2 ||
+          !IsIntermediate(*ctx, *output, root)) {
+        return false;
+      }
+      match->removed.push_back(output->node_index());
+      match->output_layout = kLayoutBSHD;
+    }
+
+    const NodeDef* output_def = output->node();
+    if (HasEquation(*output_def, kKerasOutputEquation)) {
+      match->output_layout = kLayoutBSHD;
+      match->value = {output, 1, kLayoutBSHD};
+    } else if (output_def->op() == kBatchMatMulV2) {
+      bool adj_x, adj_y;
+      TF_ABORT_IF_ERROR(GetNodeAttr(*output_def, "adj_x", &adj_x));
+      TF_ABORT_IF_ERROR(GetNodeAttr(*output_def, "adj_y", &adj_y));
+      if (adj_x || adj_y) return false;
+      match->value = {output, 1, kLayoutBHSD};
+      FoldTranspose(*ctx, root, {0, 2, 1, 3}, kLayoutBSHD, &match->value,
+                    match);
+    } else {
+      return false;
+    }
+
+    if (!MatchProbabilities(ctx, root, output, 0, match)) return false;
+    return HaveAttentionShapes(ctx, *match);
+  }
+
+  // Returns true if the query, the key and the value have the same batch
+  // and heads, so the fused op doesn't need to broadcast them.
+  static bool HaveAttentionShapes(RemapperContext* ctx,
+                                  const AttentionMatch& match) {
+    const TensorShapeProto query = InputShape(ctx, match.query);
+    const TensorShapeProto key = InputShape(ctx, match.key);
+    const TensorShapeProto value = InputShape(ctx, match.value);
+    if (Rank(query) != 4 || Rank(key) != 4 || Rank(value) != 4) return false;
+
+    auto dim = [](const TensorShapeProto& shape, const string& layout,
+                  char name) { return shape.dim(layout.find(name)).size(); };
+    auto same = [](int64 left, int64 right) {
+      // Unknown dimensions are -1, and symbolic ones are less than -1.
+      return left == right && left != -1;
+    };
+    for (char name : {'B', 'H'}) {
+      const int64 query_dim = dim(query, match.query.layout, name);
+      if (!same(query_dim, dim(key, match.key.layout, name)) ||
+          !same(query_dim, dim(value, match.value.layout, name))) {
+        return false;
+      }
+    }
+    return same(dim(query, match.query.layout, 'D'),
+                dim(key, match.key.layout, 'D')) &&
+           same(dim(key, match.key.layout, 'S'),
+                dim(value, match.value.layout, 'S'));
+  }
+};
+
+REGISTER_FUSION(ScaledDotProductAttentionFusion)
+
+}  // namespace graph
+}  // namespace itex
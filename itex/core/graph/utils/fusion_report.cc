@@ -0,0 +1,158 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "itex/core/graph/utils/fusion_report.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+
+#include "itex/core/devices/device_backend_util.h"
+#include "itex/core/utils/env_var.h"
+#include "itex/core/utils/logging.h"
+#include "itex/core/utils/path.h"
+#include "itex/core/utils/strcat.h"
+#include "itex/core/utils/stringprintf.h"
+
+namespace itex {
+namespace graph {
+
+namespace {
+
+// Returns `value` as a quoted JSON string.
+string JsonString(const string& value) {
+  string result = "\"";
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          strings::Appendf(&result, "\\u%04x", c);
+        } else {
+          result += c;
+        }
+    }
+  }
+  result += "\"";
+  return result;
+}
+
+}  // namespace
+
+void FusionReport::AddFused(const string& pass, const string& fusion,
+                            const string& node_name) {
+  fused_[std::make_pair(pass, fusion)]++;
+  rejected_.erase(node_name);
+}
+
+void FusionReport::AddRejected(const string& pass, const string& node_name,
+                               const string& op, const string& reason,
+                               const string& fusions) {
+  rejected_[node_name] = {pass, op, reason, fusions};
+}
+
+void FusionReport::Write(const string& device_name, int num_nodes_before,
+                         const GraphDef& optimized_graph) const {
+  std::unordered_map<string, const NodeDef*> nodes;
+  for (const NodeDef& node : optimized_graph.node()) {
+    nodes.emplace(node.name(), &node);
+  }
+
+  string output = "{\n";
+  strings::StrAppend(&output, "  \"device\": ", JsonString(device_name),
+                     ",\n  \"num_nodes_before\": ", num_nodes_before,
+                     ",\n  \"num_nodes_after\": ", optimized_graph.node_size(),
+                     ",\n  \"fusions\": [");
+  const char* separator = "\n";
+  for (const auto& kv : fused_) {
+    strings::StrAppend(&output, separator,
+                       "    {\"pass\": ", JsonString(kv.first.first),
+                       ", \"fusion\": ", JsonString(kv.first.second),
+                       ", \"count\": ", kv.second, "}");
+    separator = ",\n";
+  }
+  strings::StrAppend(&output, "\n  ],\n  \"rejected\": [");
+
+  std::map<string, int64> unfused_ops;
+  int64 num_unfused_ops = 0;
+  separator = "\n";
+  for (const auto& kv : rejected_) {
+    const Rejection& rejection = kv.second;
+    auto it = nodes.find(kv.first);
+    if (it == nodes.end() || it->second->op() != rejection.op) continue;
+    unfused_ops[rejection.op]++;
+    num_unfused_ops++;
+    strings::StrAppend(&output, separator,
+                       "    {\"pass\": ", JsonString(rejection.pass),
+                       ", \"node\": ", JsonString(kv.first),
+                       ", \"op\": ", JsonString(rejection.op),
+                       ", \"reason\": ", JsonString(rejection.reason),
+                       ", \"fusions\": ", JsonString(rejection.fusions), "}");
+    separator = ",\n";
+  }
+  strings::StrAppend(&output, "\n  ],\n  \"estimated_unfused_ops\": ",
+                     num_unfused_ops, ",\n  \"unfused_ops_by_type\": {");
+  separator = "\n";
+  for (const auto& kv : unfused_ops) {
+    strings::StrAppend(&output, separator, "    ", JsonString(kv.first), ": ",
+                       kv.second);
+    separator = ",\n";
+  }
+  strings::StrAppend(&output, "\n  }\n}\n");
+
+  static std::atomic<int64> num_reports{0};
+  string file_name = strings::StrCat("fusion_report_", device_name, "_",
+                                     getpid(), "_", num_reports++, ".json");
+  string path = io::JoinPath(GetFusionReportPath(), file_name);
+  std::ofstream file(path, std::ios::out | std::ios::trunc);
+  file << output;
+  file.close();
+  if (!file.good()) {
+    ITEX_LOG(WARNING) << "Failed to write fusion report " << path;
+    return;
+  }
+  ITEX_VLOG(1) << "Saved fusion report to " << path << ", "
+               << num_unfused_ops << " candidates are not fused.";
+}
+
+string GetFusionReportPath() {
+  string path = itex_get_config().debug_options().fusion_report_path();
+  if (path.empty()) {
+    ITEX_CHECK_OK(ReadStringFromEnvVar("ITEX_FUSION_REPORT_PATH", "", &path));
+  }
+  return path;
+}
+
+FusionReport* GetFusionReport(const GrapplerItem& item) {
+  if (GetFusionReportPath().empty()) return nullptr;
+  if (item.fusion_report == nullptr) {
+    item.fusion_report = std::make_shared<FusionReport>();
+  }
+  return item.fusion_report.get();
+}
+
+}  // namespace graph
+}  // namespace itex
@@ -0,0 +1,85 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef ITEX_CORE_GRAPH_UTILS_FUSION_REPORT_H_
+#define ITEX_CORE_GRAPH_UTILS_FUSION_REPORT_H_
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "itex/core/graph/utils/grappler_item.h"
+#include "itex/core/utils/types.h"
+#include "protos/graph.pb.h"
+
+namespace itex {
+namespace graph {
+
+// Reasons a fusion candidate is rejected for.
+constexpr char kRejectDevice[] = "device";
+constexpr char kRejectDataType[] = "dtype";
+constexpr char kRejectControlEdge[] = "control fanin or fanout";
+constexpr char kRejectMultipleFanout[] = "multiple fanout";
+constexpr char kRejectPatternMismatch[] = "pattern mismatch";
+
+// Fusions done and rejected by the graph passes optimizing one GrapplerItem.
+// A candidate is a node which has fusions registered for its op, or which
+// the oneDNN Graph pass can translate. A candidate which is fused by a later
+// pass, or a later run of the same pass, is no longer reported as rejected.
+class FusionReport {
+ public:
+  // Records that `pass` applied `fusion` with root node `node_name`.
+  void AddFused(const string& pass, const string& fusion,
+                const string& node_name);
+
+  // Records that no fusion of `pass` was applied to candidate `node_name`.
+  // `fusions` are the fusions tried, separated by ",".
+  void AddRejected(const string& pass, const string& node_name,
+                   const string& op, const string& reason,
+                   const string& fusions);
+
+  // Writes the report of `optimized_graph` as a JSON file to the report
+  // directory. The unfused op count is estimated as the number of rejected
+  // candidates which are still in `optimized_graph` with the same op.
+  void Write(const string& device_name, int num_nodes_before,
+             const GraphDef& optimized_graph) const;
+
+ private:
+  struct Rejection {
+    string pass;
+    string op;
+    string reason;
+    string fusions;
+  };
+
+  // Number of nodes fused, keyed by pass and fusion name.
+  std::map<std::pair<string, string>, int64> fused_;
+  // Keyed by node name.
+  std::map<string, Rejection> rejected_;
+};
+
+// Returns the directory fusion reports are written to, which is
+// `DebugOptions.fusion_report_path` or `ITEX_FUSION_REPORT_PATH`. Reporting
+// is disabled when it's empty.
+string GetFusionReportPath();
+
+// Returns the report shared by the passes optimizing `item`, or nullptr if
+// reporting is disabled.
+FusionReport* GetFusionReport(const GrapplerItem& item);
+
+}  // namespace graph
+}  // namespace itex
+
+#endif  // ITEX_CORE_GRAPH_UTILS_FUSION_REPORT_H_
@@ -15,7 +15,10 @@ limitations under the License.
 
 #include "itex/core/graph/utils/graph_properties.h"
 
+#include <utility>
+
 #include "itex/core/utils/errors.h"
+#include "itex/core/utils/logging.h"
 #include "itex/core/utils/tf_buffer.h"
 #include "protos/op_performance_data.pb.h"
 
@@ -39,6 +42,8 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
                      tf_status);
   Status status = StatusFromTF_Status(tf_status);
   TF_DeleteStatus(tf_status);
+  input_props_.clear();
+  output_props_.clear();
   return status;
 }
 
@@ -76,20 +81,145 @@ static Status GetProperties(TF_GraphProperties* graph_prop,
   return status;
 }
 
+Status GraphProperties::LookUpProperties(
+    const string& node_name, bool is_input,
+    const std::vector<OpInfo_TensorProperties>** props) const {
+  PropertiesMap& cache = is_input ? input_props_ : output_props_;
+  auto it = cache.find(node_name);
+  if (it != cache.end()) {
+    *props = &it->second;
+    return Status::OK();
+  }
+
+  std::vector<OpInfo_TensorProperties> new_props;
+  Status status =
+      is_input ? GetProperties(graph_prop_, node_name, &new_props,
+                               TF_GetInputPropertiesListSize,
+                               TF_GetInputPropertiesList)
+               : GetProperties(graph_prop_, node_name, &new_props,
+                               TF_GetOutputPropertiesListSize,
+                               TF_GetOutputPropertiesList);
+  if (!status.ok()) {
+    static const std::vector<OpInfo_TensorProperties>* empty_props =
+        new std::vector<OpInfo_TensorProperties>();
+    *props = empty_props;
+    return status;
+  }
+  *props = &cache.emplace(node_name, std::move(new_props)).first->second;
+  return Status::OK();
+}
+
 Status GraphProperties::GetInputProperties(
     const string& node_name,
     std::vector<OpInfo_TensorProperties>* input_props) const {
-  return GetProperties(graph_prop_, node_name, input_props,
-                       TF_GetInputPropertiesListSize,
-                       TF_GetInputPropertiesList);
+  const std::vector<OpInfo_TensorProperties>* props;
+  TF_RETURN_IF_ERROR(LookUpProperties(node_name, /*is_input=*/true, &props));
+  *input_props = *props;
+  return Status::OK();
 }
 
 Status GraphProperties::GetOutputProperties(
     const string& node_name,
     std::vector<OpInfo_TensorProperties>* output_props) const {
-  return GetProperties(graph_prop_, node_name, output_props,
-                       TF_GetOutputPropertiesListSize,
-                       TF_GetOutputPropertiesList);
+  const std::vector<OpInfo_TensorProperties>* props;
+  TF_RETURN_IF_ERROR(LookUpProperties(node_name, /*is_input=*/false, &props));
+  *output_props = *props;
+  return Status::OK();
+}
+
+const std::vector<OpInfo_TensorProperties>& GraphProperties::GetInputProperties(
+    const string& node_name) const {
+  const std::vector<OpInfo_TensorProperties>* props;
+  Status status = LookUpProperties(node_name, /*is_input=*/true, &props);
+  if (!status.ok()) {
+    ITEX_VLOG(1) << "Failed to get input properties of " << node_name << ": "
+                 << status;
+  }
+  return *props;
+}
+
+const std::vector<OpInfo_TensorProperties>&
+GraphProperties::GetOutputProperties(const string& node_name) const {
+  const std::vector<OpInfo_TensorProperties>* props;
+  Status status = LookUpProperties(node_name, /*is_input=*/false, &props);
+  if (!status.ok()) {
+    ITEX_VLOG(1) << "Failed to get output properties of " << node_name << ": "
+                 << status;
+  }
+  return *props;
+}
+
+void GraphProperties::SetInputProperties(
+    const string& node_name, std::vector<OpInfo_TensorProperties> input_props) {
+  input_props_[node_name] = std::move(input_props);
+}
+
+void GraphProperties::SetOutputProperties(
+    const string& node_name,
+    std::vector<OpInfo_TensorProperties> output_props) {
+  output_props_[node_name] = std::move(output_props);
+}
+
+void GraphProperties::SetInputDataType(const string& node_name, int port,
+                                       DataType dtype) {
+  std::vector<OpInfo_TensorProperties> props = GetInputProperties(node_name);
+  if (port >= static_cast<int>(props.size())) return;
+  props[port].set_dtype(dtype);
+  SetInputProperties(node_name, std::move(props));
+}
+
+void GraphProperties::SetOutputDataType(const string& node_name, int port,
+                                        DataType dtype) {
+  std::vector<OpInfo_TensorProperties> props = GetOutputProperties(node_name);
+  if (port >= static_cast<int>(props.size())) return;
+  props[port].set_dtype(dtype);
+  SetOutputProperties(node_name, std::move(props));
+}
+
+Status GraphPropertiesCache::Get(const GrapplerItem& item,
+                                 bool assume_valid_feeds,
+                                 bool include_tensor_values,
+                                 GraphProperties** properties) {
+  Entry& entry =
+      entries_[std::make_pair(assume_valid_feeds, include_tensor_values)];
+  if (entry.properties == nullptr) {
+    entry.properties.reset(new GraphProperties(item));
+    entry.status = entry.properties->InferStatically(
+        assume_valid_feeds, /*aggressive_shape_inference=*/false,
+        include_tensor_values);
+    if (entry.status.ok()) {
+      for (const Update& update : updates_) update(entry.properties.get());
+    }
+  }
+  *properties = entry.properties.get();
+  return entry.status;
+}
+
+void GraphPropertiesCache::AddUpdate(Update update) {
+  for (auto& kv : entries_) {
+    if (kv.second.status.ok()) update(kv.second.properties.get());
+  }
+  updates_.push_back(std::move(update));
+}
+
+static GraphPropertiesCache* GetGraphPropertiesCache(const GrapplerItem& item) {
+  if (item.graph_properties_cache == nullptr) {
+    item.graph_properties_cache = std::make_shared<GraphPropertiesCache>();
+  }
+  return item.graph_properties_cache.get();
+}
+
+Status GetSharedGraphProperties(const GrapplerItem& item,
+                                bool assume_valid_feeds,
+                                bool include_tensor_values,
+                                GraphProperties** properties) {
+  return GetGraphPropertiesCache(item)->Get(item, assume_valid_feeds,
+                                            include_tensor_values, properties);
+}
+
+void UpdateSharedGraphProperties(const GrapplerItem& item,
+                                 GraphPropertiesCache::Update update) {
+  GetGraphPropertiesCache(item)->AddUpdate(std::move(update));
 }
 
 }  // namespace graph
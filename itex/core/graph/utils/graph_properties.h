@@ -18,11 +18,17 @@ limitations under the License.
 #ifndef ITEX_CORE_GRAPH_UTILS_GRAPH_PROPERTIES_H_
 #define ITEX_CORE_GRAPH_UTILS_GRAPH_PROPERTIES_H_
 
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "itex/core/graph/utils/grappler_item.h"
 #include "itex/core/utils/status.h"
+#include "itex/core/utils/types.h"
 #include "protos/op_performance_data.pb.h"
 
 namespace itex {
@@ -73,10 +79,75 @@ class GraphProperties {
       const string& node_name,
       std::vector<OpInfo_TensorProperties>* output_props) const;
 
+  // Same as above without copying. Properties of each node are fetched from
+  // TensorFlow on the first query and cached, unknown nodes have none. The
+  // returned reference is valid until InferStatically() is called again.
+  const std::vector<OpInfo_TensorProperties>& GetInputProperties(
+      const string& node_name) const;
+  const std::vector<OpInfo_TensorProperties>& GetOutputProperties(
+      const string& node_name) const;
+
+  // Overrides the properties of a node, for passes which add nodes or change
+  // their inputs or outputs.
+  void SetInputProperties(const string& node_name,
+                          std::vector<OpInfo_TensorProperties> input_props);
+  void SetOutputProperties(const string& node_name,
+                           std::vector<OpInfo_TensorProperties> output_props);
+  void SetInputDataType(const string& node_name, int port, DataType dtype);
+  void SetOutputDataType(const string& node_name, int port, DataType dtype);
+
  private:
+  typedef std::unordered_map<string, std::vector<OpInfo_TensorProperties>>
+      PropertiesMap;
+
+  Status LookUpProperties(
+      const string& node_name, bool is_input,
+      const std::vector<OpInfo_TensorProperties>** props) const;
+
   TF_GraphProperties* graph_prop_;
+  // References to the values must stay valid on insertion, so these are not
+  // flat maps.
+  mutable PropertiesMap input_props_;
+  mutable PropertiesMap output_props_;
 };
 
+// Static shape inference of the graph of a GrapplerItem, shared by all passes
+// optimizing the item. Inference runs at most once for each set of options.
+//
+// The shapes are of the graph before ITEX optimization, and are found by
+// node name. Passes which add nodes or change their shapes or types record
+// an update, which is applied to the existing inference results and replayed
+// on the ones inferred later.
+class GraphPropertiesCache {
+ public:
+  typedef std::function<void(GraphProperties*)> Update;
+
+  Status Get(const GrapplerItem& item, bool assume_valid_feeds,
+             bool include_tensor_values, GraphProperties** properties);
+  void AddUpdate(Update update);
+
+ private:
+  struct Entry {
+    std::unique_ptr<GraphProperties> properties;
+    Status status;
+  };
+
+  std::map<std::pair<bool, bool>, Entry> entries_;
+  std::vector<Update> updates_;
+};
+
+// Returns the static shape inference of `item`, see GraphPropertiesCache.
+// Tensor values are included in both input and output properties if
+// `include_tensor_values` is true.
+Status GetSharedGraphProperties(const GrapplerItem& item,
+                                bool assume_valid_feeds,
+                                bool include_tensor_values,
+                                GraphProperties** properties);
+
+// Records an update of the shared properties of `item`.
+void UpdateSharedGraphProperties(const GrapplerItem& item,
+                                 GraphPropertiesCache::Update update);
+
 }  // namespace graph
 }  // namespace itex
 
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef ITEX_CORE_GRAPH_UTILS_GRAPPLER_ITEM_H_
 #define ITEX_CORE_GRAPH_UTILS_GRAPPLER_ITEM_H_
 
+#include <memory>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -28,12 +29,21 @@ limitations under the License.
 namespace itex {
 namespace graph {
 
+class FusionReport;
+class GraphPropertiesCache;
+
 class GrapplerItem {
  public:
   explicit GrapplerItem(const TF_GrapplerItem* tf_item);
   TF_GrapplerItem* GetTfGrapplerItem() const { return item_; }
   std::unordered_set<string> NodesToPreserve() const;
   std::vector<string> fetch;
+  // Static shape inference shared by the passes optimizing this item, see
+  // GetSharedGraphProperties() in graph_properties.h.
+  mutable std::shared_ptr<GraphPropertiesCache> graph_properties_cache;
+  // Fusions done by the passes optimizing this item, see GetFusionReport() in
+  // fusion_report.h.
+  mutable std::shared_ptr<FusionReport> fusion_report;
 
  private:
   TF_GrapplerItem* item_;
@@ -122,6 +122,15 @@ bool RewriteFusedConv(const utils::MutableNodeView& node_view) {
 bool RewriteMatMul(const utils::MutableNodeView& node_view) {
   const NodeDef& node_def = *(node_view.node());
 
+  // Binary post ops read extra inputs, which the OneDnn kernel doesn't have.
+  std::vector<string> fused_ops;
+  if (TryGetNodeAttr(node_def, "fused_ops", &fused_ops)) {
+    PostOpUtil post_op_util;
+    if (post_op_util.AddOps(fused_ops) && post_op_util.HasBinary()) {
+      return false;
+    }
+  }
+
   // Temporarily rewrite MatMul-like ops for CPU unconditionally.
   // TODO(itex): Remove this condition once MatMul blocked format is
   // supported on CPU.
@@ -318,6 +327,7 @@ static const std::vector<int> GetConstFilterCheckList(
                                 {"_ITEXAUGRUCell", {3, 4, 5, 6}},
                                 {"_ITEXForwardGRU", {2, 3, 4, 5}},
                                 {"_ITEXForwardAUGRU", {3, 4, 5, 6}},
+                                {"ItexRnn", {3}},
                                 {"_default", {1}}};
 
   if (op_const_checklist_map.find(op_name) == op_const_checklist_map.end()) {
@@ -35,6 +35,7 @@ void InitGlobalSetting(const OptimizerConfigFlags& config) {
       {"ITEX_LAYOUT_OPT", config.enable_layout_opt},
       {"ITEX_NATIVE_FORMAT", config.enable_native_format},
       {"ITEX_AUTO_MIXED_PRECISION", config.enable_auto_mixed_precision},
+      {"ITEX_ELEMENTWISE_FUSION", config.enable_elementwise_fusion},
 #ifndef INTEL_CPU_ONLY
       {"ITEX_TILE_AS_DEVICE", TileAsDevice},
 #endif
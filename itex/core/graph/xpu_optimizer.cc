@@ -15,13 +15,18 @@ limitations under the License.
 
 #include "itex/core/graph/xpu_optimizer.h"
 
+#include <memory>
+
 #include "itex/core/graph/auto_mixed_precision/auto_mixed_precision.h"
+#include "itex/core/graph/elementwise_fusion/elementwise_fusion.h"
 #include "itex/core/graph/memory_opt_pass/memory_opt_pass.h"
 #include "itex/core/graph/native_layout/native_layout.h"
 #include "itex/core/graph/onednn_graph/onednn_graph.h"
 #include "itex/core/graph/onednn_layout/onednn_layout.h"
+#include "itex/core/graph/optimized_graph_cache.h"
 #include "itex/core/graph/optimizer_config.h"
 #include "itex/core/graph/remapper/remapper.h"
+#include "itex/core/graph/utils/fusion_report.h"
 #include "itex/core/graph/utils/utils.h"
 #include "itex/core/utils/errors.h"
 #include "itex/core/utils/op_kernel.h"
@@ -70,9 +75,35 @@ void Optimizer_Optimize(void* optimizer, const TF_Buffer* graph_buf,
   // Deserialize graph_buf into GraphDef
   GraphDef graph_def;
   SET_STATUS_IF_ERROR(tf_status, BufferToMessage(graph_buf, graph_def));
-  GraphDef optimized_graph_def = graph_def;
   auto config = GetOptimizerConfigFlags();
 
+  // Reuse the result of the same optimization done before.
+  OptimizedGraphCache& graph_cache = OptimizedGraphCache::GetInstance();
+  string cache_key;
+  if (graph_cache.enabled()) {
+    cache_key =
+        OptimizedGraphCache::GetKey(device_name, graph_def, item, config);
+    GraphDef cached_graph_def;
+    std::shared_ptr<const FusionReport> cached_fusion_report;
+    // A graph without a fusion report is optimized again when reporting is
+    // enabled, so that every optimization writes its report.
+    if (graph_cache.Find(cache_key, &cached_graph_def,
+                         &cached_fusion_report) &&
+        (cached_fusion_report != nullptr || GetFusionReportPath().empty())) {
+      if (cached_fusion_report != nullptr) {
+        cached_fusion_report->Write(device_name, graph_def.node_size(),
+                                    cached_graph_def);
+      }
+      SET_STATUS_IF_ERROR(
+          tf_status, MessageToBuffer(cached_graph_def, optimized_graph_buf));
+      TF_StatusFromStatus(status, tf_status);
+      return;
+    }
+  }
+
+  GraphDef optimized_graph_def = graph_def;
+  int num_nodes_before = graph_def.node_size();
+
   if (config.enable_remapper) {
     // We don't want full scope remapper before onednn graph pass
     for (int i = 0; i < config.remapper_run_pass; ++i) {
@@ -120,6 +151,15 @@ void Optimizer_Optimize(void* optimizer, const TF_Buffer* graph_buf,
                                                    &optimized_graph_def));
   }
 
+  // Fuse the chains of elementwise ops which no other fusion took. It runs
+  // after the oneDNN layout pass, which keeps the ops it rewrites.
+  if (config.enable_elementwise_fusion) {
+    optimized_graph_def.Swap(&graph_def);
+    SET_STATUS_IF_ERROR(tf_status,
+                        RunElementwiseFusion(device_name, item, graph_def,
+                                             &optimized_graph_def));
+  }
+
   // Put post Native Format rewrite pass for better co-working with oneDNN
   // layout.
   if (device_name == DEVICE_CPU) {
@@ -144,6 +184,15 @@ void Optimizer_Optimize(void* optimizer, const TF_Buffer* graph_buf,
     DumpGraphDefToFile("itex_optimizer", optimized_graph_def, "./");
   }
 
+  FusionReport* fusion_report = GetFusionReport(item);
+  if (fusion_report != nullptr) {
+    fusion_report->Write(device_name, num_nodes_before, optimized_graph_def);
+  }
+
+  if (graph_cache.enabled()) {
+    graph_cache.Insert(cache_key, optimized_graph_def, item.fusion_report);
+  }
+
   // Serialize output GraphDef into optimized_graph_buf.
   SET_STATUS_IF_ERROR(
       tf_status, MessageToBuffer(optimized_graph_def, optimized_graph_buf));
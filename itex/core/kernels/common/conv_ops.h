@@ -577,7 +577,9 @@ template <typename Device, typename Tinput, typename Tfilter, typename Tbias,
           bool is_depthwise = false>
 class ConvOpBase : public OpKernel {
  public:
-  explicit ConvOpBase(OpKernelConstruction* context) : OpKernel(context) {
+  explicit ConvOpBase(OpKernelConstruction* context)
+      : OpKernel(context),
+        onednn_objects_cache_(GetOneDnnObjectCacheCapacity()) {
     OP_REQUIRES_OK(context, context->GetAttr("dilations", &dilations_));
     OP_REQUIRES_OK(context, context->GetAttr("strides", &strides_));
     is_conv2d_ = (strides_.size() == 4);
@@ -679,12 +681,35 @@ class ConvOpBase : public OpKernel {
   }
 
   void InitOrSetMemory(OpKernelContext* context) {
-    if (!(enable_cache_ && is_init_ && context->is_input_same(0, input_dims_) &&
-          context->is_input_same(1, filter_dims_) && !is_format_reordered_)) {
+    // Format reordered convolution is executed in Init, it can't be cached.
+    if (!enable_cache_ || is_format_reordered_) {
       Init(context);
       return;
     }
 
+    // Input shapes differ from last execution, switch to the oneDNN objects
+    // prepared for current shapes, or create them if not cached yet.
+    if (!(is_init_ && context->is_input_same(kSrcIndex_, input_dims_) &&
+          context->is_input_same(kFilterIndex_, filter_dims_))) {
+      std::vector<int64> input_dims, filter_dims;
+      context->input_dims(kSrcIndex_, &input_dims);
+      context->input_dims(kFilterIndex_, &filter_dims);
+      CacheKeyCreator key_creator;
+      key_creator.AddAsKey(input_dims);
+      key_creator.AddAsKey(filter_dims);
+      string key = key_creator.GetKey();
+
+      auto* onednn_objects = onednn_objects_cache_.Find(key);
+      if (onednn_objects == nullptr) {
+        Init(context);
+        if (is_init_ && !is_format_reordered_ && context->status().ok()) {
+          onednn_objects_cache_.Insert(key, SaveOneDnnObjects());
+        }
+        return;
+      }
+      RestoreOneDnnObjects(*onednn_objects);
+    }
+
     if (is_input_zero_) {
       OP_REQUIRES_OK(context, context->allocate_output(
                                   kDstIndex_, dst_tensor_shape_, &dst_tensor_));
@@ -748,6 +773,8 @@ class ConvOpBase : public OpKernel {
     }
 
     if (!is_format_reordered_) {
+      TraceMe traceme(kOneDnnPrimitiveExecuteTraceName,
+                      kOneDnnPrimitiveTraceLevel);
       fwd_primitive_.execute(onednn_stream_, fwd_primitives_args_);
     }
     scratchpad_tensor_.reset();
@@ -755,7 +782,10 @@ class ConvOpBase : public OpKernel {
 
   void Init(OpKernelContext* context) {
     try {
-      fwd_primitives_args_.clear();
+      // Create new oneDNN objects instead of updating the cached ones.
+      fwd_primitives_args_ = std::unordered_map<int, memory>();
+      weight_reorder_args_ = std::unordered_map<int, memory>();
+      is_input_zero_ = false;
 
       const Tensor& src_tensor = context->input(kSrcIndex_);
       const Tensor& filter_tensor = context->input(kFilterIndex_);
@@ -884,7 +914,11 @@ class ConvOpBase : public OpKernel {
       if (std::is_same<Tinput, float>::value) {
         post_ops_attr.set_fpmath_mode(fp32_math_mode_);
       }
-      fwd_pd_ = ConvFwdPd(fwd_desc, post_ops_attr, onednn_engine_);
+      {
+        TraceMe traceme(kOneDnnPrimitiveCreateTraceName,
+                        kOneDnnPrimitiveTraceLevel);
+        fwd_pd_ = ConvFwdPd(fwd_desc, post_ops_attr, onednn_engine_);
+      }
 
       // keep tensor out of if block to avoid of being deallocated
       is_format_reordered_ = data_layout != tag_opt;
@@ -918,7 +952,11 @@ class ConvOpBase : public OpKernel {
           dnnl::memory(fwd_pd_.scratchpad_desc(), onednn_engine_,
                        GetTensorBuffer<Tinput>(scratchpad_tensor_.get()));
 
-      fwd_primitive_ = convolution_forward(fwd_pd_);
+      {
+        TraceMe traceme(kOneDnnPrimitiveCreateTraceName,
+                        kOneDnnPrimitiveTraceLevel);
+        fwd_primitive_ = convolution_forward(fwd_pd_);
+      }
 
       src_mem_ = CreateDnnlMemory(src_md, onednn_engine_,
                                   GetTensorBuffer<Tinput>(&src_tensor));
@@ -1030,6 +1068,70 @@ class ConvOpBase : public OpKernel {
 
   mutex mu_compute_;
 
+  // oneDNN objects and TF memory prepared by Init for one pair of input
+  // shapes. Memory objects are handles, so the copies share data handles.
+  struct OneDnnObjects {
+    bool is_input_zero;
+    bool is_filter_reordered;
+    memory src_mem, src_mem_opt, dst_mem, dst_mem_opt, filter_mem,
+        filter_mem_input, scratchpad_mem, bias_mem;
+    memory::dims dst_dims_onednn;
+    memory::desc dst_md;
+    dnnl::reorder weight_reorder;
+    primitive fwd_primitive;
+    ConvFwdPd fwd_pd;
+    std::unordered_map<int, memory> fwd_primitives_args;
+    std::unordered_map<int, memory> weight_reorder_args;
+    TensorShape dst_tensor_shape;
+    std::vector<int64> input_dims, filter_dims;
+    // Copying an uninitialized Tensor is not allowed, so keep it optional.
+    std::shared_ptr<Tensor> tmp_weight;
+    int64_t scratchpad_size;
+  };
+
+  OneDnnObjects SaveOneDnnObjects() {
+    std::shared_ptr<Tensor> tmp_weight;
+    if (tmp_weight_.IsInitialized()) {
+      tmp_weight = std::make_shared<Tensor>(tmp_weight_);
+    }
+    return {is_input_zero_,        is_filter_reordered_, src_mem_,
+            src_mem_opt_,          dst_mem_,             dst_mem_opt_,
+            filter_mem_,           filter_mem_input_,    scratchpad_mem_,
+            bias_mem_,             dst_dims_onednn_,     dst_md_,
+            weight_reorder_,       fwd_primitive_,       fwd_pd_,
+            fwd_primitives_args_,  weight_reorder_args_, dst_tensor_shape_,
+            input_dims_,           filter_dims_,         tmp_weight,
+            scratchpad_size_};
+  }
+
+  void RestoreOneDnnObjects(const OneDnnObjects& objects) {
+    is_input_zero_ = objects.is_input_zero;
+    is_filter_reordered_ = objects.is_filter_reordered;
+    src_mem_ = objects.src_mem;
+    src_mem_opt_ = objects.src_mem_opt;
+    dst_mem_ = objects.dst_mem;
+    dst_mem_opt_ = objects.dst_mem_opt;
+    filter_mem_ = objects.filter_mem;
+    filter_mem_input_ = objects.filter_mem_input;
+    scratchpad_mem_ = objects.scratchpad_mem;
+    bias_mem_ = objects.bias_mem;
+    dst_dims_onednn_ = objects.dst_dims_onednn;
+    dst_md_ = objects.dst_md;
+    weight_reorder_ = objects.weight_reorder;
+    fwd_primitive_ = objects.fwd_primitive;
+    fwd_pd_ = objects.fwd_pd;
+    fwd_primitives_args_ = objects.fwd_primitives_args;
+    weight_reorder_args_ = objects.weight_reorder_args;
+    dst_tensor_shape_ = objects.dst_tensor_shape;
+    input_dims_ = objects.input_dims;
+    filter_dims_ = objects.filter_dims;
+    if (objects.tmp_weight) tmp_weight_ = *objects.tmp_weight;
+    scratchpad_size_ = objects.scratchpad_size;
+  }
+
+  // Prepared oneDNN objects keyed by input shapes, guarded by mu_compute_.
+  LRUCache<OneDnnObjects> onednn_objects_cache_;
+
  protected:
   std::vector<int64_t> explicit_paddings_;
   bool is_conv2d_;
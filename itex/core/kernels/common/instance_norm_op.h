@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef ITEX_CORE_KERNELS_COMMON_INSTANCE_NORM_OP_H_
 #define ITEX_CORE_KERNELS_COMMON_INSTANCE_NORM_OP_H_
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -32,6 +34,133 @@ limitations under the License.
 
 namespace itex {
 
+namespace functor {
+
+// Instance normalization of a whole batch on CPU. `src` and `dst` are
+// [N, S, C] if `channels_last`, otherwise [N, C, S], where S is the spatial
+// size. Mean and variance of each (sample, channel) group are accumulated in
+// U, and `dst` may alias `src`.
+template <typename T, typename U>
+struct InstanceNormCPU {
+  void operator()(const CPUDevice& d, const T* src, const U* scale,
+                  const U* shift, int64 batch_size, int64 channels,
+                  int64 spatial_size, bool channels_last, float epsilon,
+                  bool fuse_activation, float leakyrelu_alpha, T* dst) {
+    // Input is read twice for the statistics and once more to normalize.
+    const Eigen::TensorOpCost cost_per_element(3 * sizeof(T), sizeof(T), 8);
+    // Channels normalized together by one task in channels-last layout, so
+    // every row of the task is a contiguous vector.
+    const int64 kChannelBlock = 16;
+    if (channels_last) {
+      const int64 num_blocks = (channels + kChannelBlock - 1) / kChannelBlock;
+      const int64 block_size = std::min(kChannelBlock, channels);
+      d.parallelFor(
+          batch_size * num_blocks,
+          cost_per_element * spatial_size * block_size,
+          [&](Eigen::Index begin, Eigen::Index end) {
+            for (Eigen::Index task = begin; task < end; ++task) {
+              const int64 offset =
+                  (task / num_blocks) * spatial_size * channels;
+              const int64 channel = (task % num_blocks) * kChannelBlock;
+              NormalizeChannelBlock(src + offset, scale + channel,
+                                    shift + channel, channels, spatial_size,
+                                    std::min(kChannelBlock, channels - channel),
+                                    channel, epsilon, fuse_activation,
+                                    leakyrelu_alpha, dst + offset);
+            }
+          });
+    } else {
+      d.parallelFor(
+          batch_size * channels, cost_per_element * spatial_size,
+          [&](Eigen::Index begin, Eigen::Index end) {
+            for (Eigen::Index group = begin; group < end; ++group) {
+              const int64 channel = group % channels;
+              NormalizeGroup(src + group * spatial_size, scale[channel],
+                             shift[channel], spatial_size, epsilon,
+                             fuse_activation, leakyrelu_alpha,
+                             dst + group * spatial_size);
+            }
+          });
+    }
+  }
+
+ private:
+  using ArrayT = Eigen::Array<T, Eigen::Dynamic, 1>;
+  using RowArrayU = Eigen::Array<U, 1, Eigen::Dynamic>;
+
+  // Relu is handled as LeakyRelu with zero alpha.
+  template <typename Array, typename Output>
+  static void Store(const Array& x, bool fuse_activation,
+                    float leakyrelu_alpha, Output* y) {
+    if (fuse_activation) {
+      *y = (x > U(0)).select(x, x * U(leakyrelu_alpha)).template cast<T>();
+    } else {
+      *y = x.template cast<T>();
+    }
+  }
+
+  // Normalizes `spatial_size` contiguous elements of one channel.
+  static void NormalizeGroup(const T* src, U scale, U shift,
+                             int64 spatial_size, float epsilon,
+                             bool fuse_activation, float leakyrelu_alpha,
+                             T* dst) {
+    Eigen::Map<const ArrayT> x(src, spatial_size);
+    const U mean = x.template cast<U>().mean();
+    const U variance = (x.template cast<U>() - mean).square().mean();
+    const U multiplier = scale / std::sqrt(variance + U(epsilon));
+    const U offset = shift - mean * multiplier;
+
+    Eigen::Map<ArrayT> y(dst, spatial_size);
+    Store(x.template cast<U>() * multiplier + offset, fuse_activation,
+          leakyrelu_alpha, &y);
+  }
+
+  // Normalizes `block` adjacent channels of one sample, whose elements are
+  // `channels` apart along the spatial dimension.
+  static void NormalizeChannelBlock(const T* src, const U* scale,
+                                    const U* shift, int64 channels,
+                                    int64 spatial_size, int64 block,
+                                    int64 channel, float epsilon,
+                                    bool fuse_activation,
+                                    float leakyrelu_alpha, T* dst) {
+    RowArrayU sum = RowArrayU::Zero(block);
+    for (int64 s = 0; s < spatial_size; ++s) {
+      sum += Row(src, s, channels, channel, block).template cast<U>();
+    }
+    const RowArrayU mean = sum / U(spatial_size);
+
+    RowArrayU square_sum = RowArrayU::Zero(block);
+    for (int64 s = 0; s < spatial_size; ++s) {
+      square_sum += (Row(src, s, channels, channel, block).template cast<U>() -
+                     mean)
+                        .square();
+    }
+    const RowArrayU variance = square_sum / U(spatial_size);
+
+    const RowArrayU multiplier =
+        Eigen::Map<const RowArrayU>(scale, block) /
+        (variance + U(epsilon)).sqrt();
+    const RowArrayU offset =
+        Eigen::Map<const RowArrayU>(shift, block) - mean * multiplier;
+    for (int64 s = 0; s < spatial_size; ++s) {
+      Eigen::Map<Eigen::Array<T, 1, Eigen::Dynamic>> y(
+          dst + s * channels + channel, block);
+      Store(Row(src, s, channels, channel, block).template cast<U>() *
+                    multiplier +
+                offset,
+            fuse_activation, leakyrelu_alpha, &y);
+    }
+  }
+
+  static Eigen::Map<const Eigen::Array<T, 1, Eigen::Dynamic>> Row(
+      const T* src, int64 s, int64 channels, int64 channel, int64 block) {
+    return Eigen::Map<const Eigen::Array<T, 1, Eigen::Dynamic>>(
+        src + s * channels + channel, block);
+  }
+};
+
+}  // namespace functor
+
 template <typename Device, typename T, typename U, bool fuse_activation = false>
 class InstanceNormOp : public OpKernel {
  public:
@@ -70,60 +199,97 @@ class InstanceNormOp : public OpKernel {
   }
 
   void Compute(OpKernelContext* context) override {
-    try {
-      auto onednn_engine = CreateDnnlEngine<Device>(*context);
-      auto onednn_stream = CreateDnnlStream(*context, onednn_engine);
+    const size_t kSrcIndex = 0;    // index of src input tensor
+    const size_t kScaleIndex = 1;  // index of scale tensor
+    const size_t kShiftIndex = 2;  // index of shift tensor
+    const Tensor& src_tensor = context->input(kSrcIndex);
+    const Tensor& scale_tensor = context->input(kScaleIndex);
+    const Tensor& shift_tensor = context->input(kShiftIndex);
+
+    TensorShape src_tf_shape = src_tensor.shape();
+    const int ndims = src_tf_shape.dims();
+
+    OP_REQUIRES(context, ndims == 4 || ndims == 5,
+                errors::InvalidArgument(
+                    "input must be 4-dimensional or 5-dimensional",
+                    src_tensor.shape().DebugString()));
+
+    // Handle the special case: input with 0 element and 0 layer size.
+    Tensor* dst_tensor = nullptr;
+    if (src_tf_shape.num_elements() == 0) {
+      OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
+                                  {0}, 0, src_tf_shape, &dst_tensor));
+      ITEX_DCHECK(dst_tensor);
+      return;
+    } else {
+      OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
+                                  {0}, 0, src_tensor.shape(), &dst_tensor));
+    }
 
-      const size_t kSrcIndex = 0;    // index of src input tensor
-      const size_t kScaleIndex = 1;  // index of scale tensor
-      const size_t kShiftIndex = 2;  // index of shift tensor
-      const Tensor& src_tensor = context->input(kSrcIndex);
-      const Tensor& scale_tensor = context->input(kScaleIndex);
-      const Tensor& shift_tensor = context->input(kShiftIndex);
+    int num_elements_scale = scale_tensor.dim_size(0);
+    int num_elements_shift = shift_tensor.dim_size(0);
+    if (scale_tensor.dims() > 1 && shift_tensor.dims() > 1) {
+      if (data_format == "NCHW" || data_format == "NCDHW") {
+        num_elements_scale = scale_tensor.dim_size(1);
+        num_elements_shift = shift_tensor.dim_size(1);
+      } else {
+        int dims = scale_tensor.dims();
+        num_elements_scale = scale_tensor.dim_size(dims - 1);
+        num_elements_shift = shift_tensor.dim_size(dims - 1);
+      }
+    }
+
+    OP_REQUIRES(
+        context, num_elements_scale == num_elements_shift,
+        errors::InvalidArgument("Number of elements in scale and shift",
+                                "tensors are not same."));
+
+    Normalize(context, context->eigen_device<Device>(), src_tensor,
+              scale_tensor, shift_tensor, num_elements_scale, dst_tensor);
+  }
 
-      TensorShape src_tf_shape = src_tensor.shape();
-      const int ndims = src_tf_shape.dims();
+ private:
+  // Normalizes all N * C (sample, channel) groups of the batch in one
+  // thread-parallel pass on CPU, instead of executing a oneDNN primitive per
+  // sample, so the op scales with cores rather than with batch size.
+  void Normalize(OpKernelContext* context, const CPUDevice& device,
+                 const Tensor& src_tensor, const Tensor& scale_tensor,
+                 const Tensor& shift_tensor, int num_channels,
+                 Tensor* dst_tensor) {
+    const bool channels_last = tensor_format_ == FORMAT_NHWC;
+    const int ndims = src_tensor.dims();
+    const int64 batch_size = src_tensor.dim_size(0);
+    const int64 channels = src_tensor.dim_size(channels_last ? ndims - 1 : 1);
+    const int64 spatial_size =
+        src_tensor.NumElements() / (batch_size * channels);
+    OP_REQUIRES(context, num_channels == channels,
+                errors::InvalidArgument(
+                    "Number of elements in scale and shift should be ",
+                    channels, ", but got ", num_channels));
+
+    functor::InstanceNormCPU<T, U> instance_norm;
+    instance_norm(device, src_tensor.flat<T>().data(),
+                  scale_tensor.flat<U>().data(), shift_tensor.flat<U>().data(),
+                  batch_size, channels, spatial_size, channels_last, epsilon_,
+                  fuse_activation, leakyrelu_alpha_,
+                  dst_tensor->flat<T>().data());
+  }
 
-      OP_REQUIRES(context, ndims == 4 || ndims == 5,
-                  errors::InvalidArgument(
-                      "input must be 4-dimensional or 5-dimensional",
-                      src_tensor.shape().DebugString()));
+  // Executes the oneDNN batch normalization primitive on each sample.
+  template <typename EigenDevice>
+  void Normalize(OpKernelContext* context, const EigenDevice& device,
+                 const Tensor& src_tensor, const Tensor& scale_tensor,
+                 const Tensor& shift_tensor, int num_channels,
+                 Tensor* dst_tensor) {
+    try {
+      auto onednn_engine = CreateDnnlEngine<Device>(*context);
+      auto onednn_stream = CreateDnnlStream(*context, onednn_engine);
 
       const int batch_size = src_tensor.shape().dim_size(0);
       const int64_t elems_per_batch =
           src_tensor.shape().num_elements() / batch_size;
-
-      // Handle the special case: input with 0 element and 0 layer size.
-      Tensor* dst_tensor = nullptr;
-      TensorShape workspace_tf_shape;
-      if (src_tf_shape.num_elements() == 0) {
-        workspace_tf_shape.AddDim(0);
-        OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
-                                    {0}, 0, src_tf_shape, &dst_tensor));
-        ITEX_DCHECK(dst_tensor);
-        return;
-      } else {
-        OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
-                                    {0}, 0, src_tensor.shape(), &dst_tensor));
-      }
-
-      int num_elements_scale = scale_tensor.dim_size(0);
-      int num_elements_shift = shift_tensor.dim_size(0);
-      if (scale_tensor.dims() > 1 && shift_tensor.dims() > 1) {
-        if (data_format == "NCHW" || data_format == "NCDHW") {
-          num_elements_scale = scale_tensor.dim_size(1);
-          num_elements_shift = shift_tensor.dim_size(1);
-        } else {
-          int dims = scale_tensor.dims();
-          num_elements_scale = scale_tensor.dim_size(dims - 1);
-          num_elements_shift = shift_tensor.dim_size(dims - 1);
-        }
-      }
-
-      OP_REQUIRES(
-          context, num_elements_scale == num_elements_shift,
-          errors::InvalidArgument("Number of elements in scale and shift",
-                                  "tensors are not same."));
+      const int num_elements_scale = num_channels;
+      const int num_elements_shift = num_channels;
 
       bool use_3d_format = src_tensor.dims() == 5;
 
@@ -149,26 +315,31 @@ class InstanceNormOp : public OpKernel {
       auto flags = dnnl::normalization_flags::use_scale |
                    dnnl::normalization_flags::use_shift;
 
-      dnnl::batch_normalization_forward::desc bn_fwd_desc(propagation, src_md,
-                                                          epsilon_, flags);
-
-      dnnl::primitive_attr attr;
-      attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+      OneDnnPrimitiveKeyCreator key_creator("instance_norm_fwd",
+                                            onednn_engine);
+      key_creator.AddAsKey(src_md);
+      key_creator.AddAsKey(epsilon_);
+      key_creator.AddAsKey(fuse_activation);
+      if (fuse_activation) key_creator.AddAsKey(leakyrelu_alpha_);
       dnnl::batch_normalization_forward::primitive_desc bn_fwd_pd;
-
-      if (fuse_activation) {
-        dnnl::post_ops post_ops;
-        post_ops.append_eltwise(1.0, dnnl::algorithm::eltwise_relu,
-                                leakyrelu_alpha_, 0.0);
-        attr.set_post_ops(post_ops);
-        bn_fwd_pd = dnnl::batch_normalization_forward::primitive_desc(
-            bn_fwd_desc, attr, onednn_engine);
-      } else {
-        bn_fwd_pd = dnnl::batch_normalization_forward::primitive_desc(
-            bn_fwd_desc, attr, onednn_engine);
-      }
-
-      dnnl::batch_normalization_forward bn_fwd_primitive(bn_fwd_pd);
+      dnnl::primitive bn_fwd_primitive;
+      FindOrCreateCachedPrimitive<dnnl::batch_normalization_forward>(
+          key_creator.GetKey(),
+          [&]() {
+            dnnl::batch_normalization_forward::desc bn_fwd_desc(
+                propagation, src_md, epsilon_, flags);
+            dnnl::primitive_attr attr;
+            attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+            if (fuse_activation) {
+              dnnl::post_ops post_ops;
+              post_ops.append_eltwise(1.0, dnnl::algorithm::eltwise_relu,
+                                      leakyrelu_alpha_, 0.0);
+              attr.set_post_ops(post_ops);
+            }
+            return dnnl::batch_normalization_forward::primitive_desc(
+                bn_fwd_desc, attr, onednn_engine);
+          },
+          &bn_fwd_pd, &bn_fwd_primitive);
 
       void* scale_data = GetTensorBuffer<U>(&scale_tensor);
       void* shift_data = GetTensorBuffer<U>(&shift_tensor);
@@ -222,9 +393,8 @@ class InstanceNormOp : public OpKernel {
     }
   }
 
- private:
   float epsilon_;
-  float leakyrelu_alpha_;
+  float leakyrelu_alpha_ = 0.0f;
   TensorFormat tensor_format_;
   string data_format;
 };
@@ -128,13 +128,24 @@ class LayerNormOp : public OpKernel {
       auto flags = dnnl::normalization_flags::use_scale |
                    dnnl::normalization_flags::use_shift;
 
-      dnnl::layer_normalization_forward::desc ln_fwd_desc(propagation, src_md,
-                                                          epsilon_, flags);
-      dnnl::primitive_attr attr;
-      attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
-      dnnl::layer_normalization_forward::primitive_desc ln_fwd_pd(
-          ln_fwd_desc, attr, onednn_engine);
-      dnnl::layer_normalization_forward ln_fwd_primitive(ln_fwd_pd);
+      OneDnnPrimitiveKeyCreator key_creator("layer_norm_fwd", onednn_engine);
+      key_creator.AddAsKey(src_md);
+      key_creator.AddAsKey(propagation);
+      key_creator.AddAsKey(epsilon_);
+      key_creator.AddAsKey(flags);
+      dnnl::layer_normalization_forward::primitive_desc ln_fwd_pd;
+      dnnl::primitive ln_fwd_primitive;
+      FindOrCreateCachedPrimitive<dnnl::layer_normalization_forward>(
+          key_creator.GetKey(),
+          [&]() {
+            dnnl::layer_normalization_forward::desc ln_fwd_desc(
+                propagation, src_md, epsilon_, flags);
+            dnnl::primitive_attr attr;
+            attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+            return dnnl::layer_normalization_forward::primitive_desc(
+                ln_fwd_desc, attr, onednn_engine);
+          },
+          &ln_fwd_pd, &ln_fwd_primitive);
 
       // Allocate output dst tensor.
       OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
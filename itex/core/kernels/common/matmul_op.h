@@ -201,7 +201,9 @@ template <typename Device, typename T, typename Tout, typename Tpost,
           bool allow_bcast = true>
 class MatMulOp : public OpKernel {
  public:
-  explicit MatMulOp(OpKernelConstruction* context) : OpKernel(context) {
+  explicit MatMulOp(OpKernelConstruction* context)
+      : OpKernel(context),
+        onednn_objects_cache_(GetOneDnnObjectCacheCapacity()) {
     if (context->HasAttr("transpose_a")) {
       OP_REQUIRES_OK(context, context->GetAttr("transpose_a", &adj_x_));
     }
@@ -226,6 +228,15 @@ class MatMulOp : public OpKernel {
         OP_REQUIRES_OK(context, context->GetAttr("leakyrelu_alpha", &alpha));
         post_op_util_.SetLeakyReluAlpha(alpha);
       }
+
+      // Inputs of binary post ops follow the bias or the Mul scale, and the
+      // Add input, in the order of `fused_ops`.
+      binary_start_index_ = kBiasIndex_;
+      if (post_op_util_.HasBias() || post_op_util_.HasOutputScales()) {
+        ++binary_start_index_;
+      }
+      if (post_op_util_.HasAdd()) ++binary_start_index_;
+      binary_mems_.resize(post_op_util_.GetNumBinary());
     }
 
     if (context->HasAttr("inplace_sum")) {
@@ -247,12 +258,41 @@ class MatMulOp : public OpKernel {
   }
 
   void InitOrSetMemory(OpKernelContext* context) {
-    if (!(enable_cache_ && is_init_ && context->is_input_same(0, input_dims_) &&
-          context->is_input_same(1, weights_dims_))) {
+    if (!enable_cache_) {
       Init(context);
       return;
     }
 
+    // Input shapes differ from last execution, switch to the oneDNN objects
+    // prepared for current shapes, or create them if not cached yet.
+    if (!(is_init_ && context->is_input_same(kSrcIndex_, input_dims_) &&
+          context->is_input_same(kWeightIndex_, weights_dims_) &&
+          IsBinaryInputSame(context))) {
+      std::vector<int64> input_dims, weights_dims;
+      context->input_dims(kSrcIndex_, &input_dims);
+      context->input_dims(kWeightIndex_, &weights_dims);
+      CacheKeyCreator key_creator;
+      key_creator.AddAsKey(input_dims);
+      key_creator.AddAsKey(weights_dims);
+      // Binary inputs may be broadcast differently for the same src and weight.
+      for (int i = 0; i < post_op_util_.GetNumBinary(); ++i) {
+        std::vector<int64> binary_dims;
+        context->input_dims(binary_start_index_ + i, &binary_dims);
+        key_creator.AddAsKey(binary_dims);
+      }
+      string key = key_creator.GetKey();
+
+      auto* onednn_objects = onednn_objects_cache_.Find(key);
+      if (onednn_objects == nullptr) {
+        Init(context);
+        if (is_init_ && context->status().ok()) {
+          onednn_objects_cache_.Insert(key, SaveOneDnnObjects());
+        }
+        return;
+      }
+      RestoreOneDnnObjects(*onednn_objects);
+    }
+
     if (is_input_zero_) {
       functor::SetZeroFunctor<Device, Tout> f;
       OP_REQUIRES_OK(context, context->allocate_output(kDstIndex_, dst_shape_,
@@ -277,7 +317,7 @@ class MatMulOp : public OpKernel {
       bias_mem_.set_data_handle(context->tensor_data(kBiasIndex_));
     }
 
-    if (post_op_util_.HasAdd() || post_op_util_.HasBinary()) {
+    if (post_op_util_.HasAdd()) {
       add_tensor_ = &context->input(kAddIndex_);
     }
 
@@ -314,9 +354,9 @@ class MatMulOp : public OpKernel {
       OP_REQUIRES_OK(context, context->allocate_output(kDstIndex_, dst_shape_,
                                                        &dst_tensor_));
     }
-    if (post_op_util_.HasBinary()) {
-      // BatchMatMul + Add needs to set add input md in node execution.
-      add_mem_.set_data_handle(GetTensorBuffer<Tpost>(add_tensor_));
+    for (int i = 0; i < post_op_util_.GetNumBinary(); ++i) {
+      binary_mems_[i].set_data_handle(
+          context->tensor_data(binary_start_index_ + i));
     }
     dst_mem_.set_data_handle(GetTensorBuffer<Tout>(dst_tensor_));
   }
@@ -324,7 +364,9 @@ class MatMulOp : public OpKernel {
   void Init(OpKernelContext* context) {
     const Tensor& src_tensor = context->input(0);
     const Tensor& weights_tensor = context->input(1);
-    fwd_primitive_args_.clear();
+    // Create new oneDNN objects instead of updating the cached ones.
+    fwd_primitive_args_ = std::unordered_map<int, memory>();
+    is_input_zero_ = false;
     auto input_shape = src_tensor.shape();
     input_dims_.clear();
     for (int i = 0; i < input_shape.dims(); ++i) {
@@ -335,6 +377,10 @@ class MatMulOp : public OpKernel {
     for (int i = 0; i < weights_tensor_shape.dims(); ++i) {
       weights_dims_.push_back(weights_tensor_shape.dim_size(i));
     }
+    binary_dims_.resize(post_op_util_.GetNumBinary());
+    for (int i = 0; i < post_op_util_.GetNumBinary(); ++i) {
+      context->input_dims(binary_start_index_ + i, &binary_dims_[i]);
+    }
 
     OP_REQUIRES(context, src_tensor.dims() >= 2,
                 errors::InvalidArgument("In[0] ndims must be >= 2: ",
@@ -463,7 +509,7 @@ class MatMulOp : public OpKernel {
       std::shared_ptr<dnnl::matmul::primitive_desc> matmul_pd_ =
           std::make_shared<dnnl::matmul::primitive_desc>(*matmul_desc_,
                                                          dnnl_engine_);
-      if (post_op_util_.HasAdd() || post_op_util_.HasBinary()) {
+      if (post_op_util_.HasAdd()) {
         add_tensor_ = &context->input(kAddIndex_);
       }
 
@@ -523,31 +569,33 @@ class MatMulOp : public OpKernel {
 
         post_op_util_.SetOutputScale(scales);
       }
-      if (this->post_op_util_.HasBinary()) {
-        // BatchMatMul + Add needs to set add input md in node execution.
-        // const Tensor& add_tensor = context->input(kAddIndex_);
-
-        // Figure out the extended md for primitive execution
-        TensorShape tf_shape = add_tensor_->shape();
-
-        ITEX_CHECK(tf_shape.dims() >= 3)
-            << "Add input of FusedBatchMatMul must have 3 dims at least";
-
-        auto add_dims = TFShapeToOneDnnDims(tf_shape);
-        auto add_strides = CalculateTFStrides(add_dims);
-        auto add_md = memory::desc(add_dims, OneDnnType<Tpost>(), add_strides);
-
-        this->post_op_util_.SetBinaryInput(add_md);
-        add_mem_ = CreateDnnlMemory(add_md, dnnl_engine_,
-                                    GetTensorBuffer<Tpost>(add_tensor_));
-
+      // Binary post ops need to set input md in node execution.
+      for (int i = 0; i < post_op_util_.GetNumBinary(); ++i) {
+        const Tensor& binary_tensor = context->input(binary_start_index_ + i);
+        memory::dims binary_dims;
+        OP_REQUIRES_OK(context,
+                       GetBinaryDims(binary_tensor.shape(), &binary_dims));
+        auto binary_md = memory::desc(binary_dims, OneDnnType<Tpost>(),
+                                      CalculateTFStrides(binary_dims));
+
+        post_op_util_.SetBinaryInput(i, binary_md);
+        binary_mems_[i] =
+            CreateDnnlMemory(binary_md, dnnl_engine_,
+                             GetTensorBuffer<Tpost>(&binary_tensor));
         fwd_primitive_args_.emplace(
-            DNNL_ARG_ATTR_MULTIPLE_POST_OP(0) | DNNL_ARG_SRC_1, add_mem_);
+            DNNL_ARG_ATTR_MULTIPLE_POST_OP(
+                post_op_util_.GetBinaryPostOpIndex(i)) |
+                DNNL_ARG_SRC_1,
+            binary_mems_[i]);
       }
       // Set post ops attr after handling all fusions.
       post_op_util_.SetPostOpAttr(&post_ops_attr);
-      matmul_pd_.reset(new dnnl::matmul::primitive_desc(
-          *matmul_desc_, post_ops_attr, dnnl_engine_));
+      {
+        TraceMe traceme(kOneDnnPrimitiveCreateTraceName,
+                        kOneDnnPrimitiveTraceLevel);
+        matmul_pd_.reset(new dnnl::matmul::primitive_desc(
+            *matmul_desc_, post_ops_attr, dnnl_engine_));
+      }
 
       // Do weight cache only if Reorder is needed and weight is const.
       weights_mem_input_ = CreateDnnlMemory(
@@ -597,7 +645,11 @@ class MatMulOp : public OpKernel {
           dnnl::memory(matmul_pd_->scratchpad_desc(), dnnl_engine_,
                        GetTensorBuffer<T>(scratchpad_tensor_.get()));
 
-      matmul_primitive_ = dnnl::matmul(*matmul_pd_);
+      {
+        TraceMe traceme(kOneDnnPrimitiveCreateTraceName,
+                        kOneDnnPrimitiveTraceLevel);
+        matmul_primitive_ = dnnl::matmul(*matmul_pd_);
+      }
       src_mem_ = CreateDnnlMemory(src_md, dnnl_engine_,
                                   GetTensorBuffer<T>(&src_tensor));
       dst_mem_ = CreateDnnlMemory(dst_md, dnnl_engine_,
@@ -621,6 +673,40 @@ class MatMulOp : public OpKernel {
     }
   }
 
+  // Returns the dims of a binary post op input broadcast to dst. The input is
+  // aligned to the innermost dims of dst like NumPy, so a scalar or a vector
+  // of the last dim is broadcast per tensor or per channel.
+  Status GetBinaryDims(const TensorShape& binary_shape,
+                       memory::dims* binary_dims) {
+    const int dst_dims = dst_shape_.dims();
+    const int offset = dst_dims - binary_shape.dims();
+    if (offset < 0) {
+      return errors::InvalidArgument(
+          "Binary post op input ", binary_shape.DebugString(),
+          " has more dims than output ", dst_shape_.DebugString());
+    }
+    binary_dims->assign(dst_dims, 1);
+    for (int i = 0; i < binary_shape.dims(); ++i) {
+      const int64 dim = binary_shape.dim_size(i);
+      if (dim != 1 && dim != dst_shape_.dim_size(offset + i)) {
+        return errors::InvalidArgument(
+            "Binary post op input ", binary_shape.DebugString(),
+            " can't be broadcast to output ", dst_shape_.DebugString());
+      }
+      (*binary_dims)[offset + i] = dim;
+    }
+    return Status::OK();
+  }
+
+  bool IsBinaryInputSame(OpKernelContext* context) {
+    for (int i = 0; i < post_op_util_.GetNumBinary(); ++i) {
+      if (!context->is_input_same(binary_start_index_ + i, binary_dims_[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   void Compute(OpKernelContext* context) override {
     mutex_lock lock(&mu_compute_);
     dst_tensor_ = nullptr;
@@ -637,7 +723,11 @@ class MatMulOp : public OpKernel {
       return;
     }
 
-    matmul_primitive_.execute(dnnl_stream_, fwd_primitive_args_);
+    {
+      TraceMe traceme(kOneDnnPrimitiveExecuteTraceName,
+                      kOneDnnPrimitiveTraceLevel);
+      matmul_primitive_.execute(dnnl_stream_, fwd_primitive_args_);
+    }
     scratchpad_tensor_.reset();
   }
 
@@ -700,6 +790,8 @@ class MatMulOp : public OpKernel {
   bool is_input_zero_ = false;
   const int kSrcIndex_ = 0, kDstIndex_ = 0, kWeightIndex_ = 1, kBiasIndex_ = 2,
             kAddIndex_ = 3, kMulIndex_ = 2, kUnsuccess_ = -1;
+  // Index of the input of the first binary post op.
+  int binary_start_index_ = kAddIndex_;
 
   // Fusion util.
   PostOpUtil post_op_util_;
@@ -708,10 +800,66 @@ class MatMulOp : public OpKernel {
   WeightCacheManager<T> weight_cache_manager_;
 
  private:
+  // oneDNN objects and TF memory prepared by Init for one pair of input
+  // shapes. Memory objects are handles, so the copies share data handles.
+  struct OneDnnObjects {
+    bool is_input_zero;
+    bool is_weight_reorder;
+    std::unordered_map<int, memory> fwd_primitive_args;
+    memory src_mem, weights_mem, weights_mem_input, dst_mem, bias_mem,
+        fuse_add_src_mem, fuse_add_dst_mem, scratchpad_mem;
+    std::vector<memory> binary_mems;
+    dnnl::matmul matmul_primitive;
+    // Copying an uninitialized Tensor is not allowed, so keep it optional.
+    std::shared_ptr<Tensor> tmp_weight;
+    int64_t scratchpad_size;
+    std::vector<int64> input_dims, weights_dims;
+    std::vector<std::vector<int64>> binary_dims;
+    TensorShape dst_shape;
+  };
+
+  OneDnnObjects SaveOneDnnObjects() {
+    std::shared_ptr<Tensor> tmp_weight;
+    if (tmp_weight_.IsInitialized()) {
+      tmp_weight = std::make_shared<Tensor>(tmp_weight_);
+    }
+    return {is_input_zero_,     is_weight_reorder_, fwd_primitive_args_,
+            src_mem_,           weights_mem_,       weights_mem_input_,
+            dst_mem_,           bias_mem_,          fuse_add_src_mem_,
+            fuse_add_dst_mem_,  scratchpad_mem_,    binary_mems_,
+            matmul_primitive_,  tmp_weight,         scratchpad_size_,
+            input_dims_,        weights_dims_,      binary_dims_,
+            dst_shape_};
+  }
+
+  void RestoreOneDnnObjects(const OneDnnObjects& objects) {
+    is_input_zero_ = objects.is_input_zero;
+    is_weight_reorder_ = objects.is_weight_reorder;
+    fwd_primitive_args_ = objects.fwd_primitive_args;
+    src_mem_ = objects.src_mem;
+    weights_mem_ = objects.weights_mem;
+    weights_mem_input_ = objects.weights_mem_input;
+    dst_mem_ = objects.dst_mem;
+    bias_mem_ = objects.bias_mem;
+    binary_mems_ = objects.binary_mems;
+    fuse_add_src_mem_ = objects.fuse_add_src_mem;
+    fuse_add_dst_mem_ = objects.fuse_add_dst_mem;
+    scratchpad_mem_ = objects.scratchpad_mem;
+    matmul_primitive_ = objects.matmul_primitive;
+    if (objects.tmp_weight) tmp_weight_ = *objects.tmp_weight;
+    scratchpad_size_ = objects.scratchpad_size;
+    input_dims_ = objects.input_dims;
+    weights_dims_ = objects.weights_dims;
+    binary_dims_ = objects.binary_dims;
+    dst_shape_ = objects.dst_shape;
+  }
+
   mutex mul_cache_mu_, mu_compute_;
   std::unordered_map<int, memory> fwd_primitive_args_;
   memory src_mem_, weights_mem_, weights_mem_input_, dst_mem_, bias_mem_,
-      add_mem_, fuse_add_src_mem_, fuse_add_dst_mem_, scratchpad_mem_;
+      fuse_add_src_mem_, fuse_add_dst_mem_, scratchpad_mem_;
+  // Inputs of binary post ops, in the order of `fused_ops`.
+  std::vector<memory> binary_mems_;
   dnnl::matmul matmul_primitive_;
   Tensor* dst_tensor_;
   const Tensor* add_tensor_;
@@ -719,7 +867,10 @@ class MatMulOp : public OpKernel {
   std::shared_ptr<Tensor> scratchpad_tensor_;
   int64_t scratchpad_size_ = 0;
   std::vector<int64> input_dims_, weights_dims_;
+  std::vector<std::vector<int64>> binary_dims_;
   TensorShape dst_shape_;
+  // Prepared oneDNN objects keyed by input shapes, guarded by mu_compute_.
+  LRUCache<OneDnnObjects> onednn_objects_cache_;
   PersistentTensor mul_cached_tensor_ TF_GUARDED_BY(mul_cache_mu_);
   dnnl::fpmath_mode fp32_math_mode_ = dnnl::fpmath_mode::strict;
   dnnl::stream dnnl_stream_;
@@ -56,12 +56,22 @@ class SoftmaxOp : public OpKernel {
       int axis = input_dims - 1;
       auto src_md = CreatePlainMemDescWithFormatTag<T>(src_dims);
 
-      dnnl::primitive_attr attr;
-      attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
-      auto fwd_desc = dnnl::softmax_forward::desc(
-          dnnl::prop_kind::forward_training, src_md, axis);
-      auto fwd_pd =
-          dnnl::softmax_forward::primitive_desc(fwd_desc, attr, onednn_engine);
+      OneDnnPrimitiveKeyCreator key_creator("softmax_fwd", onednn_engine);
+      key_creator.AddAsKey(src_md);
+      key_creator.AddAsKey(axis);
+      dnnl::softmax_forward::primitive_desc fwd_pd;
+      dnnl::primitive softmax_fwd;
+      FindOrCreateCachedPrimitive<dnnl::softmax_forward>(
+          key_creator.GetKey(),
+          [&]() {
+            dnnl::primitive_attr attr;
+            attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+            auto fwd_desc = dnnl::softmax_forward::desc(
+                dnnl::prop_kind::forward_training, src_md, axis);
+            return dnnl::softmax_forward::primitive_desc(fwd_desc, attr,
+                                                         onednn_engine);
+          },
+          &fwd_pd, &softmax_fwd);
       auto src_mem =
           dnnl::memory(src_md, onednn_engine, GetTensorBuffer<T>(&src_tensor));
 
@@ -88,7 +98,6 @@ class SoftmaxOp : public OpKernel {
           dnnl::memory(fwd_pd.scratchpad_desc(), onednn_engine,
                        GetTensorBuffer<T>(&scratchpad_tensor));
 
-      auto softmax_fwd = dnnl::softmax_forward(fwd_pd);
       softmax_fwd.execute(onednn_stream,
                           {
                               {DNNL_ARG_SRC, src_mem},
@@ -62,9 +62,22 @@ class CastOp : public OpKernel {
       src_dims = TFShapeToOneDnnDims(src_tf_shape);
       src_md = CreatePlainMemDescWithFormatTag<SrcT>(src_dims);
       dst_md = CreatePlainMemDescWithFormatTag<DstT>(src_dims);
-      auto reorder_pd = dnnl::reorder::primitive_desc(onednn_engine, src_md,
-                                                      onednn_engine, dst_md);
-      auto reorder_primitive = dnnl::reorder(reorder_pd);
+      OneDnnPrimitiveKeyCreator key_creator("cast_reorder", onednn_engine);
+      key_creator.AddAsKey(src_md);
+      key_creator.AddAsKey(dst_md);
+      dnnl::reorder::primitive_desc reorder_pd;
+      dnnl::primitive reorder_primitive;
+      FindOrCreateCachedPrimitive<dnnl::reorder>(
+          key_creator.GetKey(),
+          [&]() {
+            // Cached primitives may run on several threads at once, so the
+            // scratchpad is owned by each call.
+            dnnl::primitive_attr attr;
+            attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+            return dnnl::reorder::primitive_desc(onednn_engine, src_md,
+                                                 onednn_engine, dst_md, attr);
+          },
+          &reorder_pd, &reorder_primitive);
 
       OneDnnShape output_onednn_shape;
       TensorShape output_tf_shape = src_tf_shape;
@@ -75,9 +88,19 @@ class CastOp : public OpKernel {
                                       GetTensorBuffer<SrcT>(&src_tensor));
       auto dst_mem = CreateDnnlMemory(dst_md, onednn_engine,
                                       GetTensorBuffer<DstT>(dst_tensor));
+      Tensor scratchpad_tensor;
+      int64 scratchpad_size = reorder_pd.scratchpad_desc().get_size();
+      OP_REQUIRES_OK(context, context->allocate_temp(
+                                  DT_UINT8, TensorShape({scratchpad_size}),
+                                  &scratchpad_tensor));
+      auto scratchpad_mem =
+          dnnl::memory(reorder_pd.scratchpad_desc(), onednn_engine,
+                       GetTensorBuffer<uint8>(&scratchpad_tensor));
       dnnl::stream onednn_stream = CreateDnnlStream(*context, onednn_engine);
       std::unordered_map<int, dnnl::memory> reorder_args = {
-          {DNNL_ARG_SRC, src_mem}, {DNNL_ARG_DST, dst_mem}};
+          {DNNL_ARG_SRC, src_mem},
+          {DNNL_ARG_DST, dst_mem},
+          {DNNL_ARG_SCRATCHPAD, scratchpad_mem}};
       reorder_primitive.execute(onednn_stream, reorder_args);
     } catch (dnnl::error& e) {
       string error_msg = "Status: " + std::to_string(e.status) +
@@ -0,0 +1,29 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "itex/core/kernels/common/ctc_loss_op.h"
+
+namespace itex {
+
+#define REGISTER_CPU(T)                                          \
+  REGISTER_KERNEL_BUILDER(                                       \
+      Name("CTCLoss").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      CTCLossOp<T>);
+
+REGISTER_CPU(float);
+#undef REGISTER_CPU
+}  // namespace itex
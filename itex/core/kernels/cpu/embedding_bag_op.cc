@@ -0,0 +1,269 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "itex/core/kernels/gpu/training_op_helpers.h"
+#include "itex/core/utils/errors.h"
+#include "itex/core/utils/op_kernel.h"
+#include "itex/core/utils/op_requires.h"
+#include "itex/core/utils/plugin_tensor.h"
+#include "itex/core/utils/prefetch.h"
+#include "itex/core/utils/register_types.h"
+#include "itex/core/utils/types.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
+namespace itex {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+namespace functor {
+
+// Rows of params fetched ahead of the one being added. Rows are scattered in
+// a large table, so hardware prefetchers can't predict them.
+constexpr int64 kEmbeddingPrefetchDistance = 4;
+
+enum class EmbeddingCombiner { kSum, kMean, kSqrtN };
+
+// Combines the rows of `params` listed in `rows` into one row per bag, where
+// bag i has the rows in [offsets[i], offsets[i + 1]). Bags are computed in
+// parallel, and each one is accumulated in fp32 without writing the gathered
+// rows to memory.
+template <typename T>
+struct EmbeddingBagCPU {
+  void operator()(const CPUDevice& d, const T* params, int64 row_size,
+                  const std::vector<int64>& rows,
+                  const std::vector<int64>& offsets,
+                  EmbeddingCombiner combiner, T* output) {
+    using Row = Eigen::Array<T, Eigen::Dynamic, 1>;
+    const int64 num_bags = offsets.size() - 1;
+    const int64 row_bytes = row_size * sizeof(T);
+    const double rows_per_bag =
+        num_bags > 0 ? static_cast<double>(rows.size()) / num_bags : 0;
+    const Eigen::TensorOpCost cost(
+        rows_per_bag * row_bytes, row_bytes,
+        rows_per_bag * row_size * Eigen::TensorOpCost::AddCost<float>());
+
+    d.parallelFor(num_bags, cost, [&](Eigen::Index first, Eigen::Index last) {
+      Eigen::ArrayXf sum(row_size);
+      for (Eigen::Index bag = first; bag < last; ++bag) {
+        const int64 begin = offsets[bag];
+        const int64 end = offsets[bag + 1];
+        sum.setZero();
+        for (int64 i = begin; i < end; ++i) {
+          if (i + kEmbeddingPrefetchDistance < end) {
+            const char* next = reinterpret_cast<const char*>(
+                params + rows[i + kEmbeddingPrefetchDistance] * row_size);
+            for (int64 b = 0; b < row_bytes; b += 64) {
+              port::prefetch<port::PREFETCH_HINT_T0>(next + b);
+            }
+          }
+          sum += Eigen::Map<const Row>(params + rows[i] * row_size, row_size)
+                     .template cast<float>();
+        }
+
+        const int64 count = end - begin;
+        float scale = 1.0f;
+        if (count > 0 && combiner == EmbeddingCombiner::kMean) {
+          scale = 1.0f / count;
+        } else if (count > 0 && combiner == EmbeddingCombiner::kSqrtN) {
+          scale = 1.0f / std::sqrt(static_cast<float>(count));
+        }
+        Eigen::Map<Row>(output + bag * row_size, row_size) =
+            (sum * scale).template cast<T>();
+      }
+    });
+  }
+};
+
+}  // namespace functor
+
+// Computes the embedding bags of `params`, which is either a tensor or a
+// resource variable. Without segment inputs, `ids` is [bags, bag_size] and
+// each row of it is a bag, like Sum(Gather(params, ids), axis=1). With them,
+// it computes SparseSegmentSum(Gather(params, ids), indices, segment_ids) and
+// its Mean and SqrtN variants.
+template <typename T>
+class EmbeddingBagOp : public OpKernel {
+ public:
+  explicit EmbeddingBagOp(OpKernelConstruction* context) : OpKernel(context) {
+    DataType params_type;
+    OP_REQUIRES_OK(context, context->GetAttr("Tparams", &params_type));
+    is_resource_ = params_type == DT_RESOURCE;
+    OP_REQUIRES_OK(context, context->GetAttr("num_segment_inputs",
+                                             &num_segment_inputs_));
+    OP_REQUIRES(context, num_segment_inputs_ <= 1,
+                errors::InvalidArgument("Expect at most 1 segment input, got ",
+                                        num_segment_inputs_));
+    string combiner;
+    OP_REQUIRES_OK(context, context->GetAttr("combiner", &combiner));
+    if (combiner == "mean") {
+      combiner_ = functor::EmbeddingCombiner::kMean;
+    } else if (combiner == "sqrtn") {
+      combiner_ = functor::EmbeddingCombiner::kSqrtN;
+    } else {
+      combiner_ = functor::EmbeddingCombiner::kSum;
+    }
+  }
+
+  void Compute(OpKernelContext* context) override {
+    if (!is_resource_) {
+      ComputeWithParams(context, context->input(0));
+      return;
+    }
+    // Hold the lock of the variable while reading it, like ResourceGather.
+    auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
+        context, /* do_lock */ true, /* sparse */ true, {0});
+    Tensor params;
+    OP_REQUIRES_OK(context,
+                   GetInputTensorFromVariable<CPUDevice, T>(
+                       context, 0, /* lock_held unused */ true,
+                       /* sparse */ true, &params));
+    ComputeWithParams(context, params);
+  }
+
+ private:
+  // Copies the int32 or int64 tensor `tensor` to `values`.
+  static void ToInt64(const Tensor& tensor, std::vector<int64>* values) {
+    values->resize(tensor.NumElements());
+    if (tensor.dtype() == DT_INT32) {
+      auto flat = tensor.flat<int32>();
+      std::copy(flat.data(), flat.data() + flat.size(), values->begin());
+    } else {
+      auto flat = tensor.flat<int64>();
+      std::copy(flat.data(), flat.data() + flat.size(), values->begin());
+    }
+  }
+
+  void ComputeWithParams(OpKernelContext* context, const Tensor& params) {
+    OP_REQUIRES(context, params.dims() >= 1,
+                errors::InvalidArgument("params must be at least 1 "
+                                        "dimensional, got ",
+                                        params.shape().DebugString()));
+    const Tensor& ids = context->input(1);
+    std::vector<int64> rows;
+    ToInt64(ids, &rows);
+
+    std::vector<int64> offsets;
+    TensorShape output_shape;
+    if (num_segment_inputs_ == 0) {
+      OP_REQUIRES(context, ids.dims() == 2,
+                  errors::InvalidArgument("ids must be 2 dimensional, got ",
+                                          ids.shape().DebugString()));
+      const int64 num_bags = ids.dim_size(0);
+      const int64 bag_size = ids.dim_size(1);
+      offsets.resize(num_bags + 1);
+      for (int64 bag = 0; bag <= num_bags; ++bag) {
+        offsets[bag] = bag * bag_size;
+      }
+      output_shape.AddDim(num_bags);
+    } else {
+      OP_REQUIRES(context, ids.dims() == 1,
+                  errors::InvalidArgument("ids must be a vector, got ",
+                                          ids.shape().DebugString()));
+      const Tensor& indices = context->input(2);
+      const Tensor& segment_ids = context->input(3);
+      OP_REQUIRES(context, TensorShapeUtils::IsVector(indices.shape()),
+                  errors::InvalidArgument("indices should be a vector."));
+      OP_REQUIRES(context, TensorShapeUtils::IsVector(segment_ids.shape()),
+                  errors::InvalidArgument("segment_ids should be a vector."));
+      OP_REQUIRES(context, indices.NumElements() == segment_ids.NumElements(),
+                  errors::InvalidArgument(
+                      "segment_ids and indices should have same size."));
+      std::vector<int64> positions, segments;
+      ToInt64(indices, &positions);
+      ToInt64(segment_ids, &segments);
+
+      // The bags are picked from the gathered rows by `indices`.
+      const int64 num_ids = ids.dim_size(0);
+      std::vector<int64> picked(positions.size());
+      for (size_t i = 0; i < positions.size(); ++i) {
+        OP_REQUIRES(context, positions[i] >= 0 && positions[i] < num_ids,
+                    errors::InvalidArgument("indices[", i, "] = ", positions[i],
+                                            " is out of range [0, ", num_ids,
+                                            ")"));
+        picked[i] = rows[positions[i]];
+      }
+      rows.swap(picked);
+
+      // Check all segment ids before they are used as offsets. Sorted ids
+      // starting from >= 0 are all in [0, num_bags).
+      OP_REQUIRES(context, segments.empty() || segments.front() >= 0,
+                  errors::InvalidArgument("segment ids must be >= 0"));
+      for (size_t i = 1; i < segments.size(); ++i) {
+        OP_REQUIRES(context, segments[i - 1] <= segments[i],
+                    errors::InvalidArgument("segment ids are not increasing"));
+      }
+      const int64 num_bags = segments.empty() ? 0 : segments.back() + 1;
+      offsets.assign(num_bags + 1, 0);
+      for (int64 segment : segments) {
+        ++offsets[segment + 1];
+      }
+      for (int64 bag = 0; bag < num_bags; ++bag) {
+        offsets[bag + 1] += offsets[bag];
+      }
+      output_shape.AddDim(num_bags);
+    }
+
+    const int64 num_rows = params.dim_size(0);
+    int64 row_size = 1;
+    for (int i = 1; i < params.dims(); ++i) {
+      output_shape.AddDim(params.dim_size(i));
+      row_size *= params.dim_size(i);
+    }
+    for (size_t i = 0; i < rows.size(); ++i) {
+      OP_REQUIRES(context, rows[i] >= 0 && rows[i] < num_rows,
+                  errors::InvalidArgument("ids[", i, "] = ", rows[i],
+                                          " is not in [0, ", num_rows, ")"));
+    }
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+
+    // Mean over an empty axis is NaN in the unfused graph. Empty segments of
+    // SparseSegmentMean are 0 instead, which the functor computes.
+    if (num_segment_inputs_ == 0 && rows.empty() &&
+        combiner_ == functor::EmbeddingCombiner::kMean) {
+      output->flat<T>().setConstant(Eigen::NumTraits<T>::quiet_NaN());
+      return;
+    }
+
+    functor::EmbeddingBagCPU<T>()(context->eigen_cpu_device(),
+                                  params.flat<T>().data(), row_size, rows,
+                                  offsets, combiner_,
+                                  output->flat<T>().data());
+  }
+
+  bool is_resource_ = false;
+  int num_segment_inputs_ = 0;
+  functor::EmbeddingCombiner combiner_ = functor::EmbeddingCombiner::kSum;
+};
+
+#define REGISTER_EMBEDDING_BAG_KERNEL(TYPE)               \
+  REGISTER_KERNEL_BUILDER(Name("_ITEXEmbeddingBag")       \
+                              .Device(DEVICE_CPU)         \
+                              .TypeConstraint<TYPE>("T"), \
+                          EmbeddingBagOp<TYPE>);
+
+REGISTER_EMBEDDING_BAG_KERNEL(float);
+REGISTER_EMBEDDING_BAG_KERNEL(Eigen::bfloat16);
+#undef REGISTER_EMBEDDING_BAG_KERNEL
+
+}  // namespace itex
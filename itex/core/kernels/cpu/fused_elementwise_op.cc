@@ -0,0 +1,460 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "itex/core/utils/errors.h"
+#include "itex/core/utils/op_kernel.h"
+#include "itex/core/utils/op_requires.h"
+#include "itex/core/utils/plugin_tensor.h"
+#include "itex/core/utils/register_types.h"
+#include "itex/core/utils/types.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
+namespace itex {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+namespace functor {
+
+// Elements of the output computed at a time. A tile of every input and every
+// op result stays in cache from loading the inputs to storing the output.
+constexpr int64 kElementwiseTileSize = 512;
+
+enum class ElementwiseOpType {
+  kAbs,
+  kCast,
+  kExp,
+  kIdentity,
+  kLog,
+  kNeg,
+  kReciprocal,
+  kRelu,
+  kRelu6,
+  kRsqrt,
+  kSigmoid,
+  kSqrt,
+  kSquare,
+  kTanh,
+  kAdd,
+  kMaximum,
+  kMinimum,
+  kMul,
+  kRealDiv,
+  kSquaredDifference,
+  kSub,
+  kSelect,
+};
+
+struct ElementwiseOpInfo {
+  ElementwiseOpType type;
+  int arity;
+};
+
+const std::unordered_map<string, ElementwiseOpInfo>& GetElementwiseOpInfo() {
+  using Type = ElementwiseOpType;
+  static const auto* info = new std::unordered_map<string, ElementwiseOpInfo>(
+      {{"Abs", {Type::kAbs, 1}},
+       {"Cast", {Type::kCast, 1}},
+       {"Exp", {Type::kExp, 1}},
+       {"Identity", {Type::kIdentity, 1}},
+       {"Log", {Type::kLog, 1}},
+       {"Neg", {Type::kNeg, 1}},
+       {"Reciprocal", {Type::kReciprocal, 1}},
+       {"Relu", {Type::kRelu, 1}},
+       {"Relu6", {Type::kRelu6, 1}},
+       {"Rsqrt", {Type::kRsqrt, 1}},
+       {"Sigmoid", {Type::kSigmoid, 1}},
+       {"Sqrt", {Type::kSqrt, 1}},
+       {"Square", {Type::kSquare, 1}},
+       {"Tanh", {Type::kTanh, 1}},
+       {"Add", {Type::kAdd, 2}},
+       {"AddV2", {Type::kAdd, 2}},
+       {"Maximum", {Type::kMaximum, 2}},
+       {"Minimum", {Type::kMinimum, 2}},
+       {"Mul", {Type::kMul, 2}},
+       {"RealDiv", {Type::kRealDiv, 2}},
+       {"SquaredDifference", {Type::kSquaredDifference, 2}},
+       {"Sub", {Type::kSub, 2}},
+       {"Select", {Type::kSelect, 3}},
+       {"SelectV2", {Type::kSelect, 3}}});
+  return *info;
+}
+
+// One op of the fused chain. Its operands index the values of the chain,
+// which are the inputs followed by the results of the ops.
+struct ElementwiseInstruction {
+  ElementwiseOpType type;
+  int operands[3];
+  // Whether the result is rounded to bfloat16, for a Cast to bfloat16. The
+  // other results are kept in fp32.
+  bool round_to_bfloat16;
+};
+
+// Indexes the inputs broadcast to the output like NumPy. Output dimensions
+// of size 1 are dropped, and adjacent dimensions along which every input is
+// either broadcast or not are merged, so most inputs are read in long
+// contiguous or constant runs.
+class ElementwiseBroadcast {
+ public:
+  // Returns an error if `shapes` can't be broadcast to one shape, which is
+  // returned in `output_shape` otherwise.
+  Status Init(const std::vector<TensorShape>& shapes,
+              TensorShape* output_shape) {
+    int rank = 0;
+    for (const TensorShape& shape : shapes) rank = std::max(rank, shape.dims());
+    std::vector<int64> output_dims(rank, 1);
+    for (const TensorShape& shape : shapes) {
+      for (int i = 0; i < shape.dims(); ++i) {
+        const int64 dim = shape.dim_size(i);
+        int64* output_dim = &output_dims[rank - shape.dims() + i];
+        if (dim == 1 || dim == *output_dim) continue;
+        if (*output_dim != 1) {
+          return errors::InvalidArgument(
+              "Input shape ", shape.DebugString(),
+              " can't be broadcast to size ", *output_dim, " at dimension ", i);
+        }
+        *output_dim = dim;
+      }
+    }
+    *output_shape = TensorShape(output_dims);
+
+    const int num_args = shapes.size();
+    auto is_broadcast = [&](int arg, int i) {
+      const int index = i - (rank - shapes[arg].dims());
+      return index < 0 || shapes[arg].dim_size(index) != output_dims[i];
+    };
+    dims_.clear();
+    std::vector<std::vector<bool>> broadcast(num_args);
+    for (int i = 0; i < rank; ++i) {
+      if (output_dims[i] == 1) continue;
+      bool merge = !dims_.empty();
+      for (int arg = 0; arg < num_args && merge; ++arg) {
+        merge = broadcast[arg].back() == is_broadcast(arg, i);
+      }
+      if (merge) {
+        dims_.back() *= output_dims[i];
+        continue;
+      }
+      dims_.push_back(output_dims[i]);
+      for (int arg = 0; arg < num_args; ++arg) {
+        broadcast[arg].push_back(is_broadcast(arg, i));
+      }
+    }
+    if (dims_.empty()) {
+      dims_.push_back(1);
+      for (int arg = 0; arg < num_args; ++arg) broadcast[arg].push_back(true);
+    }
+
+    strides_.assign(num_args, std::vector<int64>(dims_.size()));
+    for (int arg = 0; arg < num_args; ++arg) {
+      int64 stride = 1;
+      for (int i = dims_.size() - 1; i >= 0; --i) {
+        strides_[arg][i] = broadcast[arg][i] ? 0 : stride;
+        if (!broadcast[arg][i]) stride *= dims_[i];
+      }
+    }
+    return Status::OK();
+  }
+
+  // Copies `size` elements of input `arg` broadcast to the output, from
+  // output element `begin`, to `buffer` in fp32.
+  template <typename T>
+  void Load(const T* data, int arg, int64 begin, int64 size,
+            float* buffer) const {
+    const std::vector<int64>& strides = strides_[arg];
+    const int64 inner_dim = dims_.back();
+    const int64 inner_stride = strides.back();
+    for (int64 done = 0; done < size;) {
+      int64 index = begin + done;
+      const int64 inner_index = index % inner_dim;
+      int64 offset = inner_index * inner_stride;
+      index /= inner_dim;
+      for (int i = dims_.size() - 2; i >= 0 && index > 0; --i) {
+        offset += index % dims_[i] * strides[i];
+        index /= dims_[i];
+      }
+      const int64 count = std::min(inner_dim - inner_index, size - done);
+      auto run = Eigen::Map<Eigen::ArrayXf>(buffer + done, count);
+      if (inner_stride == 0) {
+        run.setConstant(static_cast<float>(data[offset]));
+      } else {
+        run = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>(
+                  data + offset, count)
+                  .template cast<float>();
+      }
+      done += count;
+    }
+  }
+
+ private:
+  std::vector<int64> dims_;
+  // Strides of the inputs along `dims_`, which are 0 if broadcast.
+  std::vector<std::vector<int64>> strides_;
+};
+
+// Copies `size` elements of an input broadcast to the output, from output
+// element `begin`, to an fp32 buffer.
+using ElementwiseLoader =
+    std::function<void(int64 begin, int64 size, float* buffer)>;
+
+// Evaluates the ops on the output one tile at a time. The ops are computed
+// in fp32 on the tiles with Eigen, which vectorizes them.
+template <typename T>
+struct FusedElementwiseCPU {
+  void operator()(const CPUDevice& d,
+                  const std::vector<ElementwiseInstruction>& program,
+                  const std::vector<ElementwiseLoader>& loaders, int64 size,
+                  T* output) {
+    using Type = ElementwiseOpType;
+    const int num_args = loaders.size();
+    const int num_values = num_args + program.size();
+    const int64 num_tiles =
+        (size + kElementwiseTileSize - 1) / kElementwiseTileSize;
+    const Eigen::TensorOpCost cost(
+        kElementwiseTileSize * num_args * sizeof(T),
+        kElementwiseTileSize * sizeof(T),
+        kElementwiseTileSize * program.size() *
+            Eigen::TensorOpCost::MulCost<float>() * 4);
+
+    d.parallelFor(num_tiles, cost, [&](Eigen::Index first, Eigen::Index last) {
+      Eigen::ArrayXXf values(kElementwiseTileSize, num_values);
+      for (Eigen::Index tile = first; tile < last; ++tile) {
+        const int64 begin = tile * kElementwiseTileSize;
+        const int64 n = std::min(kElementwiseTileSize, size - begin);
+        for (int arg = 0; arg < num_args; ++arg) {
+          loaders[arg](begin, n, values.col(arg).data());
+        }
+
+        for (size_t i = 0; i < program.size(); ++i) {
+          const ElementwiseInstruction& op = program[i];
+          auto out = values.col(num_args + i).head(n);
+          auto x = values.col(op.operands[0]).head(n);
+          auto y = values.col(op.operands[1]).head(n);
+          auto z = values.col(op.operands[2]).head(n);
+          switch (op.type) {
+            case Type::kAbs:
+              out = x.abs();
+              break;
+            case Type::kCast:
+            case Type::kIdentity:
+              out = x;
+              break;
+            case Type::kExp:
+              out = x.exp();
+              break;
+            case Type::kLog:
+              out = x.log();
+              break;
+            case Type::kNeg:
+              out = -x;
+              break;
+            case Type::kReciprocal:
+              out = x.inverse();
+              break;
+            case Type::kRelu:
+              out = x.max(0.0f);
+              break;
+            case Type::kRelu6:
+              out = x.max(0.0f).min(6.0f);
+              break;
+            case Type::kRsqrt:
+              out = x.rsqrt();
+              break;
+            case Type::kSigmoid:
+              out = x.logistic();
+              break;
+            case Type::kSqrt:
+              out = x.sqrt();
+              break;
+            case Type::kSquare:
+              out = x.square();
+              break;
+            case Type::kTanh:
+              out = x.tanh();
+              break;
+            case Type::kAdd:
+              out = x + y;
+              break;
+            case Type::kMaximum:
+              out = x.max(y);
+              break;
+            case Type::kMinimum:
+              out = x.min(y);
+              break;
+            case Type::kMul:
+              out = x * y;
+              break;
+            case Type::kRealDiv:
+              out = x / y;
+              break;
+            case Type::kSquaredDifference:
+              out = (x - y).square();
+              break;
+            case Type::kSub:
+              out = x - y;
+              break;
+            case Type::kSelect:
+              out = (x != 0.0f).select(y, z);
+              break;
+          }
+          if (op.round_to_bfloat16) {
+            out = out.template cast<Eigen::bfloat16>().template cast<float>();
+          }
+        }
+
+        Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>>(output + begin, n) =
+            values.col(num_values - 1).head(n).template cast<T>();
+      }
+    });
+  }
+};
+
+}  // namespace functor
+
+template <typename Device, typename T>
+class FusedElementwiseOp : public OpKernel {
+ public:
+  explicit FusedElementwiseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    std::vector<DataType> arg_types;
+    std::vector<string> fused_ops;
+    std::vector<int32> operands;
+    std::vector<DataType> op_types;
+    OP_REQUIRES_OK(context, context->GetAttr("Targs", &arg_types));
+    OP_REQUIRES_OK(context, context->GetAttr("fused_ops", &fused_ops));
+    OP_REQUIRES_OK(context, context->GetAttr("operands", &operands));
+    OP_REQUIRES_OK(context, context->GetAttr("op_types", &op_types));
+    OP_REQUIRES(context, op_types.size() == fused_ops.size(),
+                errors::InvalidArgument("Expected ", fused_ops.size(),
+                                        " op types, got ", op_types.size()));
+    num_args_ = arg_types.size();
+
+    // Ops read the inputs or the results of the ops before them.
+    int num_operands = 0;
+    for (int i = 0; i < static_cast<int>(fused_ops.size()); ++i) {
+      auto it = functor::GetElementwiseOpInfo().find(fused_ops[i]);
+      OP_REQUIRES(context, it != functor::GetElementwiseOpInfo().end(),
+                  errors::Unimplemented("Unsupported elementwise op ",
+                                        fused_ops[i]));
+      const int arity = it->second.arity;
+      OP_REQUIRES(context,
+                  num_operands + arity <= static_cast<int>(operands.size()),
+                  errors::InvalidArgument("Too few operands for ",
+                                          fused_ops[i]));
+      functor::ElementwiseInstruction op;
+      op.type = it->second.type;
+      for (int j = 0; j < 3; ++j) {
+        // Unused operands read the first value, which is never written.
+        op.operands[j] = j < arity ? operands[num_operands + j] : 0;
+        OP_REQUIRES(context,
+                    op.operands[j] >= 0 && op.operands[j] < num_args_ + i,
+                    errors::InvalidArgument("Operand ", op.operands[j],
+                                            " of ", fused_ops[i],
+                                            " is out of range"));
+      }
+      op.round_to_bfloat16 =
+          op.type == functor::ElementwiseOpType::kCast &&
+          op_types[i] == DT_BFLOAT16;
+      program_.push_back(op);
+      num_operands += arity;
+    }
+    OP_REQUIRES(context,
+                !program_.empty() &&
+                    num_operands == static_cast<int>(operands.size()),
+                errors::InvalidArgument("Expected ", num_operands,
+                                        " operands, got ", operands.size()));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    std::vector<TensorShape> shapes;
+    for (int i = 0; i < num_args_; ++i) {
+      shapes.push_back(context->input(i).shape());
+    }
+    functor::ElementwiseBroadcast broadcast;
+    TensorShape output_shape;
+    OP_REQUIRES_OK(context, broadcast.Init(shapes, &output_shape));
+
+    // The output may reuse an input which isn't broadcast, since each tile of
+    // the inputs is loaded before the tile of the output is stored.
+    std::vector<int> candidates;
+    for (int i = 0; i < num_args_; ++i) {
+      if (context->input(i).dtype() == DataTypeToEnum<T>::v() &&
+          shapes[i] == output_shape) {
+        candidates.push_back(i);
+      }
+    }
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
+                                candidates, 0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+
+    std::vector<functor::ElementwiseLoader> loaders;
+    for (int i = 0; i < num_args_; ++i) {
+      const Tensor& input = context->input(i);
+      switch (input.dtype()) {
+        case DT_FLOAT:
+          loaders.push_back(MakeLoader(broadcast, input.flat<float>().data(),
+                                       i));
+          break;
+        case DT_BFLOAT16:
+          loaders.push_back(MakeLoader(
+              broadcast, input.flat<Eigen::bfloat16>().data(), i));
+          break;
+        case DT_BOOL:
+          loaders.push_back(MakeLoader(broadcast, input.flat<bool>().data(),
+                                       i));
+          break;
+        default:
+          OP_REQUIRES(context, false,
+                      errors::InvalidArgument(
+                          "Unsupported input type ",
+                          DataTypeString(input.dtype())));
+      }
+    }
+
+    functor::FusedElementwiseCPU<T>()(context->eigen_cpu_device(), program_,
+                                      loaders, output->NumElements(),
+                                      output->flat<T>().data());
+  }
+
+ private:
+  template <typename U>
+  static functor::ElementwiseLoader MakeLoader(
+      const functor::ElementwiseBroadcast& broadcast, const U* data,
+      int arg) {
+    return [&broadcast, data, arg](int64 begin, int64 size, float* buffer) {
+      broadcast.Load(data, arg, begin, size, buffer);
+    };
+  }
+
+  int num_args_;
+  std::vector<functor::ElementwiseInstruction> program_;
+};
+
+#define REGISTER_KERNEL(TYPE)                             \
+  REGISTER_KERNEL_BUILDER(Name("_ITEXFusedElementwise")   \
+                              .Device(DEVICE_CPU)         \
+                              .TypeConstraint<TYPE>("T"), \
+                          FusedElementwiseOp<CPUDevice, TYPE>);
+TF_CALL_float(REGISTER_KERNEL);
+TF_CALL_bfloat16(REGISTER_KERNEL);
+#undef REGISTER_KERNEL
+
+}  // namespace itex
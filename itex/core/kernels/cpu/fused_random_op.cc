@@ -0,0 +1,116 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_join.h"
+#include "itex/core/kernels/common/random_op.h"
+#include "itex/core/kernels/cpu/random_op_cpu.h"
+#include "itex/core/utils/lib/random/guarded_philox_random.h"
+#include "itex/core/utils/op_kernel.h"
+#include "itex/core/utils/op_requires.h"
+#include "itex/core/utils/plugin_tensor.h"
+#include "itex/core/utils/register_types.h"
+#include "itex/core/utils/types.h"
+
+namespace itex {
+
+// Computes Cast(GreaterEqual(RandomUniform(shape), y)) for a scalar y, which
+// is the keep mask of dropout, without the uniform tensor. With fused Mul ops
+// the mask is applied to args[0], scaled by the scalar args[1] if it exists,
+// so the mask isn't written to memory either.
+template <typename T>
+class FusedRandomOp : public OpKernel {
+ public:
+  explicit FusedRandomOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, generator_.Init(ctx));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("direction", &direction_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("fused_ops", &fused_ops_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_args", &num_args_));
+    const int num_fused_ops = fused_ops_.size();
+    bool is_supported = num_fused_ops == 3 + num_args_ && num_args_ <= 2;
+    for (int i = 3; is_supported && i < num_fused_ops; ++i) {
+      is_supported = fused_ops_[i] == "Mul";
+    }
+    OP_REQUIRES(ctx, is_supported,
+                errors::Unimplemented("Unsupported fusion: [",
+                                      absl::StrJoin(fused_ops_, ","), "]"));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& shape = ctx->input(0);
+    const Tensor& compare = ctx->input(1);
+    OP_REQUIRES(ctx, compare.NumElements() == 1,
+                errors::InvalidArgument("Only support compare dim is 0, got ",
+                                        compare.shape().DebugString()));
+    Tensor* output;
+    const T* input_data = nullptr;
+    const T* scale_data = nullptr;
+    if (num_args_ == 0) {
+      OP_REQUIRES_OK(ctx, AllocateOutputWithShape(ctx, shape, 0, &output));
+    } else {
+      TensorShape output_shape;
+      auto shape_vec = shape.flat<int32>();
+      OP_REQUIRES_OK(ctx,
+                     TensorShapeUtils::MakeShape(
+                         shape_vec.data(), shape_vec.size(), &output_shape));
+      const Tensor& input = ctx->input(2);
+      OP_REQUIRES(ctx, input.shape() == output_shape,
+                  errors::InvalidArgument(
+                      "The mask of shape ", output_shape.DebugString(),
+                      " can't be applied to input of shape ",
+                      input.shape().DebugString()));
+      if (num_args_ == 2) {
+        const Tensor& scale = ctx->input(3);
+        OP_REQUIRES(ctx, scale.NumElements() == 1,
+                    errors::InvalidArgument("scale must be a scalar, got ",
+                                            scale.shape().DebugString()));
+        scale_data = scale.flat<T>().data();
+      }
+      OP_REQUIRES_OK(ctx, ctx->forward_input_or_allocate_output(
+                              {2}, 0, output_shape, &output));
+      input_data = input.flat<T>().data();
+    }
+    auto output_flat = output->flat<T>();
+    functor::FillPhiloxRandomWithComparison<T>()(
+        ctx->eigen_cpu_device(),
+        // Multiplier 256 is the same as in FillPhiloxRandomTask; do not
+        // change it just here.
+        generator_.ReserveRandomOutputs(output_flat.size(), 256),
+        output_flat.data(), output_flat.size(), compare.flat<T>()(0),
+        direction_, input_data, scale_data);
+  }
+
+ private:
+  GuardedPhiloxRandom generator_;
+  int direction_ = 0;
+  int num_args_ = 0;
+  std::vector<string> fused_ops_;
+};
+
+#define REGISTER_FUSED_RANDOM_KERNEL(TYPE)                   \
+  REGISTER_KERNEL_BUILDER(Name("_ITEXFusedRandom")           \
+                              .Device(DEVICE_CPU)            \
+                              .TypeConstraint<int32>("T")    \
+                              .TypeConstraint<TYPE>("DstT"), \
+                          FusedRandomOp<TYPE>);
+
+REGISTER_FUSED_RANDOM_KERNEL(float);
+REGISTER_FUSED_RANDOM_KERNEL(Eigen::bfloat16);
+REGISTER_FUSED_RANDOM_KERNEL(Eigen::half);
+#undef REGISTER_FUSED_RANDOM_KERNEL
+
+}  // namespace itex
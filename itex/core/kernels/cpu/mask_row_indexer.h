@@ -0,0 +1,88 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef ITEX_CORE_KERNELS_CPU_MASK_ROW_INDEXER_H_
+#define ITEX_CORE_KERNELS_CPU_MASK_ROW_INDEXER_H_
+
+#include <vector>
+
+#include "itex/core/utils/errors.h"
+#include "itex/core/utils/status.h"
+#include "itex/core/utils/tensor_shape.h"
+#include "itex/core/utils/types.h"
+
+namespace itex {
+namespace functor {
+
+// Offset of the mask row added to each logits row, for a mask broadcast to
+// the logits shape.
+class MaskRowIndexer {
+ public:
+  // Returns an error if `mask_shape` can't be broadcast to `logits_shape`.
+  Status Init(const TensorShape& logits_shape, const TensorShape& mask_shape) {
+    const int rank = logits_shape.dims();
+    const int mask_rank = mask_shape.dims();
+    if (mask_rank > rank) {
+      return errors::InvalidArgument("Mask ", mask_shape.DebugString(),
+                                     " has more dimensions than logits ",
+                                     logits_shape.DebugString());
+    }
+    int64 mask_stride = 1;
+    row_dims_.assign(rank - 1, 1);
+    mask_strides_.assign(rank - 1, 0);
+    for (int i = rank - 1; i >= 0; --i) {
+      const int mask_index = i - (rank - mask_rank);
+      const int64 mask_dim =
+          mask_index >= 0 ? mask_shape.dim_size(mask_index) : 1;
+      const int64 dim = logits_shape.dim_size(i);
+      if (mask_dim != dim && mask_dim != 1) {
+        return errors::InvalidArgument(
+            "Mask ", mask_shape.DebugString(),
+            " can't be broadcast to logits ", logits_shape.DebugString());
+      }
+      if (i == rank - 1) {
+        broadcast_depth_ = mask_dim == 1;
+      } else {
+        row_dims_[i] = dim;
+        mask_strides_[i] = mask_dim == 1 ? 0 : mask_stride;
+      }
+      mask_stride *= mask_dim;
+    }
+    return Status::OK();
+  }
+
+  int64 MaskRowOffset(int64 row) const {
+    int64 offset = 0;
+    for (int i = static_cast<int>(row_dims_.size()) - 1; i >= 0 && row > 0;
+         --i) {
+      offset += (row % row_dims_[i]) * mask_strides_[i];
+      row /= row_dims_[i];
+    }
+    return offset;
+  }
+
+  // True if the mask has one element per row.
+  bool broadcast_depth() const { return broadcast_depth_; }
+
+ private:
+  std::vector<int64> row_dims_;
+  std::vector<int64> mask_strides_;
+  bool broadcast_depth_ = false;
+};
+
+}  // namespace functor
+}  // namespace itex
+
+#endif  // ITEX_CORE_KERNELS_CPU_MASK_ROW_INDEXER_H_
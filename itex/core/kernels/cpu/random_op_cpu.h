@@ -265,6 +265,73 @@ struct FillPhiloxRandom<CPUDevice, Distribution> {
   }
 };
 
+// Fills `data` with cast(random >= y) if `direction` is 0, or with
+// cast(y >= random) otherwise, where random is the uniform tensor which
+// FillPhiloxRandom generates from `gen`. The groups of samples are sharded as
+// in FillPhiloxRandom and compared a block at a time, so the result is the
+// same as the unfused ops without writing the random tensor to memory.
+//
+// If `input` isn't nullptr, the mask is applied to it as by a following Mul,
+// after scaling it by `*scale` if `scale` isn't nullptr, and `data` is filled
+// with the result. `data` may be `input`.
+template <typename T>
+struct FillPhiloxRandomWithComparison {
+  typedef random::UniformDistribution<random::PhiloxRandom, T> Distribution;
+  static constexpr int kGroupSize = Distribution::kResultElementCount;
+  // Groups of samples generated before they are compared.
+  static constexpr int kBlockGroups = 256;
+
+  void operator()(const CPUDevice& d, random::PhiloxRandom gen, T* data,
+                  int64 size, T y, int direction, const T* input = nullptr,
+                  const T* scale = nullptr) {
+    int64 total_group_count = (size + kGroupSize - 1) / kGroupSize;
+    const int kGroupCost =
+        kGroupSize * (random::PhiloxRandom::kElementCost +
+                      Distribution::kElementCost + 1 +
+                      (input == nullptr ? 0 : 1) + (scale == nullptr ? 0 : 1));
+    d.parallelFor(
+        total_group_count,
+        Eigen::TensorOpCost(input == nullptr ? 0 : kGroupSize * sizeof(T),
+                            kGroupSize * sizeof(T), kGroupCost),
+        [&gen, data, size, y, direction, input, scale](Eigen::Index first,
+                                                       Eigen::Index last) {
+          T samples[kBlockGroups * kGroupSize];
+          Distribution dist;
+          DistributionVec<random::PhiloxRandom, T, Distribution> dist_vec(
+              &dist);
+          random::PhiloxRandom block_gen = gen;
+          block_gen.Skip(first);
+          for (int64 group = first; group < last; group += kBlockGroups) {
+            const int64 limit_group =
+                std::min<int64>(group + kBlockGroups, last);
+            const int64 offset = group * kGroupSize;
+            const int64 block_size =
+                std::min(limit_group * kGroupSize, size) - offset;
+            // The last group may be partial, but is generated whole.
+            for (int64 i = 0; i < block_size; i += kGroupSize) {
+              auto result = dist_vec(&block_gen);
+              std::copy(&result[0], &result[0] + kGroupSize, samples + i);
+            }
+            dist_vec.VecCopy(samples, block_size);
+
+            for (int64 i = 0; i < block_size; ++i) {
+              const bool keep =
+                  direction == 0 ? samples[i] >= y : y >= samples[i];
+              if (input == nullptr) {
+                data[offset + i] = static_cast<T>(keep);
+              } else {
+                // Rounded after each Mul, as the unfused ops are.
+                const T value = scale == nullptr
+                                    ? input[offset + i]
+                                    : T(input[offset + i] * *scale);
+                data[offset + i] = value * static_cast<T>(keep);
+              }
+            }
+          }
+        });
+  }
+};
+
 }  // namespace functor
 
 }  // end namespace itex
@@ -0,0 +1,1064 @@
+/* Copyright (c) 2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "itex/core/kernels/common/rnn_ops.h"
+#include "itex/core/utils/errors.h"
+#include "itex/core/utils/onednn/onednn_util.h"
+#include "itex/core/utils/op_kernel.h"
+#include "itex/core/utils/op_requires.h"
+#include "itex/core/utils/plugin_tensor.h"
+#include "itex/core/utils/register_types.h"
+#include "itex/core/utils/types.h"
+
+using dnnl::memory;
+using dnnl::prop_kind;
+
+namespace itex {
+
+namespace {
+
+// Buffers in the training workspace start at this alignment in bytes.
+constexpr int64 kRnnWorkspaceAlignment = 64;
+
+inline int64 AlignRnnWorkspace(int64 size) {
+  return (size + kRnnWorkspaceAlignment - 1) / kRnnWorkspaceAlignment *
+         kRnnWorkspaceAlignment;
+}
+
+// Memory descs of a single layer left to right RNN over `seq_length` time
+// steps. Weights are format_tag::any to let the primitive choose the layout.
+// Bias and cell states are always f32, which oneDNN requires for bf16.
+struct RnnMemoryDescs {
+  memory::desc src_layer;
+  memory::desc src_iter;
+  memory::desc src_iter_c;
+  memory::desc weights_layer;
+  memory::desc weights_iter;
+  memory::desc weights_projection;
+  memory::desc bias;
+  memory::desc dst_layer;
+  memory::desc dst_iter;
+  memory::desc dst_iter_c;
+
+  void AddToKey(OneDnnPrimitiveKeyCreator* key_creator) const {
+    for (const memory::desc* md :
+         {&src_layer, &src_iter, &src_iter_c, &weights_layer, &weights_iter,
+          &weights_projection, &bias, &dst_layer, &dst_iter, &dst_iter_c}) {
+      key_creator->AddAsKey(*md);
+    }
+  }
+};
+
+template <typename T>
+RnnMemoryDescs GetRnnMemoryDescs(const RnnModelConfig& rmc,
+                                 memory::dim seq_length) {
+  const memory::dim batch_size = rmc.batch_size;
+  const memory::dim input_size = rmc.input_size;
+  const memory::dim output_size = rmc.output_size;
+  const memory::dim num_gates = rmc.num_gates;
+  const memory::dim gate_size = rmc.GateSize();
+  const auto dtype = OneDnnType<T>();
+  const auto f32 = memory::data_type::f32;
+  const auto any = memory::format_tag::any;
+
+  RnnMemoryDescs md;
+  md.src_layer = memory::desc({seq_length, batch_size, input_size}, dtype,
+                              memory::format_tag::tnc);
+  md.src_iter = memory::desc({1, 1, batch_size, output_size}, dtype,
+                             memory::format_tag::ldnc);
+  md.weights_layer =
+      memory::desc({1, 1, input_size, num_gates, gate_size}, dtype, any);
+  md.weights_iter =
+      memory::desc({1, 1, output_size, num_gates, gate_size}, dtype, any);
+  md.bias = memory::desc({1, 1, num_gates, gate_size}, f32,
+                         memory::format_tag::ldgo);
+  md.dst_layer = memory::desc({seq_length, batch_size, output_size}, dtype,
+                              memory::format_tag::tnc);
+  md.dst_iter = md.src_iter;
+  if (rmc.HasInputC()) {
+    md.src_iter_c = memory::desc({1, 1, batch_size, gate_size}, f32,
+                                 memory::format_tag::ldnc);
+    md.dst_iter_c = md.src_iter_c;
+  }
+  if (rmc.HasProjection()) {
+    md.weights_projection =
+        memory::desc({1, 1, gate_size, output_size}, dtype, any);
+  }
+  return md;
+}
+
+// User layout of the params, see RnnCommonKernel::ExtractInput. Offsets are
+// in elements.
+struct RnnParamsLayout {
+  memory::desc weights_layer;
+  memory::desc weights_iter;
+  memory::desc bias;
+  memory::desc weights_projection;
+  int64 weights_iter_offset;
+  int64 bias_offset;
+  int64 weights_projection_offset;
+};
+
+template <typename T>
+RnnParamsLayout GetRnnParamsLayout(const RnnModelConfig& rmc) {
+  const memory::dim input_size = rmc.input_size;
+  const memory::dim output_size = rmc.output_size;
+  const memory::dim num_gates = rmc.num_gates;
+  const memory::dim gate_size = rmc.GateSize();
+  const auto dtype = OneDnnType<T>();
+
+  RnnParamsLayout layout;
+  layout.weights_layer =
+      memory::desc({1, 1, input_size, num_gates, gate_size}, dtype,
+                   memory::format_tag::ldgoi);
+  layout.weights_iter =
+      memory::desc({1, 1, output_size, num_gates, gate_size}, dtype,
+                   memory::format_tag::ldgoi);
+  layout.bias = memory::desc({1, 1, num_gates, gate_size}, dtype,
+                             memory::format_tag::ldgo);
+  if (rmc.HasProjection()) {
+    layout.weights_projection = memory::desc(
+        {1, 1, gate_size, output_size}, dtype, memory::format_tag::ldoi);
+  }
+  layout.weights_iter_offset = num_gates * gate_size * input_size;
+  layout.bias_offset =
+      layout.weights_iter_offset + num_gates * gate_size * output_size;
+  layout.weights_projection_offset = layout.bias_offset + num_gates * gate_size;
+  return layout;
+}
+
+// oneDNN LSTM, whose gates are in the order of i, f, c and o, the same as
+// Keras LSTM.
+struct LstmPrimitives {
+  using Forward = dnnl::lstm_forward;
+  using Backward = dnnl::lstm_backward;
+
+  static const char* Name() { return "lstm"; }
+
+  static Forward::desc ForwardDesc(prop_kind prop, const RnnMemoryDescs& md) {
+    return Forward::desc(prop, dnnl::rnn_direction::unidirectional_left2right,
+                         md.src_layer, md.src_iter, md.src_iter_c,
+                         md.weights_layer, md.weights_iter, memory::desc(),
+                         md.weights_projection, md.bias, md.dst_layer,
+                         md.dst_iter, md.dst_iter_c);
+  }
+
+  // Gradients have the same descs as their forward tensors.
+  static Backward::desc BackwardDesc(const RnnMemoryDescs& md) {
+    return Backward::desc(
+        prop_kind::backward, dnnl::rnn_direction::unidirectional_left2right,
+        md.src_layer, md.src_iter, md.src_iter_c, md.weights_layer,
+        md.weights_iter, memory::desc(), md.weights_projection, md.bias,
+        md.dst_layer, md.dst_iter, md.dst_iter_c, md.src_layer, md.src_iter,
+        md.src_iter_c, md.weights_layer, md.weights_iter, memory::desc(),
+        md.weights_projection, md.bias, md.dst_layer, md.dst_iter,
+        md.dst_iter_c);
+  }
+};
+
+// oneDNN GRU, whose gates are in the order of u, r and o, the same as z, r
+// and h of Keras GRU with reset_after=False.
+struct GruPrimitives {
+  using Forward = dnnl::gru_forward;
+  using Backward = dnnl::gru_backward;
+
+  static const char* Name() { return "gru"; }
+
+  static Forward::desc ForwardDesc(prop_kind prop, const RnnMemoryDescs& md) {
+    return Forward::desc(prop, dnnl::rnn_direction::unidirectional_left2right,
+                         md.src_layer, md.src_iter, md.weights_layer,
+                         md.weights_iter, md.bias, md.dst_layer, md.dst_iter);
+  }
+
+  static Backward::desc BackwardDesc(const RnnMemoryDescs& md) {
+    return Backward::desc(
+        prop_kind::backward, dnnl::rnn_direction::unidirectional_left2right,
+        md.src_layer, md.src_iter, md.weights_layer, md.weights_iter, md.bias,
+        md.dst_layer, md.dst_iter, md.src_layer, md.src_iter, md.weights_layer,
+        md.weights_iter, md.bias, md.dst_layer, md.dst_iter);
+  }
+};
+
+template <typename Cell>
+void GetRnnForwardPrimitive(const dnnl::engine& onednn_engine, prop_kind prop,
+                            const RnnMemoryDescs& md,
+                            typename Cell::Forward::primitive_desc* pd,
+                            dnnl::primitive* primitive) {
+  OneDnnPrimitiveKeyCreator key_creator(string(Cell::Name()) + "_fwd",
+                                        onednn_engine);
+  key_creator.AddAsKey(prop);
+  md.AddToKey(&key_creator);
+  FindOrCreateCachedPrimitive<typename Cell::Forward>(
+      key_creator.GetKey(),
+      [&]() {
+        dnnl::primitive_attr attr;
+        attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+        return typename Cell::Forward::primitive_desc(
+            Cell::ForwardDesc(prop, md), attr, onednn_engine);
+      },
+      pd, primitive);
+}
+
+template <typename Cell>
+void GetRnnBackwardPrimitive(
+    const dnnl::engine& onednn_engine, const RnnMemoryDescs& md,
+    const typename Cell::Forward::primitive_desc& fwd_pd,
+    typename Cell::Backward::primitive_desc* pd, dnnl::primitive* primitive) {
+  OneDnnPrimitiveKeyCreator key_creator(string(Cell::Name()) + "_bwd",
+                                        onednn_engine);
+  md.AddToKey(&key_creator);
+  FindOrCreateCachedPrimitive<typename Cell::Backward>(
+      key_creator.GetKey(),
+      [&]() {
+        dnnl::primitive_attr attr;
+        attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+        return typename Cell::Backward::primitive_desc(
+            Cell::BackwardDesc(md), attr, onednn_engine, fwd_pd);
+      },
+      pd, primitive);
+}
+
+// oneDNN RNN primitives have no variable sequence length, so the time steps
+// are split at every distinct sequence length and each segment is computed by
+// one primitive. Every sequence ends at the end of a segment, where its final
+// states are taken. Ended sequences are still computed by later segments, but
+// their outputs are dropped, and zero gradients flow into them.
+struct RnnSegments {
+  std::vector<int> seq_lengths;
+  // Ends of the segments in increasing order, the first one begins at 0.
+  std::vector<int> ends;
+
+  int size() const { return ends.size(); }
+  int begin(int i) const { return i == 0 ? 0 : ends[i - 1]; }
+  int length(int i) const { return ends[i] - begin(i); }
+  int max_end() const { return ends.empty() ? 0 : ends.back(); }
+};
+
+Status GetRnnSegments(const RnnModelConfig& rmc, const Tensor* seq_lengths,
+                      RnnSegments* segments) {
+  segments->seq_lengths.assign(rmc.batch_size, rmc.max_seq_length);
+  if (rmc.var_seq_length) {
+    auto seq_lengths_flat = seq_lengths->flat<int32>();
+    for (int b = 0; b < rmc.batch_size; ++b) {
+      const int length = seq_lengths_flat(b);
+      if (length < 0 || length > rmc.max_seq_length) {
+        return errors::InvalidArgument("sequence_lengths[", b, "] = ", length,
+                                       " is not in [0, ", rmc.max_seq_length,
+                                       "]");
+      }
+      segments->seq_lengths[b] = length;
+    }
+  }
+
+  segments->ends.clear();
+  for (int length : segments->seq_lengths) {
+    if (length > 0) segments->ends.push_back(length);
+  }
+  std::sort(segments->ends.begin(), segments->ends.end());
+  segments->ends.erase(
+      std::unique(segments->ends.begin(), segments->ends.end()),
+      segments->ends.end());
+  return Status::OK();
+}
+
+// Training workspace of the CPU kernels, in bytes:
+// 1. h_states: (num_segments, batch_size, output_size) of T, hidden states at
+//    the end of each segment.
+// 2. c_states: (num_segments, batch_size, cell_size) of f32, cell states at
+//    the end of each segment, LSTM only.
+// 3. oneDNN workspace of each segment.
+struct RnnWorkspaceLayout {
+  int64 c_states_offset = 0;
+  std::vector<int64> onednn_offsets;
+  int64 size = 0;
+
+  template <typename T>
+  TensorShape Shape() const {
+    const int64 num_elements = (size + sizeof(T) - 1) / sizeof(T);
+    return TensorShape({num_elements});
+  }
+};
+
+template <typename T, typename PrimitiveDesc>
+RnnWorkspaceLayout GetRnnWorkspaceLayout(
+    const RnnModelConfig& rmc, const std::vector<PrimitiveDesc>& fwd_pds) {
+  const int64 num_segments = fwd_pds.size();
+  RnnWorkspaceLayout layout;
+  layout.size = AlignRnnWorkspace(num_segments * rmc.batch_size *
+                                  rmc.output_size * sizeof(T));
+  layout.c_states_offset = layout.size;
+  if (rmc.HasInputC()) {
+    layout.size += AlignRnnWorkspace(num_segments * rmc.batch_size *
+                                     rmc.cell_size * sizeof(float));
+  }
+  for (const auto& pd : fwd_pds) {
+    layout.onednn_offsets.push_back(layout.size);
+    layout.size += AlignRnnWorkspace(pd.workspace_desc().get_size());
+  }
+  return layout;
+}
+
+// A weight of the params and its copy in the layout of the primitive being
+// executed.
+template <typename W>
+struct RnnWeight {
+  memory user;
+  memory prepared;
+  // Holds the reordered weight if it's neither the params nor cached.
+  Tensor buffer;
+};
+
+// Prepares `weight` in `expected_md`. The reorder is skipped if the layout
+// is the same as the last prepared one, and done only once per kernel if
+// `cache` is given.
+template <typename W>
+Status PrepareRnnWeight(OpKernelContext* context,
+                        const dnnl::engine& onednn_engine,
+                        const memory::desc& expected_md,
+                        WeightCacheManager<W>* cache, RnnWeight<W>* weight) {
+  if (weight->prepared && weight->prepared.get_desc() == expected_md) {
+    return Status::OK();
+  }
+
+  if (cache != nullptr) {
+    if (cache->IsEmpty()) {
+      cache->SetCache(context, weight->user.get_desc(), expected_md,
+                      weight->user.get_data_handle(), onednn_engine);
+    }
+    W* cached_data = cache->GetCache(context, expected_md);
+    if (cached_data != nullptr) {
+      weight->prepared =
+          CreateDnnlMemory(expected_md, onednn_engine, cached_data);
+      return Status::OK();
+    }
+  }
+
+  if (weight->user.get_desc() == expected_md) {
+    weight->prepared = weight->user;
+    return Status::OK();
+  }
+  const int64 size = (expected_md.get_size() + sizeof(W) - 1) / sizeof(W);
+  TF_RETURN_IF_ERROR(context->allocate_temp(
+      DataTypeToEnum<W>::v(), TensorShape({size}), &weight->buffer));
+  weight->prepared = CreateDnnlMemory(expected_md, onednn_engine,
+                                      GetTensorBuffer<W>(&weight->buffer));
+  ReorderMemory(*context, &weight->user, &weight->prepared, onednn_engine);
+  return Status::OK();
+}
+
+template <typename T>
+void InitRnnWeights(const dnnl::engine& onednn_engine,
+                    const RnnParamsLayout& layout, T* params_data,
+                    RnnWeight<T>* weights_layer, RnnWeight<T>* weights_iter,
+                    RnnWeight<float>* bias,
+                    RnnWeight<T>* weights_projection) {
+  weights_layer->user =
+      CreateDnnlMemory(layout.weights_layer, onednn_engine, params_data);
+  weights_iter->user =
+      CreateDnnlMemory(layout.weights_iter, onednn_engine,
+                       params_data + layout.weights_iter_offset);
+  bias->user = CreateDnnlMemory(layout.bias, onednn_engine,
+                                params_data + layout.bias_offset);
+  if (!layout.weights_projection.is_zero()) {
+    weights_projection->user =
+        CreateDnnlMemory(layout.weights_projection, onednn_engine,
+                         params_data + layout.weights_projection_offset);
+  }
+}
+
+template <typename T>
+Status AllocateRnnScratchpad(OpKernelContext* context, int64 size_bytes,
+                             Tensor* scratchpad) {
+  const int64 size = (size_bytes + sizeof(T) - 1) / sizeof(T);
+  return context->allocate_temp(DataTypeToEnum<T>::v(), TensorShape({size}),
+                                scratchpad);
+}
+
+Status CheckOneDnnRnnSupport(const RnnModelConfig& rmc) {
+  if (rmc.rnn_mode != RnnMode::kRnnLstm && rmc.rnn_mode != RnnMode::kRnnGru) {
+    return errors::Unimplemented("ItexRnn on CPU only supports lstm and gru");
+  }
+  // Keras applies different dropout masks to the inputs of each gate, which
+  // can't be fused into a single oneDNN primitive.
+  if (rmc.HasDpMask() || rmc.HasRecDpMask()) {
+    return errors::Unimplemented(
+        "ItexRnn on CPU doesn't support dropout and recurrent_dropout");
+  }
+  return Status::OK();
+}
+
+inline void DnnlExceptionToStatus(OpKernelContext* context,
+                                  const dnnl::error& e) {
+  string error_msg = "Status: " + std::to_string(e.status) +
+                     ", message: " + string(e.message) + ", in file " +
+                     string(__FILE__) + ":" + std::to_string(__LINE__);
+  OP_REQUIRES_OK(context, errors::Aborted("Operation received an exception:",
+                                          error_msg));
+}
+
+}  // namespace
+
+// ------------------------------------------------------------------
+// RNN OP
+// ------------------------------------------------------------------
+template <typename T>
+class OneDnnRnnOp : public RnnCommonKernel {
+ public:
+  explicit OneDnnRnnOp(OpKernelConstruction* context)
+      : RnnCommonKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("is_training", &rmc_.is_training));
+    if (context->HasAttr("is_filter_const")) {
+      OP_REQUIRES_OK(context,
+                     context->GetAttr("is_filter_const", &is_filter_const_));
+    }
+  }
+
+  void Compute(OpKernelContext* context) override {
+    try {
+      const Tensor* input = nullptr;
+      const Tensor* input_h = nullptr;
+      const Tensor* input_c = nullptr;
+      const Tensor* params = nullptr;
+      const Tensor* seq_lengths = nullptr;
+      const Tensor* dp_mask = nullptr;
+      const Tensor* rec_dp_mask = nullptr;
+      OP_REQUIRES_OK(context,
+                     ExtractInput(context, &input, &input_h, &input_c, &params,
+                                  &seq_lengths, &dp_mask, &rec_dp_mask));
+      OP_REQUIRES_OK(context, CheckOneDnnRnnSupport(rmc_));
+
+      if (rmc_.rnn_mode == RnnMode::kRnnLstm) {
+        ComputeImpl<LstmPrimitives>(context, input, input_h, input_c, params,
+                                    seq_lengths);
+      } else {
+        ComputeImpl<GruPrimitives>(context, input, input_h, input_c, params,
+                                   seq_lengths);
+      }
+    } catch (dnnl::error& e) {
+      DnnlExceptionToStatus(context, e);
+    }
+  }
+
+ private:
+  template <typename Cell>
+  void ComputeImpl(OpKernelContext* context, const Tensor* input,
+                   const Tensor* input_h, const Tensor* input_c,
+                   const Tensor* params, const Tensor* seq_lengths) {
+    RnnSegments segments;
+    OP_REQUIRES_OK(context, GetRnnSegments(rmc_, seq_lengths, &segments));
+    const int num_segments = segments.size();
+
+    auto onednn_engine = CreateDnnlEngine<CPUDevice>(*context);
+    auto onednn_stream = CreateDnnlStream(*context, onednn_engine);
+    const prop_kind prop = rmc_.is_training ? prop_kind::forward_training
+                                            : prop_kind::forward_inference;
+
+    std::vector<RnnMemoryDescs> mds(num_segments);
+    std::vector<typename Cell::Forward::primitive_desc> pds(num_segments);
+    std::vector<dnnl::primitive> primitives(num_segments);
+    int64 scratchpad_size = 0;
+    for (int i = 0; i < num_segments; ++i) {
+      mds[i] = GetRnnMemoryDescs<T>(rmc_, segments.length(i));
+      GetRnnForwardPrimitive<Cell>(onednn_engine, prop, mds[i], &pds[i],
+                                   &primitives[i]);
+      scratchpad_size =
+          std::max<int64>(scratchpad_size, pds[i].scratchpad_desc().get_size());
+    }
+
+    RnnWorkspaceLayout workspace_layout;
+    if (rmc_.is_training) {
+      workspace_layout = GetRnnWorkspaceLayout<T>(rmc_, pds);
+      rmc_.workspace_shape = workspace_layout.Shape<T>();
+    }
+
+    Tensor* output = nullptr;
+    Tensor* output_h = nullptr;
+    Tensor* output_c = nullptr;
+    Tensor* workspace = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, rmc_.output_shape, &output));
+    OP_REQUIRES_OK(context, context->allocate_output(1, rmc_.hidden_state_shape,
+                                                     &output_h));
+    OP_REQUIRES_OK(
+        context, context->allocate_output(2, rmc_.cell_state_shape, &output_c));
+    OP_REQUIRES_OK(
+        context, context->allocate_output(3, rmc_.workspace_shape, &workspace));
+
+    const int64 batch_size = rmc_.batch_size;
+    const int64 input_size = rmc_.input_size;
+    const int64 output_size = rmc_.output_size;
+    const int64 cell_size = rmc_.cell_size;
+    const int64 h_size = batch_size * output_size;
+    const int64 c_size = batch_size * cell_size;
+    T* input_data = static_cast<T*>(GetTensorBuffer<T>(input));
+    T* input_h_data = static_cast<T*>(GetTensorBuffer<T>(input_h));
+    T* output_data = static_cast<T*>(GetTensorBuffer<T>(output));
+    T* output_h_data = static_cast<T*>(GetTensorBuffer<T>(output_h));
+
+    // Hidden and cell states at the end of each segment. Training keeps all
+    // of them in the workspace for the gradient, inference only needs two.
+    T* h_states = nullptr;
+    float* c_states = nullptr;
+    int num_state_slots = 2;
+    Tensor h_states_tensor, c_states_tensor;
+    if (rmc_.is_training) {
+      char* workspace_data =
+          static_cast<char*>(GetTensorBuffer<T>(workspace));
+      h_states = reinterpret_cast<T*>(workspace_data);
+      c_states = reinterpret_cast<float*>(workspace_data +
+                                          workspace_layout.c_states_offset);
+      num_state_slots = std::max(num_segments, 1);
+    } else {
+      OP_REQUIRES_OK(context, context->allocate_temp(
+                                  DataTypeToEnum<T>::v(),
+                                  TensorShape({2 * h_size}), &h_states_tensor));
+      h_states = static_cast<T*>(GetTensorBuffer<T>(&h_states_tensor));
+      if (rmc_.HasInputC()) {
+        OP_REQUIRES_OK(context, context->allocate_temp(
+                                    DT_FLOAT, TensorShape({2 * c_size}),
+                                    &c_states_tensor));
+        c_states =
+            static_cast<float*>(GetTensorBuffer<float>(&c_states_tensor));
+      }
+    }
+    auto h_state = [&](int i) {
+      return h_states + (i % num_state_slots) * h_size;
+    };
+    auto c_state = [&](int i) {
+      return c_states + (i % num_state_slots) * c_size;
+    };
+
+    // oneDNN takes the initial cell state in f32.
+    Tensor c_init_tensor;
+    float* c_init = nullptr;
+    if (rmc_.HasInputC()) {
+      OP_REQUIRES_OK(context,
+                     context->allocate_temp(DT_FLOAT, TensorShape({c_size}),
+                                            &c_init_tensor));
+      c_init = static_cast<float*>(GetTensorBuffer<float>(&c_init_tensor));
+      auto input_c_flat = input_c->flat<T>();
+      for (int64 j = 0; j < c_size; ++j) {
+        c_init[j] = static_cast<float>(input_c_flat(j));
+      }
+    }
+
+    // Takes the states of the sequences which end at `end` as final states.
+    auto take_final_states = [&](int end, const T* h, const float* c) {
+      for (int b = 0; b < batch_size; ++b) {
+        if (segments.seq_lengths[b] != end) continue;
+        std::copy_n(h + b * output_size, output_size,
+                    output_h_data + b * output_size);
+        if (rmc_.HasInputC()) {
+          auto output_c_flat = output_c->flat<T>();
+          for (int64 j = b * cell_size; j < (b + 1) * cell_size; ++j) {
+            output_c_flat(j) = static_cast<T>(c[j]);
+          }
+        }
+      }
+    };
+    take_final_states(0, input_h_data, c_init);
+
+    const RnnParamsLayout params_layout = GetRnnParamsLayout<T>(rmc_);
+    RnnWeight<T> weights_layer, weights_iter, weights_projection;
+    RnnWeight<float> bias;
+    InitRnnWeights(onednn_engine, params_layout,
+                   static_cast<T*>(GetTensorBuffer<T>(params)), &weights_layer,
+                   &weights_iter, &bias, &weights_projection);
+
+    Tensor scratchpad_tensor;
+    OP_REQUIRES_OK(context, AllocateRnnScratchpad<T>(context, scratchpad_size,
+                                                     &scratchpad_tensor));
+    void* scratchpad_data = GetTensorBuffer<T>(&scratchpad_tensor);
+
+    for (int i = 0; i < num_segments; ++i) {
+      const auto& md = mds[i];
+      const auto& pd = pds[i];
+      const int64 begin = segments.begin(i);
+
+      OP_REQUIRES_OK(context, PrepareRnnWeight(
+                                  context, onednn_engine,
+                                  pd.weights_layer_desc(),
+                                  GetCache(&weights_layer_cache_),
+                                  &weights_layer));
+      OP_REQUIRES_OK(context, PrepareRnnWeight(
+                                  context, onednn_engine,
+                                  pd.weights_iter_desc(),
+                                  GetCache(&weights_iter_cache_),
+                                  &weights_iter));
+      OP_REQUIRES_OK(context,
+                     PrepareRnnWeight(context, onednn_engine, pd.bias_desc(),
+                                      GetCache(&bias_cache_), &bias));
+
+      std::unordered_map<int, memory> args = {
+          {DNNL_ARG_SRC_LAYER,
+           CreateDnnlMemory(md.src_layer, onednn_engine,
+                            input_data + begin * batch_size * input_size)},
+          {DNNL_ARG_SRC_ITER,
+           CreateDnnlMemory(md.src_iter, onednn_engine,
+                            i == 0 ? input_h_data : h_state(i - 1))},
+          {DNNL_ARG_WEIGHTS_LAYER, weights_layer.prepared},
+          {DNNL_ARG_WEIGHTS_ITER, weights_iter.prepared},
+          {DNNL_ARG_BIAS, bias.prepared},
+          {DNNL_ARG_DST_LAYER,
+           CreateDnnlMemory(md.dst_layer, onednn_engine,
+                            output_data + begin * h_size)},
+          {DNNL_ARG_DST_ITER,
+           CreateDnnlMemory(md.dst_iter, onednn_engine, h_state(i))},
+          {DNNL_ARG_SCRATCHPAD,
+           CreateDnnlMemory(pd.scratchpad_desc(), onednn_engine,
+                            scratchpad_data)}};
+      if (rmc_.HasInputC()) {
+        args.insert({DNNL_ARG_SRC_ITER_C,
+                     CreateDnnlMemory(md.src_iter_c, onednn_engine,
+                                      i == 0 ? c_init : c_state(i - 1))});
+        args.insert({DNNL_ARG_DST_ITER_C,
+                     CreateDnnlMemory(md.dst_iter_c, onednn_engine,
+                                      c_state(i))});
+      }
+      if (rmc_.HasProjection()) {
+        OP_REQUIRES_OK(context, PrepareRnnWeight(
+                                    context, onednn_engine,
+                                    pd.weights_projection_desc(),
+                                    GetCache(&weights_projection_cache_),
+                                    &weights_projection));
+        args.insert({DNNL_ARG_WEIGHTS_PROJECTION, weights_projection.prepared});
+      }
+      if (rmc_.is_training) {
+        char* workspace_data =
+            static_cast<char*>(GetTensorBuffer<T>(workspace));
+        args.insert({DNNL_ARG_WORKSPACE,
+                     CreateDnnlMemory(
+                         pd.workspace_desc(), onednn_engine,
+                         workspace_data + workspace_layout.onednn_offsets[i])});
+      }
+
+      primitives[i].execute(onednn_stream, args);
+      onednn_stream.wait();
+      take_final_states(segments.ends[i], h_state(i), c_state(i));
+    }
+
+    // Outputs after the end of each sequence are zero.
+    if (rmc_.var_seq_length) {
+      for (int64 t = 0; t < rmc_.max_seq_length; ++t) {
+        for (int b = 0; b < batch_size; ++b) {
+          if (t < segments.seq_lengths[b]) continue;
+          std::fill_n(output_data + t * h_size + b * output_size, output_size,
+                      T(0));
+        }
+      }
+    }
+  }
+
+  template <typename W>
+  WeightCacheManager<W>* GetCache(WeightCacheManager<W>* cache) {
+    return is_filter_const_ ? cache : nullptr;
+  }
+
+  bool is_filter_const_ = false;
+  WeightCacheManager<T> weights_layer_cache_;
+  WeightCacheManager<T> weights_iter_cache_;
+  WeightCacheManager<T> weights_projection_cache_;
+  WeightCacheManager<float> bias_cache_;
+};
+
+// ------------------------------------------------------------------
+// RNN GRADIENT OP
+// ------------------------------------------------------------------
+template <typename T>
+class OneDnnRnnGradOp : public RnnCommonKernel {
+ public:
+  explicit OneDnnRnnGradOp(OpKernelConstruction* context)
+      : RnnCommonKernel(context) {
+    rmc_.is_training = true;
+  }
+
+  void Compute(OpKernelContext* context) override {
+    try {
+      const Tensor* input = nullptr;
+      const Tensor* input_h = nullptr;
+      const Tensor* input_c = nullptr;
+      const Tensor* params = nullptr;
+      const Tensor* seq_lengths = nullptr;
+      const Tensor* dp_mask = nullptr;
+      const Tensor* rec_dp_mask = nullptr;
+      OP_REQUIRES_OK(context,
+                     ExtractInput(context, &input, &input_h, &input_c, &params,
+                                  &seq_lengths, &dp_mask, &rec_dp_mask));
+      OP_REQUIRES_OK(context, CheckOneDnnRnnSupport(rmc_));
+
+      if (rmc_.rnn_mode == RnnMode::kRnnLstm) {
+        ComputeImpl<LstmPrimitives>(context, input, input_h, input_c, params,
+                                    seq_lengths);
+      } else {
+        ComputeImpl<GruPrimitives>(context, input, input_h, input_c, params,
+                                   seq_lengths);
+      }
+    } catch (dnnl::error& e) {
+      DnnlExceptionToStatus(context, e);
+    }
+  }
+
+ private:
+  template <typename Cell>
+  void ComputeImpl(OpKernelContext* context, const Tensor* input,
+                   const Tensor* input_h, const Tensor* input_c,
+                   const Tensor* params, const Tensor* seq_lengths) {
+    RnnSegments segments;
+    OP_REQUIRES_OK(context, GetRnnSegments(rmc_, seq_lengths, &segments));
+    const int num_segments = segments.size();
+
+    auto onednn_engine = CreateDnnlEngine<CPUDevice>(*context);
+    auto onednn_stream = CreateDnnlStream(*context, onednn_engine);
+
+    std::vector<RnnMemoryDescs> mds(num_segments);
+    std::vector<typename Cell::Forward::primitive_desc> fwd_pds(num_segments);
+    std::vector<typename Cell::Backward::primitive_desc> pds(num_segments);
+    std::vector<dnnl::primitive> primitives(num_segments);
+    int64 scratchpad_size = 0;
+    for (int i = 0; i < num_segments; ++i) {
+      dnnl::primitive fwd_primitive;
+      mds[i] = GetRnnMemoryDescs<T>(rmc_, segments.length(i));
+      GetRnnForwardPrimitive<Cell>(onednn_engine, prop_kind::forward_training,
+                                   mds[i], &fwd_pds[i], &fwd_primitive);
+      GetRnnBackwardPrimitive<Cell>(onednn_engine, mds[i], fwd_pds[i], &pds[i],
+                                    &primitives[i]);
+      scratchpad_size =
+          std::max<int64>(scratchpad_size, pds[i].scratchpad_desc().get_size());
+    }
+    const RnnWorkspaceLayout workspace_layout =
+        GetRnnWorkspaceLayout<T>(rmc_, fwd_pds);
+    rmc_.workspace_shape = workspace_layout.Shape<T>();
+
+    const Tensor* output = nullptr;
+    const Tensor* output_h = nullptr;
+    const Tensor* output_c = nullptr;
+    const Tensor* workspace = nullptr;
+    const Tensor* output_backprop = nullptr;
+    const Tensor* output_h_backprop = nullptr;
+    const Tensor* output_c_backprop = nullptr;
+    OP_REQUIRES_OK(context,
+                   ExtractGradInputs(context, &output, &output_h, &output_c,
+                                     &workspace, &output_backprop,
+                                     &output_h_backprop, &output_c_backprop));
+
+    Tensor* input_backprop = nullptr;
+    Tensor* input_h_backprop = nullptr;
+    Tensor* input_c_backprop = nullptr;
+    Tensor* params_backprop = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, rmc_.input_shape,
+                                                     &input_backprop));
+    OP_REQUIRES_OK(context, context->allocate_output(1, rmc_.hidden_state_shape,
+                                                     &input_h_backprop));
+    OP_REQUIRES_OK(context, context->allocate_output(2, rmc_.cell_state_shape,
+                                                     &input_c_backprop));
+    OP_REQUIRES_OK(context, context->allocate_output(3, rmc_.params_shape,
+                                                     &params_backprop));
+
+    const int64 batch_size = rmc_.batch_size;
+    const int64 input_size = rmc_.input_size;
+    const int64 output_size = rmc_.output_size;
+    const int64 cell_size = rmc_.cell_size;
+    const int64 h_size = batch_size * output_size;
+    const int64 c_size = batch_size * cell_size;
+    const int64 x_size = batch_size * input_size;
+    T* input_data = static_cast<T*>(GetTensorBuffer<T>(input));
+    T* input_h_data = static_cast<T*>(GetTensorBuffer<T>(input_h));
+    T* output_data = static_cast<T*>(GetTensorBuffer<T>(output));
+    T* input_backprop_data =
+        static_cast<T*>(GetTensorBuffer<T>(input_backprop));
+    char* workspace_data = static_cast<char*>(GetTensorBuffer<T>(workspace));
+    T* h_states = reinterpret_cast<T*>(workspace_data);
+    float* c_states = reinterpret_cast<float*>(
+        workspace_data + workspace_layout.c_states_offset);
+
+    // Inputs after the longest sequence get no gradient, the others are
+    // written by the primitives.
+    std::fill(input_backprop_data + segments.max_end() * x_size,
+              input_backprop_data + rmc_.max_seq_length * x_size, T(0));
+
+    Tensor c_init_tensor;
+    float* c_init = nullptr;
+    if (rmc_.HasInputC()) {
+      OP_REQUIRES_OK(context,
+                     context->allocate_temp(DT_FLOAT, TensorShape({c_size}),
+                                            &c_init_tensor));
+      c_init = static_cast<float*>(GetTensorBuffer<float>(&c_init_tensor));
+      auto input_c_flat = input_c->flat<T>();
+      for (int64 j = 0; j < c_size; ++j) {
+        c_init[j] = static_cast<float>(input_c_flat(j));
+      }
+    }
+
+    // Outputs after the end of each sequence are constant zero.
+    T* diff_dst_data = static_cast<T*>(GetTensorBuffer<T>(output_backprop));
+    Tensor masked_diff_dst_tensor;
+    if (rmc_.var_seq_length) {
+      OP_REQUIRES_OK(context,
+                     context->allocate_temp(DataTypeToEnum<T>::v(),
+                                            rmc_.output_shape,
+                                            &masked_diff_dst_tensor));
+      T* masked_data =
+          static_cast<T*>(GetTensorBuffer<T>(&masked_diff_dst_tensor));
+      for (int64 t = 0; t < rmc_.max_seq_length; ++t) {
+        for (int b = 0; b < batch_size; ++b) {
+          const int64 offset = t * h_size + b * output_size;
+          if (t < segments.seq_lengths[b]) {
+            std::copy_n(diff_dst_data + offset, output_size,
+                        masked_data + offset);
+          } else {
+            std::fill_n(masked_data + offset, output_size, T(0));
+          }
+        }
+      }
+      diff_dst_data = masked_data;
+    }
+
+    // Gradients of the hidden and cell states flowing between segments.
+    Tensor diff_h_tensor, diff_c_tensor;
+    OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<T>::v(),
+                                                   TensorShape({2 * h_size}),
+                                                   &diff_h_tensor));
+    T* diff_h = static_cast<T*>(GetTensorBuffer<T>(&diff_h_tensor));
+    std::fill_n(diff_h, 2 * h_size, T(0));
+    float* diff_c = nullptr;
+    if (rmc_.HasInputC()) {
+      OP_REQUIRES_OK(context,
+                     context->allocate_temp(DT_FLOAT, TensorShape({2 * c_size}),
+                                            &diff_c_tensor));
+      diff_c = static_cast<float*>(GetTensorBuffer<float>(&diff_c_tensor));
+      std::fill_n(diff_c, 2 * c_size, 0.0f);
+    }
+    int cur = 0;
+
+    // Adds the gradients of the final states of sequences which end at `end`.
+    auto add_final_state_grads = [&](int end) {
+      auto output_h_backprop_flat = output_h_backprop->flat<T>();
+      for (int b = 0; b < batch_size; ++b) {
+        if (segments.seq_lengths[b] != end) continue;
+        T* dh = diff_h + cur * h_size;
+        for (int64 j = b * output_size; j < (b + 1) * output_size; ++j) {
+          dh[j] += output_h_backprop_flat(j);
+        }
+        if (rmc_.HasInputC()) {
+          auto output_c_backprop_flat = output_c_backprop->flat<T>();
+          float* dc = diff_c + cur * c_size;
+          for (int64 j = b * cell_size; j < (b + 1) * cell_size; ++j) {
+            dc[j] += static_cast<float>(output_c_backprop_flat(j));
+          }
+        }
+      }
+    };
+
+    const RnnParamsLayout params_layout = GetRnnParamsLayout<T>(rmc_);
+    RnnWeight<T> weights_layer, weights_iter, weights_projection;
+    RnnWeight<float> bias;
+    InitRnnWeights(onednn_engine, params_layout,
+                   static_cast<T*>(GetTensorBuffer<T>(params)), &weights_layer,
+                   &weights_iter, &bias, &weights_projection);
+
+    // oneDNN accumulates the weight gradients, so all segments share the
+    // same zero initialized buffers.
+    RnnWeight<T> diff_weights_layer, diff_weights_iter, diff_weights_projection;
+    RnnWeight<float> diff_bias;
+    InitRnnWeights(onednn_engine, params_layout,
+                   static_cast<T*>(GetTensorBuffer<T>(params_backprop)),
+                   &diff_weights_layer, &diff_weights_iter, &diff_bias,
+                   &diff_weights_projection);
+    if (num_segments > 0) {
+      const auto& pd = pds[num_segments - 1];
+      OP_REQUIRES_OK(context, AllocateDiffWeight(context, onednn_engine,
+                                                 pd.diff_weights_layer_desc(),
+                                                 &diff_weights_layer));
+      OP_REQUIRES_OK(context, AllocateDiffWeight(context, onednn_engine,
+                                                 pd.diff_weights_iter_desc(),
+                                                 &diff_weights_iter));
+      OP_REQUIRES_OK(context, AllocateDiffWeight(context, onednn_engine,
+                                                 pd.diff_bias_desc(),
+                                                 &diff_bias));
+      if (rmc_.HasProjection()) {
+        OP_REQUIRES_OK(context,
+                       AllocateDiffWeight(context, onednn_engine,
+                                          pd.diff_weights_projection_desc(),
+                                          &diff_weights_projection));
+      }
+    }
+
+    Tensor scratchpad_tensor;
+    OP_REQUIRES_OK(context, AllocateRnnScratchpad<T>(context, scratchpad_size,
+                                                     &scratchpad_tensor));
+    void* scratchpad_data = GetTensorBuffer<T>(&scratchpad_tensor);
+
+    for (int i = num_segments - 1; i >= 0; --i) {
+      const auto& md = mds[i];
+      const auto& pd = pds[i];
+      const int64 begin = segments.begin(i);
+      const int next = 1 - cur;
+
+      OP_REQUIRES(
+          context,
+          pd.diff_weights_layer_desc() ==
+                  diff_weights_layer.prepared.get_desc() &&
+              pd.diff_weights_iter_desc() ==
+                  diff_weights_iter.prepared.get_desc() &&
+              pd.diff_bias_desc() == diff_bias.prepared.get_desc(),
+          errors::Internal("Layouts of RNN weight gradients differ between "
+                           "sequence segments"));
+      OP_REQUIRES_OK(context,
+                     PrepareRnnWeight<T>(context, onednn_engine,
+                                         pd.weights_layer_desc(), nullptr,
+                                         &weights_layer));
+      OP_REQUIRES_OK(context,
+                     PrepareRnnWeight<T>(context, onednn_engine,
+                                         pd.weights_iter_desc(), nullptr,
+                                         &weights_iter));
+      OP_REQUIRES_OK(context,
+                     PrepareRnnWeight<float>(context, onednn_engine,
+                                             pd.bias_desc(), nullptr, &bias));
+      add_final_state_grads(segments.ends[i]);
+
+      std::unordered_map<int, memory> args = {
+          {DNNL_ARG_SRC_LAYER,
+           CreateDnnlMemory(md.src_layer, onednn_engine,
+                            input_data + begin * x_size)},
+          {DNNL_ARG_SRC_ITER,
+           CreateDnnlMemory(
+               md.src_iter, onednn_engine,
+               i == 0 ? input_h_data : h_states + (i - 1) * h_size)},
+          {DNNL_ARG_WEIGHTS_LAYER, weights_layer.prepared},
+          {DNNL_ARG_WEIGHTS_ITER, weights_iter.prepared},
+          {DNNL_ARG_BIAS, bias.prepared},
+          {DNNL_ARG_DST_LAYER,
+           CreateDnnlMemory(md.dst_layer, onednn_engine,
+                            output_data + begin * h_size)},
+          {DNNL_ARG_DST_ITER, CreateDnnlMemory(md.dst_iter, onednn_engine,
+                                               h_states + i * h_size)},
+          {DNNL_ARG_WORKSPACE,
+           CreateDnnlMemory(
+               pd.workspace_desc(), onednn_engine,
+               workspace_data + workspace_layout.onednn_offsets[i])},
+          {DNNL_ARG_DIFF_SRC_LAYER,
+           CreateDnnlMemory(md.src_layer, onednn_engine,
+                            input_backprop_data + begin * x_size)},
+          {DNNL_ARG_DIFF_SRC_ITER,
+           CreateDnnlMemory(md.src_iter, onednn_engine,
+                            diff_h + next * h_size)},
+          {DNNL_ARG_DIFF_WEIGHTS_LAYER, diff_weights_layer.prepared},
+          {DNNL_ARG_DIFF_WEIGHTS_ITER, diff_weights_iter.prepared},
+          {DNNL_ARG_DIFF_BIAS, diff_bias.prepared},
+          {DNNL_ARG_DIFF_DST_LAYER,
+           CreateDnnlMemory(md.dst_layer, onednn_engine,
+                            diff_dst_data + begin * h_size)},
+          {DNNL_ARG_DIFF_DST_ITER,
+           CreateDnnlMemory(md.dst_iter, onednn_engine,
+                            diff_h + cur * h_size)},
+          {DNNL_ARG_SCRATCHPAD,
+           CreateDnnlMemory(pd.scratchpad_desc(), onednn_engine,
+                            scratchpad_data)}};
+      if (rmc_.HasInputC()) {
+        args.insert({DNNL_ARG_SRC_ITER_C,
+                     CreateDnnlMemory(md.src_iter_c, onednn_engine,
+                                      i == 0 ? c_init
+                                             : c_states + (i - 1) * c_size)});
+        args.insert({DNNL_ARG_DST_ITER_C,
+                     CreateDnnlMemory(md.dst_iter_c, onednn_engine,
+                                      c_states + i * c_size)});
+        args.insert({DNNL_ARG_DIFF_SRC_ITER_C,
+                     CreateDnnlMemory(md.src_iter_c, onednn_engine,
+                                      diff_c + next * c_size)});
+        args.insert({DNNL_ARG_DIFF_DST_ITER_C,
+                     CreateDnnlMemory(md.dst_iter_c, onednn_engine,
+                                      diff_c + cur * c_size)});
+      }
+      if (rmc_.HasProjection()) {
+        OP_REQUIRES(context,
+                    pd.diff_weights_projection_desc() ==
+                        diff_weights_projection.prepared.get_desc(),
+                    errors::Internal("Layouts of RNN weight gradients differ "
+                                     "between sequence segments"));
+        OP_REQUIRES_OK(context,
+                       PrepareRnnWeight<T>(context, onednn_engine,
+                                           pd.weights_projection_desc(),
+                                           nullptr, &weights_projection));
+        args.insert({DNNL_ARG_WEIGHTS_PROJECTION, weights_projection.prepared});
+        args.insert({DNNL_ARG_DIFF_WEIGHTS_PROJECTION,
+                     diff_weights_projection.prepared});
+      }
+
+      primitives[i].execute(onednn_stream, args);
+      onednn_stream.wait();
+      cur = next;
+    }
+    add_final_state_grads(0);
+
+    std::copy_n(diff_h + cur * h_size, h_size,
+                static_cast<T*>(GetTensorBuffer<T>(input_h_backprop)));
+    if (rmc_.HasInputC()) {
+      auto input_c_backprop_flat = input_c_backprop->flat<T>();
+      for (int64 j = 0; j < c_size; ++j) {
+        input_c_backprop_flat(j) = static_cast<T>(diff_c[cur * c_size + j]);
+      }
+    }
+
+    if (num_segments == 0) {
+      params_backprop->flat<T>().setZero();
+      return;
+    }
+    ReorderMemory(*context, &diff_weights_layer.prepared,
+                  &diff_weights_layer.user, onednn_engine);
+    ReorderMemory(*context, &diff_weights_iter.prepared,
+                  &diff_weights_iter.user, onednn_engine);
+    ReorderMemory(*context, &diff_bias.prepared, &diff_bias.user,
+                  onednn_engine);
+    if (rmc_.HasProjection()) {
+      ReorderMemory(*context, &diff_weights_projection.prepared,
+                    &diff_weights_projection.user, onednn_engine);
+    }
+  }
+
+  // Allocates the zero initialized gradient of a weight in `md`.
+  template <typename W>
+  Status AllocateDiffWeight(OpKernelContext* context,
+                            const dnnl::engine& onednn_engine,
+                            const memory::desc& md, RnnWeight<W>* weight) {
+    const int64 size_bytes = md.get_size();
+    const int64 size = (size_bytes + sizeof(W) - 1) / sizeof(W);
+    TF_RETURN_IF_ERROR(context->allocate_temp(
+        DataTypeToEnum<W>::v(), TensorShape({size}), &weight->buffer));
+    void* data = GetTensorBuffer<W>(&weight->buffer);
+    std::memset(data, 0, size_bytes);
+    weight->prepared = CreateDnnlMemory(md, onednn_engine, data);
+    return Status::OK();
+  }
+};
+
+#define REGISTER_CPU(T)                                              \
+  REGISTER_KERNEL_BUILDER(                                           \
+      Name("ItexRnn").Device(DEVICE_CPU).TypeConstraint<T>("T"),     \
+      OneDnnRnnOp<T>);                                               \
+  REGISTER_KERNEL_BUILDER(                                           \
+      Name("ItexRnnGrad").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      OneDnnRnnGradOp<T>);
+
+TF_CALL_CPU_NUMBER_TYPES(REGISTER_CPU);
+#undef REGISTER_CPU
+
+}  // namespace itex
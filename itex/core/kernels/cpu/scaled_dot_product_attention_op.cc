@@ -0,0 +1,308 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+#include "itex/core/kernels/cpu/mask_row_indexer.h"
+#include "itex/core/utils/errors.h"
+#include "itex/core/utils/op_kernel.h"
+#include "itex/core/utils/op_requires.h"
+#include "itex/core/utils/plugin_tensor.h"
+#include "itex/core/utils/register_types.h"
+#include "itex/core/utils/types.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
+namespace itex {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+namespace functor {
+
+using RowMajorMatrix =
+    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+// Rows of the query, and of the key and the value, computed at a time.
+constexpr int64 kQueryBlockSize = 64;
+constexpr int64 kKeyBlockSize = 256;
+
+// A [batch, heads, seq, depth] view of a tensor stored in a layout such as
+// "BSHD", where the letters are the dimensions from the outermost one.
+struct AttentionTensor {
+  int64 batch;
+  int64 heads;
+  int64 seq;
+  int64 depth;
+  int64 batch_stride;
+  int64 head_stride;
+  int64 seq_stride;
+  int64 depth_stride;
+
+  Status Init(const TensorShape& shape, const string& layout) {
+    if (shape.dims() != 4) {
+      return errors::InvalidArgument("Expected a 4-D tensor in ", layout,
+                                     " layout, got ", shape.DebugString());
+    }
+    int64 stride = 1;
+    for (int i = 3; i >= 0; --i) {
+      const int64 dim = shape.dim_size(i);
+      switch (layout[i]) {
+        case 'B':
+          batch = dim;
+          batch_stride = stride;
+          break;
+        case 'H':
+          heads = dim;
+          head_stride = stride;
+          break;
+        case 'S':
+          seq = dim;
+          seq_stride = stride;
+          break;
+        default:
+          depth = dim;
+          depth_stride = stride;
+      }
+      stride *= dim;
+    }
+    return Status::OK();
+  }
+
+  TensorShape Shape(const string& layout) const {
+    TensorShape shape;
+    for (char dim : layout) {
+      if (dim == 'B') {
+        shape.AddDim(batch);
+      } else if (dim == 'H') {
+        shape.AddDim(heads);
+      } else if (dim == 'S') {
+        shape.AddDim(seq);
+      } else {
+        shape.AddDim(depth);
+      }
+    }
+    return shape;
+  }
+
+  int64 Offset(int64 b, int64 h, int64 s) const {
+    return b * batch_stride + h * head_stride + s * seq_stride;
+  }
+};
+
+// Copies `rows` rows of head (b, h) from `begin` to the top of `block`, in
+// fp32.
+template <typename T>
+void LoadRows(const T* data, const AttentionTensor& t, int64 b, int64 h,
+              int64 begin, int64 rows, RowMajorMatrix* block) {
+  using ConstRowMap =
+      Eigen::Map<const Eigen::Matrix<T, 1, Eigen::Dynamic>, Eigen::Unaligned,
+                 Eigen::InnerStride<>>;
+  for (int64 r = 0; r < rows; ++r) {
+    block->row(r) = ConstRowMap(data + t.Offset(b, h, begin + r), t.depth,
+                                Eigen::InnerStride<>(t.depth_stride))
+                        .template cast<float>();
+  }
+}
+
+// Computes softmax(query * key^T * scale + mask) * value with the online
+// softmax: each block of query rows is multiplied by the key and the value
+// one block at a time, and the running max and sum of each row rescale the
+// accumulated output. The [seq, seq] scores of a head are never written to
+// memory, and the blocks are computed in fp32 buffers which stay in cache.
+template <typename T>
+struct ScaledDotProductAttentionCPU {
+  void operator()(const CPUDevice& d, const T* query, const AttentionTensor& q,
+                  const T* key, const AttentionTensor& k, const T* value,
+                  const AttentionTensor& v, float scale, const T* mask,
+                  const MaskRowIndexer& indexer, T* output,
+                  const AttentionTensor& out) {
+    const int64 num_query_blocks =
+        (q.seq + kQueryBlockSize - 1) / kQueryBlockSize;
+    const int64 num_blocks = q.batch * q.heads * num_query_blocks;
+    const int64 block_rows = std::min(q.seq, kQueryBlockSize);
+    const Eigen::TensorOpCost cost(
+        (block_rows * q.depth + k.seq * (k.depth + v.depth)) * sizeof(T),
+        block_rows * v.depth * sizeof(T),
+        block_rows * k.seq *
+            (2 * (q.depth + v.depth) *
+                 Eigen::TensorOpCost::MulCost<float>() +
+             Eigen::internal::functor_traits<
+                 Eigen::internal::scalar_exp_op<float>>::Cost));
+
+    d.parallelFor(num_blocks, cost, [&](Eigen::Index begin, Eigen::Index end) {
+      const float kMinusInf = -std::numeric_limits<float>::infinity();
+      RowMajorMatrix query_block(kQueryBlockSize, q.depth);
+      RowMajorMatrix key_block(kKeyBlockSize, k.depth);
+      RowMajorMatrix value_block(kKeyBlockSize, v.depth);
+      RowMajorMatrix scores(kQueryBlockSize, kKeyBlockSize);
+      RowMajorMatrix accum(kQueryBlockSize, v.depth);
+      Eigen::ArrayXf row_max(kQueryBlockSize);
+      Eigen::ArrayXf row_sum(kQueryBlockSize);
+
+      for (Eigen::Index i = begin; i < end; ++i) {
+        const int64 b = i / (q.heads * num_query_blocks);
+        const int64 h = i / num_query_blocks % q.heads;
+        const int64 query_begin = i % num_query_blocks * kQueryBlockSize;
+        const int64 rows = std::min(kQueryBlockSize, q.seq - query_begin);
+
+        LoadRows(query, q, b, h, query_begin, rows, &query_block);
+        query_block.topRows(rows) *= scale;
+        row_max.head(rows).setConstant(kMinusInf);
+        row_sum.head(rows).setZero();
+        accum.topRows(rows).setZero();
+
+        for (int64 key_begin = 0; key_begin < k.seq;
+             key_begin += kKeyBlockSize) {
+          const int64 cols = std::min(kKeyBlockSize, k.seq - key_begin);
+          LoadRows(key, k, b, h, key_begin, cols, &key_block);
+          LoadRows(value, v, b, h, key_begin, cols, &value_block);
+
+          auto block_scores = scores.topLeftCorner(rows, cols);
+          block_scores.noalias() =
+              query_block.topRows(rows) * key_block.topRows(cols).transpose();
+
+          const int64 scores_row = (b * q.heads + h) * q.seq + query_begin;
+          for (int64 r = 0; r < rows; ++r) {
+            auto row = block_scores.row(r).array();
+            if (mask != nullptr) {
+              const T* mask_row = mask + indexer.MaskRowOffset(scores_row + r);
+              if (indexer.broadcast_depth()) {
+                row += static_cast<float>(*mask_row);
+              } else {
+                row += Eigen::Map<const Eigen::Array<T, 1, Eigen::Dynamic>>(
+                           mask_row + key_begin, cols)
+                           .template cast<float>();
+              }
+            }
+            const float new_max = std::max(row_max(r), row.maxCoeff());
+            // Rows masked out so far have no contribution to rescale.
+            const float base = new_max == kMinusInf ? 0.0f : new_max;
+            row = (row - base).exp();
+            const float correction = std::exp(row_max(r) - base);
+            row_sum(r) = row_sum(r) * correction + row.sum();
+            accum.row(r) *= correction;
+            row_max(r) = new_max;
+          }
+          accum.topRows(rows).noalias() +=
+              block_scores * value_block.topRows(cols);
+        }
+
+        using RowMap =
+            Eigen::Map<Eigen::Matrix<T, 1, Eigen::Dynamic>, Eigen::Unaligned,
+                       Eigen::InnerStride<>>;
+        for (int64 r = 0; r < rows; ++r) {
+          RowMap(output + out.Offset(b, h, query_begin + r), out.depth,
+                 Eigen::InnerStride<>(out.depth_stride)) =
+              (accum.row(r) / row_sum(r)).template cast<T>();
+        }
+      }
+    });
+  }
+};
+
+}  // namespace functor
+
+template <typename Device, typename T>
+class ScaledDotProductAttentionOp : public OpKernel {
+ public:
+  explicit ScaledDotProductAttentionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("query_layout", &query_layout_));
+    OP_REQUIRES_OK(context, context->GetAttr("key_layout", &key_layout_));
+    OP_REQUIRES_OK(context, context->GetAttr("value_layout", &value_layout_));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("output_layout", &output_layout_));
+    int num_masks;
+    OP_REQUIRES_OK(context, context->GetAttr("num_masks", &num_masks));
+    OP_REQUIRES(context, num_masks <= 1,
+                errors::InvalidArgument("Expected at most 1 mask, got ",
+                                        num_masks));
+    has_mask_ = num_masks == 1;
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& query = context->input(0);
+    const Tensor& key = context->input(1);
+    const Tensor& value = context->input(2);
+    const Tensor& scale = context->input(3);
+
+    functor::AttentionTensor q, k, v;
+    OP_REQUIRES_OK(context, q.Init(query.shape(), query_layout_));
+    OP_REQUIRES_OK(context, k.Init(key.shape(), key_layout_));
+    OP_REQUIRES_OK(context, v.Init(value.shape(), value_layout_));
+    OP_REQUIRES(
+        context,
+        q.batch == k.batch && q.batch == v.batch && q.heads == k.heads &&
+            q.heads == v.heads && q.depth == k.depth && k.seq == v.seq,
+        errors::InvalidArgument("Incompatible attention inputs: query ",
+                                query.shape().DebugString(), ", key ",
+                                key.shape().DebugString(), ", value ",
+                                value.shape().DebugString()));
+    OP_REQUIRES(context, scale.NumElements() == 1,
+                errors::InvalidArgument("scale must have 1 element, got ",
+                                        scale.shape().DebugString()));
+
+    functor::MaskRowIndexer indexer;
+    const T* mask = nullptr;
+    if (has_mask_) {
+      const Tensor& mask_tensor = context->input(4);
+      OP_REQUIRES_OK(
+          context,
+          indexer.Init(TensorShape({q.batch, q.heads, q.seq, k.seq}),
+                       mask_tensor.shape()));
+      mask = mask_tensor.flat<T>().data();
+    }
+
+    functor::AttentionTensor out = q;
+    out.depth = v.depth;
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, out.Init(out.Shape(output_layout_),
+                                     output_layout_));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, out.Shape(output_layout_), &output));
+    if (output->NumElements() == 0) return;
+    if (k.seq == 0) {
+      // The product of empty probabilities and value is zero.
+      output->flat<T>().setZero();
+      return;
+    }
+
+    functor::ScaledDotProductAttentionCPU<T>()(
+        context->eigen_cpu_device(), query.flat<T>().data(), q,
+        key.flat<T>().data(), k, value.flat<T>().data(), v,
+        static_cast<float>(scale.flat<T>()(0)), mask, indexer,
+        output->flat<T>().data(), out);
+  }
+
+ private:
+  string query_layout_;
+  string key_layout_;
+  string value_layout_;
+  string output_layout_;
+  bool has_mask_;
+};
+
+#define REGISTER_KERNEL(TYPE)                                    \
+  REGISTER_KERNEL_BUILDER(Name("_ITEXScaledDotProductAttention") \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<TYPE>("T"),        \
+                          ScaledDotProductAttentionOp<CPUDevice, TYPE>);
+TF_CALL_float(REGISTER_KERNEL);
+TF_CALL_bfloat16(REGISTER_KERNEL);
+#undef REGISTER_KERNEL
+
+}  // namespace itex
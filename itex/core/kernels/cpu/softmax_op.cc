@@ -15,7 +15,96 @@ limitations under the License.
 
 #include "itex/core/kernels/common/softmax_op.h"
 
+#include "itex/core/kernels/cpu/mask_row_indexer.h"
+
 namespace itex {
+
+namespace functor {
+
+template <typename T>
+using ConstRowMap = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>;
+template <typename T>
+using RowMap = Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>>;
+
+// Computes softmax(logits + mask) over the last dimension in one pass over
+// the logits. Rows are sharded over the threads, and each row is computed in
+// fp32 in a buffer which stays in cache, so the masked logits are never
+// written to memory.
+template <typename T>
+struct AddV2WithSoftmaxCPU {
+  void operator()(const CPUDevice& d, const T* logits, const T* mask,
+                  const MaskRowIndexer& indexer, int64 num_rows, int64 depth,
+                  T* output) {
+    const Eigen::TensorOpCost cost(
+        2 * depth * sizeof(T), depth * sizeof(T),
+        depth * (3 * Eigen::TensorOpCost::AddCost<float>() +
+                 Eigen::TensorOpCost::MulCost<float>() +
+                 Eigen::internal::functor_traits<
+                     Eigen::internal::scalar_exp_op<float>>::Cost));
+    d.parallelFor(num_rows, cost, [&](Eigen::Index begin, Eigen::Index end) {
+      Eigen::ArrayXf row(depth);
+      for (Eigen::Index i = begin; i < end; ++i) {
+        const auto logits_row =
+            ConstRowMap<T>(logits + i * depth, depth).template cast<float>();
+        const T* mask_row = mask + indexer.MaskRowOffset(i);
+        if (indexer.broadcast_depth()) {
+          row = logits_row + static_cast<float>(*mask_row);
+        } else {
+          row = logits_row +
+                ConstRowMap<T>(mask_row, depth).template cast<float>();
+        }
+        row = (row - row.maxCoeff()).exp();
+        const float scale = 1.0f / row.sum();
+        RowMap<T>(output + i * depth, depth) = (row * scale).template cast<T>();
+      }
+    });
+  }
+};
+
+}  // namespace functor
+
+template <typename Device, typename T>
+class AddV2WithSoftmaxOp : public OpKernel {
+ public:
+  explicit AddV2WithSoftmaxOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    for (int i = 0; i < 2; ++i) {
+      const TensorShape& shape = context->input(i).shape();
+      OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(shape),
+                  errors::InvalidArgument(
+                      "inputs must have >= 1 dimension, got ",
+                      shape.DebugString()));
+    }
+
+    // AddV2 is commutative, so the logits are the input with the shape of the
+    // output, and the other one is the mask broadcast to them. Inputs which
+    // both need broadcasting aren't supported.
+    functor::MaskRowIndexer indexer;
+    int logits_index = 0;
+    if (!indexer.Init(context->input(0).shape(), context->input(1).shape())
+             .ok()) {
+      logits_index = 1;
+      OP_REQUIRES_OK(context, indexer.Init(context->input(1).shape(),
+                                           context->input(0).shape()));
+    }
+    const Tensor& logits = context->input(logits_index);
+    const Tensor& mask = context->input(1 - logits_index);
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
+                                {logits_index}, 0, logits.shape(), &output));
+    if (logits.NumElements() == 0) return;
+
+    const int64 depth = logits.dim_size(logits.dims() - 1);
+    functor::AddV2WithSoftmaxCPU<T>()(
+        context->eigen_cpu_device(), logits.flat<T>().data(),
+        mask.flat<T>().data(), indexer, logits.NumElements() / depth, depth,
+        output->flat<T>().data());
+  }
+};
+
 #define REGISTER_KERNEL(TYPE)                                            \
   REGISTER_KERNEL_BUILDER(                                               \
       Name("_ITEXSoftmax").Device(DEVICE_CPU).TypeConstraint<TYPE>("T"), \
@@ -23,4 +112,13 @@ namespace itex {
 TF_CALL_CPU_NUMBER_TYPES(REGISTER_KERNEL);
 #undef REGISTER_KERNEL
 
+#define REGISTER_KERNEL(TYPE)                                \
+  REGISTER_KERNEL_BUILDER(Name("_ITEXFusedAddV2WithSoftmax") \
+                              .Device(DEVICE_CPU)            \
+                              .TypeConstraint<TYPE>("T"),    \
+                          AddV2WithSoftmaxOp<CPUDevice, TYPE>);
+TF_CALL_float(REGISTER_KERNEL);
+TF_CALL_bfloat16(REGISTER_KERNEL);
+#undef REGISTER_KERNEL
+
 }  // namespace itex
@@ -0,0 +1,423 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "itex/core/kernels/gpu/training_op_helpers.h"
+#include "itex/core/utils/errors.h"
+#include "itex/core/utils/op_kernel.h"
+#include "itex/core/utils/op_requires.h"
+#include "itex/core/utils/plugin_tensor.h"
+#include "itex/core/utils/register_types.h"
+#include "itex/core/utils/types.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
+namespace itex {
+
+namespace functor {
+
+// Optimizer updates are computed in fp32 on blocks of this many elements. A
+// block of the gradient, the slots and the variable stays in L1 from loading
+// to storing, so every tensor is streamed through memory exactly once.
+constexpr int kTrainingBlockSize = 256;
+
+using FloatBlock = Eigen::Array<float, Eigen::Dynamic, 1, Eigen::ColMajor,
+                                kTrainingBlockSize, 1>;
+
+template <typename T>
+using ConstBlockMap = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>;
+template <typename T>
+using BlockMap = Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>>;
+
+template <typename T>
+void LoadBlock(const T* src, Eigen::Index n, FloatBlock* dst) {
+  *dst = ConstBlockMap<T>(src, n).template cast<float>();
+}
+
+template <typename T>
+void StoreBlock(const FloatBlock& src, T* dst) {
+  BlockMap<T>(dst, src.size()) = src.template cast<T>();
+}
+
+// Gradient produced by the fused Mul + AddN prologue:
+//   grad = mul_left * mul_right + addn_input
+// where `mul_right` is a scalar and `addn_input` is optional. Unfused ops use
+// mul_right = 1 and no addn_input.
+template <typename T>
+struct FusedGradient {
+  const T* mul_left;
+  float mul_right;
+  const T* addn_input;
+
+  void Load(Eigen::Index begin, Eigen::Index n, FloatBlock* grad) const {
+    *grad = ConstBlockMap<T>(mul_left + begin, n).template cast<float>() *
+            mul_right;
+    if (addn_input != nullptr) {
+      *grad += ConstBlockMap<T>(addn_input + begin, n).template cast<float>();
+    }
+  }
+
+  int NumInputs() const { return addn_input == nullptr ? 1 : 2; }
+};
+
+// Shards [0, size) over the threads of `d`, and calls `fn(begin, n)` on
+// blocks of at most kTrainingBlockSize elements.
+template <typename Fn>
+void ParallelForBlocks(const CPUDevice& d, Eigen::Index size,
+                       const Eigen::TensorOpCost& cost, const Fn& fn) {
+  d.parallelFor(size, cost, [&fn](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index i = begin; i < end; i += kTrainingBlockSize) {
+      fn(i, std::min<Eigen::Index>(kTrainingBlockSize, end - i));
+    }
+  });
+}
+
+template <typename T>
+struct FusedApplyAdamCPU {
+  void operator()(const CPUDevice& d, T* var, T* m, T* v, float beta1_power,
+                  float beta2_power, float lr, float beta1, float beta2,
+                  float epsilon, float weight_decay, bool use_nesterov,
+                  const FusedGradient<T>& grad, Eigen::Index size) {
+    const float alpha =
+        lr * Eigen::numext::sqrt(1.0f - beta2_power) / (1.0f - beta1_power);
+    const float beta1_sub = 1.0f - beta1;
+    const float beta2_sub = 1.0f - beta2;
+    const float decay = 1.0f - weight_decay * lr;
+
+    const Eigen::TensorOpCost cost(
+        (3 + grad.NumInputs()) * sizeof(T), 3 * sizeof(T),
+        6 * Eigen::TensorOpCost::AddCost<float>() +
+            7 * Eigen::TensorOpCost::MulCost<float>() +
+            Eigen::TensorOpCost::DivCost<float>() +
+            Eigen::internal::functor_traits<
+                Eigen::internal::scalar_sqrt_op<float>>::Cost);
+    ParallelForBlocks(d, size, cost, [&](Eigen::Index begin, Eigen::Index n) {
+      FloatBlock g, m_b, v_b, var_b;
+      grad.Load(begin, n, &g);
+      LoadBlock(m + begin, n, &m_b);
+      LoadBlock(v + begin, n, &v_b);
+      LoadBlock(var + begin, n, &var_b);
+
+      m_b += (g - m_b) * beta1_sub;
+      v_b += (g.square() - v_b) * beta2_sub;
+      if (use_nesterov) {
+        var_b = var_b * decay - ((m_b * beta1 + g * beta1_sub) * alpha) /
+                                    (v_b.sqrt() + epsilon);
+      } else {
+        var_b = var_b * decay - (m_b * alpha) / (v_b.sqrt() + epsilon);
+      }
+
+      StoreBlock(m_b, m + begin);
+      StoreBlock(v_b, v + begin);
+      StoreBlock(var_b, var + begin);
+    });
+  }
+};
+
+template <typename T>
+struct FusedApplyMomentumCPU {
+  void operator()(const CPUDevice& d, T* var, T* accum, float lr,
+                  float momentum, bool use_nesterov,
+                  const FusedGradient<T>& grad, Eigen::Index size) {
+    const Eigen::TensorOpCost cost(
+        (2 + grad.NumInputs()) * sizeof(T), 2 * sizeof(T),
+        4 * Eigen::TensorOpCost::AddCost<float>() +
+            5 * Eigen::TensorOpCost::MulCost<float>());
+    ParallelForBlocks(d, size, cost, [&](Eigen::Index begin, Eigen::Index n) {
+      FloatBlock g, accum_b, var_b;
+      grad.Load(begin, n, &g);
+      LoadBlock(accum + begin, n, &accum_b);
+      LoadBlock(var + begin, n, &var_b);
+
+      accum_b = accum_b * momentum + g;
+      if (use_nesterov) {
+        var_b -= g * lr + accum_b * momentum * lr;
+      } else {
+        var_b -= accum_b * lr;
+      }
+
+      StoreBlock(accum_b, accum + begin);
+      StoreBlock(var_b, var + begin);
+    });
+  }
+};
+
+}  // namespace functor
+
+namespace {
+
+template <typename T>
+float GetScalar(const Tensor& tensor) {
+  return static_cast<float>(tensor.scalar<T>()());
+}
+
+// Returns the tensor and the scalar operand of the fused Mul, which are
+// inputs `index` and `index + 1` in either order.
+Status GetFusedMulInputs(OpKernelContext* ctx, int index, Tensor* tensor,
+                         Tensor* scalar) {
+  const Tensor& left = ctx->input(index);
+  const Tensor& right = ctx->input(index + 1);
+  if (TensorShapeUtils::IsScalar(right.shape())) {
+    *tensor = left;
+    *scalar = right;
+  } else if (TensorShapeUtils::IsScalar(left.shape())) {
+    *tensor = right;
+    *scalar = left;
+  } else {
+    return errors::InvalidArgument("neither of mul's inputs is a scalar: ",
+                                   left.shape().DebugString(), " ",
+                                   right.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+// Handles {Resource}ApplyAdamWithWeightDecay and the remapper's
+// _Fused{Resource}ApplyAdam{WithWeightDecay} on CPU.
+template <typename T, bool with_weight_decay, bool is_fused>
+class FusedApplyAdamOp : public OpKernel {
+ public:
+  explicit FusedApplyAdamOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("use_nesterov", &use_nesterov_));
+    if (is_fused) {
+      std::vector<std::string> fused_ops;
+      int num_addn_inputs;
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("fused_ops", &fused_ops));
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("num_addn_inputs", &num_addn_inputs));
+      // The remapper doesn't fuse AddN into Adam.
+      OP_REQUIRES(
+          ctx,
+          fused_ops.size() == 1 && fused_ops[0] == "Mul" &&
+              num_addn_inputs == 0,
+          errors::Unimplemented("Only Mul + ApplyAdam is implemented"));
+    }
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const bool sparse = false;
+    auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
+        ctx, use_exclusive_lock_, sparse, {0, 1, 2});
+
+    Tensor var;
+    OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
+                            ctx, 0, use_exclusive_lock_, sparse, &var));
+    Tensor m;
+    OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
+                            ctx, 1, use_exclusive_lock_, sparse, &m));
+    Tensor v;
+    OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
+                            ctx, 2, use_exclusive_lock_, sparse, &v));
+    OP_REQUIRES(ctx, var.IsInitialized(),
+                errors::FailedPrecondition(
+                    "Attempting to use uninitialized variables"));
+    OP_REQUIRES(ctx, m.IsInitialized(),
+                errors::FailedPrecondition(
+                    "Attempting to use uninitialized variables"));
+    OP_REQUIRES(ctx, v.IsInitialized(),
+                errors::FailedPrecondition(
+                    "Attempting to use uninitialized variables"));
+
+    static const char* const kScalarNames[] = {
+        "beta1_power", "beta2_power", "lr", "beta1", "beta2", "epsilon",
+        "weight_decay"};
+    const int num_scalars = with_weight_decay ? 7 : 6;
+    for (int i = 0; i < num_scalars; ++i) {
+      const Tensor& scalar = ctx->input(3 + i);
+      OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(scalar.shape()),
+                  errors::InvalidArgument(kScalarNames[i], " is not a scalar: ",
+                                          scalar.shape().DebugString()));
+    }
+
+    const int grad_index = with_weight_decay ? 10 : 9;
+    const float weight_decay =
+        with_weight_decay ? GetScalar<T>(ctx->input(9)) : 0.0f;
+
+    Tensor grad, mul_right;
+    if (is_fused) {
+      OP_REQUIRES_OK(ctx,
+                     GetFusedMulInputs(ctx, grad_index, &grad, &mul_right));
+    } else {
+      grad = ctx->input(grad_index);
+    }
+
+    OP_REQUIRES(ctx, var.shape().IsSameSize(m.shape()),
+                errors::InvalidArgument("var and m do not have the same shape",
+                                        var.shape().DebugString(), " ",
+                                        m.shape().DebugString()));
+    OP_REQUIRES(ctx, var.shape().IsSameSize(v.shape()),
+                errors::InvalidArgument("var and v do not have the same shape",
+                                        var.shape().DebugString(), " ",
+                                        v.shape().DebugString()));
+    OP_REQUIRES(
+        ctx, var.shape().IsSameSize(grad.shape()),
+        errors::InvalidArgument("var and grad do not have the same shape",
+                                var.shape().DebugString(), " ",
+                                grad.shape().DebugString()));
+
+    functor::FusedGradient<T> fused_grad{
+        grad.flat<T>().data(), is_fused ? GetScalar<T>(mul_right) : 1.0f,
+        nullptr};
+
+    functor::FusedApplyAdamCPU<T>()(
+        ctx->eigen_cpu_device(), var.flat<T>().data(), m.flat<T>().data(),
+        v.flat<T>().data(), GetScalar<T>(ctx->input(3)),
+        GetScalar<T>(ctx->input(4)), GetScalar<T>(ctx->input(5)),
+        GetScalar<T>(ctx->input(6)), GetScalar<T>(ctx->input(7)),
+        GetScalar<T>(ctx->input(8)), weight_decay, use_nesterov_, fused_grad,
+        var.NumElements());
+    ctx->forward_ref_input_to_ref_output(0, 0);
+  }
+
+ private:
+  bool use_exclusive_lock_;
+  bool use_nesterov_;
+};
+
+// Handles the remapper's _Fused{Resource}ApplyMomentum on CPU.
+template <typename T>
+class FusedApplyMomentumOp : public OpKernel {
+ public:
+  explicit FusedApplyMomentumOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("use_nesterov", &use_nesterov_));
+
+    std::vector<std::string> fused_ops;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("fused_ops", &fused_ops));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_addn_inputs", &num_addn_inputs_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_mul_inputs", &num_mul_inputs_));
+    const int num_fused_ops = fused_ops.size();
+    OP_REQUIRES(ctx,
+                num_fused_ops == 1 + num_addn_inputs_ &&
+                    fused_ops[0] == "Mul" && num_addn_inputs_ <= 1 &&
+                    num_mul_inputs_ <= 2,
+                errors::Unimplemented(
+                    "Only Mul + (AddN) + ApplyMomentum is implemented"));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const bool sparse = false;
+    auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
+        ctx, use_exclusive_lock_, sparse, {0, 1});
+
+    Tensor var;
+    OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
+                            ctx, 0, use_exclusive_lock_, sparse, &var));
+    Tensor accum;
+    OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
+                            ctx, 1, use_exclusive_lock_, sparse, &accum));
+    OP_REQUIRES(ctx, var.IsInitialized(),
+                errors::FailedPrecondition(
+                    "Attempting to use uninitialized variables"));
+    OP_REQUIRES(ctx, accum.IsInitialized(),
+                errors::FailedPrecondition(
+                    "Attempting to use uninitialized variables"));
+    const Tensor& lr = ctx->input(2);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(lr.shape()),
+                errors::InvalidArgument("lr is not a scalar: ",
+                                        lr.shape().DebugString()));
+    const Tensor& momentum = ctx->input(3);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(momentum.shape()),
+                errors::InvalidArgument("momentum is not a scalar: ",
+                                        momentum.shape().DebugString()));
+
+    // With a single Mul input, the other operand is the variable itself.
+    Tensor mul_left, mul_right;
+    if (num_mul_inputs_ == 1) {
+      mul_left = var;
+      mul_right = ctx->input(4);
+      OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(mul_right.shape()),
+                  errors::InvalidArgument("mul's input is not a scalar: ",
+                                          mul_right.shape().DebugString()));
+    } else {
+      OP_REQUIRES_OK(ctx, GetFusedMulInputs(ctx, 4, &mul_left, &mul_right));
+    }
+
+    OP_REQUIRES(
+        ctx, var.shape().IsSameSize(accum.shape()),
+        errors::InvalidArgument("var and accum do not have the same shape",
+                                var.shape().DebugString(), " ",
+                                accum.shape().DebugString()));
+    OP_REQUIRES(
+        ctx, var.shape().IsSameSize(mul_left.shape()),
+        errors::InvalidArgument("var and mul_left do not have the same shape",
+                                var.shape().DebugString(), " ",
+                                mul_left.shape().DebugString()));
+
+    functor::FusedGradient<T> fused_grad{mul_left.flat<T>().data(),
+                                         GetScalar<T>(mul_right), nullptr};
+    if (num_addn_inputs_ == 1) {
+      const Tensor& addn_input = ctx->input(4 + num_mul_inputs_);
+      OP_REQUIRES(ctx, var.shape().IsSameSize(addn_input.shape()),
+                  errors::InvalidArgument(
+                      "var and addN_input do not have the same shape",
+                      var.shape().DebugString(), " ",
+                      addn_input.shape().DebugString()));
+      fused_grad.addn_input = addn_input.flat<T>().data();
+    }
+
+    functor::FusedApplyMomentumCPU<T>()(
+        ctx->eigen_cpu_device(), var.flat<T>().data(), accum.flat<T>().data(),
+        GetScalar<T>(lr), GetScalar<T>(momentum), use_nesterov_, fused_grad,
+        var.NumElements());
+    ctx->forward_ref_input_to_ref_output(0, 0);
+  }
+
+ private:
+  bool use_exclusive_lock_;
+  bool use_nesterov_;
+  int num_addn_inputs_;
+  int num_mul_inputs_;
+};
+
+#define REGISTER_CPU_KERNELS(T)                                               \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("_FusedApplyAdam").Device(DEVICE_CPU).TypeConstraint<T>("T"),      \
+      FusedApplyAdamOp<T, false, true>);                                      \
+  REGISTER_KERNEL_BUILDER(Name("_FusedResourceApplyAdam")                     \
+                              .Device(DEVICE_CPU)                             \
+                              .TypeConstraint<T>("T"),                        \
+                          FusedApplyAdamOp<T, false, true>);                  \
+  REGISTER_KERNEL_BUILDER(Name("ApplyAdamWithWeightDecay")                    \
+                              .Device(DEVICE_CPU)                             \
+                              .TypeConstraint<T>("T"),                        \
+                          FusedApplyAdamOp<T, true, false>);                  \
+  REGISTER_KERNEL_BUILDER(Name("ResourceApplyAdamWithWeightDecay")            \
+                              .Device(DEVICE_CPU)                             \
+                              .TypeConstraint<T>("T"),                        \
+                          FusedApplyAdamOp<T, true, false>);                  \
+  REGISTER_KERNEL_BUILDER(Name("_FusedApplyAdamWithWeightDecay")              \
+                              .Device(DEVICE_CPU)                             \
+                              .TypeConstraint<T>("T"),                        \
+                          FusedApplyAdamOp<T, true, true>);                   \
+  REGISTER_KERNEL_BUILDER(Name("_FusedResourceApplyAdamWithWeightDecay")      \
+                              .Device(DEVICE_CPU)                             \
+                              .TypeConstraint<T>("T"),                        \
+                          FusedApplyAdamOp<T, true, true>);                   \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("_FusedApplyMomentum").Device(DEVICE_CPU).TypeConstraint<T>("T"),  \
+      FusedApplyMomentumOp<T>);                                               \
+  REGISTER_KERNEL_BUILDER(Name("_FusedResourceApplyMomentum")                 \
+                              .Device(DEVICE_CPU)                             \
+                              .TypeConstraint<T>("T"),                        \
+                          FusedApplyMomentumOp<T>);
+
+TF_CALL_CPU_NUMBER_TYPES(REGISTER_CPU_KERNELS);
+#undef REGISTER_CPU_KERNELS
+
+}  // namespace itex
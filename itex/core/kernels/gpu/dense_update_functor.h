@@ -62,6 +62,7 @@ struct DenseUpdate<CPUDevice, T, SUB> {
   }
 };
 
+#ifndef INTEL_CPU_ONLY
 template <typename T>
 struct DenseUpdate<GPUDevice, T, ASSIGN> {
   void operator()(const GPUDevice& d, typename TTypes<T>::Flat params,
@@ -85,9 +86,11 @@ struct DenseUpdate<GPUDevice, T, SUB> {
     params.device(d) -= update;
   }
 };
+#endif  // INTEL_CPU_ONLY
 
 }  // end namespace functor
 
+#ifndef INTEL_CPU_ONLY
 #define DEFINE_GPU_KERNELS(T)                              \
   template struct functor::DenseUpdate<GPUDevice, T, ADD>; \
   template struct functor::DenseUpdate<GPUDevice, T, SUB>;
@@ -114,6 +117,7 @@ TF_CALL_complex128(DEFINE_GPU_KERNELS);
 #endif  // ITEX_ENABLE_DOUBLE
 
 #undef DEFINE_GPU_KERNELS
+#endif  // INTEL_CPU_ONLY
 
 }  // end namespace itex
 
@@ -18,63 +18,13 @@ limitations under the License.
 #ifndef ITEX_CORE_KERNELS_GPU_RNN_OPS_H_
 #define ITEX_CORE_KERNELS_GPU_RNN_OPS_H_
 
-#include <string>
-
+#include "itex/core/kernels/common/rnn_ops.h"
 #include "itex/core/utils/op_kernel.h"
 #include "itex/core/utils/plugin_tensor.h"
-#include "itex/core/utils/stringprintf.h"
 #include "itex/core/utils/tensor_types.h"
 
 namespace itex {
 
-enum class RnnMode {
-  kRnnRelu = 0,
-  kRnnTanh = 1,
-  kRnnLstm = 2,
-  kRnnGru = 3,
-};
-
-struct RnnModelConfig {
-  // input attribute
-  RnnMode rnn_mode;
-  float dropout;
-  float recurrent_dropout;
-  int num_proj;
-  bool var_seq_length;
-  bool is_training;
-
-  // model shapes
-  int max_seq_length;
-  int batch_size;
-  int input_size;
-  int output_size;
-  int cell_size;
-  int num_gates;
-  TensorShape input_shape;
-  TensorShape output_shape;
-  TensorShape hidden_state_shape;
-  TensorShape cell_state_shape;
-  TensorShape params_shape;
-  TensorShape workspace_shape;
-
-  bool HasInputC() const { return rnn_mode == RnnMode::kRnnLstm; }
-  bool HasDpMask() const { return dropout > 0 && dropout < 1; }
-  bool HasRecDpMask() const {
-    return recurrent_dropout > 0 && recurrent_dropout < 1;
-  }
-
-  string DebugString() const {
-    return strings::Printf(
-        "rnn_mode: %d, dropout: %f, recurrent_dropout: %f, num_proj: %d, "
-        "var_seq_length: %d, is_training: %d\n"
-        "seq_length: %d, batch_size: %d, input_size: %d, output size: %d, "
-        "cell_size: %d, num_gates: %d\n",
-        rnn_mode, dropout, recurrent_dropout, num_proj, var_seq_length,
-        is_training, max_seq_length, batch_size, input_size, output_size,
-        cell_size, num_gates);
-  }
-};
-
 namespace functor {
 
 template <typename Device, typename T>
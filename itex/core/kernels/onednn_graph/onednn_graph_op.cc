@@ -18,7 +18,18 @@ limitations under the License.
 #include "itex/core/devices/gpu/gpu_pool_allocator.h"
 #include "third_party/build_option/dpcpp/runtime/dpcpp_runtime.h"
 #endif  // INTEL_CPU_ONLY
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "itex/core/devices/host_allocator.h"
+#include "itex/core/utils/env_var.h"
 #include "itex/core/utils/errors.h"
+#include "itex/core/utils/lru_cache.h"
+#include "itex/core/utils/mutex.h"
 #include "itex/core/utils/onednn/onednn_graph_util.h"
 #include "itex/core/utils/onednn/onednn_layout_util.h"
 #include "itex/core/utils/op_kernel.h"
@@ -34,12 +45,31 @@ dnnl::graph::stream CreateDnnlStream(
     OpKernelContext* ctx,
     dnnl::graph::engine& engine);  // NOLINT(runtime/references)
 
+void* host_malloc_wrapper(size_t size, size_t alignment) {
+  // Chunks of the BFC allocator are 256 bytes aligned, which covers the
+  // alignment oneDNN Graph asks for.
+  ITEX_DCHECK_LE(alignment, 256);
+  return GetHostBFCAllocator()->AllocateRaw(size);
+}
+
+void host_free_wrapper(void* ptr) { GetHostBFCAllocator()->DeallocateRaw(ptr); }
+
 // Spicialization for CPU
 template <>
 dnnl::graph::engine CreateDnnlEngine<CPUDevice>(OpKernelContext* ctx) {
-  static dnnl::graph::engine cpu_engine(dnnl::graph::engine::kind::cpu, 0);
+  // Scratchpads and temporary tensors of compiled partitions come from the
+  // host BFC allocator if it's enabled.
+  static dnnl::graph::engine cpu_engine =
+      GetHostBFCAllocator() == nullptr
+          ? dnnl::graph::engine(dnnl::graph::engine::kind::cpu, 0)
+          : dnnl::graph::engine(
+                dnnl::graph::engine::kind::cpu, 0,
+                dnnl::graph::allocator(host_malloc_wrapper,
+                                       host_free_wrapper));
   return cpu_engine;
 }
+// TODO(itex): oneDNN Graph is built with its own CPU runtime, so partitions
+// don't run on the Eigen thread pool even with `--config=cpu-threadpool`.
 template <>
 dnnl::graph::stream CreateDnnlStream<CPUDevice>(
     OpKernelContext* ctx,
@@ -76,14 +106,24 @@ void sycl_free_wrapper(void* ptr, const void* device, const void* context,
 }
 
 // Spicialization for GPU
+// Compiled partitions are bound to the engine they are compiled with, so keep
+// one engine per stream to make cached compiled partitions reusable.
 template <>
 dnnl::graph::engine CreateDnnlEngine<GPUDevice>(OpKernelContext* ctx) {
-  auto* queue = ctx->GetDeviceStream();
+  static mutex engine_map_mu;
+  static std::map<DPCPPStream*, dnnl::graph::engine> stream_engine_map;
   static dnnl::graph::allocator allocator =
       dnnl::graph::sycl_interop::make_allocator(sycl_malloc_wrapper,
                                                 sycl_free_wrapper);
+  auto* queue = ctx->GetDeviceStream();
+
+  mutex_lock lock(&engine_map_mu);
+  auto iter = stream_engine_map.find(queue);
+  if (iter != stream_engine_map.end()) return iter->second;
+
   dnnl::graph::engine gpu_engine = dnnl::graph::sycl_interop::make_engine(
       queue->get_device(), queue->get_context(), allocator);
+  stream_engine_map.insert({queue, gpu_engine});
   return gpu_engine;
 }
 
@@ -128,6 +168,103 @@ void GetInplaceIdMap(
   }
 }
 
+// Per-kernel cache of compiled partitions. The key is made of partition id and
+// the input logical tensors (data type, shape, layout and constant property),
+// which fully determine the compilation result since output logical tensors
+// of a kernel only depend on its attributes. So steady-state steps with seen
+// shapes only bind data handles and execute.
+class CompiledPartitionCache {
+ public:
+  // Compiled partition with everything queried from it to bind outputs.
+  struct Entry {
+    dnnl::graph::compiled_partition c_partition;
+    std::vector<dnnl::graph::logical_tensor> output_logical_tensors;
+    std::unordered_map<size_t, size_t> inplace_id_map;  // <output, input>
+
+    explicit Entry(dnnl::graph::compiled_partition cp)
+        : c_partition(std::move(cp)) {}
+  };
+
+  CompiledPartitionCache() : cache_(GetCapacity()) {}
+
+  std::shared_ptr<Entry> FindOrCompile(
+      int partition_id,
+      const std::vector<dnnl::graph::logical_tensor>& l_input_logical_tensor,
+      const std::vector<dnnl::graph::logical_tensor>& l_output_logical_tensor,
+      const dnnl::graph::engine& onednn_engine) TF_LOCKS_EXCLUDED(mu_) {
+    string key = GetKey(partition_id, l_input_logical_tensor);
+    {
+      mutex_lock lock(&mu_);
+      auto* entry = cache_.Find(key);
+      if (entry != nullptr) return *entry;
+    }
+
+    // Compile outside the lock, so kernels hitting other shapes won't be
+    // blocked. Racing compilations of the same key are harmless.
+    auto partition = graph::GetOneDnnGraphPartition(partition_id);
+    auto entry = std::make_shared<Entry>(partition.compile(
+        l_input_logical_tensor, l_output_logical_tensor, onednn_engine));
+    GetInplaceIdMap(entry->c_partition, l_input_logical_tensor,
+                    l_output_logical_tensor, &entry->inplace_id_map);
+    for (auto& lt : l_output_logical_tensor) {
+      entry->output_logical_tensors.push_back(
+          entry->c_partition.query_logical_tensor(lt.get_id()));
+    }
+
+    mutex_lock lock(&mu_);
+    cache_.Insert(key, entry);
+    ITEX_VLOG(2) << "OneDnnGraph partition " << partition_id
+                 << " compiled, cache size: " << cache_.size()
+                 << ", hit: " << cache_.hit_count()
+                 << ", miss: " << cache_.miss_count()
+                 << ", evict: " << cache_.evict_count();
+    return entry;
+  }
+
+  int64 hit_count() TF_LOCKS_EXCLUDED(mu_) {
+    tf_shared_lock lock(&mu_);
+    return cache_.hit_count();
+  }
+
+  int64 miss_count() TF_LOCKS_EXCLUDED(mu_) {
+    tf_shared_lock lock(&mu_);
+    return cache_.miss_count();
+  }
+
+ private:
+  static size_t GetCapacity() {
+    int64 capacity;
+    ITEX_CHECK_OK(ReadInt64FromEnvVar("ITEX_ONEDNN_GRAPH_CACHE_CAPACITY", 64,
+                                      &capacity));
+    return capacity > 0 ? capacity : 1;
+  }
+
+  static string GetKey(
+      int partition_id,
+      const std::vector<dnnl::graph::logical_tensor>& l_input_logical_tensor) {
+    CacheKeyCreator key_creator;
+    key_creator.AddAsKey(partition_id);
+    for (auto& lt : l_input_logical_tensor) {
+      auto layout_type = lt.get_layout_type();
+      key_creator.AddAsKey(lt.get_id());
+      key_creator.AddAsKey(lt.get_data_type());
+      key_creator.AddAsKey(lt.get_dims());
+      key_creator.AddAsKey(lt.get_property_type());
+      key_creator.AddAsKey(layout_type);
+      if (layout_type == dnnl::graph::logical_tensor::layout_type::opaque) {
+        key_creator.AddAsKey(lt.get_layout_id());
+      } else if (layout_type ==
+                 dnnl::graph::logical_tensor::layout_type::strided) {
+        key_creator.AddAsKey(lt.get_strides());
+      }
+    }
+    return key_creator.GetKey();
+  }
+
+  mutex mu_;
+  LRUCache<std::shared_ptr<Entry>> cache_ TF_GUARDED_BY(mu_);
+};
+
 // Currently, LLGA kernels only works with Layout pass ON. Because meta tensor
 // is required to pass the LLGA layout information
 // TODO(itex): Enable LLGA with ITEX plain format.
@@ -158,8 +295,6 @@ class OneDnnGraphOp : public OpKernel {
     dnnl::graph::engine onednn_engine = CreateDnnlEngine<Device>(ctx);
     dnnl::graph::stream onednn_stream =
         CreateDnnlStream<Device>(ctx, onednn_engine);
-    auto partition = std::make_shared<dnnl::graph::partition>(
-        graph::GetOneDnnGraphPartition(partition_id_));
 
     ITEX_CHECK_EQ(input_edge_ids_.size(), is_constant_input_edge_.size());
 
@@ -206,28 +341,29 @@ class OneDnnGraphOp : public OpKernel {
           dnnl::graph::logical_tensor::layout_type::strided));
     }
 
-    auto c_partition = partition->compile(
-        l_input_logical_tensor, l_output_logical_tensor, onednn_engine);
-
-    std::unordered_map<size_t, size_t> inplace_id_map;  // <output_id, input_id>
-    GetInplaceIdMap(c_partition, l_input_logical_tensor,
-                    l_output_logical_tensor, &inplace_id_map);
+    auto compiled = compiled_partition_cache_.FindOrCompile(
+        partition_id_, l_input_logical_tensor, l_output_logical_tensor,
+        onednn_engine);
+    ITEX_VLOG(3) << "compiled partition cache hit: "
+                 << compiled_partition_cache_.hit_count()
+                 << ", miss: " << compiled_partition_cache_.miss_count();
+    const auto& inplace_id_map = compiled->inplace_id_map;
 
     // Prepare output tensors
     for (int index = 0; index < output_edge_ids_.size(); index++) {
       TensorShape tf_shape;
-      auto output_logical_tensor =
-          c_partition.query_logical_tensor(output_edge_ids_[index]);
+      const auto& output_logical_tensor =
+          compiled->output_logical_tensors[index];
       for (int dim : output_logical_tensor.get_dims()) {
         tf_shape.AddDim(dim);
       }
 
       if (inplace_id_map.find(index) != inplace_id_map.end() &&
-          candidate_inplace_input_edge_[inplace_id_map[index]] == true) {
+          candidate_inplace_input_edge_[inplace_id_map.at(index)] == true) {
         // TODO(itex): Check whether LLGA and TensorFlow inplace mechanism
         // are exacly the same
 
-        int input_index = inplace_id_map[index];
+        int input_index = inplace_id_map.at(index);
         const Tensor& input_tensor = ctx->input(input_index);
 
         if (input_tensor.dtype() != ctx->expected_output_dtype(index)) {
@@ -257,7 +393,8 @@ class OneDnnGraphOp : public OpKernel {
     }
 
     // Execute
-    c_partition.execute(onednn_stream, l_input_tensor, l_output_tensor);
+    compiled->c_partition.execute(onednn_stream, l_input_tensor,
+                                  l_output_tensor);
     ITEX_VLOG(3) << "PARTITION EXECUTED SUCCESSFULLY";
   }
 
@@ -269,6 +406,7 @@ class OneDnnGraphOp : public OpKernel {
   std::vector<bool> is_constant_input_edge_;
   std::vector<bool> candidate_inplace_input_edge_;
   std::vector<string> framework_ops_;
+  CompiledPartitionCache compiled_partition_cache_;
 };
 
 #define MATCH_TYPE_AND_SIZE(TYPE) \
@@ -322,8 +460,6 @@ class OneDnnGraphWithLayoutOp : public OpKernel {
     dnnl::graph::engine onednn_engine = CreateDnnlEngine<Device>(ctx);
     dnnl::graph::stream onednn_stream =
         CreateDnnlStream<Device>(ctx, onednn_engine);
-    auto partition = std::make_shared<dnnl::graph::partition>(
-        graph::GetOneDnnGraphPartition(partition_id_));
 
     ITEX_CHECK_EQ(input_edge_ids_.size(), is_constant_input_edge_.size());
 
@@ -394,17 +530,18 @@ class OneDnnGraphWithLayoutOp : public OpKernel {
             dnnl::graph::logical_tensor::layout_type::any));
     }
 
-    auto c_partition = partition->compile(
-        l_input_logical_tensor, l_output_logical_tensor, onednn_engine);
-
-    std::unordered_map<size_t, size_t> inplace_id_map;  // <output_id, input_id>
-    GetInplaceIdMap(c_partition, l_input_logical_tensor,
-                    l_output_logical_tensor, &inplace_id_map);
+    auto compiled = compiled_partition_cache_.FindOrCompile(
+        partition_id_, l_input_logical_tensor, l_output_logical_tensor,
+        onednn_engine);
+    ITEX_VLOG(3) << "compiled partition cache hit: "
+                 << compiled_partition_cache_.hit_count()
+                 << ", miss: " << compiled_partition_cache_.miss_count();
+    const auto& inplace_id_map = compiled->inplace_id_map;
 
     // Prepare output tensors
     for (int index = 0; index < output_edge_ids_.size(); index++) {
-      auto output_logical_tensor =
-          c_partition.query_logical_tensor(output_edge_ids_[index]);
+      const auto& output_logical_tensor =
+          compiled->output_logical_tensors[index];
       TensorShape tf_shape;
       if (is_end_node_[index]) {
         auto sizes = output_logical_tensor.get_dims();
@@ -439,10 +576,10 @@ class OneDnnGraphWithLayoutOp : public OpKernel {
       }
 
       if (inplace_id_map.find(index) != inplace_id_map.end() &&
-          candidate_inplace_input_edge_[inplace_id_map[index]] == true) {
+          candidate_inplace_input_edge_[inplace_id_map.at(index)] == true) {
         // TODO(itex): Check whether LLGA and TensorFlow inplace mechanism
         // are exacly the same
-        int input_index = inplace_id_map[index];
+        int input_index = inplace_id_map.at(index);
         const Tensor& input_tensor = ctx->input(input_index);
 
         if (input_tensor.dtype() != ctx->expected_output_dtype(index)) {
@@ -475,7 +612,8 @@ class OneDnnGraphWithLayoutOp : public OpKernel {
     }
 
     // Execute
-    c_partition.execute(onednn_stream, l_input_tensor, l_output_tensor);
+    compiled->c_partition.execute(onednn_stream, l_input_tensor,
+                                  l_output_tensor);
     ITEX_VLOG(3) << "PARTITION EXECUTED SUCCESSFULLY";
   }
 
@@ -488,6 +626,7 @@ class OneDnnGraphWithLayoutOp : public OpKernel {
   std::vector<bool> candidate_inplace_input_edge_;
   std::vector<string> framework_ops_;
   std::vector<bool> is_end_node_;
+  CompiledPartitionCache compiled_partition_cache_;
 };
 
 #ifdef INTEL_CPU_ONLY
@@ -162,11 +162,14 @@ void Register_FusedRandomOP() {
         TF_NewOpDefinitionBuilder("_ITEXFusedRandom");
     TF_OpDefinitionBuilderAddInput(op_builder, "shape: T");
     TF_OpDefinitionBuilderAddInput(op_builder, "y: DstT");
+    // The input the mask is applied to, and its scale, if Mul is fused.
+    TF_OpDefinitionBuilderAddInput(op_builder, "args: num_args * DstT");
 
     TF_OpDefinitionBuilderAddOutput(op_builder, "output: DstT");
 
     TF_OpDefinitionBuilderAddAttr(op_builder, "T: {int32, int64}");
     TF_OpDefinitionBuilderAddAttr(op_builder, "DstT: {half,bfloat16,float}");
+    TF_OpDefinitionBuilderAddAttr(op_builder, "num_args: int >= 0 = 0");
     TF_OpDefinitionBuilderAddAttr(op_builder, "fused_ops: list(string) = []");
     TF_OpDefinitionBuilderAddAttr(op_builder, "direction: int = 0");
     TF_OpDefinitionBuilderAddAttr(op_builder, "seed: int = 0");
@@ -219,3 +222,60 @@ void Register_ITEXFusedBinaryOp() {
         << "_ITEXFusedBinary op registration failed: ";
   }
 }
+
+void Register_ITEXFusedElementwiseOp() {
+  itex::StatusUniquePtr status(TF_NewStatus());
+  {
+    TF_OpDefinitionBuilder* op_builder =
+        TF_NewOpDefinitionBuilder("_ITEXFusedElementwise");
+    TF_OpDefinitionBuilderAddInput(op_builder, "args: Targs");
+    TF_OpDefinitionBuilderAddOutput(op_builder, "output: T");
+    TF_OpDefinitionBuilderAddAttr(op_builder, "T: {bfloat16, float}");
+    TF_OpDefinitionBuilderAddAttr(op_builder,
+                                  "Targs: list({bfloat16, float, bool}) >= 1");
+    TF_OpDefinitionBuilderAddAttr(op_builder, "fused_ops: list(string) >= 1");
+    // Value ids of the inputs of each fused op, where the args come first and
+    // then the results of the ops.
+    TF_OpDefinitionBuilderAddAttr(op_builder, "operands: list(int)");
+    TF_OpDefinitionBuilderAddAttr(op_builder,
+                                  "op_types: list({bfloat16, float})");
+    TF_OpDefinitionBuilderSetShapeInferenceFunction(op_builder,
+                                                    &unknown_shape_fn);
+    TF_RegisterOpDefinition(op_builder, status.get());
+    ITEX_CHECK_EQ(TF_OK, TF_GetCode(status.get()))
+        << "_ITEXFusedElementwise op registration failed: ";
+  }
+}
+
+void Register_ITEXEmbeddingBagOp() {
+  itex::StatusUniquePtr status(TF_NewStatus());
+  {
+    TF_OpDefinitionBuilder* op_builder =
+        TF_NewOpDefinitionBuilder("_ITEXEmbeddingBag");
+    TF_OpDefinitionBuilderAddInput(op_builder, "params: Tparams");
+    TF_OpDefinitionBuilderAddInput(op_builder, "ids: Tindices");
+    TF_OpDefinitionBuilderAddInput(op_builder,
+                                   "indices: num_segment_inputs * Tidx");
+    TF_OpDefinitionBuilderAddInput(
+        op_builder, "segment_ids: num_segment_inputs * Tsegmentids");
+    TF_OpDefinitionBuilderAddOutput(op_builder, "output: T");
+    TF_OpDefinitionBuilderAddAttr(op_builder, "T: {bfloat16, float}");
+    // Params are either a tensor of T or a resource variable of T.
+    TF_OpDefinitionBuilderAddAttr(op_builder,
+                                  "Tparams: {bfloat16, float, resource}");
+    TF_OpDefinitionBuilderAddAttr(op_builder, "Tindices: {int32, int64}");
+    TF_OpDefinitionBuilderAddAttr(op_builder,
+                                  "Tidx: {int32, int64} = DT_INT32");
+    TF_OpDefinitionBuilderAddAttr(op_builder,
+                                  "Tsegmentids: {int32, int64} = DT_INT32");
+    TF_OpDefinitionBuilderAddAttr(op_builder,
+                                  "combiner: {'sum', 'mean', 'sqrtn'} = 'sum'");
+    TF_OpDefinitionBuilderAddAttr(op_builder,
+                                  "num_segment_inputs: int >= 0 = 0");
+    TF_OpDefinitionBuilderSetShapeInferenceFunction(op_builder,
+                                                    &unknown_shape_fn);
+    TF_RegisterOpDefinition(op_builder, status.get());
+    ITEX_CHECK_EQ(TF_OK, TF_GetCode(status.get()))
+        << "_ITEXEmbeddingBag op registration failed: ";
+  }
+}
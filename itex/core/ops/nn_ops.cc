@@ -3019,6 +3019,36 @@ void Register_ITEXFusedAddV2WithSoftmaxOp() {
   }
 }
 
+void Register_ITEXScaledDotProductAttentionOp() {
+  itex::StatusUniquePtr status(TF_NewStatus());
+  {
+    TF_OpDefinitionBuilder* op_builder =
+        TF_NewOpDefinitionBuilder("_ITEXScaledDotProductAttention");
+    TF_OpDefinitionBuilderAddInput(op_builder, "query: T");
+    TF_OpDefinitionBuilderAddInput(op_builder, "key: T");
+    TF_OpDefinitionBuilderAddInput(op_builder, "value: T");
+    TF_OpDefinitionBuilderAddInput(op_builder, "scale: T");
+    TF_OpDefinitionBuilderAddInput(op_builder, "mask: num_masks * T");
+    TF_OpDefinitionBuilderAddOutput(op_builder, "output: T");
+    TF_OpDefinitionBuilderAddAttr(op_builder, "T: {bfloat16, float}");
+    TF_OpDefinitionBuilderAddAttr(
+        op_builder, "query_layout: {'BHSD', 'BSHD'} = 'BHSD'");
+    TF_OpDefinitionBuilderAddAttr(
+        op_builder, "key_layout: {'BHSD', 'BSHD', 'BHDS'} = 'BHSD'");
+    TF_OpDefinitionBuilderAddAttr(
+        op_builder, "value_layout: {'BHSD', 'BSHD'} = 'BHSD'");
+    TF_OpDefinitionBuilderAddAttr(
+        op_builder, "output_layout: {'BHSD', 'BSHD'} = 'BHSD'");
+    TF_OpDefinitionBuilderAddAttr(op_builder, "num_masks: int >= 0 = 0");
+    TF_OpDefinitionBuilderSetShapeInferenceFunction(op_builder,
+                                                    &unknown_shape_fn);
+
+    TF_RegisterOpDefinition(op_builder, status.get());
+    ITEX_CHECK_EQ(TF_OK, TF_GetCode(status.get()))
+        << "_ITEXScaledDotProductAttention op registration failed: ";
+  }
+}
+
 void Register_ITEXResizeBilinearOp() {
   itex::StatusUniquePtr status(TF_NewStatus());
   {
@@ -93,6 +93,7 @@ void RegisterOps() {
   Register_FusedConv2DWithSumOp();
   Register_FusedDequantizeWithReshapeOp();
   Register_ITEXFusedAddV2WithSoftmaxOp();
+  Register_ITEXScaledDotProductAttentionOp();
   Register_FusedMatMulGradOp();
   Register_FusedMatMulWithSumOp();
   Register_FusedInstanceNormOp();
@@ -105,6 +106,8 @@ void RegisterOps() {
   Register_ITEXFusedMatMulOp();
   Register_ITEXFusedQuantizeV2WithQuantizedConv2DOp();
   Register_ITEXFusedBinaryOp();
+  Register_ITEXFusedElementwiseOp();
+  Register_ITEXEmbeddingBagOp();
   Register_ITEXRandomUniformOp();
   Register_LayerNormOp();
   Register_LayerNormGradOp();
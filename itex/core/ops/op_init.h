@@ -72,8 +72,11 @@ void Register_ITEXFusedDepthwiseConv2dNativeOp();
 void Register_ITEXFusedMatMulOp();
 void Register_ITEXFusedQuantizeV2WithQuantizedConv2DOp();
 void Register_ITEXFusedBinaryOp();
+void Register_ITEXFusedElementwiseOp();
+void Register_ITEXEmbeddingBagOp();
 void Register_ITEXRandomUniformOp();
 void Register_ITEXFusedAddV2WithSoftmaxOp();
+void Register_ITEXScaledDotProductAttentionOp();
 void Register_LayerNormOp();
 void Register_LayerNormGradOp();
 void Register_ITEXRnnOp();
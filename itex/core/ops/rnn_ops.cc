@@ -48,6 +48,7 @@ void Register_ITEXRnnOp() {
     TF_OpDefinitionBuilderAddAttr(op_builder, "num_proj: int = 0");
     TF_OpDefinitionBuilderAddAttr(op_builder, "var_seq_length: bool = false");
     TF_OpDefinitionBuilderAddAttr(op_builder, "is_training: bool = true");
+    TF_OpDefinitionBuilderAddAttr(op_builder, "is_filter_const: bool = false");
     TF_OpDefinitionBuilderSetShapeInferenceFunction(op_builder,
                                                     &unknown_shape_fn);
     TF_RegisterOpDefinition(op_builder, status.get());
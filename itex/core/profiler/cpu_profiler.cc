@@ -0,0 +1,163 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "itex/core/profiler/utils/parse_annotation.h"
+#include "itex/core/profiler/utils/xplane_builder.h"
+#include "itex/core/profiler/utils/xplane_schema.h"
+#include "itex/core/profiler/utils/xplane_utils.h"
+#include "itex/core/utils/env_var.h"
+#include "itex/core/utils/logging.h"
+#include "itex/core/utils/mutex.h"
+#include "itex/core/utils/time_utils.h"
+#include "itex/core/utils/traceme_recorder.h"
+#include "itex/core/utils/types.h"
+#include "protos/xplane.pb.h"
+#include "tensorflow/c/experimental/pluggable_profiler/pluggable_profiler.h"
+
+// Host tracer of the CPU plugin. ITEX kernels are traced by ITEX's own
+// TraceMeRecorder (op names and shapes from the REGISTER_KERNEL_BUILDER
+// Compute wrapper, oneDNN primitive creation and execution inside kernels),
+// which is invisible to TensorFlow's host tracer. This profiler collects those
+// events and exports them as host thread lines, which TensorFlow merges into
+// its "/host:CPU" plane.
+
+namespace {
+
+// Default TraceMe level, same as TensorFlow's default host tracer level.
+// Level 1 records kernels only, level 2 also records oneDNN primitive
+// creation and execution.
+constexpr itex::int64 kDefaultCpuProfilerTraceLevel = 2;
+
+itex::mutex mu;
+uint64_t start_walltime_ns TF_GUARDED_BY(mu) = 0;
+itex::TraceMeRecorder::Events events TF_GUARDED_BY(mu);
+
+int GetCpuProfilerTraceLevel() {
+  static int level = []() {
+    itex::int64 value;
+    ITEX_CHECK_OK(itex::ReadInt64FromEnvVar("ITEX_CPU_PROFILER_TRACE_LEVEL",
+                                            kDefaultCpuProfilerTraceLevel,
+                                            &value));
+    return static_cast<int>(value);
+  }();
+  return level;
+}
+
+void AddEvent(const itex::TraceMeRecorder::Event& event,
+              itex::profiler::XPlaneBuilder* plane,
+              itex::profiler::XLineBuilder* line) {
+  itex::profiler::Annotation annotation =
+      itex::profiler::ParseAnnotation(event.name);
+  itex::profiler::XEventMetadata* metadata =
+      plane->GetOrCreateEventMetadata(annotation.name);
+  itex::profiler::XEventBuilder xevent = line->AddEvent(*metadata);
+  xevent.SetTimestampNs(event.start_time);
+  xevent.SetEndTimestampNs(event.end_time);
+  for (const auto& stat : annotation.metadata) {
+    xevent.ParseAndAddStatValue(*plane->GetOrCreateStatMetadata(stat.key),
+                                stat.value);
+  }
+}
+
+// Converts events of each thread to a line of `raw_plane`. Events recorded
+// by TraceMe::ActivityStart/ActivityEnd are paired up by activity id, and
+// unpaired ones are discarded.
+void ConvertEventsToXPlane(uint64_t start_timestamp_ns,
+                           itex::TraceMeRecorder::Events&& events,
+                           itex::XPlane* raw_plane) {
+  itex::profiler::XPlaneBuilder plane(raw_plane);
+  for (auto& thread : events) {
+    itex::profiler::XLineBuilder line =
+        plane.GetOrCreateLine(thread.thread.tid);
+    line.SetName(thread.thread.name);
+    line.SetTimestampNs(start_timestamp_ns);
+    line.ReserveEvents(thread.events.size());
+
+    absl::flat_hash_map<int64_t, itex::TraceMeRecorder::Event> start_events;
+    for (auto& event : thread.events) {
+      if (event.IsComplete()) {
+        AddEvent(event, &plane, &line);
+      } else if (event.IsStart()) {
+        start_events.emplace(event.ActivityId(), std::move(event));
+      } else {
+        auto iter = start_events.find(event.ActivityId());
+        if (iter == start_events.end()) continue;
+        itex::TraceMeRecorder::Event& start_event = iter->second;
+        start_event.end_time = event.end_time;
+        AddEvent(start_event, &plane, &line);
+        start_events.erase(iter);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void cpu_start(const TP_Profiler* profiler, TF_Status* status) {
+  itex::mutex_lock lock(&mu);
+  events.clear();
+  start_walltime_ns = itex::profiler::GetCurrentTimeNanos();
+  if (!itex::TraceMeRecorder::Start(GetCpuProfilerTraceLevel())) {
+    ITEX_LOG(WARNING) << "ITEX CPU profiler is already started.";
+  }
+}
+
+void cpu_stop(const TP_Profiler* profiler, TF_Status* status) {
+  itex::mutex_lock lock(&mu);
+  events = itex::TraceMeRecorder::Stop();
+}
+
+void cpu_collect_data_xspace(const TP_Profiler* profiler, uint8_t* buffer,
+                             size_t* size_in_bytes, TF_Status* status) {
+  itex::mutex_lock lock(&mu);
+  // TensorFlow calls this function twice, first to query the buffer size and
+  // then to fill the buffer, so the XSpace is rebuilt from `events` each time.
+  itex::XSpace space;
+  if (!events.empty()) {
+    itex::TraceMeRecorder::Events events_copy = events;
+    ConvertEventsToXPlane(start_walltime_ns, std::move(events_copy),
+                          itex::profiler::FindOrAddMutablePlaneWithName(
+                              &space, itex::profiler::kHostThreadsPlaneName));
+  }
+
+  *size_in_bytes = space.ByteSizeLong();
+  if (buffer == nullptr) {
+    return;
+  }
+  space.SerializeToArray(buffer, space.ByteSizeLong());
+  events.clear();
+}
+
+void cpu_destroy_profiler(TP_Profiler* profiler) {}
+
+void cpu_destroy_profiler_fns(TP_ProfilerFns* profiler_fns) {}
+
+void TF_InitProfiler(TF_ProfilerRegistrationParams* params, TF_Status* status) {
+  params->struct_size = TF_PROFILER_REGISTRATION_PARAMS_STRUCT_SIZE;
+  params->profiler->struct_size = TP_PROFILER_STRUCT_SIZE;
+  params->profiler_fns->struct_size = TP_PROFILER_FNS_STRUCT_SIZE;
+
+  params->profiler->device_type = itex::DEVICE_CPU;
+
+  params->profiler_fns->start = cpu_start;
+  params->profiler_fns->stop = cpu_stop;
+  params->profiler_fns->collect_data_xspace = cpu_collect_data_xspace;
+  params->destroy_profiler = cpu_destroy_profiler;
+  params->destroy_profiler_fns = cpu_destroy_profiler_fns;
+}
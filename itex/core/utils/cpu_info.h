@@ -18,6 +18,8 @@ limitations under the License.
 #ifndef ITEX_CORE_UTILS_CPU_INFO_H_
 #define ITEX_CORE_UTILS_CPU_INFO_H_
 
+#include <vector>
+
 namespace itex {
 namespace port {
 
@@ -53,6 +55,22 @@ int NumHyperthreadsPerCore();
 // Returns num of hyperthreads per physical core
 int CPUIDNumSMT();
 
+// NUMA topology read from sysfs. Only NUMA nodes which have schedulable CPUs
+// are counted, and they are numbered from 0 to NUMANumNodes() - 1. When the
+// topology is unavailable, all schedulable CPUs are considered as one node.
+static constexpr int kNUMANoAffinity = -1;
+int NUMANumNodes();
+
+// Returns the schedulable CPUs of `node`.
+std::vector<int> NUMANodeCPUs(int node);
+
+// Returns the node of the CPU which the calling thread is running on, or
+// kNUMANoAffinity if it's unknown.
+int NUMAGetCurrentNode();
+
+// Binds the calling thread to the schedulable CPUs of `node`.
+void NUMASetThreadNodeAffinity(int node);
+
 }  // namespace port
 }  // namespace itex
 
@@ -27,6 +27,7 @@ limitations under the License.
 #include "itex/core/utils/str_util.h"
 #include "itex/core/utils/strcat.h"
 #include "third_party/eigen3/Eigen/Core"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 
 namespace itex {
 namespace ctc {
@@ -64,6 +65,7 @@ class CTCLossCalculator {
   CTCLossCalculator(int blank_index, int output_delay)
       : blank_index_(blank_index), output_delay_(output_delay) {}
 
+  // Batch elements are sharded across the threads of `device`.
   template <typename VectorIn, typename VectorOut, typename MatrixIn,
             typename MatrixOut>
   Status CalculateLoss(const VectorIn& seq_len, const LabelSequences& labels,
@@ -71,20 +73,41 @@ class CTCLossCalculator {
                        bool preprocess_collapse_repeated,
                        bool ctc_merge_repeated,
                        bool ignore_longer_outputs_than_inputs, VectorOut* loss,
-                       std::vector<MatrixOut>* gradients) const;
+                       std::vector<MatrixOut>* gradients,
+                       const Eigen::ThreadPoolDevice& device) const;
 
  private:
+  // Scratch buffers of one shard of the batch. They are allocated for the
+  // longest batch element once, and reused by every element of the shard.
+  struct Workspace {
+    Workspace(size_t max_u_prime, int64 max_seq_len, int64 num_classes,
+              bool requires_backprop)
+        : log_alpha(max_u_prime * max_seq_len),
+          log_beta(max_u_prime * max_seq_len),
+          y(num_classes * max_seq_len),
+          dy(requires_backprop ? num_classes * max_seq_len : 0),
+          y_b_col(num_classes),
+          prob_sum(num_classes) {}
+
+    std::vector<T> log_alpha;
+    std::vector<T> log_beta;
+    std::vector<T> y;
+    std::vector<T> dy;
+    Array y_b_col;
+    Array prob_sum;
+  };
+
   void CalculateForwardVariables(const std::vector<int>& l_prime,
-                                 const Matrix& y, bool ctc_merge_repeated,
-                                 Matrix* log_alpha) const;
+                                 const InputMap& y, bool ctc_merge_repeated,
+                                 OutputMap* log_alpha) const;
 
   void CalculateBackwardVariables(const std::vector<int>& l_prime,
-                                  const Matrix& y, bool ctc_merge_repeated,
-                                  Matrix* log_beta) const;
+                                  const InputMap& y, bool ctc_merge_repeated,
+                                  OutputMap* log_beta) const;
 
-  void CalculateGradient(const std::vector<int>& l_prime, const Matrix& y,
-                         const Matrix& log_alpha, const Matrix& log_beta,
-                         T log_p_z_x, Matrix* dy) const;
+  void CalculateGradient(const std::vector<int>& l_prime, const InputMap& y,
+                         const InputMap& log_alpha, const InputMap& log_beta,
+                         T log_p_z_x, Array* prob_sum, OutputMap* dy) const;
 
   void GetLPrimeIndices(const std::vector<int>& l,
                         std::vector<int>* l_prime) const;
@@ -115,7 +138,8 @@ Status CTCLossCalculator<T>::CalculateLoss(
     const VectorIn& seq_len, const LabelSequences& labels,
     const std::vector<MatrixIn>& inputs, bool preprocess_collapse_repeated,
     bool ctc_merge_repeated, bool ignore_longer_outputs_than_inputs,
-    VectorOut* loss, std::vector<MatrixOut>* gradients) const {
+    VectorOut* loss, std::vector<MatrixOut>* gradients,
+    const Eigen::ThreadPoolDevice& device) const {
   using Eigen::numext::log;
 
   auto num_time_steps = inputs.size();
@@ -170,13 +194,15 @@ Status CTCLossCalculator<T>::CalculateLoss(
     return l_p_ret;
   }
 
-  // Process each item in a batch in parallel, using at most kMaxThreads.
-  auto ComputeLossAndGradients = [this, num_classes, &labels, &l_primes,
-                                  &seq_len, &inputs, requires_backprop,
-                                  ctc_merge_repeated,
+  // Process each item in a batch in parallel.
+  auto ComputeLossAndGradients = [this, num_classes, max_u_prime, max_seq_len,
+                                  &labels, &l_primes, &seq_len, &inputs,
+                                  requires_backprop, ctc_merge_repeated,
                                   ignore_longer_outputs_than_inputs, &loss,
-                                  &gradients](int64 start_row,
-                                              int64 limit_row) {
+                                  &gradients](Eigen::Index start_row,
+                                              Eigen::Index limit_row) {
+    Workspace workspace(max_u_prime, max_seq_len, num_classes,
+                        requires_backprop);
     for (int b = start_row; b < limit_row; b++) {
       // Return zero gradient for empty sequences or sequences with labels
       // longer than input, which is not supported by CTC.
@@ -197,23 +223,21 @@ Status CTCLossCalculator<T>::CalculateLoss(
       //   col size is: seq_len[b] - output_delay_
       const std::vector<int>& l_prime = l_primes[b];
 
-      Matrix log_alpha_b(l_prime.size(), seq_len(b) - this->output_delay_);
-      Matrix log_beta_b(l_prime.size(), seq_len(b) - this->output_delay_);
-
-      // Work matrices, pre-allocated to the size required by this batch item.
-      Matrix y(num_classes, seq_len(b));
-      Matrix dy;
-      if (requires_backprop) {
-        dy = Matrix::Zero(y.rows(), y.cols());
-      }
+      OutputMap log_alpha_b(workspace.log_alpha.data(), l_prime.size(),
+                            seq_len(b) - this->output_delay_);
+      OutputMap log_beta_b(workspace.log_beta.data(), l_prime.size(),
+                           seq_len(b) - this->output_delay_);
 
+      // Work matrices, shaped to the size required by this batch item.
       // For this batch, we'll only work with this shortened sequence_length.
-      Matrix y_b = y.leftCols(seq_len(b));
+      OutputMap y_b(workspace.y.data(), num_classes, seq_len(b));
+      OutputMap dy(workspace.dy.data(), requires_backprop ? num_classes : 0,
+                   requires_backprop ? seq_len(b) : 0);
 
       // Convert label from DistBelief
       // y, prob are in num_classes x seq_len(b)
       // Output activations.
-      Array y_b_col;
+      Array& y_b_col = workspace.y_b_col;
       for (int t = 0; t < seq_len(b); t++) {
         // Calculate the softmax of y_b.  Use original precision
         // arithmetic for the sum.
@@ -221,12 +245,15 @@ Status CTCLossCalculator<T>::CalculateLoss(
         y_b_col = (inputs[t].row(b).array() - max_coeff).exp();
         y_b.col(t) = y_b_col / y_b_col.sum();
       }
+      InputMap y_b_in(y_b.data(), y_b.rows(), y_b.cols());
 
       // Compute forward, backward.
       // Forward variables.
-      CalculateForwardVariables(l_prime, y_b, ctc_merge_repeated, &log_alpha_b);
+      CalculateForwardVariables(l_prime, y_b_in, ctc_merge_repeated,
+                                &log_alpha_b);
       // Backward variables.
-      CalculateBackwardVariables(l_prime, y_b, ctc_merge_repeated, &log_beta_b);
+      CalculateBackwardVariables(l_prime, y_b_in, ctc_merge_repeated,
+                                 &log_beta_b);
 
       // The loss is computed as the log(p(z|x)) between the target and
       // prediction. Do lazy evaluation of log_prob here.
@@ -243,8 +270,12 @@ Status CTCLossCalculator<T>::CalculateLoss(
         // Gradients with respect to input activations.
         // Calculate gradient.
         dy.setZero();
-        CalculateGradient(l_prime, y_b, log_alpha_b, log_beta_b, log_p_z_x,
-                          &dy);
+        CalculateGradient(
+            l_prime, y_b_in,
+            InputMap(log_alpha_b.data(), log_alpha_b.rows(),
+                     log_alpha_b.cols()),
+            InputMap(log_beta_b.data(), log_beta_b.rows(), log_beta_b.cols()),
+            log_p_z_x, &workspace.prob_sum, &dy);
 
         // Convert gradient for current sample to DistBelief.
         for (int t = 0; t < seq_len(b); t++) {
@@ -253,7 +284,20 @@ Status CTCLossCalculator<T>::CalculateLoss(
       }
     }  // for (int b = ...
   };
-  ComputeLossAndGradients(0, batch_size);
+
+  // Cost of one batch element: softmax over the classes, then forward and
+  // backward passes over the lattice, each summing up to 3 paths per cell.
+  const double cost_exp =
+      Eigen::internal::functor_traits<Eigen::internal::scalar_exp_op<T>>::Cost;
+  const double cost_log =
+      Eigen::internal::functor_traits<Eigen::internal::scalar_log_op<T>>::Cost;
+  const double cost_log_sum_exp =
+      Eigen::TensorOpCost::AddCost<T>() + cost_exp + cost_log;
+  const double cost_softmax = cost_exp + Eigen::TensorOpCost::DivCost<T>();
+  const double cost = max_seq_len * num_classes * cost_softmax +
+                      max_seq_len * 2 * max_u_prime * 3 * cost_log_sum_exp;
+  device.parallelFor(batch_size, Eigen::TensorOpCost(0, 0, cost),
+                     ComputeLossAndGradients);
   return Status::OK();
 }
 
@@ -347,8 +391,8 @@ Status CTCLossCalculator<T>::PopulateLPrimes(
 // Based on Kanishka's CTC.
 template <typename TT>
 void CTCLossCalculator<TT>::CalculateForwardVariables(
-    const std::vector<int>& l_prime, const Matrix& y, bool ctc_merge_repeated,
-    Matrix* log_alpha) const {
+    const std::vector<int>& l_prime, const InputMap& y, bool ctc_merge_repeated,
+    OutputMap* log_alpha) const {
   using Eigen::numext::log;
 
   // Number of cols is the number of time steps = number of cols in target
@@ -404,8 +448,8 @@ void CTCLossCalculator<TT>::CalculateForwardVariables(
 // Calculates the beta(t, u) as described in (GravesTh) Section 7.3.
 template <class TT>
 void CTCLossCalculator<TT>::CalculateBackwardVariables(
-    const std::vector<int>& l_prime, const Matrix& y, bool ctc_merge_repeated,
-    Matrix* log_beta) const {
+    const std::vector<int>& l_prime, const InputMap& y, bool ctc_merge_repeated,
+    OutputMap* log_beta) const {
   // Number of cols is the number of time steps =  number of cols in target.
   // Matrix log_beta =
   //    Matrix::Constant(l_prime.size(), y.cols() - output_delay_,
@@ -461,11 +505,10 @@ void CTCLossCalculator<TT>::CalculateBackwardVariables(
 
 // Using (GravesTh) Eq 7.26 & 7.34.
 template <typename TT>
-void CTCLossCalculator<TT>::CalculateGradient(const std::vector<int>& l_prime,
-                                              const Matrix& y,
-                                              const Matrix& log_alpha,
-                                              const Matrix& log_beta,
-                                              TT log_p_z_x, Matrix* dy) const {
+void CTCLossCalculator<TT>::CalculateGradient(
+    const std::vector<int>& l_prime, const InputMap& y,
+    const InputMap& log_alpha, const InputMap& log_beta, TT log_p_z_x,
+    Array* prob_sum, OutputMap* dy) const {
   // Only working with the leftmost part of dy for this batch element.
   auto dy_b = dy->leftCols(y.cols());
 
@@ -482,19 +525,19 @@ void CTCLossCalculator<TT>::CalculateGradient(const std::vector<int>& l_prime,
   int U = l_prime.size();
 
   for (int t = 0; t < T - output_delay_; ++t) {
-    Array prob_sum(L);
-    prob_sum.setConstant(kLogZero<TT>());
+    prob_sum->setConstant(kLogZero<TT>());
 
     for (int u = 0; u < U; ++u) {
       int l = l_prime[u];
       ITEX_CHECK(l >= 0);
       ITEX_CHECK(l < L);
-      prob_sum[l] = LogSumExp(prob_sum[l], log_alpha(u, t) + log_beta(u, t));
+      (*prob_sum)[l] =
+          LogSumExp((*prob_sum)[l], log_alpha(u, t) + log_beta(u, t));
     }
 
     for (int l = 0; l < L; ++l) {
       // Negative term in (GravesTh) Eq 7.28.
-      auto negative_term = expf(prob_sum[l] - log_p_z_x);
+      auto negative_term = expf((*prob_sum)[l] - log_p_z_x);
 
       dy_b(l, output_delay_ + t) = y(l, output_delay_ + t) - negative_term;
     }
@@ -0,0 +1,153 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef ITEX_CORE_UTILS_LRU_CACHE_H_
+#define ITEX_CORE_UTILS_LRU_CACHE_H_
+
+#include <list>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "itex/core/utils/logging.h"
+#include "itex/core/utils/stringpiece.h"
+#include "itex/core/utils/types.h"
+
+namespace itex {
+
+// A simple string-keyed cache with least-recently-used eviction. It is not
+// thread safe, callers are responsible for guarding it with their own mutex.
+template <typename T>
+class LRUCache {
+ public:
+  explicit LRUCache(size_t capacity) : capacity_(capacity) {
+    ITEX_DCHECK_GT(capacity_, 0);
+  }
+  ~LRUCache() = default;
+
+  // Returns the cached value of `key` and marks it as most recently used, or
+  // nullptr if `key` is not cached. Hit and miss counters are updated.
+  T* Find(const string& key) {
+    auto it = cache_.find(key);
+    if (it == cache_.end()) {
+      ++miss_count_;
+      return nullptr;
+    }
+    ++hit_count_;
+    lru_list_.splice(lru_list_.begin(), lru_list_, it->second.lru_iterator);
+    return &it->second.value;
+  }
+
+  // Inserts `value` for `key` as the most recently used entry, evicting the
+  // least recently used entry if the cache is full. An existing entry with
+  // the same key is overwritten. Returns the cached value.
+  T* Insert(const string& key, T value) {
+    auto it = cache_.find(key);
+    if (it != cache_.end()) {
+      it->second.value = std::move(value);
+      lru_list_.splice(lru_list_.begin(), lru_list_, it->second.lru_iterator);
+      return &it->second.value;
+    }
+
+    while (cache_.size() >= capacity_) {
+      DeleteLRUEntry();
+    }
+
+    lru_list_.push_front(key);
+    Entry entry(std::move(value), lru_list_.begin());
+    return &cache_.emplace(key, std::move(entry)).first->second.value;
+  }
+
+  void Clear() {
+    cache_.clear();
+    lru_list_.clear();
+  }
+
+  size_t size() const { return cache_.size(); }
+  size_t capacity() const { return capacity_; }
+  int64 hit_count() const { return hit_count_; }
+  int64 miss_count() const { return miss_count_; }
+  int64 evict_count() const { return evict_count_; }
+
+ private:
+  struct Entry {
+    T value;
+    // Position of this entry's key in `lru_list_`.
+    std::list<string>::iterator lru_iterator;
+
+    Entry(T value, std::list<string>::iterator it)
+        : value(std::move(value)), lru_iterator(it) {}
+  };
+
+  void DeleteLRUEntry() {
+    ITEX_DCHECK(!lru_list_.empty());
+    cache_.erase(lru_list_.back());
+    lru_list_.pop_back();
+    ++evict_count_;
+  }
+
+  size_t capacity_;
+  // Most recently used key is at the front.
+  std::list<string> lru_list_;
+  std::unordered_map<string, Entry> cache_;
+
+  int64 hit_count_ = 0;
+  int64 miss_count_ = 0;
+  int64 evict_count_ = 0;
+};
+
+// Helper to build the string key of LRUCache from POD values, strings and
+// vectors of POD values.
+class CacheKeyCreator {
+ public:
+  CacheKeyCreator() { key_.reserve(kMaxKeyLength); }
+  ~CacheKeyCreator() = default;
+
+  void AddAsKey(const string& str) { Append(str); }
+
+  template <typename T>
+  void AddAsKey(const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only vector of trivially copyable type is supported.");
+    AddAsKey(values.size());
+    for (const T& value : values) AddAsKey(value);
+  }
+
+  template <typename T>
+  void AddAsKey(const T& data) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only trivially copyable type is supported.");
+    Append(StringPiece(reinterpret_cast<const char*>(&data), sizeof(T)));
+  }
+
+  string GetKey() { return key_; }
+
+ private:
+  static constexpr char kDelimiter = 'x';
+  static constexpr size_t kMaxKeyLength = 256;
+
+  void Append(StringPiece s) {
+    key_.append(s.data(), s.size());
+    key_.append(1, kDelimiter);
+  }
+
+  string key_;
+};
+
+}  // namespace itex
+
+#endif  // ITEX_CORE_UTILS_LRU_CACHE_H_
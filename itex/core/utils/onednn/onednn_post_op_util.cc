@@ -65,6 +65,12 @@ const std::vector<PostOpInfo>& PostOpUtil::GetAllPostOpInfo() {
       /* Kind: binary */
       {"BinaryAdd", kind::binary, algorithm::binary_add, kAlphaOne, kBetaZero,
        kScaleOne},
+      {"BinaryMaximum", kind::binary, algorithm::binary_max, kAlphaOne,
+       kBetaZero, kScaleOne},
+      {"BinaryMinimum", kind::binary, algorithm::binary_min, kAlphaOne,
+       kBetaZero, kScaleOne},
+      {"BinaryMul", kind::binary, algorithm::binary_mul, kAlphaOne, kBetaZero,
+       kScaleOne},
   };
 
   return info_vec;
@@ -88,6 +94,9 @@ bool PostOpUtil::AddOps(const std::vector<string>& fused_ops) {
         postop_scale_list_.push_back(std::make_pair(name, scale_default));
       } else if (op_kind == kind::binary) {
         this->has_binary_ = true;
+        // Each binary op reads its own input, which is set in node execution.
+        binary_post_op_indices_.push_back(postop_scale_list_.size());
+        binary_md_list_.push_back(dnnl::memory::desc());
         // TODO(itex): Scale for binary is useless now, but it can be supported
         //             in future once oneDNN supports it.
         postop_scale_list_.push_back(std::make_pair(name, scale_default));
@@ -127,12 +136,21 @@ bool PostOpUtil::AddOps(const std::vector<string>& fused_ops) {
 }
 
 void PostOpUtil::SetBinaryInput(const dnnl::memory::desc& binary_md) {
-  ITEX_CHECK(this->has_binary_)
-      << "PostOpUtil: can't find binary op when set input md";
-  // TODO(ITEX): Do not .clear() and .push_back(). It is thread unsafe, and it
+  ITEX_CHECK(this->binary_md_list_.size() == 1)
+      << "PostOpUtil: expect 1 binary op when set input md, but get "
+      << this->binary_md_list_.size();
+  SetBinaryInput(0, binary_md);
+}
+
+void PostOpUtil::SetBinaryInput(int binary_index,
+                                const dnnl::memory::desc& binary_md) {
+  ITEX_CHECK(binary_index >= 0 && binary_index < GetNumBinary())
+      << "PostOpUtil: can't find binary op " << binary_index
+      << " when set input md";
+  // TODO(ITEX): Do not store the md in PostOpUtil. It is thread unsafe, and it
   // will cause error in Bert weight sharing case, where multiple threads excute
   // the same kernel.
-  this->binary_md_list_ = {binary_md};
+  this->binary_md_list_[binary_index] = binary_md;
 }
 
 void PostOpUtil::SetLeakyReluAlpha(float alpha) {
@@ -183,6 +201,7 @@ bool PostOpUtil::IsSupportedActivation(const absl::string_view op_name) {
 }
 
 void PostOpUtil::SetPostOp(dnnl::post_ops* post_ops) {
+  int binary_index = 0;
   for (const auto& postop_data : postop_scale_list_) {
     const absl::string_view name = postop_data.first;
     float scale = postop_data.second;
@@ -193,7 +212,7 @@ void PostOpUtil::SetPostOp(dnnl::post_ops* post_ops) {
     kind op_kind = info->kind;
     if (op_kind == kind::eltwise) {
       float alpha = info->alpha;
-      if (this->has_leaky_relu_) {
+      if (name == "LeakyRelu") {
         alpha = this->leaky_relu_alpha_;
         ITEX_CHECK(!std::isnan(alpha))
             << "PostOpUtil: LeakyRelu alpha is never set";
@@ -202,9 +221,10 @@ void PostOpUtil::SetPostOp(dnnl::post_ops* post_ops) {
     } else if (op_kind == kind::sum) {
       post_ops->append_sum(scale);
     } else if (op_kind == kind::binary) {
-      ITEX_CHECK(this->binary_md_list_.size() == 1)
-          << "PostOpUtil: binary input md is set wrongly";
-      post_ops->append_binary(info->alg, this->binary_md_list_.front());
+      const dnnl::memory::desc& binary_md = binary_md_list_[binary_index++];
+      ITEX_CHECK(binary_md != dnnl::memory::desc())
+          << "PostOpUtil: binary input md of " << name << " is never set";
+      post_ops->append_binary(info->alg, binary_md);
     } else {
       // TODO(itex): Support `depthwise` and in future.
       ITEX_LOG(FATAL) << "PostOpUtil: unsupported post op fusion: " << name;
@@ -59,9 +59,20 @@ class PostOpUtil {
   bool AddOps(const std::vector<string>& fused_ops);
 
   // Set extra input md for post binary op.
-  // Will report error if no binary op in post ops.
+  // Will report error if post ops don't have exactly one binary op.
   void SetBinaryInput(const dnnl::memory::desc& binary_md);
 
+  // Set extra input md for the `binary_index`-th post binary op, in the order
+  // of `fused_ops`. The md may broadcast the input to the dst with dims of 1.
+  void SetBinaryInput(int binary_index, const dnnl::memory::desc& binary_md);
+
+  // Return the index of the `binary_index`-th post binary op among all post
+  // ops, which is needed to pass its input in primitive execution by
+  // `DNNL_ARG_ATTR_MULTIPLE_POST_OP(index) | DNNL_ARG_SRC_1`.
+  inline int GetBinaryPostOpIndex(int binary_index) {
+    return binary_post_op_indices_[binary_index];
+  }
+
   // Set alpha for `LeakyRelu`.
   // Will report error if no `LeakyRelu` in post ops.
   void SetLeakyReluAlpha(float alpha);
@@ -88,6 +99,7 @@ class PostOpUtil {
   inline bool HasBias() { return has_bias_; }
   inline bool HasMul() { return has_mul_; }
   inline bool HasBinary() { return has_binary_; }
+  inline int GetNumBinary() { return binary_md_list_.size(); }
   inline bool HasLeakyRelu() { return has_leaky_relu_; }
 
   // TODO(itex): currently both INT8 output scale and batchmatmul + mul
@@ -138,8 +150,9 @@ class PostOpUtil {
   // Helper vars for post op execution.
   float leaky_relu_alpha_ = NAN;
 
-  // Helper var for input of post binary op.
+  // Helper vars for inputs of post binary ops, one for each op.
   std::vector<dnnl::memory::desc> binary_md_list_;
+  std::vector<int> binary_post_op_indices_;
 };
 
 }  // namespace itex
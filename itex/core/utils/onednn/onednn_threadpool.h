@@ -0,0 +1,105 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef ITEX_CORE_UTILS_ONEDNN_ONEDNN_THREADPOOL_H_
+#define ITEX_CORE_UTILS_ONEDNN_ONEDNN_THREADPOOL_H_
+
+#include "dnnl.hpp"  // NOLINT(build/include_subdir)
+
+// oneDNN built with `--config=cpu --define=build_with_onednn_threadpool=true`
+// runs CPU primitives on a user provided thread pool instead of OpenMP. It
+// doesn't apply to oneDNN Graph, which is a separate library.
+#if DNNL_CPU_THREADING_RUNTIME == DNNL_RUNTIME_THREADPOOL
+#define ITEX_ONEDNN_THREADPOOL
+#endif
+
+#ifdef ITEX_ONEDNN_THREADPOOL
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+#include "dnnl_threadpool.hpp"  // NOLINT(build/include_subdir)
+#include "itex/core/utils/mutex.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
+namespace itex {
+
+// Runs oneDNN CPU primitives on an Eigen thread pool, so that Eigen and
+// oneDNN kernels share the same worker threads instead of oversubscribing
+// the cores with two pools.
+class OneDnnThreadPool : public dnnl::threadpool_interop::threadpool_iface {
+ public:
+  explicit OneDnnThreadPool(Eigen::ThreadPoolInterface* eigen_pool)
+      : eigen_pool_(eigen_pool) {}
+
+  // Returns the adapter of `eigen_pool`, which lives as long as the process
+  // since oneDNN streams keep a pointer to it.
+  static OneDnnThreadPool* Get(Eigen::ThreadPoolInterface* eigen_pool) {
+    // Fast path for the inter-op thread which always uses the same pool.
+    thread_local Eigen::ThreadPoolInterface* last_eigen_pool = nullptr;
+    thread_local OneDnnThreadPool* last_pool = nullptr;
+    if (eigen_pool == last_eigen_pool) return last_pool;
+
+    static mutex mu;
+    static auto* pools =
+        new std::unordered_map<Eigen::ThreadPoolInterface*,
+                               std::unique_ptr<OneDnnThreadPool>>();
+    mutex_lock lock(&mu);
+    auto& pool = (*pools)[eigen_pool];
+    if (!pool) pool.reset(new OneDnnThreadPool(eigen_pool));
+    last_eigen_pool = eigen_pool;
+    last_pool = pool.get();
+    return last_pool;
+  }
+
+  int get_num_threads() const override { return eigen_pool_->NumThreads(); }
+
+  bool get_in_parallel() const override {
+    return eigen_pool_->CurrentThreadId() != -1;
+  }
+
+  // Primitives are executed synchronously, so callers don't need to wait on
+  // the stream.
+  uint64_t get_flags() const override { return 0; }
+
+  void parallel_for(int n, const std::function<void(int, int)>& fn) override {
+    // Nested parallelism runs sequentially in the calling worker thread to
+    // avoid deadlock on a saturated pool.
+    if (n <= 1 || get_in_parallel()) {
+      for (int i = 0; i < n; ++i) fn(i, n);
+      return;
+    }
+
+    Eigen::Barrier barrier(n - 1);
+    for (int i = 1; i < n; ++i) {
+      eigen_pool_->Schedule([i, n, &fn, &barrier]() {
+        fn(i, n);
+        barrier.Notify();
+      });
+    }
+    fn(0, n);
+    barrier.Wait();
+  }
+
+ private:
+  Eigen::ThreadPoolInterface* eigen_pool_;
+};
+
+}  // namespace itex
+
+#endif  // ITEX_ONEDNN_THREADPOOL
+
+#endif  // ITEX_CORE_UTILS_ONEDNN_ONEDNN_THREADPOOL_H_
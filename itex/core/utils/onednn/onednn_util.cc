@@ -17,18 +17,106 @@ limitations under the License.
 
 #include <unordered_map>
 
+#include "itex/core/utils/env_var.h"
 #include "itex/core/utils/register_types.h"
 
 namespace itex {
 
+namespace {
+// Print primitive cache statistics every `kStatsDumpInterval` misses.
+constexpr int64 kStatsDumpInterval = 1000;
+
+size_t GetPrimitiveCacheCapacity() {
+  int64 capacity;
+  ITEX_CHECK_OK(ReadInt64FromEnvVar("ITEX_ONEDNN_PRIMITIVE_CACHE_CAPACITY",
+                                    1024, &capacity));
+  return capacity > 0 ? capacity : 1;
+}
+}  // namespace
+
+OneDnnPrimitiveCache::OneDnnPrimitiveCache()
+    : cache_(GetPrimitiveCacheCapacity()) {}
+
+OneDnnPrimitiveCache& OneDnnPrimitiveCache::GetInstance() {
+  static OneDnnPrimitiveCache* instance = new OneDnnPrimitiveCache();
+  return *instance;
+}
+
+bool OneDnnPrimitiveCache::Find(const string& key, Entry* entry)
+    TF_LOCKS_EXCLUDED(mu_) {
+  mutex_lock lock(&mu_);
+  Entry* cached = cache_.Find(key);
+  if (cached == nullptr) {
+    if (cache_.miss_count() % kStatsDumpInterval == 0) {
+      ITEX_VLOG(3) << DebugStringLocked();
+    }
+    return false;
+  }
+  *entry = *cached;
+  return true;
+}
+
+void OneDnnPrimitiveCache::Insert(const string& key, const Entry& entry)
+    TF_LOCKS_EXCLUDED(mu_) {
+  mutex_lock lock(&mu_);
+  bool is_full = cache_.size() == cache_.capacity();
+  cache_.Insert(key, entry);
+  // Report the first eviction, it's a hint to enlarge the capacity.
+  if (is_full && cache_.evict_count() == 1) {
+    ITEX_VLOG(2) << "oneDNN primitive cache is full, consider enlarging "
+                 << "ITEX_ONEDNN_PRIMITIVE_CACHE_CAPACITY. "
+                 << DebugStringLocked();
+  }
+}
+
+string OneDnnPrimitiveCache::DebugString() TF_LOCKS_EXCLUDED(mu_) {
+  mutex_lock lock(&mu_);
+  return DebugStringLocked();
+}
+
+string OneDnnPrimitiveCache::DebugStringLocked()
+    TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+  return strings::StrCat("oneDNN primitive cache size: ", cache_.size(), "/",
+                         cache_.capacity(), ", hit: ", cache_.hit_count(),
+                         ", miss: ", cache_.miss_count(),
+                         ", evict: ", cache_.evict_count());
+}
+
 void ReorderMemory(const OpKernelContext& context,
                    const dnnl::memory* src_memory, dnnl::memory* reorder_memory,
                    const dnnl::engine& onednn_engine) {
   dnnl::stream onednn_stream = CreateDnnlStream(context, onednn_engine);
-  dnnl::reorder reorder_primitive = dnnl::reorder(*src_memory, *reorder_memory);
+
+  auto src_md = src_memory->get_desc();
+  auto dst_md = reorder_memory->get_desc();
+  auto src_engine = src_memory->get_engine();
+  auto dst_engine = reorder_memory->get_engine();
+  OneDnnPrimitiveKeyCreator key_creator("reorder", src_engine);
+  key_creator.AddAsKey(dst_engine.get());
+  key_creator.AddAsKey(src_md);
+  key_creator.AddAsKey(dst_md);
+  string key = key_creator.GetKey();
+
+  auto& cache = OneDnnPrimitiveCache::GetInstance();
+  OneDnnPrimitiveCache::Entry entry;
+  if (!cache.Find(key, &entry)) {
+    TraceMe traceme(kOneDnnPrimitiveCreateTraceName,
+                    kOneDnnPrimitiveTraceLevel);
+    auto reorder_pd = std::make_shared<dnnl::reorder::primitive_desc>(
+        src_engine, src_md, dst_engine, dst_md);
+    entry.pd = reorder_pd;
+    entry.primitive = dnnl::reorder(*reorder_pd);
+    // Reorder uses library scratchpad, which isn't safe to share between
+    // threads, so only cache the ones without scratchpad.
+    if (reorder_pd->scratchpad_desc().get_size() == 0) {
+      cache.Insert(key, entry);
+    }
+  }
+
   std::unordered_map<int, dnnl::memory> reorder_args = {
       {DNNL_ARG_SRC, *src_memory}, {DNNL_ARG_DST, *reorder_memory}};
-  reorder_primitive.execute(onednn_stream, reorder_args);
+  TraceMe traceme(kOneDnnPrimitiveExecuteTraceName, kOneDnnPrimitiveTraceLevel);
+  entry.primitive.execute(onednn_stream, reorder_args);
 }
 
 // TF datatype and shape is meaningless for some tensors, such as scratchpad
@@ -17,6 +17,7 @@ limitations under the License.
 #define ITEX_CORE_UTILS_ONEDNN_ONEDNN_UTIL_H_
 
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -28,12 +29,16 @@ limitations under the License.
 #endif                    // INTEL_CPU_ONLY
 
 #include "itex/core/utils/logging.h"
+#include "itex/core/utils/lru_cache.h"
+#include "itex/core/utils/mutex.h"
+#include "itex/core/utils/onednn/onednn_threadpool.h"
 #include "itex/core/utils/op_kernel.h"
 #include "itex/core/utils/op_requires.h"
 #include "itex/core/utils/status.h"
 #include "itex/core/utils/strcat.h"
 #include "itex/core/utils/tensor_format.h"
 #include "itex/core/utils/tensor_shape.h"
+#include "itex/core/utils/traceme.h"
 
 namespace itex {
 
@@ -204,8 +209,26 @@ inline dnnl::engine& CreateDnnlEngine<GPUDevice>(const OpKernelContext& ctx) {
 template <>
 inline dnnl::engine& CreateDnnlEngine<CPUDevice>(const OpKernelContext& ctx) {
   // Right now ITEX doesn't own proper TF CPU device and NUMA info is
-  // unavailable, so simply consider ITEX only have 1 CPU device.
+  // unavailable from TF. If NUMA aware is enabled, use a separate engine for
+  // each NUMA node, so that objects cached with the engine as key, such as
+  // primitives and weights, are created and reused on the same node.
+  // Otherwise simply consider ITEX only have 1 CPU device.
   // TODO(itex): Check NUMA after integrating new CPU device.
+  if (IsNUMAAwareEnabled()) {
+    static std::vector<dnnl::engine>* numa_engines = []() {
+      auto* engines = new std::vector<dnnl::engine>();
+      for (int node = 0; node < port::NUMANumNodes(); ++node) {
+        // oneDNN has only one CPU engine index, the node is decided by the
+        // threads executing the primitives.
+        engines->emplace_back(dnnl::engine::kind::cpu, 0);
+      }
+      return engines;
+    }();
+    int node = port::NUMAGetCurrentNode();
+    if (node < 0 || node >= numa_engines->size()) node = 0;
+    return numa_engines->at(node);
+  }
+
   ITEX_CHECK(&(ctx.eigen_cpu_device()) == &(ctx.eigen_cpu_device_singleton()))
       << "Global oneDNN CPU engine mismatched with current context";
   static dnnl::engine cpu_engine = dnnl::engine(dnnl::engine::kind::cpu, 0);
@@ -224,7 +247,13 @@ inline dnnl::stream CreateDnnlStream(const OpKernelContext& ctx,
   // Default path, always assume it's CPU engine.
   ITEX_CHECK(engine.get_kind() == dnnl::engine::kind::cpu)
       << "Create oneDNN stream for unsupported engine.";
+#ifdef ITEX_ONEDNN_THREADPOOL
+  // Share the Eigen thread pool of current context with oneDNN.
+  return dnnl::threadpool_interop::make_stream(
+      engine, OneDnnThreadPool::Get(ctx.eigen_cpu_device().getPool()));
+#else
   return dnnl::stream(engine);
+#endif  // ITEX_ONEDNN_THREADPOOL
 }
 
 inline dnnl::memory CreateDnnlMemory(const dnnl::memory::desc& md,
@@ -498,6 +527,97 @@ inline dnnl::memory::desc CreatePlainMemDescWithFormatTag(
                               dnnl::memory::format_tag::abcdefghijkl);
 }
 
+// Process-wide cache of oneDNN primitives, shared by kernels which create
+// primitive from scratch in every Compute. Entries are keyed by the string
+// built with OneDnnPrimitiveKeyCreator, and the least recently used one is
+// evicted once the cache reaches `ITEX_ONEDNN_PRIMITIVE_CACHE_CAPACITY`.
+//
+// Cached primitives may be executed by several threads at the same time, so
+// only primitives with user scratchpad or without scratchpad can be cached.
+class OneDnnPrimitiveCache {
+ public:
+  struct Entry {
+    std::shared_ptr<dnnl::primitive_desc_base> pd;
+    dnnl::primitive primitive;
+  };
+
+  static OneDnnPrimitiveCache& GetInstance();
+
+  bool Find(const string& key, Entry* entry) TF_LOCKS_EXCLUDED(mu_);
+  void Insert(const string& key, const Entry& entry) TF_LOCKS_EXCLUDED(mu_);
+
+  // Returns size, hit, miss and evict count of the cache.
+  string DebugString() TF_LOCKS_EXCLUDED(mu_);
+
+ private:
+  OneDnnPrimitiveCache();
+  TF_DISALLOW_COPY_AND_ASSIGN(OneDnnPrimitiveCache);
+
+  string DebugStringLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutex mu_;
+  LRUCache<Entry> cache_ TF_GUARDED_BY(mu_);
+};
+
+// TraceMe names which split the host time of oneDNN kernels into primitive
+// creation and execution in the profiler timeline. They are recorded at a
+// higher level than kernels, so `ITEX_CPU_PROFILER_TRACE_LEVEL=1` drops them.
+constexpr char kOneDnnPrimitiveCreateTraceName[] = "OneDnnPrimitiveCreate";
+constexpr char kOneDnnPrimitiveExecuteTraceName[] = "OneDnnPrimitiveExecute";
+constexpr int kOneDnnPrimitiveTraceLevel = 2;
+
+// Key of OneDnnPrimitiveCache. It always starts with the primitive name and
+// the engine, callers should add all memory descs and attributes which are
+// used to create the primitive desc.
+class OneDnnPrimitiveKeyCreator : public CacheKeyCreator {
+ public:
+  OneDnnPrimitiveKeyCreator(const string& prim_name,
+                            const dnnl::engine& onednn_engine) {
+    AddAsKey(prim_name);
+    AddAsKey(onednn_engine.get_kind());
+    AddAsKey(onednn_engine.get());
+  }
+
+  using CacheKeyCreator::AddAsKey;
+  void AddAsKey(const dnnl::memory::desc& md) {
+    CacheKeyCreator::AddAsKey(md.data);
+  }
+};
+
+// Get primitive desc and primitive of `key` from the global primitive cache.
+// On cache miss, `create_pd` is called to create the primitive desc, and the
+// new primitive is cached.
+template <typename Primitive, typename CreatePdFunc>
+void FindOrCreateCachedPrimitive(const string& key, CreatePdFunc create_pd,
+                                 typename Primitive::primitive_desc* pd,
+                                 dnnl::primitive* primitive) {
+  using PrimitiveDesc = typename Primitive::primitive_desc;
+  auto& cache = OneDnnPrimitiveCache::GetInstance();
+  OneDnnPrimitiveCache::Entry entry;
+  if (!cache.Find(key, &entry)) {
+    TraceMe traceme(kOneDnnPrimitiveCreateTraceName,
+                    kOneDnnPrimitiveTraceLevel);
+    auto new_pd = std::make_shared<PrimitiveDesc>(create_pd());
+    entry.pd = new_pd;
+    entry.primitive = Primitive(*new_pd);
+    cache.Insert(key, entry);
+  }
+  *pd = *std::static_pointer_cast<PrimitiveDesc>(entry.pd);
+  *primitive = entry.primitive;
+}
+
+// Max number of input shapes whose oneDNN objects are cached by each kernel
+// when `ITEX_CACHE_ONEDNN_OBJECT` is on.
+inline size_t GetOneDnnObjectCacheCapacity() {
+  static size_t capacity = []() {
+    int64 value;
+    ITEX_CHECK_OK(
+        ReadInt64FromEnvVar("ITEX_ONEDNN_OBJECT_CACHE_CAPACITY", 4, &value));
+    return value > 0 ? static_cast<size_t>(value) : 1;
+  }();
+  return capacity;
+}
+
 // Reorder src memory to expected memory
 void ReorderMemory(const OpKernelContext& context,
                    const dnnl::memory* src_memory, dnnl::memory* reorder_memory,
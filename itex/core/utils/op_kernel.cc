@@ -17,8 +17,12 @@ limitations under the License.
 
 #include "itex/core/utils/op_kernel.h"
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
 #include <string>
+#include <vector>
 
 #include "itex/core/devices/device_backend_util.h"
 #include "itex/core/utils/kernel_def_util.h"
@@ -164,6 +168,17 @@ bool OpKernelContext::is_input_same(int index, std::vector<int64> shape) {
   return true;
 }
 
+void OpKernelContext::input_dims(int index, std::vector<int64>* dims) {
+  TF_Tensor* tensor = nullptr;
+  TF_GetInput(ctx_, index, &tensor, status_);
+  int num_dims = TF_NumDims(tensor);
+  dims->resize(num_dims);
+  for (int i = 0; i < num_dims; ++i) {
+    (*dims)[i] = TF_Dim(tensor, i);
+  }
+  TF_DeleteTensor(tensor);
+}
+
 // Status OpKernelContext::set_output(StringPiece name, const Tensor& tensor) {
 //   TF_Status* status = TF_NewStatus();
 
@@ -755,6 +770,78 @@ bool IsVerboseEnabled() {
   return verbose_enabled != 0;
 }
 
+bool IsNUMAAwareEnabled() {
+  static bool numa_aware_enabled = []() {
+    bool enabled;
+    ITEX_CHECK_OK(ReadBoolFromEnvVar("ITEX_NUMA_AWARE", false, &enabled));
+    if (enabled) {
+      ITEX_VLOG(1) << "NUMA aware CPU execution is enabled with "
+                   << port::NUMANumNodes() << " NUMA node(s).";
+    }
+    return enabled;
+  }();
+  return numa_aware_enabled;
+}
+
+namespace {
+// Eigen thread environment which binds the threads to a NUMA node.
+struct NUMAThreadEnvironment : public Eigen::StlThreadEnvironment {
+  explicit NUMAThreadEnvironment(int node = port::kNUMANoAffinity)
+      : node(node) {}
+
+  EnvThread* CreateThread(std::function<void()> f) {
+    const int thread_node = node;
+    return new EnvThread([thread_node, f = std::move(f)]() {
+      if (thread_node != port::kNUMANoAffinity) {
+        port::NUMASetThreadNodeAffinity(thread_node);
+      }
+      f();
+    });
+  }
+
+  int node;
+};
+
+class NUMAThreadPoolDevice {
+ public:
+  explicit NUMAThreadPoolDevice(int node) {
+    bool pin_threads;
+    ITEX_CHECK_OK(
+        ReadBoolFromEnvVar("ITEX_NUMA_PIN_THREADS", false, &pin_threads));
+    const int num_cpus = port::NUMANodeCPUs(node).size();
+    const int num_threads = std::max(num_cpus, 1);
+    threadpool_.reset(new Eigen::ThreadPoolTempl<NUMAThreadEnvironment>(
+        num_threads, NUMAThreadEnvironment(pin_threads
+                                               ? node
+                                               : port::kNUMANoAffinity)));
+    device_.reset(new Eigen::ThreadPoolDevice(
+        threadpool_.get(), (num_threads + port::NumHyperthreadsPerCore() - 1) /
+                               port::NumHyperthreadsPerCore()));
+  }
+
+  const Eigen::ThreadPoolDevice& device() const { return *device_; }
+
+ private:
+  std::unique_ptr<Eigen::ThreadPoolTempl<NUMAThreadEnvironment>> threadpool_;
+  std::unique_ptr<Eigen::ThreadPoolDevice> device_;
+};
+}  // namespace
+
+const Eigen::ThreadPoolDevice& OpKernelContext::eigen_cpu_device_numa(
+    int node) {
+  static std::vector<std::unique_ptr<NUMAThreadPoolDevice>>* devices =
+      new std::vector<std::unique_ptr<NUMAThreadPoolDevice>>(
+          port::NUMANumNodes());
+  static std::vector<std::once_flag>* device_flags =
+      new std::vector<std::once_flag>(port::NUMANumNodes());
+
+  if (node < 0 || node >= devices->size()) node = 0;
+  std::call_once(device_flags->at(node), [node]() {
+    devices->at(node).reset(new NUMAThreadPoolDevice(node));
+  });
+  return devices->at(node)->device();
+}
+
 bool IsSyncExecEnabled() {
   static std::once_flag sync_exec_flag;
   static bool sync_exec_enabled;
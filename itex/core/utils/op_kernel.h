@@ -33,6 +33,7 @@ limitations under the License.
 #include "itex/core/utils/kernel_def_util.h"
 #include "itex/core/utils/logging.h"
 #include "itex/core/utils/mutex.h"
+#include "itex/core/utils/op_latency_stats.h"
 #include "itex/core/utils/plugin_tensor.h"
 #include "itex/core/utils/types.h"
 #include "protos/node_def.pb.h"
@@ -55,6 +56,10 @@ class PersistentTensor;
 void EmptyCopyFunctor(TF_OpKernelContext* tf_ctx, TF_Tensor* tf_source,
                       TF_Tensor* tf_dest);
 
+// CPU kernels use the thread pool and oneDNN engine of the NUMA node which
+// the calling inter-op thread is running on, if `ITEX_NUMA_AWARE=1`.
+bool IsNUMAAwareEnabled();
+
 template <typename ListType, typename ElementType>
 class OpArgIterator {
  public:
@@ -204,6 +209,9 @@ class OpKernelContext {
 
   bool is_input_same(int index, std::vector<int64> shape);
 
+  // Get dims of the input without creating Tensor.
+  void input_dims(int index, std::vector<int64>* dims);
+
   //  Status input_list(StringPiece name, OpInputList* list);
   //
   //  TF_Mutex* input_ref_mutex(int index);
@@ -318,10 +326,17 @@ class OpKernelContext {
     return threadpool_device;
   }
 
+  // Thread pool device of NUMA `node`, created on first use. Its threads are
+  // bound to the CPUs of the node if `ITEX_NUMA_PIN_THREADS=1`.
+  static const Eigen::ThreadPoolDevice& eigen_cpu_device_numa(int node);
+
   const Eigen::ThreadPoolDevice& eigen_cpu_device() const {
     // TODO(itex): CPU should get thread pool device from local device:
     // *device()->eigen_cpu_device();
-    // This helps to identity NUMA affinity.
+    // Before that, use the NUMA node of the calling thread instead.
+    if (IsNUMAAwareEnabled()) {
+      return eigen_cpu_device_numa(port::NUMAGetCurrentNode());
+    }
     return eigen_cpu_device_singleton();
   }
 
@@ -786,6 +801,7 @@ class OpTypeFactory {
                  << op->type();                                             \
     AnnotatedTraceMe activity(                                              \
         [op, &context] { return op->TraceString(context); });               \
+    ScopedOpLatencyRecorder latency_recorder(op->type(), op->name());       \
     RunOrWaitUntilFinish(&context, op);                                     \
   }                                                                         \
   static void Register##ctr(const char* device_name, const char* backend) { \
@@ -0,0 +1,276 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "itex/core/utils/op_latency_stats.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "itex/core/utils/env_var.h"
+#include "itex/core/utils/logging.h"
+#include "itex/core/utils/mutex.h"
+#include "itex/core/utils/strcat.h"
+#include "itex/core/utils/stringprintf.h"
+#include "itex/core/utils/time_utils.h"
+
+namespace itex {
+
+int OpLatencyHistogram::BucketIndex(uint64 latency_ns) {
+  if (latency_ns < kSubBuckets) return static_cast<int>(latency_ns);
+  int log2 = 63 - __builtin_clzll(latency_ns);
+  if (log2 > kMaxLog2) return kNumBuckets - 1;
+  int sub_bucket = (latency_ns >> (log2 - kSubBucketBits)) & (kSubBuckets - 1);
+  return (log2 - kSubBucketBits + 1) * kSubBuckets + sub_bucket;
+}
+
+uint64 OpLatencyHistogram::BucketLowerBound(int index) {
+  if (index < kSubBuckets) return index;
+  int log2 = index / kSubBuckets + kSubBucketBits - 1;
+  uint64 sub_bucket = index % kSubBuckets;
+  return (kSubBuckets + sub_bucket) << (log2 - kSubBucketBits);
+}
+
+namespace {
+
+struct OpLatencyEntry {
+  OpLatencyEntry(absl::string_view op_type, absl::string_view op_name)
+      : op_type(op_type), op_name(op_name) {}
+
+  const string op_type;
+  const string op_name;
+  OpLatencyHistogram histogram;
+};
+
+// Histograms of the ops executed by one thread. Only the owner thread adds
+// entries, so it looks them up without locking; `mu` serializes adding
+// entries with the dumper iterating them.
+struct ThreadOpLatencyStats {
+  mutex mu;
+  absl::flat_hash_map<string, std::unique_ptr<OpLatencyEntry>> entries;
+};
+
+// Stats of every thread which has executed an op. They are kept after the
+// thread exits, so the dump covers the whole process lifetime.
+struct OpLatencyStatsRegistry {
+  mutex mu;
+  std::vector<std::shared_ptr<ThreadOpLatencyStats>> threads
+      TF_GUARDED_BY(mu);
+};
+
+OpLatencyStatsRegistry* GetRegistry() {
+  static OpLatencyStatsRegistry* registry = new OpLatencyStatsRegistry;
+  return registry;
+}
+
+ThreadOpLatencyStats* GetThreadStats() {
+  thread_local std::shared_ptr<ThreadOpLatencyStats> stats = []() {
+    auto new_stats = std::make_shared<ThreadOpLatencyStats>();
+    OpLatencyStatsRegistry* registry = GetRegistry();
+    mutex_lock lock(&registry->mu);
+    registry->threads.push_back(new_stats);
+    return new_stats;
+  }();
+  return stats.get();
+}
+
+OpLatencyEntry* FindOrAddEntry(ThreadOpLatencyStats* stats,
+                               absl::string_view key, absl::string_view op_type,
+                               absl::string_view op_name) {
+  auto it = stats->entries.find(key);
+  if (ITEX_PREDICT_TRUE(it != stats->entries.end())) return it->second.get();
+
+  mutex_lock lock(&stats->mu);
+  auto& entry = stats->entries[string(key)];
+  entry.reset(new OpLatencyEntry(op_type, op_name));
+  return entry.get();
+}
+
+struct MergedOpLatency {
+  string op_type;
+  string op_name;
+  uint64 count = 0;
+  uint64 total_ns = 0;
+  uint64 max_ns = 0;
+  std::vector<uint64> buckets =
+      std::vector<uint64>(OpLatencyHistogram::kNumBuckets, 0);
+
+  void Merge(const OpLatencyHistogram& histogram) {
+    count += histogram.count();
+    total_ns += histogram.total_ns();
+    max_ns = std::max(max_ns, histogram.max_ns());
+    for (int i = 0; i < OpLatencyHistogram::kNumBuckets; ++i) {
+      buckets[i] += histogram.bucket(i);
+    }
+  }
+
+  // Upper bound of the bucket which holds the `quantile`, clipped to the max
+  // latency.
+  uint64 PercentileNs(double quantile) const {
+    uint64 rank = std::max<uint64>(1, static_cast<uint64>(quantile * count));
+    uint64 accumulated = 0;
+    for (int i = 0; i < OpLatencyHistogram::kNumBuckets - 1; ++i) {
+      accumulated += buckets[i];
+      if (accumulated >= rank) {
+        return std::min(max_ns, OpLatencyHistogram::BucketLowerBound(i + 1));
+      }
+    }
+    return max_ns;
+  }
+};
+
+void AppendTable(const string& title, bool with_op_name,
+                 std::vector<const MergedOpLatency*> rows, string* output) {
+  std::sort(rows.begin(), rows.end(),
+            [](const MergedOpLatency* a, const MergedOpLatency* b) {
+              return a->total_ns > b->total_ns;
+            });
+  strings::StrAppend(output, title, "\n");
+  strings::StrAppend(output, with_op_name ? "op_name,op_type" : "op_type",
+                     ",count,total_us,mean_us,p50_us,p99_us,max_us\n");
+  for (const MergedOpLatency* row : rows) {
+    if (with_op_name) strings::StrAppend(output, row->op_name, ",");
+    strings::Appendf(output, "%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                     row->op_type.c_str(),
+                     static_cast<unsigned long long>(row->count),  // NOLINT
+                     profiler::NanosToMicros(row->total_ns),
+                     profiler::NanosToMicros(row->total_ns) / row->count,
+                     profiler::NanosToMicros(row->PercentileNs(0.5)),
+                     profiler::NanosToMicros(row->PercentileNs(0.99)),
+                     profiler::NanosToMicros(row->max_ns));
+  }
+}
+
+string FormatOpLatencyStats() {
+  std::map<string, MergedOpLatency> by_type;
+  std::map<std::pair<string, string>, MergedOpLatency> by_name;
+  {
+    OpLatencyStatsRegistry* registry = GetRegistry();
+    mutex_lock registry_lock(&registry->mu);
+    for (const auto& thread : registry->threads) {
+      mutex_lock thread_lock(&thread->mu);
+      for (const auto& kv : thread->entries) {
+        const OpLatencyEntry& entry = *kv.second;
+        if (entry.histogram.count() == 0) continue;
+        MergedOpLatency& type_stats = by_type[entry.op_type];
+        type_stats.op_type = entry.op_type;
+        type_stats.Merge(entry.histogram);
+        MergedOpLatency& name_stats =
+            by_name[std::make_pair(entry.op_name, entry.op_type)];
+        name_stats.op_type = entry.op_type;
+        name_stats.op_name = entry.op_name;
+        name_stats.Merge(entry.histogram);
+      }
+    }
+  }
+
+  std::vector<const MergedOpLatency*> type_rows, name_rows;
+  for (const auto& kv : by_type) type_rows.push_back(&kv.second);
+  for (const auto& kv : by_name) name_rows.push_back(&kv.second);
+  string output;
+  AppendTable("ITEX op latency stats by op type:", false, std::move(type_rows),
+              &output);
+  AppendTable("ITEX op latency stats by op name:", true, std::move(name_rows),
+              &output);
+  return output;
+}
+
+string GetOpLatencyStatsFile() {
+  static string* file = []() {
+    string value;
+    ITEX_CHECK_OK(
+        ReadStringFromEnvVar("ITEX_OP_LATENCY_STATS_FILE", "", &value));
+    return new string(value);
+  }();
+  return *file;
+}
+
+void StartPeriodicDump() {
+  int64 interval_secs;
+  ITEX_CHECK_OK(ReadInt64FromEnvVar("ITEX_OP_LATENCY_STATS_INTERVAL_SECS", 0,
+                                    &interval_secs));
+  if (interval_secs <= 0) return;
+  std::thread([interval_secs]() {
+    while (true) {
+      profiler::SleepForSeconds(interval_secs);
+      DumpOpLatencyStats();
+    }
+  }).detach();
+}
+
+}  // namespace
+
+bool IsOpLatencyStatsEnabled() {
+  static bool op_latency_stats_enabled = []() {
+    bool enabled;
+    ITEX_CHECK_OK(
+        ReadBoolFromEnvVar("ITEX_OP_LATENCY_STATS", false, &enabled));
+    if (enabled) {
+      std::atexit(DumpOpLatencyStats);
+      StartPeriodicDump();
+    }
+    return enabled;
+  }();
+  return op_latency_stats_enabled;
+}
+
+void RecordOpLatency(absl::string_view op_type, absl::string_view op_name,
+                     uint64 latency_ns) {
+  ThreadOpLatencyStats* stats = GetThreadStats();
+  OpLatencyEntry* entry = FindOrAddEntry(stats, op_name, op_type, op_name);
+  // Different graphs may have nodes with the same name but different types.
+  if (ITEX_PREDICT_FALSE(entry->op_type != op_type)) {
+    entry = FindOrAddEntry(stats, strings::StrCat(op_name, ":", op_type),
+                           op_type, op_name);
+  }
+  entry->histogram.Record(latency_ns);
+}
+
+void DumpOpLatencyStats() {
+  static mutex* dump_mu = new mutex;
+  mutex_lock lock(dump_mu);
+  string stats = FormatOpLatencyStats();
+  const string& path = GetOpLatencyStatsFile();
+  if (path.empty()) {
+    ITEX_LOG(INFO) << "\n" << stats;
+    return;
+  }
+
+  // Write to a temporary file first, so that readers never see a partial
+  // dump.
+  string tmp_path = strings::StrCat(path, ".tmp.", getpid());
+  std::ofstream output(tmp_path, std::ios::out | std::ios::trunc);
+  if (!output.is_open()) {
+    ITEX_LOG(WARNING) << "Unable to create op latency stats file " << tmp_path;
+    return;
+  }
+  output << stats;
+  output.close();
+  if (!output.good() || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    ITEX_LOG(WARNING) << "Failed to write op latency stats file " << path;
+    std::remove(tmp_path.c_str());
+  }
+}
+
+}  // namespace itex
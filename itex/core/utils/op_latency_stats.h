@@ -0,0 +1,131 @@
+/* Copyright (c) 2021-2022 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef ITEX_CORE_UTILS_OP_LATENCY_STATS_H_
+#define ITEX_CORE_UTILS_OP_LATENCY_STATS_H_
+
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "itex/core/utils/macros.h"
+#include "itex/core/utils/types.h"
+
+namespace itex {
+
+// Latency histogram of one op, written by a single thread and read by the
+// dumper, so updates are plain relaxed atomic load/store instead of locked
+// read-modify-write.
+//
+// Buckets are log-linear: every power of two is split into 4 buckets, so
+// percentiles are accurate to within 25%. Latencies above 2^37 ns (~137 s)
+// fall into the last bucket.
+class OpLatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 2;
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kMaxLog2 = 36;
+  static constexpr int kNumBuckets =
+      (kMaxLog2 - kSubBucketBits + 2) * kSubBuckets;
+
+  OpLatencyHistogram() {
+    for (auto& bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+  }
+
+  void Record(uint64 latency_ns) {
+    Increase(&count_, 1);
+    Increase(&total_ns_, latency_ns);
+    if (latency_ns > max_ns_.load(std::memory_order_relaxed)) {
+      max_ns_.store(latency_ns, std::memory_order_relaxed);
+    }
+    Increase(&buckets_[BucketIndex(latency_ns)], 1);
+  }
+
+  uint64 count() const { return count_.load(std::memory_order_relaxed); }
+  uint64 total_ns() const { return total_ns_.load(std::memory_order_relaxed); }
+  uint64 max_ns() const { return max_ns_.load(std::memory_order_relaxed); }
+  uint64 bucket(int index) const {
+    return buckets_[index].load(std::memory_order_relaxed);
+  }
+
+  static int BucketIndex(uint64 latency_ns);
+  // Smallest latency which falls into bucket `index`.
+  static uint64 BucketLowerBound(int index);
+
+ private:
+  static void Increase(std::atomic<uint64>* value, uint64 delta) {
+    value->store(value->load(std::memory_order_relaxed) + delta,
+                 std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64> count_{0};
+  std::atomic<uint64> total_ns_{0};
+  std::atomic<uint64> max_ns_{0};
+  std::atomic<uint64> buckets_[kNumBuckets];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(OpLatencyHistogram);
+};
+
+// Returns true if `ITEX_OP_LATENCY_STATS` is on. The first call also starts
+// the periodic dump thread if `ITEX_OP_LATENCY_STATS_INTERVAL_SECS` is set.
+bool IsOpLatencyStatsEnabled();
+
+// Adds one execution of op `op_name` with type `op_type` to the calling
+// thread's histograms. Lock free except for the first execution of each op
+// on each thread.
+void RecordOpLatency(absl::string_view op_type, absl::string_view op_name,
+                     uint64 latency_ns);
+
+// Merges the histograms of all threads and writes count, total, mean, p50,
+// p99 and max latency per op type and per op name to
+// `ITEX_OP_LATENCY_STATS_FILE`, or to the log if it's not set. Called
+// periodically, at process exit, and may be called at any time.
+void DumpOpLatencyStats();
+
+// Records the host latency of the enclosing scope when op latency stats are
+// enabled. The op type and name must outlive this object.
+class ScopedOpLatencyRecorder {
+ public:
+  ScopedOpLatencyRecorder(absl::string_view op_type, absl::string_view op_name)
+      : enabled_(IsOpLatencyStatsEnabled()) {
+    if (ITEX_PREDICT_FALSE(enabled_)) {
+      op_type_ = op_type;
+      op_name_ = op_name;
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~ScopedOpLatencyRecorder() {
+    if (ITEX_PREDICT_FALSE(enabled_)) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start_)
+                         .count();
+      RecordOpLatency(op_type_, op_name_, static_cast<uint64>(elapsed));
+    }
+  }
+
+ private:
+  bool enabled_;
+  absl::string_view op_type_;
+  absl::string_view op_name_;
+  std::chrono::steady_clock::time_point start_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ScopedOpLatencyRecorder);
+};
+
+}  // namespace itex
+
+#endif  // ITEX_CORE_UTILS_OP_LATENCY_STATS_H_
@@ -27,12 +27,20 @@ limitations under the License.
 #include <cpuid.h>
 #endif
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 #if defined(__FreeBSD__)
 #include <thread>  // NOLINT(build/c++11)
 #endif
 
 #include "itex/core/utils/cpu_info.h"
+#include "itex/core/utils/logging.h"
 
 namespace itex {
 namespace port {
@@ -67,5 +75,109 @@ int NumTotalCPUs() {
   return (count <= 0) ? kUnknownCPU : count;
 }
 
+namespace {
+// Parses sysfs list format, e.g. "0-3,8,10-11".
+std::vector<int> ParseSysfsList(const std::string& list) {
+  std::vector<int> values;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    int first, last;
+    if (sscanf(range.c_str(), "%d-%d", &first, &last) == 2) {
+      for (int i = first; i <= last; ++i) values.push_back(i);
+    } else if (sscanf(range.c_str(), "%d", &first) == 1) {
+      values.push_back(first);
+    }
+  }
+  return values;
+}
+
+std::vector<int> ReadSysfsList(const std::string& path) {
+  std::ifstream file(path);
+  std::string list;
+  if (!file.is_open() || !std::getline(file, list)) return {};
+  return ParseSysfsList(list);
+}
+
+struct NUMATopology {
+  // Schedulable CPUs of each node.
+  std::vector<std::vector<int>> node_cpus;
+  // Node of each CPU, kNUMANoAffinity if it's not schedulable.
+  std::vector<int> cpu_node;
+
+  NUMATopology() {
+    std::vector<int> schedulable_cpus;
+#if defined(__linux__)
+    cpu_set_t cpuset;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpuset) == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &cpuset)) schedulable_cpus.push_back(cpu);
+      }
+    }
+#endif
+    int max_cpu = 0;
+    for (int cpu : schedulable_cpus) max_cpu = std::max(max_cpu, cpu);
+    std::vector<bool> is_schedulable(max_cpu + 1, false);
+    for (int cpu : schedulable_cpus) is_schedulable[cpu] = true;
+    cpu_node.resize(max_cpu + 1, kNUMANoAffinity);
+
+    for (int sys_node : ReadSysfsList("/sys/devices/system/node/online")) {
+      std::vector<int> cpus;
+      for (int cpu : ReadSysfsList("/sys/devices/system/node/node" +
+                                   std::to_string(sys_node) + "/cpulist")) {
+        if (cpu <= max_cpu && is_schedulable[cpu]) cpus.push_back(cpu);
+      }
+      if (cpus.empty()) continue;
+      for (int cpu : cpus) cpu_node[cpu] = node_cpus.size();
+      node_cpus.push_back(std::move(cpus));
+    }
+
+    if (node_cpus.empty()) {
+      node_cpus.push_back(schedulable_cpus);
+      for (int cpu : schedulable_cpus) cpu_node[cpu] = 0;
+    }
+  }
+};
+
+const NUMATopology& GetNUMATopology() {
+  static const NUMATopology topology;
+  return topology;
+}
+}  // namespace
+
+int NUMANumNodes() { return GetNUMATopology().node_cpus.size(); }
+
+std::vector<int> NUMANodeCPUs(int node) {
+  const auto& topology = GetNUMATopology();
+  if (node < 0 || node >= topology.node_cpus.size()) return {};
+  return topology.node_cpus[node];
+}
+
+int NUMAGetCurrentNode() {
+#if defined(__linux__)
+  const auto& topology = GetNUMATopology();
+  if (topology.node_cpus.size() == 1) return 0;
+  int cpu = sched_getcpu();
+  if (cpu >= 0 && cpu < topology.cpu_node.size()) {
+    return topology.cpu_node[cpu];
+  }
+#endif
+  return kNUMANoAffinity;
+}
+
+void NUMASetThreadNodeAffinity(int node) {
+#if defined(__linux__)
+  std::vector<int> cpus = NUMANodeCPUs(node);
+  if (cpus.empty()) return;
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (int cpu : cpus) CPU_SET(cpu, &cpuset);
+  if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) {
+    ITEX_LOG(WARNING) << "Failed to bind thread to NUMA node " << node << ": "
+                      << strerror(errno);
+  }
+#endif
+}
+
 }  // namespace port
 }  // namespace itex
@@ -0,0 +1,131 @@
+# Copyright (c) 2022 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the embedding bag fusion on CPU."""
+
+import numpy as np
+
+from intel_extension_for_tensorflow.python.test_func import test as test_lib
+from intel_extension_for_tensorflow.python.test_func import test_util
+
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import errors
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+
+
+class EmbeddingBagTest(test_lib.TestCase):
+
+  def _RunAndGetFused(self, output, feed_dict):
+    run_options = config_pb2.RunOptions(output_partition_graphs=True)
+    metadata = config_pb2.RunMetadata()
+    with self.session() as sess:
+      output_val = sess.run(output, feed_dict=feed_dict, options=run_options,
+                            run_metadata=metadata)
+    fused = [node for graph in metadata.partition_graphs
+             for node in graph.node if node.op == "_ITEXEmbeddingBag"]
+    return output_val, fused
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testSparseSegmentMean(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    params_np = np.random.normal(size=(100, 16)).astype(np.float32)
+    ids_np = np.array([3, 97, 42, 3, 0, 55], dtype=np.int64)
+    indices_np = np.array([0, 1, 2, 3, 5, 4, 1], dtype=np.int32)
+    segments_np = np.array([0, 0, 0, 2, 2, 3, 3], dtype=np.int32)
+
+    params = array_ops.placeholder(dtypes.float32, params_np.shape)
+    ids = array_ops.placeholder(dtypes.int64, ids_np.shape)
+    embeddings = array_ops.gather(params, ids)
+    output = array_ops.identity(
+        math_ops.sparse_segment_mean(embeddings, indices_np, segments_np))
+
+    output_val, fused = self._RunAndGetFused(
+        output, {params: params_np, ids: ids_np})
+    self.assertEqual(len(fused), 1)
+    gathered = params_np[ids_np[indices_np]]
+    expected = np.zeros((4, 16), dtype=np.float32)
+    for segment in range(4):
+      rows = gathered[segments_np == segment]
+      if rows.size:
+        expected[segment] = rows.mean(axis=0)
+    self.assertAllClose(expected, output_val, rtol=1e-5, atol=1e-5)
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testSumOverBags(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    params_np = np.random.normal(size=(50, 8)).astype(np.float32)
+    ids_np = np.random.randint(0, 50, size=(6, 5)).astype(np.int32)
+
+    params = array_ops.placeholder(dtypes.float32, params_np.shape)
+    ids = array_ops.placeholder(dtypes.int32, ids_np.shape)
+    embeddings = array_ops.gather(params, ids)
+    output = array_ops.identity(math_ops.reduce_sum(embeddings, axis=1))
+
+    output_val, fused = self._RunAndGetFused(
+        output, {params: params_np, ids: ids_np})
+    self.assertEqual(len(fused), 1)
+    expected = params_np[ids_np].sum(axis=1)
+    self.assertAllClose(expected, output_val, rtol=1e-5, atol=1e-5)
+
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testUnsortedSegments(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    params_np = np.random.normal(size=(20, 4)).astype(np.float32)
+    ids_np = np.array([1, 5, 7, 9], dtype=np.int64)
+    indices_np = np.array([0, 1, 2, 3], dtype=np.int32)
+    # The last id would be a bag far past the one of the previous ids.
+    segments_np = np.array([0, 1000, 1, 2], dtype=np.int32)
+
+    params = array_ops.placeholder(dtypes.float32, params_np.shape)
+    ids = array_ops.placeholder(dtypes.int64, ids_np.shape)
+    segments = array_ops.placeholder(dtypes.int32, segments_np.shape)
+    embeddings = array_ops.gather(params, ids)
+    output = array_ops.identity(
+        math_ops.sparse_segment_sum(embeddings, indices_np, segments))
+
+    with self.assertRaises(errors.InvalidArgumentError):
+      self._RunAndGetFused(
+          output, {params: params_np, ids: ids_np, segments: segments_np})
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testMeanOverEmptyBags(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    params_np = np.random.normal(size=(50, 8)).astype(np.float32)
+    ids_np = np.zeros((6, 0), dtype=np.int32)
+
+    params = array_ops.placeholder(dtypes.float32, params_np.shape)
+    ids = array_ops.placeholder(dtypes.int32, ids_np.shape)
+    embeddings = array_ops.gather(params, ids)
+    output = array_ops.identity(math_ops.reduce_mean(embeddings, axis=1))
+
+    output_val, fused = self._RunAndGetFused(
+        output, {params: params_np, ids: ids_np})
+    self.assertEqual(len(fused), 1)
+    # Same as the unfused Mean over an empty axis.
+    self.assertAllEqual(np.full((6, 8), np.nan), output_val)
+
+
+if __name__ == "__main__":
+  test_lib.main()
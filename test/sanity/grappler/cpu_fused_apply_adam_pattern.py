@@ -0,0 +1,95 @@
+# Copyright (c) 2022 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the Mul + ApplyAdam fusion on CPU."""
+
+import numpy as np
+
+from intel_extension_for_tensorflow.python.test_func import test as test_lib
+from intel_extension_for_tensorflow.python.test_func import test_util
+
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import resource_variable_ops
+from tensorflow.python.ops import variables
+from tensorflow.python.training import gen_training_ops
+
+
+def _apply_adam_ref(var, m, v, grad, beta1_power, beta2_power, lr, beta1,
+                    beta2, epsilon, use_nesterov):
+  """Same update as the unfused ApplyAdam kernel."""
+  alpha = lr * np.sqrt(1 - beta2_power) / (1 - beta1_power)
+  m = m + (grad - m) * (1 - beta1)
+  v = v + (grad * grad - v) * (1 - beta2)
+  if use_nesterov:
+    var = var - (m * beta1 + (1 - beta1) * grad) * alpha / (
+        np.sqrt(v) + epsilon)
+  else:
+    var = var - m * alpha / (np.sqrt(v) + epsilon)
+  return var, m, v
+
+
+class FusedApplyAdamTest(test_lib.TestCase):
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testMulAndApplyAdam(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    np.random.seed(0)
+    shape = (13, 67)
+    var_np = np.random.normal(size=shape).astype(np.float32)
+    m_np = np.random.normal(size=shape).astype(np.float32)
+    v_np = np.abs(np.random.normal(size=shape)).astype(np.float32)
+    grad_np = np.random.normal(size=shape).astype(np.float32)
+    scale_np = np.float32(0.5)
+    hyper = dict(beta1_power=0.9**3, beta2_power=0.999**3, lr=0.01,
+                 beta1=0.9, beta2=0.999, epsilon=1e-7)
+
+    for use_nesterov in [False, True]:
+      with ops.Graph().as_default():
+        var = resource_variable_ops.ResourceVariable(var_np)
+        m = resource_variable_ops.ResourceVariable(m_np)
+        v = resource_variable_ops.ResourceVariable(v_np)
+        grad = array_ops.placeholder(dtypes.float32, shape)
+        scale = array_ops.placeholder(dtypes.float32, [])
+        update = gen_training_ops.resource_apply_adam(
+            var.handle, m.handle, v.handle,
+            grad=math_ops.multiply(grad, scale),
+            use_nesterov=use_nesterov,
+            **{k: np.float32(val) for k, val in hyper.items()})
+        run_options = config_pb2.RunOptions(output_partition_graphs=True)
+        metadata = config_pb2.RunMetadata()
+        with self.session() as sess:
+          sess.run(variables.global_variables_initializer())
+          sess.run(update, feed_dict={grad: grad_np, scale: scale_np},
+                   options=run_options, run_metadata=metadata)
+          var_val, m_val, v_val = sess.run([var, m, v])
+        fused = [node for graph in metadata.partition_graphs
+                 for node in graph.node
+                 if node.op == "_FusedResourceApplyAdam"]
+        self.assertEqual(len(fused), 1)
+
+      expected = _apply_adam_ref(var_np, m_np, v_np, grad_np * scale_np,
+                                 use_nesterov=use_nesterov, **hyper)
+      self.assertAllClose(expected[0], var_val, rtol=1e-5, atol=1e-5)
+      self.assertAllClose(expected[1], m_val, rtol=1e-5, atol=1e-5)
+      self.assertAllClose(expected[2], v_val, rtol=1e-5, atol=1e-5)
+
+
+if __name__ == "__main__":
+  test_lib.main()
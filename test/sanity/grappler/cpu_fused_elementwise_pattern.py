@@ -0,0 +1,91 @@
+# Copyright (c) 2022 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the elementwise chain fusion on CPU."""
+
+import os
+
+import numpy as np
+
+from intel_extension_for_tensorflow.python.test_func import test as test_lib
+from intel_extension_for_tensorflow.python.test_func import test_util
+
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python.framework import dtypes
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import nn_ops
+
+os.environ["ITEX_ELEMENTWISE_FUSION"] = "1"
+
+class FusedElementwiseTest(test_lib.TestCase):
+
+  def _RunAndGetFused(self, output, feed_dict):
+    run_options = config_pb2.RunOptions(output_partition_graphs=True)
+    metadata = config_pb2.RunMetadata()
+    with self.session() as sess:
+      output_val = sess.run(output, feed_dict=feed_dict, options=run_options,
+                            run_metadata=metadata)
+    fused = [node for graph in metadata.partition_graphs
+             for node in graph.node if node.op == "_ITEXFusedElementwise"]
+    return output_val, fused
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testBroadcastChain(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    x_np = np.random.normal(size=(4, 1, 33)).astype(np.float32)
+    y_np = np.random.normal(size=(7, 33)).astype(np.float32)
+    cond_np = np.random.uniform(size=(4, 7, 1)) > 0.5
+
+    x = array_ops.placeholder(dtypes.float32, x_np.shape)
+    y = array_ops.placeholder(dtypes.float32, y_np.shape)
+    cond = array_ops.placeholder(dtypes.bool, cond_np.shape)
+    prod = math_ops.multiply(x, y)
+    act = math_ops.sigmoid(math_ops.tanh(nn_ops.relu(prod + 0.5)))
+    act = math_ops.maximum(act, 0.6)
+    output = array_ops.identity(array_ops.where_v2(cond, act, prod))
+
+    output_val, fused = self._RunAndGetFused(
+        output, {x: x_np, y: y_np, cond: cond_np})
+    self.assertEqual(len(fused), 1)
+    self.assertEqual(fused[0].attr["fused_ops"].list.s[-1], b"SelectV2")
+    prod_np = x_np * y_np
+    act_np = 1.0 / (1.0 + np.exp(-np.tanh(np.maximum(prod_np + 0.5, 0.0))))
+    expected = np.where(cond_np, np.maximum(act_np, 0.6), prod_np)
+    self.assertAllClose(expected, output_val, rtol=1e-5, atol=1e-5)
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testCastToBfloat16(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    x_np = np.random.normal(size=(3, 1000)).astype(np.float32)
+    y_np = np.random.normal(size=(1000,)).astype(np.float32)
+
+    x = array_ops.placeholder(dtypes.float32, x_np.shape)
+    y = array_ops.placeholder(dtypes.float32, y_np.shape)
+    diff = math_ops.squared_difference(x, y)
+    half = math_ops.cast(math_ops.exp(-diff), dtypes.bfloat16)
+    output = array_ops.identity(math_ops.cast(half * half, dtypes.float32))
+
+    output_val, fused = self._RunAndGetFused(output, {x: x_np, y: y_np})
+    self.assertEqual(len(fused), 1)
+    expected = np.exp(-np.square(x_np - y_np)) ** 2
+    self.assertAllClose(expected, output_val, rtol=2e-2, atol=2e-2)
+
+
+if __name__ == "__main__":
+  test_lib.main()
@@ -0,0 +1,113 @@
+# Copyright (c) 2022 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the dropout fusions of random, comparison, cast and mul on CPU."""
+
+import numpy as np
+
+from intel_extension_for_tensorflow.python.test_func import test as test_lib
+from intel_extension_for_tensorflow.python.test_func import test_util
+
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import random_ops
+
+
+class FusedRandomTest(test_lib.TestCase):
+
+  def _DropoutMask(self, shape, rate, dtype):
+    random = random_ops.random_uniform(shape, dtype=dtype, seed=7)
+    keep = math_ops.greater_equal(random, math_ops.cast(rate, dtype))
+    return random, math_ops.cast(keep, dtype)
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testDropoutMask(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    shape, rate = (37, 129), 0.3
+    for dtype in [dtypes.float32, dtypes.bfloat16]:
+      # The fused mask is the same as the unfused one with the same seeds.
+      with ops.Graph().as_default():
+        random, mask = self._DropoutMask(shape, rate, dtype)
+        with self.session() as sess:
+          random_val, expected = sess.run([random, mask])
+
+      with ops.Graph().as_default():
+        _, mask = self._DropoutMask(shape, rate, dtype)
+        output = array_ops.identity(mask)
+        run_options = config_pb2.RunOptions(output_partition_graphs=True)
+        metadata = config_pb2.RunMetadata()
+        with self.session() as sess:
+          output_val = sess.run(output, options=run_options,
+                                run_metadata=metadata)
+        fused = [node for graph in metadata.partition_graphs
+                 for node in graph.node if node.op == "_ITEXFusedRandom"]
+        self.assertEqual(len(fused), 1)
+
+      self.assertAllEqual(expected, output_val)
+      self.assertAllEqual(
+          (random_val >= np.array(rate).astype(random_val.dtype)),
+          output_val.astype(bool))
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testDropout(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    shape, rate = (37, 129), 0.3
+    x_np = np.random.normal(size=shape)
+    for dtype in [dtypes.float32, dtypes.bfloat16]:
+      def _Dropout():
+        x = array_ops.placeholder(dtype, shape)
+        scale = array_ops.placeholder(dtype, [])
+        random, mask = self._DropoutMask(shape, rate, dtype)
+        return x, scale, random, math_ops.multiply(
+            math_ops.multiply(x, scale), mask)
+
+      feed = lambda x, scale: {x: x_np.astype(x.dtype.as_numpy_dtype),
+                               scale: 1 / (1 - rate)}
+      # Fetching the random tensor keeps the ops unfused.
+      with ops.Graph().as_default():
+        x, scale, random, dropout = _Dropout()
+        with self.session() as sess:
+          random_val, expected = sess.run([random, dropout],
+                                          feed_dict=feed(x, scale))
+
+      # The mask and the scale are applied by _ITEXFusedRandom.
+      with ops.Graph().as_default():
+        x, scale, _, dropout = _Dropout()
+        output = array_ops.identity(dropout)
+        run_options = config_pb2.RunOptions(output_partition_graphs=True)
+        metadata = config_pb2.RunMetadata()
+        with self.session() as sess:
+          output_val = sess.run(output, feed_dict=feed(x, scale),
+                                options=run_options, run_metadata=metadata)
+        nodes = [node for graph in metadata.partition_graphs
+                 for node in graph.node]
+        fused = [node for node in nodes if node.op == "_ITEXFusedRandom"]
+        self.assertEqual(len(fused), 1)
+        self.assertEqual(fused[0].attr["num_args"].i, 2)
+        self.assertFalse([node for node in nodes if node.op == "Mul"])
+
+      self.assertAllEqual(expected, output_val)
+      self.assertAllEqual(random_val >= np.array(rate).astype(random_val.dtype),
+                          output_val != 0)
+
+
+if __name__ == "__main__":
+  test_lib.main()
@@ -0,0 +1,67 @@
+# Copyright (c) 2022 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the MatMul with post op chain fusion on CPU."""
+
+import numpy as np
+
+from intel_extension_for_tensorflow.python.test_func import test as test_lib
+from intel_extension_for_tensorflow.python.test_func import test_util
+
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python.framework import dtypes
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import nn_ops
+
+
+class MatMulPostOpChainTest(test_lib.TestCase):
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testGatedResidual(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    x_np = np.random.normal(size=(16, 32)).astype(np.float32)
+    w_np = np.random.normal(size=(32, 24)).astype(np.float32)
+    b_np = np.random.normal(size=(24,)).astype(np.float32)
+    gate_np = np.random.uniform(size=(24,)).astype(np.float32)
+    residual_np = np.random.normal(size=(16, 24)).astype(np.float32)
+
+    x = array_ops.placeholder(dtypes.float32, x_np.shape)
+    residual = array_ops.placeholder(dtypes.float32, residual_np.shape)
+    dense = nn_ops.bias_add(math_ops.matmul(x, w_np), b_np)
+    gated = math_ops.multiply(dense, gate_np)
+    act = math_ops.tanh(math_ops.add_v2(gated, residual))
+    output = array_ops.identity(math_ops.maximum(act, 0.1))
+
+    run_options = config_pb2.RunOptions(output_partition_graphs=True)
+    metadata = config_pb2.RunMetadata()
+    with self.session() as sess:
+      output_val = sess.run(output, feed_dict={x: x_np, residual: residual_np},
+                            options=run_options, run_metadata=metadata)
+    fused = [node for graph in metadata.partition_graphs
+             for node in graph.node if node.op == "_ITEXFusedMatMul"]
+    self.assertEqual(len(fused), 1)
+    self.assertAllEqual(
+        fused[0].attr["fused_ops"].list.s,
+        [b"BiasAdd", b"BinaryMul", b"BinaryAdd", b"Tanh", b"BinaryMaximum"])
+
+    expected = np.maximum(
+        np.tanh((np.matmul(x_np, w_np) + b_np) * gate_np + residual_np), 0.1)
+    self.assertAllClose(expected, output_val, rtol=1e-5, atol=1e-5)
+
+
+if __name__ == "__main__":
+  test_lib.main()
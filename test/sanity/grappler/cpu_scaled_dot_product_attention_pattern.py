@@ -0,0 +1,122 @@
+# Copyright (c) 2022 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the scaled dot product attention fusion on CPU."""
+
+import numpy as np
+
+from intel_extension_for_tensorflow.python.test_func import test as test_lib
+from intel_extension_for_tensorflow.python.test_func import test_util
+
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python.framework import dtypes
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import nn_ops
+from tensorflow.python.ops import special_math_ops
+
+
+def _np_attention(query, key, value, scale, mask):
+  """Attention of [batch, heads, seq, depth] inputs."""
+  scores = np.matmul(query, np.swapaxes(key, -1, -2)) * scale + mask
+  scores = np.exp(scores - np.max(scores, axis=-1, keepdims=True))
+  probs = scores / np.sum(scores, axis=-1, keepdims=True)
+  return np.matmul(probs, value)
+
+
+class ScaledDotProductAttentionTest(test_lib.TestCase):
+
+  def _RunAndCheckFused(self, output, feed_dict):
+    run_options = config_pb2.RunOptions(output_partition_graphs=True)
+    metadata = config_pb2.RunMetadata()
+    with self.session() as sess:
+      output_val = sess.run(output, feed_dict=feed_dict, options=run_options,
+                            run_metadata=metadata)
+    fused = [node for graph in metadata.partition_graphs
+             for node in graph.node
+             if node.op == "_ITEXScaledDotProductAttention"]
+    self.assertEqual(len(fused), 1)
+    return output_val, fused[0]
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testTransposedBatchMatMul(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    # [batch, seq, heads, depth] inputs transposed to [batch, heads, seq,
+    # depth] as in BERT, with a sequence longer than one block of keys.
+    batch, seq, heads, depth = 2, 300, 4, 16
+    query_np = np.random.normal(size=(batch, seq, heads, depth))
+    key_np = np.random.normal(size=(batch, seq, heads, depth))
+    value_np = np.random.normal(size=(batch, seq, heads, depth))
+    mask_np = np.where(np.random.uniform(size=(batch, 1, 1, seq)) > 0.8,
+                       -10000.0, 0.0)
+    scale = 1.0 / np.sqrt(depth)
+
+    query = array_ops.placeholder(dtypes.float32, query_np.shape)
+    key = array_ops.placeholder(dtypes.float32, key_np.shape)
+    value = array_ops.placeholder(dtypes.float32, value_np.shape)
+    mask = array_ops.placeholder(dtypes.float32, mask_np.shape)
+    perm = [0, 2, 1, 3]
+    scores = math_ops.matmul(array_ops.transpose(query, perm),
+                             array_ops.transpose(key, perm), transpose_b=True)
+    scores = math_ops.multiply(scores, np.float32(scale))
+    probs = nn_ops.softmax(math_ops.add_v2(scores, mask))
+    context = math_ops.matmul(probs, array_ops.transpose(value, perm))
+    output = array_ops.identity(array_ops.transpose(context, perm))
+
+    output_val, fused = self._RunAndCheckFused(
+        output, {query: query_np, key: key_np, value: value_np,
+                 mask: mask_np})
+    self.assertEqual(fused.attr["query_layout"].s, b"BSHD")
+    self.assertEqual(fused.attr["key_layout"].s, b"BSHD")
+    self.assertEqual(fused.attr["output_layout"].s, b"BSHD")
+    expected = _np_attention(query_np.transpose(perm), key_np.transpose(perm),
+                             value_np.transpose(perm), scale, mask_np)
+    self.assertAllClose(expected.transpose(perm), output_val, rtol=1e-4,
+                        atol=1e-4)
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testKerasEinsum(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("Skip on GPU due to the pattern not supported")
+    # The Einsum equations of the Keras MultiHeadAttention layer, with the
+    # scale applied to the query.
+    batch, seq, heads, depth = 2, 70, 2, 8
+    query_np = np.random.normal(size=(batch, seq, heads, depth))
+    key_np = np.random.normal(size=(batch, seq, heads, depth))
+    value_np = np.random.normal(size=(batch, seq, heads, depth))
+    scale = 1.0 / np.sqrt(depth)
+
+    query = array_ops.placeholder(dtypes.float32, query_np.shape)
+    key = array_ops.placeholder(dtypes.float32, key_np.shape)
+    value = array_ops.placeholder(dtypes.float32, value_np.shape)
+    scaled_query = math_ops.multiply(query, np.float32(scale))
+    scores = special_math_ops.einsum("aecd,abcd->acbe", key, scaled_query)
+    probs = array_ops.identity(nn_ops.softmax(scores))
+    context = special_math_ops.einsum("acbe,aecd->abcd", probs, value)
+    output = array_ops.identity(context)
+
+    output_val, _ = self._RunAndCheckFused(
+        output, {query: query_np, key: key_np, value: value_np})
+    perm = [0, 2, 1, 3]
+    expected = _np_attention(query_np.transpose(perm), key_np.transpose(perm),
+                             value_np.transpose(perm), scale, 0.0)
+    self.assertAllClose(expected.transpose(perm), output_val, rtol=1e-4,
+                        atol=1e-4)
+
+
+if __name__ == "__main__":
+  test_lib.main()
@@ -0,0 +1,84 @@
+# Copyright (c) 2022 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the fusion report of the graph passes."""
+
+import glob
+import json
+import os
+import tempfile
+
+import numpy as np
+import tensorflow as tf
+
+from intel_extension_for_tensorflow.python.test_func import test as test_lib
+
+from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import test_util
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import nn
+
+tf.compat.v1.disable_eager_execution()
+os.environ["ITEX_LAYOUT_OPT"] = "0"
+report_dir = tempfile.mkdtemp()
+os.environ["ITEX_FUSION_REPORT_PATH"] = report_dir
+
+
+@test_util.run_deprecated_v1
+class FusionReportTest(test_lib.TestCase):
+
+  def _LoadReports(self):
+    reports = []
+    for path in glob.glob(os.path.join(report_dir, "fusion_report_*.json")):
+      with open(path) as f:
+        reports.append(json.load(f))
+    return reports
+
+  def testMatMulBiasAddReported(self):
+    a_np = np.random.rand(3, 4).astype(np.float32)
+    b_np = np.random.rand(4, 5).astype(np.float32)
+    bias_np = np.random.rand(5).astype(np.float32)
+
+    a = constant_op.constant(a_np)
+    b = constant_op.constant(b_np)
+    bias = constant_op.constant(bias_np)
+    # The second BiasAdd reads the output of a MatMul which is used twice, so
+    # it can't be fused.
+    c = nn.bias_add(math_ops.matmul(a, b), bias)
+    d = math_ops.matmul(a, b, name="shared_matmul")
+    e = nn.bias_add(d, bias, name="unfused_bias_add")
+    output = array_ops.identity(c + e * d)
+
+    with self.session() as sess:
+      sess.run(output)
+
+    reports = self._LoadReports()
+    self.assertNotEmpty(reports)
+    fused = [fusion for report in reports for fusion in report["fusions"]
+             if fusion["pass"] == "remapper" and
+             fusion["fusion"] == "contraction-with-bias"]
+    self.assertNotEmpty(fused)
+    rejected = [rejection for report in reports
+                for rejection in report["rejected"]
+                if rejection["node"] == "unfused_bias_add"]
+    self.assertNotEmpty(rejected)
+    self.assertEqual(rejected[0]["reason"], "multiple fanout")
+    for report in reports:
+      self.assertEqual(report["estimated_unfused_ops"],
+                       len(report["rejected"]))
+
+
+if __name__ == "__main__":
+  test_lib.main()
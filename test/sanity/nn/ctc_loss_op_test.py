@@ -0,0 +1,113 @@
+# Copyright (c) 2022 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for CTCLoss on CPU."""
+
+import numpy as np
+
+from intel_extension_for_tensorflow.python.test_func import test
+from intel_extension_for_tensorflow.python.test_func import test_util
+
+from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import ops
+from tensorflow.python.framework import sparse_tensor
+from tensorflow.python.ops import ctc_ops
+from tensorflow.python.ops import gradients_impl
+
+
+def _ctc_loss_ref(logits, labels, blank):
+  """Negative log likelihood of `labels` for [time, classes] `logits`."""
+  log_probs = logits - np.logaddexp.reduce(logits, axis=1, keepdims=True)
+  ext = [blank]
+  for label in labels:
+    ext += [label, blank]
+  num_steps, num_states = log_probs.shape[0], len(ext)
+
+  alpha = np.full((num_steps, num_states), -np.inf)
+  alpha[0, 0] = log_probs[0, blank]
+  if num_states > 1:
+    alpha[0, 1] = log_probs[0, ext[1]]
+  for t in range(1, num_steps):
+    for s in range(num_states):
+      a = alpha[t - 1, s]
+      if s > 0:
+        a = np.logaddexp(a, alpha[t - 1, s - 1])
+      if s > 1 and ext[s] != blank and ext[s] != ext[s - 2]:
+        a = np.logaddexp(a, alpha[t - 1, s - 2])
+      alpha[t, s] = a + log_probs[t, ext[s]]
+  log_likelihood = alpha[-1, -1]
+  if num_states > 1:
+    log_likelihood = np.logaddexp(log_likelihood, alpha[-1, -2])
+  return -log_likelihood
+
+
+class CTCLossTest(test.TestCase):
+
+  def _RefLoss(self, inputs, labels, seq_lens):
+    blank = inputs.shape[2] - 1
+    return np.array([
+        _ctc_loss_ref(inputs[:seq_lens[b], b], labels[b], blank)
+        for b in range(inputs.shape[1])
+    ])
+
+  def _RefGrad(self, inputs, labels, seq_lens, eps=1e-4):
+    grad = np.zeros_like(inputs)
+    for index in np.ndindex(*inputs.shape):
+      plus = inputs.copy()
+      minus = inputs.copy()
+      plus[index] += eps
+      minus[index] -= eps
+      batch = index[1]
+      grad[index] = (
+          self._RefLoss(plus, labels, seq_lens)[batch] -
+          self._RefLoss(minus, labels, seq_lens)[batch]) / (2 * eps)
+    return grad
+
+  @test_util.run_deprecated_v1
+  def testLossAndGradient(self):
+    np.random.seed(0)
+    num_steps, num_classes = 8, 5
+    # Repeated labels need a blank between them.
+    labels = [[0, 1, 1, 2], [3, 0], [2]]
+    seq_lens = np.array([8, 6, 3], dtype=np.int32)
+    inputs_np = np.random.normal(
+        size=(num_steps, len(labels), num_classes)).astype(np.float64)
+
+    indices = [[b, i] for b, label in enumerate(labels)
+               for i in range(len(label))]
+    values = [v for label in labels for v in label]
+    dense_shape = [len(labels), max(len(label) for label in labels)]
+
+    with ops.device("/cpu:0"):
+      inputs = constant_op.constant(inputs_np.astype(np.float32))
+      sparse_labels = sparse_tensor.SparseTensor(
+          constant_op.constant(indices, dtype="int64"),
+          constant_op.constant(values, dtype="int32"),
+          constant_op.constant(dense_shape, dtype="int64"))
+      loss = ctc_ops.ctc_loss(sparse_labels, inputs, seq_lens)
+      grad = gradients_impl.gradients(loss, [inputs])[0]
+
+    with self.cached_session(use_gpu=False) as sess:
+      loss_val, grad_val = sess.run([loss, grad])
+
+    self.assertAllClose(self._RefLoss(inputs_np, labels, seq_lens), loss_val,
+                        rtol=1e-5, atol=1e-5)
+    expected_grad = self._RefGrad(inputs_np, labels, seq_lens)
+    self.assertAllClose(expected_grad, grad_val, rtol=1e-4, atol=1e-4)
+    # Steps past the sequence length get no gradient.
+    self.assertAllEqual(np.zeros_like(grad_val[3:, 2]), grad_val[3:, 2])
+
+
+if __name__ == "__main__":
+  test.main()
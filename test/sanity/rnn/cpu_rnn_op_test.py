@@ -0,0 +1,107 @@
+# Copyright (c) 2022 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the ItexRnn LSTM kernel on CPU."""
+
+import numpy as np
+
+from intel_extension_for_tensorflow.python.ops.load_ops_library import load_ops_library
+from intel_extension_for_tensorflow.python.test_func import test
+from intel_extension_for_tensorflow.python.test_func import test_util
+
+from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import ops
+
+
+def _sigmoid(x):
+  return 1 / (1 + np.exp(-x))
+
+
+def _lstm_ref(inputs, h, c, w_x, w_h, bias, w_proj, seq_lens):
+  """Unrolled LSTM with gates i, f, c, o and optional projection."""
+  outputs = np.zeros((inputs.shape[0], inputs.shape[1], h.shape[1]))
+  for t in range(inputs.shape[0]):
+    gates = [inputs[t] @ w_x[g].T + h @ w_h[g].T + bias[g] for g in range(4)]
+    c_t = _sigmoid(gates[1]) * c + _sigmoid(gates[0]) * np.tanh(gates[2])
+    h_t = _sigmoid(gates[3]) * np.tanh(c_t)
+    if w_proj is not None:
+      h_t = h_t @ w_proj.T
+    # Steps past the sequence length keep the state and output zeros.
+    valid = (t < seq_lens)[:, None]
+    h = np.where(valid, h_t, h)
+    c = np.where(valid, c_t, c)
+    outputs[t] = np.where(valid, h_t, 0)
+  return outputs, h, c
+
+
+class CpuRnnTest(test.TestCase):
+
+  def _RunLstm(self, num_proj, var_seq_length):
+    np.random.seed(0)
+    seq_length, batch_size, input_size, cell_size = 5, 3, 4, 6
+    output_size = num_proj if num_proj else cell_size
+    inputs = np.random.normal(size=(seq_length, batch_size, input_size))
+    h = np.random.normal(size=(batch_size, output_size))
+    c = np.random.normal(size=(batch_size, cell_size))
+    w_x = np.random.normal(size=(4, cell_size, input_size)) * 0.5
+    w_h = np.random.normal(size=(4, cell_size, output_size)) * 0.5
+    bias = np.random.normal(size=(4, cell_size)) * 0.5
+    w_proj = (np.random.normal(size=(output_size, cell_size)) * 0.5
+              if num_proj else None)
+    params = [w_x, w_h, bias] + ([w_proj] if num_proj else [])
+    params = np.concatenate([p.ravel() for p in params])
+    if var_seq_length:
+      seq_lens = np.array([5, 2, 0], dtype=np.int32)
+    else:
+      seq_lens = np.full([batch_size], seq_length, dtype=np.int32)
+
+    def _const(x):
+      return constant_op.constant(x.astype(np.float32))
+
+    with ops.device("/cpu:0"):
+      outputs, output_h, output_c, _ = load_ops_library.itex_rnn(
+          input=_const(inputs),
+          input_h=_const(h),
+          input_c=_const(c),
+          params=_const(params),
+          dropout_mask=0.0,
+          recurrent_dropout_mask=0.0,
+          sequence_lengths=seq_lens if var_seq_length else 0,
+          rnn_mode="lstm",
+          num_proj=num_proj,
+          var_seq_length=var_seq_length,
+          is_training=False)
+    with self.cached_session(use_gpu=False) as sess:
+      actual = sess.run([outputs, output_h, output_c])
+
+    expected = _lstm_ref(inputs, h, c, w_x, w_h, bias, w_proj, seq_lens)
+    for e, a in zip(expected, actual):
+      self.assertAllClose(e, a, rtol=1e-5, atol=1e-5)
+
+  @test_util.run_deprecated_v1
+  def testLstm(self):
+    self._RunLstm(num_proj=0, var_seq_length=False)
+
+  @test_util.run_deprecated_v1
+  def testLstmWithProjection(self):
+    self._RunLstm(num_proj=3, var_seq_length=False)
+
+  @test_util.run_deprecated_v1
+  def testLstmWithSequenceLengths(self):
+    self._RunLstm(num_proj=0, var_seq_length=True)
+    self._RunLstm(num_proj=3, var_seq_length=True)
+
+
+if __name__ == "__main__":
+  test.main()
@@ -58,8 +58,6 @@ class AddWithSoftmaxTest(test_lib.TestCase):
   @test_util.run_deprecated_v1
   @test_util.disable_xla('This test does not pass with XLA')
   def testGraphStructure(self):
-    if not test_lib.is_gpu_available():
-      self.skipTest("Skip on CPU due to the pattern not supported")
     run_options = config_pb2.RunOptions(output_partition_graphs=True)
     metadata = config_pb2.RunMetadata()
 
@@ -81,7 +79,66 @@ class AddWithSoftmaxTest(test_lib.TestCase):
         if '_ITEXFusedAddV2WithSoftmax' in node.op:
             existing_pattern = True
             break
-    self.assertTrue(existing_pattern)    
-    
+    self.assertTrue(existing_pattern)
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testBroadcastMask(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("GPU kernel only supports masks of [batch, 1, from, to]")
+    run_options = config_pb2.RunOptions(output_partition_graphs=True)
+    metadata = config_pb2.RunMetadata()
+
+    np_features = np.random.uniform(low=-3.0, high=3.0, size=(2, 4, 3, 37)).astype(np.float32)
+    mask_features = np.random.uniform(low=-3.0, high=3.0, size=(2, 1, 1, 37)).astype(np.float32)
+
+    x_tensor = tf.constant(np_features)
+    mask_tensor = tf.constant(mask_features)
+    new_adder = math_ops.add_v2(mask_tensor, x_tensor)
+    out = nn_ops.softmax(new_adder)
+    final_out = array_ops.identity(out)
+    np_softmax = self._npSoftmax(np_features + mask_features)
+    with self.session(use_gpu=True) as sess:
+        output_val = sess.run(final_out, options=run_options, run_metadata=metadata)
+        graph = metadata.partition_graphs[0]
+    self.assertAllClose(np_softmax, output_val)
+    existing_pattern = False
+    for node in graph.node:
+        if '_ITEXFusedAddV2WithSoftmax' in node.op:
+            existing_pattern = True
+            break
+    self.assertTrue(existing_pattern)
+
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def testMaskWithSameNumElements(self):
+    if test_lib.is_gpu_available():
+      self.skipTest("GPU kernel only supports masks of [batch, 1, from, to]")
+    run_options = config_pb2.RunOptions(output_partition_graphs=True)
+    metadata = config_pb2.RunMetadata()
+
+    # The mask has as many elements as the logits but a lower rank, so the
+    # logits are picked by shape, not by size.
+    np_features = np.random.uniform(low=-3.0, high=3.0, size=(1, 3, 37)).astype(np.float32)
+    mask_features = np.random.uniform(low=-3.0, high=3.0, size=(3, 37)).astype(np.float32)
+
+    x_tensor = tf.constant(np_features)
+    mask_tensor = tf.constant(mask_features)
+    new_adder = math_ops.add_v2(mask_tensor, x_tensor)
+    out = nn_ops.softmax(new_adder)
+    final_out = array_ops.identity(out)
+    np_softmax = self._npSoftmax(np_features + mask_features)
+    with self.session(use_gpu=True) as sess:
+        output_val = sess.run(final_out, options=run_options, run_metadata=metadata)
+        graph = metadata.partition_graphs[0]
+    self.assertAllEqual(np_softmax.shape, output_val.shape)
+    self.assertAllClose(np_softmax, output_val)
+    existing_pattern = False
+    for node in graph.node:
+        if '_ITEXFusedAddV2WithSoftmax' in node.op:
+            existing_pattern = True
+            break
+    self.assertTrue(existing_pattern)
+
 if __name__ == "__main__":
   test_lib.main()
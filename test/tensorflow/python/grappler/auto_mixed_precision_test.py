@@ -229,7 +229,7 @@ def _build_simple_loop_graph(inp_colors, body_colors, out_colors):
   return a
 
 
-def _get_config(auto_mixed_precision_mode):
+def _get_config(auto_mixed_precision_mode, remapper=False):
   """Returns a ConfigProto with auto mixed precision enabled if appropriate."""
   rewrite_config = rewriter_config_pb2.RewriterConfig(
       # do not remove duplicated nodes
@@ -247,7 +247,7 @@ def _get_config(auto_mixed_precision_mode):
     # enable auto mixed precision.
     os.environ['ITEX_AUTO_MIXED_PRECISION'] = '1'
     # disable ramapper. do not turn Conv2D and other nodes into _FusedConv2D
-    os.environ['ITEX_REMAPPER'] = '0'
+    os.environ['ITEX_REMAPPER'] = '1' if remapper else '0'
   else:
     assert auto_mixed_precision_mode is None
     # disable meta optimization.
@@ -358,13 +358,13 @@ class AutoMixedPrecisionTest(test.TestCase, parameterized.TestCase):
     self.assertEqual(node_map[node_name].output_info[output_port].dtype,
                      self._lower_precision_dtype(mode).as_datatype_enum)
 
-  def _run(self, mode, fetches):
+  def _run(self, mode, fetches, remapper=False):
     """Runs the graph and returns the evaluation of the fetches."""
     with session.Session(config=_get_config(None)) as sess:
       sess.run(variables.global_variables_initializer())
       output_val_ref = self.evaluate(fetches)
 
-    with session.Session(config=_get_config(mode)) as sess:
+    with session.Session(config=_get_config(mode, remapper)) as sess:
       sess.run(variables.global_variables_initializer())
       metadata = config_pb2.RunMetadata()
       output_val = sess.run(fetches, run_metadata=metadata)
@@ -668,6 +668,63 @@ class AutoMixedPrecisionTest(test.TestCase, parameterized.TestCase):
     self._assert_output_f16(mode, node_map, 'while/Tanh_1')
     self.assertAllClose(output_val_ref, output_val, atol=1e-3, rtol=1e-3)
 
+  @parameterized.parameters(['bfloat16'])
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def test_cost_model(self, mode):
+    """Test the cost model keeps only the clusters worth their casts."""
+    if test.is_gpu_available():
+      self.skipTest('The cost model only supports CPU')
+    os.environ['ITEX_AUTO_MIXED_PRECISION_COST_MODEL'] = '1'
+    try:
+      with ops.device(_get_device()):
+        random_seed.set_random_seed(0)
+        # The casts of the small MatMul move more bytes than it saves.
+        small = nn.relu(math_ops.matmul(_input([2, 8]), _weight([8, 8])))
+        large = nn.relu(
+            math_ops.matmul(_input([256, 512]), _weight([512, 512])))
+        output = (array_ops.identity(small), array_ops.identity(large))
+
+      output_val_ref, output_val, cost_graph = self._run(mode, output)
+    finally:
+      del os.environ['ITEX_AUTO_MIXED_PRECISION_COST_MODEL']
+    node_map = _build_node_map(cost_graph.node)
+
+    self.assertEqual(node_map['MatMul'].output_info[0].dtype,
+                     types_pb2.DT_FLOAT)
+    self._assert_output_f16(mode, node_map, 'MatMul_1')
+    self.assertAllClose(output_val_ref, output_val, atol=5e-2, rtol=5e-2)
+
+  @parameterized.parameters(['bfloat16'])
+  @test_util.run_deprecated_v1
+  @test_util.disable_xla('This test does not pass with XLA')
+  def test_cost_model_with_remapper(self, mode):
+    """Test the cost model on the contractions fused by the remapper."""
+    if test.is_gpu_available():
+      self.skipTest('The cost model only supports CPU')
+    os.environ['ITEX_AUTO_MIXED_PRECISION_COST_MODEL'] = '1'
+    try:
+      with ops.device(_get_device()):
+        random_seed.set_random_seed(0)
+        # The fused nodes are named after the Relu they replace.
+        small = nn.relu(nn.bias_add(
+            math_ops.matmul(_input([2, 8]), _weight([8, 8])), _bias([8])))
+        large = nn.relu(nn.bias_add(
+            math_ops.matmul(_input([256, 512]), _weight([512, 512])),
+            _bias([512])))
+        output = (array_ops.identity(small), array_ops.identity(large))
+
+      output_val_ref, output_val, cost_graph = self._run(
+          mode, output, remapper=True)
+    finally:
+      del os.environ['ITEX_AUTO_MIXED_PRECISION_COST_MODEL']
+    node_map = _build_node_map(cost_graph.node)
+
+    self.assertEqual(node_map['Relu'].output_info[0].dtype,
+                     types_pb2.DT_FLOAT)
+    self._assert_output_f16(mode, node_map, 'Relu_1')
+    self.assertAllClose(output_val_ref, output_val, atol=5e-2, rtol=5e-2)
+
   @parameterized.parameters(['float16', 'bfloat16'])
   @test_util.run_v1_only('v1 loop test')
   @test_util.disable_xla('This test does not pass with XLA')